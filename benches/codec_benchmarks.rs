@@ -0,0 +1,313 @@
+//! PACK and binary packet codec benchmarks
+//!
+//! Throughput is reported in bytes, so criterion prints MB/s for every
+//! decoder and encoder. The corpus has two kinds of PACK:
+//!
+//! - auth responses laid out the way SoftEther servers send them: a
+//!   `Welcome` PACK with session keys, `pencore` padding and the hub's
+//!   policy set, with and without trailing binary session data
+//! - synthetic PACKs of 10 to 10,000 elements (the decoder's limit) mixing
+//!   every value type
+//!
+//! `pack_ip_scan` times the address scans of auth-response session data.
+//!
+//! Captured server responses carry session keys, so none are checked in.
+//! To bench your own, point `RVPNSE_PACK_CORPUS` at a directory of raw
+//! PACK bodies (`*.pack`, the HTTP response body as received).
+
+use bytes::{BufMut, Bytes, BytesMut};
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use rvpnse::protocol::binary::SoftEtherPacket;
+use rvpnse::protocol::pack::IpAssignment;
+use rvpnse::protocol::{ElementType, Pack, PackView};
+use rvpnse::tunnel::packet_framing::PacketHeader;
+use std::hint::black_box;
+use std::path::Path;
+
+/// Synthetic PACK sizes, in elements
+const SYNTHETIC_ELEMENTS: [usize; 4] = [10, 100, 1000, 10_000];
+
+/// Session data scanned in the large `pack_ip_scan` case
+const IP_SCAN_LARGE: usize = 64 * 1024;
+
+/// Binary packet payload sizes: TCP ACK, mixed-traffic mean, full MTU
+const PACKET_SIZES: [usize; 3] = [64, 512, 1400];
+
+/// Policies a SoftEther 4.x hub sends in its welcome PACK, as `policy:<name>`
+const POLICIES: [&str; 38] = [
+    "Access", "DHCPFilter", "DHCPNoServer", "DHCPForce", "NoBridge", "NoRouting", "CheckMac", "CheckIP",
+    "ArpDhcpOnly", "PrivacyFilter", "NoServer", "NoBroadcastLimiter", "MonitorPort", "MaxConnection",
+    "TimeOut", "MaxMac", "MaxIP", "MaxUpload", "MaxDownload", "FixPassword", "MultiLogins", "NoQoS",
+    "RSandRAFilter", "RAFilter", "DHCPv6Filter", "DHCPv6NoServer", "NoRoutingV6", "CheckIPv6",
+    "NoServerV6", "MaxIPv6", "NoSavePassword", "AutoDisconnect", "FilterIPv4", "FilterIPv6",
+    "FilterNonIP", "NoIPv6DefaultRouterInRA", "NoIPv6DefaultRouterInRAWhenIPv6", "VLanId",
+];
+
+/// Deterministic filler so every run benches the same bytes
+struct Filler(u64);
+
+impl Filler {
+    fn bytes(&mut self, len: usize) -> Vec<u8> {
+        (0..len)
+            .map(|_| {
+                self.0 = self.0.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+                (self.0 >> 56) as u8
+            })
+            .collect()
+    }
+}
+
+/// PACK body under construction, in server wire layout
+///
+/// Servers pad names and values to four bytes and put three zero bytes
+/// between elements; `Pack::to_bytes` does neither, so encoder output is
+/// not a fair decoder input.
+struct WirePack {
+    elements: u32,
+    body: BytesMut,
+}
+
+impl WirePack {
+    fn new() -> Self {
+        Self { elements: 0, body: BytesMut::new() }
+    }
+
+    fn element(&mut self, name: &str, element_type: ElementType, values: &[&[u8]]) {
+        let name_len = name.len() + 1;
+        self.body.put_u32(name_len as u32);
+        self.body.put_slice(name.as_bytes());
+        self.body.put_u8(0);
+        self.body.put_bytes(0, ((name_len + 3) & !3) - name_len);
+        self.body.put_u8(0);
+        self.body.put_u32(element_type as u32);
+        self.body.put_u32(values.len() as u32);
+        for value in values {
+            self.body.put_u32(value.len() as u32);
+            self.body.put_slice(value);
+            self.body.put_bytes(0, ((value.len() + 3) & !3) - value.len());
+        }
+        self.body.put_bytes(0, 3);
+        self.elements += 1;
+    }
+
+    fn int(&mut self, name: &str, value: u32) {
+        self.element(name, ElementType::Int, &[&value.to_be_bytes()]);
+    }
+
+    fn int64(&mut self, name: &str, value: u64) {
+        self.element(name, ElementType::Int64, &[&value.to_be_bytes()]);
+    }
+
+    fn data(&mut self, name: &str, value: &[u8]) {
+        self.element(name, ElementType::Data, &[value]);
+    }
+
+    fn str(&mut self, name: &str, value: &str) {
+        self.element(name, ElementType::Str, &[value.as_bytes()]);
+    }
+
+    fn unistr(&mut self, name: &str, value: &str) {
+        let utf16: Vec<u8> = value.encode_utf16().flat_map(u16::to_le_bytes).collect();
+        self.element(name, ElementType::UniStr, &[&utf16]);
+    }
+
+    /// Append binary session data: an element-shaped header with an
+    /// out-of-range type, which the decoders stop at
+    fn session_data(&mut self, data: &[u8]) {
+        self.body.put_u32(4);
+        self.body.put_slice(b"ipc\0");
+        self.body.put_u32(0x0001_0000);
+        self.body.put_slice(data);
+        self.elements += 1;
+    }
+
+    fn finish(self) -> Bytes {
+        let mut out = BytesMut::with_capacity(4 + self.body.len());
+        out.put_u32(self.elements);
+        out.extend_from_slice(&self.body);
+        out.freeze()
+    }
+}
+
+/// Welcome PACK of a successful login
+///
+/// With `session_data`, ends in a binary blob holding the assigned
+/// addresses among other bytes, as some servers' responses do.
+fn auth_response(filler: &mut Filler, session_data: bool) -> Bytes {
+    let mut pack = WirePack::new();
+    pack.str("session_name", "SID-BENCH-[SECURENAT]-7");
+    pack.str("connection_name", "CID-BENCH-42");
+    pack.int("max_connection", 8);
+    pack.int("use_encrypt", 1);
+    pack.int("use_compress", 0);
+    pack.int("half_connection", 0);
+    pack.int("timeout", 20_000);
+    pack.int("qos", 0);
+    pack.int("is_azure_session", 0);
+    pack.data("session_key", &filler.bytes(20));
+    pack.int("session_key_32", 0x5eed_1234);
+    pack.int("enable_udp_recovery", 1);
+    pack.int64("server_ticks", 1_728_000_000_000);
+    pack.unistr("hub_message", "Welcome to the bench hub");
+    for (i, policy) in POLICIES.iter().enumerate() {
+        pack.int(&format!("policy:{}", policy), (i % 3) as u32);
+    }
+    pack.data("pencore", &filler.bytes(731));
+
+    if session_data {
+        let mut blob = filler.bytes(1536);
+        // Assigned address, gateway and mask somewhere in the middle
+        blob[700..704].copy_from_slice(&[10, 21, 255, 23]);
+        blob[708..712].copy_from_slice(&[10, 21, 255, 1]);
+        blob[716..720].copy_from_slice(&[255, 255, 255, 0]);
+        pack.session_data(&blob);
+    }
+    pack.finish()
+}
+
+/// PACK of `elements` elements cycling through every value type
+fn synthetic(filler: &mut Filler, elements: usize) -> Bytes {
+    let mut pack = WirePack::new();
+    for i in 0..elements {
+        let name = format!("element_{}", i);
+        match i % 5 {
+            0 => pack.int(&name, i as u32),
+            1 => pack.int64(&name, (i as u64) << 33),
+            2 => pack.str(&name, "softether-bench-value"),
+            3 => pack.data(&name, &filler.bytes(32)),
+            _ => pack.unistr(&name, "ユニコード"),
+        }
+    }
+    pack.finish()
+}
+
+/// Named PACK bodies to decode
+fn corpus() -> Vec<(String, Bytes)> {
+    let mut filler = Filler(0x5eed);
+    let mut corpus = vec![
+        ("auth_response".to_string(), auth_response(&mut filler, false)),
+        ("auth_response_session_data".to_string(), auth_response(&mut filler, true)),
+    ];
+    for elements in SYNTHETIC_ELEMENTS {
+        corpus.push((format!("synthetic_{}", elements), synthetic(&mut filler, elements)));
+    }
+
+    if let Ok(dir) = std::env::var("RVPNSE_PACK_CORPUS") {
+        let mut recorded: Vec<_> = std::fs::read_dir(&dir)
+            .unwrap_or_else(|e| panic!("RVPNSE_PACK_CORPUS {}: {}", dir, e))
+            .filter_map(|entry| entry.ok().map(|entry| entry.path()))
+            .filter(|path| path.extension().is_some_and(|ext| ext == "pack"))
+            .collect();
+        recorded.sort();
+        for path in recorded {
+            let name = Path::new(&path).file_stem().unwrap().to_string_lossy().into_owned();
+            let data = std::fs::read(&path).unwrap_or_else(|e| panic!("{}: {}", path.display(), e));
+            corpus.push((format!("recorded_{}", name), Bytes::from(data)));
+        }
+    }
+
+    for (name, data) in &corpus {
+        if let Err(e) = PackView::parse(data) {
+            panic!("corpus PACK {} does not decode: {}", name, e);
+        }
+    }
+    corpus
+}
+
+/// Owned decoding against the zero-copy view it is built on
+fn pack_decode_benchmark(c: &mut Criterion) {
+    let mut group = c.benchmark_group("pack_decode");
+    for (name, data) in corpus() {
+        group.throughput(Throughput::Bytes(data.len() as u64));
+        group.bench_with_input(BenchmarkId::new("pack_from_bytes", &name), &data, |b, data| {
+            b.iter(|| black_box(Pack::from_bytes(black_box(data.clone())).unwrap()));
+        });
+        group.bench_with_input(BenchmarkId::new("pack_view_parse", &name), &data, |b, data| {
+            b.iter(|| black_box(PackView::parse(black_box(data)).unwrap()));
+        });
+    }
+    group.finish();
+}
+
+/// Encoding the decoded corpus, into a fresh buffer and into a reused one
+fn pack_encode_benchmark(c: &mut Criterion) {
+    let mut group = c.benchmark_group("pack_encode");
+    for (name, data) in corpus() {
+        let pack = Pack::from_bytes(data).unwrap();
+        group.throughput(Throughput::Bytes(pack.encoded_len() as u64));
+        group.bench_with_input(BenchmarkId::new("to_bytes", &name), &pack, |b, pack| {
+            b.iter(|| black_box(black_box(pack).to_bytes().unwrap()));
+        });
+        let mut buf = BytesMut::with_capacity(pack.encoded_len());
+        group.bench_with_input(BenchmarkId::new("encode_into", &name), &pack, |b, pack| {
+            b.iter(|| {
+                buf.clear();
+                black_box(pack).encode_into(&mut buf).unwrap();
+                black_box(&buf);
+            });
+        });
+    }
+    group.finish();
+}
+
+/// Address scans over binary session data
+///
+/// The auth response's own session data, plus a large blob with the
+/// assigned address at its end, which every scan has to read through.
+fn pack_ip_scan_benchmark(c: &mut Criterion) {
+    let mut filler = Filler(0x1d);
+    let auth = Pack::from_bytes(auth_response(&mut filler, true)).unwrap();
+    let mut blob = filler.bytes(IP_SCAN_LARGE);
+    blob[IP_SCAN_LARGE - 4..].copy_from_slice(&[10, 251, 8, 33]);
+    let large = Pack::new().with_binary_session_data(Bytes::from(blob));
+
+    let mut group = c.benchmark_group("pack_ip_scan");
+    for (name, pack) in [("auth_response", &auth), ("large", &large)] {
+        let session_data = pack.get_binary_session_data().unwrap();
+        group.throughput(Throughput::Bytes(session_data.len() as u64));
+        group.bench_with_input(BenchmarkId::new("extract_ip_configuration", name), pack, |b, pack| {
+            b.iter(|| black_box(black_box(pack).extract_ip_configuration()));
+        });
+        group.bench_with_input(BenchmarkId::new("analyze_for_ip_addresses", name), pack, |b, pack| {
+            b.iter(|| black_box(black_box(pack).analyze_for_ip_addresses()));
+        });
+        group.bench_with_input(BenchmarkId::new("ip_assignment_scan", name), session_data, |b, data| {
+            b.iter(|| black_box(IpAssignment::scan(black_box(data))));
+        });
+    }
+    group.finish();
+}
+
+/// Binary protocol packet and tunnel frame header codecs
+fn packet_codec_benchmark(c: &mut Criterion) {
+    let mut group = c.benchmark_group("softether_packet");
+    for size in PACKET_SIZES {
+        let packet = SoftEtherPacket::create_data_packet(7, 1, Bytes::from(vec![0x45; size]));
+        let wire = packet.to_bytes();
+        group.throughput(Throughput::Bytes(wire.len() as u64));
+        group.bench_with_input(BenchmarkId::new("to_bytes", size), &packet, |b, packet| {
+            b.iter(|| black_box(black_box(packet).to_bytes()));
+        });
+        group.bench_with_input(BenchmarkId::new("from_bytes", size), &wire, |b, wire| {
+            b.iter(|| black_box(SoftEtherPacket::from_bytes(black_box(wire.clone())).unwrap()));
+        });
+    }
+    group.finish();
+
+    let mut group = c.benchmark_group("packet_header");
+    let header = PacketHeader::new(PacketHeader::TYPE_DATA, 7, 1400).to_bytes();
+    group.throughput(Throughput::Bytes(PacketHeader::SIZE as u64));
+    group.bench_function("from_bytes", |b| {
+        b.iter(|| black_box(PacketHeader::from_bytes(black_box(&header)).unwrap()));
+    });
+    group.finish();
+}
+
+criterion_group!(
+    benches,
+    pack_decode_benchmark,
+    pack_encode_benchmark,
+    pack_ip_scan_benchmark,
+    packet_codec_benchmark
+);
+criterion_main!(benches);
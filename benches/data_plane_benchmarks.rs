@@ -0,0 +1,300 @@
+//! Data plane benchmarks against a loopback mock SoftEther server
+//!
+//! Each group connects through the real setup path (watermark, login PACK,
+//! binary hello and session over one TLS connection) and then moves packets
+//! through the split `BinaryProtocolClient` data channel: framing, vectored
+//! writes, TLS and batched reads, plus AES-GCM sealing in `sealed_echo`.
+//!
+//! Besides criterion's timings, every case prints pps, Gbit/s, per-packet
+//! p50/p99 latency and heap allocations per packet, and the figures are
+//! saved to `target/criterion/data_plane/summary.json` for
+//! `scripts/run-benchmarks.sh`. Allocations are counted on the client thread
+//! only; the mock server runs on a thread of its own.
+//!
+//! `engine` hosts [`ENGINE_SESSIONS`] idle sessions on one `SessionEngine`
+//! and prints the heap each of them holds, then times a send to all of them.
+
+mod support;
+
+use bytes::{Bytes, BytesMut};
+use criterion::{criterion_group, BenchmarkId, Criterion, Throughput};
+use rvpnse::crypto::{SessionCipher, SEAL_OVERHEAD};
+use rvpnse::monitoring::LatencyHistogram;
+use rvpnse::protocol::binary::{BinaryDataReader, BinaryDataWriter, DataReadHalf, DataWriteHalf};
+use rvpnse::{EngineConfig, SessionEngine, SessionKey};
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+use support::{DataMode, DataPlaneReport, MockServer};
+
+#[global_allocator]
+static ALLOCATOR: support::CountingAllocator = support::CountingAllocator;
+
+/// IP packet sizes: TCP ACK, a typical mixed-traffic mean, full MTU
+const PACKET_SIZES: [usize; 3] = [64, 512, 1400];
+
+/// Packets per send batch, as the packet pump sends them
+const BATCH: usize = 32;
+
+/// Packets moved for each summary measurement
+const REPORT_PACKETS: u64 = 64 * 1024;
+
+/// Sessions hosted by the engine benchmark
+const ENGINE_SESSIONS: usize = 256;
+
+/// Client side of an established data channel
+struct Channel {
+    reader: BinaryDataReader<DataReadHalf>,
+    writer: BinaryDataWriter<DataWriteHalf>,
+    received: Vec<Bytes>,
+}
+
+impl Channel {
+    fn open(runtime: &tokio::runtime::Runtime, server: &MockServer) -> Self {
+        let (reader, writer) = runtime
+            .block_on(server.connect())
+            .and_then(|channel| channel.into_split())
+            .expect("mock server session");
+        Self { reader, writer, received: Vec::with_capacity(BATCH) }
+    }
+
+    /// Send `payloads` as one batch and wait for all of them to come back
+    async fn echo(&mut self, payloads: &mut [Vec<u8>], epoch: Instant, latency: Option<&LatencyHistogram>) {
+        for payload in payloads.iter_mut() {
+            support::stamp(payload, epoch);
+        }
+        self.writer.send_batch(payloads.iter().map(Vec::as_slice)).await.unwrap();
+        let mut remaining = payloads.len();
+        while remaining > 0 {
+            remaining -= self.reader.recv_batch(remaining, &mut self.received).await.unwrap();
+            if let Some(latency) = latency {
+                for packet in &self.received {
+                    latency.record(support::stamped_latency(packet, epoch));
+                }
+            }
+            self.received.clear();
+        }
+    }
+}
+
+/// Seals outbound and opens inbound payloads in reused buffers
+struct Sealer {
+    cipher: SessionCipher,
+    sealed: BytesMut,
+    /// End offset of each sealed payload in `sealed`
+    ends: Vec<usize>,
+    opened: Vec<u8>,
+}
+
+impl Sealer {
+    fn new() -> Self {
+        Self {
+            cipher: SessionCipher::new(&[0x42; 32]).unwrap(),
+            sealed: BytesMut::with_capacity(BATCH * (1500 + SEAL_OVERHEAD)),
+            ends: Vec::with_capacity(BATCH),
+            opened: Vec::with_capacity(1500 + SEAL_OVERHEAD),
+        }
+    }
+
+    /// Seal, send, receive and open one batch
+    async fn echo(&mut self, channel: &mut Channel, payloads: &mut [Vec<u8>], epoch: Instant, latency: Option<&LatencyHistogram>) {
+        self.sealed.clear();
+        self.ends.clear();
+        for payload in payloads.iter_mut() {
+            support::stamp(payload, epoch);
+            self.cipher.seal_into(payload, &mut self.sealed).unwrap();
+            self.ends.push(self.sealed.len());
+        }
+        let sealed = &self.sealed;
+        let frames = self.ends.iter().scan(0, |start, &end| {
+            let frame = &sealed[*start..end];
+            *start = end;
+            Some(frame)
+        });
+        channel.writer.send_batch(frames).await.unwrap();
+
+        let mut remaining = payloads.len();
+        while remaining > 0 {
+            remaining -= channel.reader.recv_batch(remaining, &mut channel.received).await.unwrap();
+            for packet in channel.received.drain(..) {
+                self.opened.clear();
+                self.opened.extend_from_slice(&packet);
+                let plaintext = self.cipher.open_in_place(&mut self.opened).unwrap();
+                if let Some(latency) = latency {
+                    latency.record(support::stamped_latency(plaintext, epoch));
+                }
+            }
+        }
+    }
+}
+
+fn payloads(size: usize) -> Vec<Vec<u8>> {
+    (0..BATCH).map(|i| vec![i as u8; size]).collect()
+}
+
+fn client_runtime() -> tokio::runtime::Runtime {
+    let runtime = tokio::runtime::Builder::new_current_thread().enable_all().build().unwrap();
+    support::count_allocations_on_this_thread();
+    runtime
+}
+
+/// Batches of packets out to the server and back, as a ping-pong
+fn echo_benchmark(c: &mut Criterion) {
+    let runtime = client_runtime();
+    let server = MockServer::start(DataMode::Echo);
+    let mut channel = Channel::open(&runtime, &server);
+    let epoch = Instant::now();
+
+    let mut group = c.benchmark_group("data_plane_echo");
+    group.measurement_time(Duration::from_secs(5));
+    for size in PACKET_SIZES {
+        let mut batch = payloads(size);
+        support::record(DataPlaneReport::measure("echo", size, REPORT_PACKETS, |latency| {
+            runtime.block_on(async {
+                for _ in 0..REPORT_PACKETS / BATCH as u64 {
+                    channel.echo(&mut batch, epoch, Some(latency)).await;
+                }
+            })
+        }));
+
+        group.throughput(Throughput::Elements(BATCH as u64));
+        group.bench_with_input(BenchmarkId::new("round_trip", size), &size, |b, _| {
+            b.iter_custom(|iters| {
+                runtime.block_on(async {
+                    let started = Instant::now();
+                    for _ in 0..iters {
+                        channel.echo(&mut batch, epoch, None).await;
+                    }
+                    started.elapsed()
+                })
+            });
+        });
+    }
+    group.finish();
+}
+
+/// Packets streamed to a server that drops them: the uplink's bulk rate
+fn uplink_benchmark(c: &mut Criterion) {
+    let runtime = client_runtime();
+    let server = MockServer::start(DataMode::Sink);
+    let mut channel = Channel::open(&runtime, &server);
+
+    let mut group = c.benchmark_group("data_plane_uplink");
+    group.measurement_time(Duration::from_secs(5));
+    for size in PACKET_SIZES {
+        let batch = payloads(size);
+        support::record(DataPlaneReport::measure("uplink", size, REPORT_PACKETS, |_| {
+            runtime.block_on(async {
+                for _ in 0..REPORT_PACKETS / BATCH as u64 {
+                    channel.writer.send_batch(batch.iter().map(Vec::as_slice)).await.unwrap();
+                }
+            })
+        }));
+
+        group.throughput(Throughput::Bytes((BATCH * size) as u64));
+        group.bench_with_input(BenchmarkId::new("send_batch", size), &size, |b, _| {
+            b.iter_custom(|iters| {
+                runtime.block_on(async {
+                    let started = Instant::now();
+                    for _ in 0..iters {
+                        channel.writer.send_batch(batch.iter().map(Vec::as_slice)).await.unwrap();
+                    }
+                    started.elapsed()
+                })
+            });
+        });
+    }
+    group.finish();
+}
+
+/// Echo with every payload sealed on the way out and opened on the way back
+fn sealed_echo_benchmark(c: &mut Criterion) {
+    let runtime = client_runtime();
+    let server = MockServer::start(DataMode::Echo);
+    let mut channel = Channel::open(&runtime, &server);
+    let mut sealer = Sealer::new();
+    let epoch = Instant::now();
+
+    let mut group = c.benchmark_group("data_plane_sealed_echo");
+    group.measurement_time(Duration::from_secs(5));
+    for size in PACKET_SIZES {
+        let mut batch = payloads(size);
+        support::record(DataPlaneReport::measure("sealed_echo", size, REPORT_PACKETS, |latency| {
+            runtime.block_on(async {
+                for _ in 0..REPORT_PACKETS / BATCH as u64 {
+                    sealer.echo(&mut channel, &mut batch, epoch, Some(latency)).await;
+                }
+            })
+        }));
+
+        group.throughput(Throughput::Elements(BATCH as u64));
+        group.bench_with_input(BenchmarkId::new("round_trip", size), &size, |b, _| {
+            b.iter_custom(|iters| {
+                runtime.block_on(async {
+                    let started = Instant::now();
+                    for _ in 0..iters {
+                        sealer.echo(&mut channel, &mut batch, epoch, None).await;
+                    }
+                    started.elapsed()
+                })
+            });
+        });
+    }
+    group.finish();
+}
+
+/// Many idle sessions on one engine: heap per session, then a packet to each
+fn engine_benchmark(c: &mut Criterion) {
+    let server = MockServer::start(DataMode::Sink);
+    let config = EngineConfig { worker_threads: 2, ..EngineConfig::default() };
+    let engine = SessionEngine::new(config, Arc::new(|_, packets: &mut Vec<Bytes>| packets.clear())).unwrap();
+
+    // One session first, so one-off setup (TLS config, pools) is not counted
+    let warmup = engine.runtime().block_on(server.connect()).and_then(|channel| engine.attach(channel)).unwrap();
+    std::thread::sleep(Duration::from_millis(100));
+    let heap_before = support::heap_in_use();
+    let keys: Vec<SessionKey> = (0..ENGINE_SESSIONS)
+        .map(|_| engine.runtime().block_on(server.connect()).and_then(|channel| engine.attach(channel)).unwrap())
+        .collect();
+    // Let setup leftovers (HTTP clients, handshake buffers) drop
+    std::thread::sleep(Duration::from_millis(500));
+    let per_session = (support::heap_in_use() - heap_before) as f64 / ENGINE_SESSIONS as f64;
+    println!("engine: {} idle sessions, {:.1} KiB heap per session", ENGINE_SESSIONS, per_session / 1024.0);
+
+    let payload = vec![0u8; 64];
+    let fan_out = || async {
+        for &key in &keys {
+            engine.send(key, [payload.as_slice()]).await.unwrap();
+        }
+    };
+    support::record(DataPlaneReport::measure("engine_fan_out", payload.len(), (ENGINE_SESSIONS * 64) as u64, |_| {
+        engine.runtime().block_on(async {
+            for _ in 0..64 {
+                fan_out().await;
+            }
+        })
+    }));
+
+    let mut group = c.benchmark_group("data_plane_engine");
+    group.throughput(Throughput::Elements(ENGINE_SESSIONS as u64));
+    group.bench_function(BenchmarkId::new("fan_out", ENGINE_SESSIONS), |b| {
+        b.iter_custom(|iters| {
+            engine.runtime().block_on(async {
+                let started = Instant::now();
+                for _ in 0..iters {
+                    fan_out().await;
+                }
+                started.elapsed()
+            })
+        });
+    });
+    group.finish();
+    engine.close(warmup);
+}
+
+criterion_group!(benches, echo_benchmark, uplink_benchmark, sealed_echo_benchmark, engine_benchmark);
+
+fn main() {
+    benches();
+    Criterion::default().configure_from_args().final_summary();
+    support::write_summary();
+}
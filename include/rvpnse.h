@@ -6,10 +6,12 @@
  * 
  * Usage:
  * 1. Parse and validate configuration with vpnse_parse_config()
- * 2. Create client instance with vpnse_client_new()
+ * 2. Create client instance with vpnse_client_new(), or compile the
+ *    configuration once with vpnse_config_compile() and create any number
+ *    of clients from it with vpnse_client_new_from_config()
  * 3. Connect to server with vpnse_client_connect()
  * 4. Authenticate with vpnse_client_authenticate()
- * 5. Handle packet forwarding in your application
+ * 5. Forward packets with vpnse_client_send_batch() / vpnse_client_recv_batch()
  * 6. Disconnect with vpnse_client_disconnect()
  * 7. Free client with vpnse_client_free()
  */
@@ -56,6 +58,49 @@ typedef enum {
  */
 typedef struct vpnse_client vpnse_client_t;
 
+/**
+ * Opaque handle of a parsed and validated configuration
+ */
+typedef struct vpnse_config vpnse_config_t;
+
+/**
+ * Caller-owned packet buffer for batched packet I/O
+ */
+typedef struct {
+    uint8_t* data;  /**< Start of the packet buffer */
+    size_t len;     /**< Packet length (send) or capacity in / length out (receive) */
+} vpnse_iovec;
+
+/**
+ * Latency percentiles of one data path direction, in microseconds
+ */
+typedef struct {
+    uint64_t count;    /**< Packets measured */
+    uint64_t mean_us;
+    uint64_t p50_us;
+    uint64_t p90_us;
+    uint64_t p99_us;
+    uint64_t max_us;
+} vpnse_latency_t;
+
+/**
+ * Data path counters, filled in by vpnse_client_get_stats()
+ */
+typedef struct {
+    uint64_t active;               /**< 1 while the packet pump runs; all else is 0 otherwise */
+    uint64_t uplink_packets;       /**< Read from TUN and sent to the server */
+    uint64_t uplink_bytes;
+    uint64_t downlink_packets;     /**< Received from the server and written to TUN */
+    uint64_t downlink_bytes;
+    vpnse_latency_t uplink_latency;   /**< TUN read -> data channel write */
+    vpnse_latency_t downlink_latency; /**< Data channel read -> TUN write */
+    uint64_t backpressure_events;  /**< Times a pipeline stage waited on a full queue */
+    uint64_t transport_losses;     /**< Data channels lost under the running tunnel */
+    uint64_t resumes;              /**< Replacement data channels taken over */
+    uint64_t tunnel_mtu;           /**< Current tunnel MTU */
+    uint64_t mss_clamped;          /**< TCP SYNs whose MSS was clamped */
+} vpnse_stats_t;
+
 /**
  * Parse and validate a SoftEther VPN configuration
  * 
@@ -74,6 +119,33 @@ int vpnse_parse_config(const char* config_str, char* error_msg, size_t error_msg
  */
 vpnse_client_t* vpnse_client_new(const char* config_str);
 
+/**
+ * Parse and validate a configuration once, for creating many clients
+ * 
+ * @param config_str TOML configuration string (null-terminated)
+ * @param error_msg Output buffer for error messages (can be NULL)
+ * @param error_msg_len Size of error message buffer
+ * @return Configuration handle on success, NULL on failure
+ */
+const vpnse_config_t* vpnse_config_compile(const char* config_str, char* error_msg, size_t error_msg_len);
+
+/**
+ * Create a new VPN client from a compiled configuration
+ * 
+ * The client shares the configuration; the handle may be freed afterwards.
+ * 
+ * @param config Handle from vpnse_config_compile()
+ * @return Opaque pointer to VPN client on success, NULL on failure
+ */
+vpnse_client_t* vpnse_client_new_from_config(const vpnse_config_t* config);
+
+/**
+ * Free a compiled configuration handle
+ * 
+ * @param config Handle from vpnse_config_compile() (can be NULL)
+ */
+void vpnse_config_free(const vpnse_config_t* config);
+
 /**
  * Connect to SoftEther VPN server
  * 
@@ -124,6 +196,63 @@ const char* vpnse_version(void);
  */
 int vpnse_client_status(const vpnse_client_t* client);
 
+/**
+ * Send a batch of packets through the VPN data channel
+ * 
+ * The batch is written with a single call into the library; buffers are
+ * only read and remain owned by the caller.
+ * 
+ * @param client VPN client instance (must be authenticated)
+ * @param pkts Array of packet buffers
+ * @param n Number of packets in the batch
+ * @return VPNSE_SUCCESS on success, error code on failure
+ */
+int vpnse_client_send_batch(vpnse_client_t* client, const vpnse_iovec* pkts, size_t n);
+
+/**
+ * Receive a batch of packets from the VPN data channel
+ * 
+ * Packets are copied directly into the caller's buffers. On input each
+ * pkts[i].len is the buffer capacity; on output it holds the packet length
+ * for the first *received entries. A packet that does not fit is kept for
+ * the next call.
+ * 
+ * @param client VPN client instance (must be authenticated)
+ * @param pkts Array of caller-owned packet buffers
+ * @param n Number of buffers available
+ * @param received Output for the number of packets stored
+ * @param timeout_ms Maximum time to wait for the first packet (0 polls)
+ * @return VPNSE_SUCCESS on success (including timeout with *received == 0),
+ *         VPNSE_BUFFER_TOO_SMALL if the next packet does not fit in pkts[0],
+ *         error code on failure
+ */
+int vpnse_client_recv_batch(vpnse_client_t* client, vpnse_iovec* pkts, size_t n,
+                            size_t* received, uint32_t timeout_ms);
+
+/**
+ * Resume the tunnel on new data channels after a network change
+ * 
+ * Keeps the TUN interface, routes, DNS and assigned IP and rejoins the
+ * existing session; traffic read meanwhile is queued and sent once the
+ * new channels connect.
+ * 
+ * @param client VPN client instance with an established tunnel
+ * @return VPNSE_SUCCESS on success, error code on failure
+ */
+int vpnse_client_resume_session(vpnse_client_t* client);
+
+/**
+ * Read the data path counters and latency percentiles
+ * 
+ * Cheap enough to poll every second; nothing is formatted or allocated.
+ * 
+ * @param client VPN client instance
+ * @param stats Output structure, fully overwritten
+ * @return VPNSE_SUCCESS on success (stats->active == 0 when no tunnel is
+ *         forwarding), VPNSE_INVALID_PARAMETER if an argument is NULL
+ */
+int vpnse_client_get_stats(const vpnse_client_t* client, vpnse_stats_t* stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,6 +13,10 @@ NC='\033[0m' # No Color
 # Configuration
 BENCHMARK_DIR="target/criterion"
 REPORT_DIR="benchmark-reports"
+# Written by data_plane_benchmarks; one entry per traffic pattern and packet size
+DATA_PLANE_SUMMARY="$BENCHMARK_DIR/data_plane/summary.json"
+# Packets/s drop, in percent, that counts as a data plane regression
+REGRESSION_THRESHOLD="${REGRESSION_THRESHOLD:-10}"
 DATE=$(date +"%Y-%m-%d_%H-%M-%S")
 COMMIT_HASH=$(git rev-parse --short HEAD 2>/dev/null || echo "unknown")
 
@@ -42,6 +46,47 @@ run_benchmark() {
     fi
 }
 
+# Keep this run's data plane figures and compare them with the previous run's
+#
+# Prints a markdown table; returns 1 if any case lost more than
+# REGRESSION_THRESHOLD percent of its packets/s.
+check_data_plane() {
+    local current="$REPORT_DIR/data-plane-$DATE.json"
+    [ -f "$DATA_PLANE_SUMMARY" ] || return 0
+
+    local previous
+    previous=$(ls -1 "$REPORT_DIR"/data-plane-*.json 2>/dev/null | sort | tail -n 1 || true)
+    cp "$DATA_PLANE_SUMMARY" "$current"
+
+    python3 - "$current" "${previous:-}" "$REGRESSION_THRESHOLD" <<'PY'
+import json, sys
+
+current_path, previous_path, threshold = sys.argv[1], sys.argv[2], float(sys.argv[3])
+current = json.load(open(current_path))["benchmarks"]
+previous = {}
+if previous_path:
+    previous = {(b["name"], b["packet_size"]): b for b in json.load(open(previous_path))["benchmarks"]}
+
+def us(value):
+    return "-" if value is None else f"{value:.1f}"
+
+regressions = 0
+print("| Benchmark | Size | pps | Gbit/s | p50 µs | p99 µs | allocs/pkt | vs previous |")
+print("|-----------|------|-----|--------|--------|--------|------------|-------------|")
+for b in current:
+    change = "-"
+    before = previous.get((b["name"], b["packet_size"]))
+    if before and before["pps"]:
+        delta = (b["pps"] - before["pps"]) * 100.0 / before["pps"]
+        change = f"{delta:+.1f}%"
+        if delta < -threshold:
+            change += " ⚠️"
+            regressions += 1
+    print(f"| {b['name']} | {b['packet_size']} | {b['pps']:.0f} | {b['gbps']:.3f} | {us(b['p50_us'])} | {us(b['p99_us'])} | {b['allocs_per_packet']:.3f} | {change} |")
+sys.exit(1 if regressions else 0)
+PY
+}
+
 # Function to generate summary report
 generate_summary() {
     local report_file="$REPORT_DIR/benchmark-summary-$DATE.md"
@@ -64,6 +109,18 @@ and FFI interface performance.
 
 EOF
 
+    if [ -f "$DATA_PLANE_SUMMARY" ]; then
+        echo "### Data Plane" >> "$report_file"
+        echo "" >> "$report_file"
+        if check_data_plane >> "$report_file"; then
+            DATA_PLANE_REGRESSED=0
+        else
+            DATA_PLANE_REGRESSED=1
+            echo -e "${RED}⚠️  Data plane throughput regressed by more than ${REGRESSION_THRESHOLD}%${NC}"
+        fi
+        echo "" >> "$report_file"
+    fi
+
     # Add individual benchmark summaries if available
     if [ -d "$BENCHMARK_DIR" ]; then
         echo "### Available Benchmark Data" >> "$report_file"
@@ -98,6 +155,18 @@ EOF
 - **Memory Safety**: Pointer validation and memory management
 - **Throughput**: Data processing rates across the FFI boundary
 
+### Data Plane
+- **Echo**: Packet batches through a loopback mock SoftEther server and back
+- **Uplink**: Bulk send rate into a server that drops the packets
+- **Sealed Echo**: Echo with AES-GCM sealing and opening per packet
+- **Allocations**: Heap allocations per packet on the client thread
+
+### Codecs
+- **PACK Decoding**: Owned and zero-copy decoding of auth responses and PACKs of up to 10,000 elements, in MB/s
+- **PACK Encoding**: Serialization into fresh and reused buffers
+- **IP Scans**: Address extraction from binary session data
+- **Packets**: Binary protocol packet and tunnel frame header codecs
+
 ## Platform Information
 
 - **OS**: $(uname -s) $(uname -r)
@@ -145,8 +214,10 @@ generate_metrics() {
         "ffi_interface": {
             "status": "completed",
             "metrics_available": $([ -d "$BENCHMARK_DIR/ffi_benchmarks" ] && echo "true" || echo "false")
-        }
-    }
+        },
+        "data_plane": $([ -f "$DATA_PLANE_SUMMARY" ] && cat "$DATA_PLANE_SUMMARY" || echo "null")
+    },
+    "data_plane_regressed": ${DATA_PLANE_REGRESSED:-0}
 }
 EOF
 
@@ -168,7 +239,7 @@ main() {
     
     # Run benchmarks
     local success_count=0
-    local total_count=3
+    local total_count=5
     
     if run_benchmark "config_benchmarks" "Configuration Parsing Benchmarks"; then
         ((success_count++))
@@ -182,6 +253,14 @@ main() {
         ((success_count++))
     fi
     
+    if run_benchmark "data_plane_benchmarks" "Data Plane Benchmarks"; then
+        ((success_count++))
+    fi
+    
+    if run_benchmark "codec_benchmarks" "Codec Benchmarks"; then
+        ((success_count++))
+    fi
+    
     echo ""
     echo -e "${BLUE}📈 Benchmark Results Summary${NC}"
     echo -e "${BLUE}=========================${NC}"
@@ -207,6 +286,10 @@ main() {
     if [ -d "$BENCHMARK_DIR" ]; then
         echo "Detailed results in: $BENCHMARK_DIR/"
     fi
+
+    if [ "${DATA_PLANE_REGRESSED:-0}" -eq 1 ] && [ "${FAIL_ON_REGRESSION:-0}" -eq 1 ]; then
+        exit 1
+    fi
 }
 
 # Handle script arguments
@@ -220,6 +303,14 @@ case "${1:-all}" in
     "ffi")
         run_benchmark "ffi_benchmarks" "FFI Interface Benchmarks"
         ;;
+    "data-plane")
+        mkdir -p "$REPORT_DIR"
+        run_benchmark "data_plane_benchmarks" "Data Plane Benchmarks"
+        check_data_plane
+        ;;
+    "codec")
+        run_benchmark "codec_benchmarks" "Codec Benchmarks"
+        ;;
     "all"|*)
         main
         ;;
@@ -0,0 +1,245 @@
+//! Packet Buffer Pool
+//!
+//! Fixed-size `BytesMut` chunks (MTU plus headroom) that are handed out for
+//! packet reads and returned to the pool when dropped, so steady-state packet
+//! I/O reuses a bounded set of buffers instead of allocating per packet.
+
+use bytes::{Bytes, BytesMut};
+use std::ops::{Deref, DerefMut};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+
+/// Extra room beyond the MTU, enough for protocol headers in front of a full-size payload
+pub const DEFAULT_HEADROOM: usize = 64;
+
+/// Default number of idle buffers a pool keeps
+pub const DEFAULT_POOL_CAPACITY: usize = 1024;
+
+/// Pool usage counters
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct BufferPoolStats {
+    /// Buffers served from the free list
+    pub hits: u64,
+    /// Buffers that had to be allocated
+    pub misses: u64,
+    /// Buffers returned to the free list
+    pub recycled: u64,
+    /// Buffers freed because the pool was full or they were oversized
+    pub discarded: u64,
+    /// Buffers currently idle in the pool
+    pub available: usize,
+}
+
+struct PoolInner {
+    buffer_size: usize,
+    max_idle: usize,
+    free: Mutex<Vec<BytesMut>>,
+    hits: AtomicU64,
+    misses: AtomicU64,
+    recycled: AtomicU64,
+    discarded: AtomicU64,
+}
+
+/// Shared pool of packet buffers; clones share the same free list
+#[derive(Clone)]
+pub struct BufferPool {
+    inner: Arc<PoolInner>,
+}
+
+impl BufferPool {
+    /// Create a pool of `buffer_size` chunks keeping at most `max_idle` idle buffers
+    pub fn new(buffer_size: usize, max_idle: usize) -> Self {
+        Self {
+            inner: Arc::new(PoolInner {
+                buffer_size,
+                max_idle,
+                free: Mutex::new(Vec::with_capacity(max_idle.min(DEFAULT_POOL_CAPACITY))),
+                hits: AtomicU64::new(0),
+                misses: AtomicU64::new(0),
+                recycled: AtomicU64::new(0),
+                discarded: AtomicU64::new(0),
+            }),
+        }
+    }
+
+    /// Create a pool sized for packets up to `mtu` bytes
+    pub fn for_mtu(mtu: usize) -> Self {
+        Self::new(mtu + DEFAULT_HEADROOM, DEFAULT_POOL_CAPACITY)
+    }
+
+    /// Size of the chunks this pool hands out
+    pub fn buffer_size(&self) -> usize {
+        self.inner.buffer_size
+    }
+
+    /// Take an empty buffer with at least `buffer_size()` capacity
+    pub fn acquire(&self) -> PooledBuffer {
+        let recycled = self.inner.free.lock().unwrap().pop();
+        let buf = match recycled {
+            Some(buf) => {
+                self.inner.hits.fetch_add(1, Ordering::Relaxed);
+                buf
+            }
+            None => {
+                self.inner.misses.fetch_add(1, Ordering::Relaxed);
+                BytesMut::with_capacity(self.inner.buffer_size)
+            }
+        };
+        PooledBuffer {
+            buf: Some(buf),
+            pool: self.inner.clone(),
+        }
+    }
+
+    /// Take an empty buffer with room for `len` bytes
+    ///
+    /// Requests larger than the chunk size are allocated directly and counted
+    /// as misses; they are not kept when dropped.
+    pub fn acquire_for(&self, len: usize) -> PooledBuffer {
+        if len <= self.inner.buffer_size {
+            return self.acquire();
+        }
+        self.inner.misses.fetch_add(1, Ordering::Relaxed);
+        PooledBuffer {
+            buf: Some(BytesMut::with_capacity(len)),
+            pool: self.inner.clone(),
+        }
+    }
+
+    /// Snapshot of the pool counters
+    pub fn stats(&self) -> BufferPoolStats {
+        BufferPoolStats {
+            hits: self.inner.hits.load(Ordering::Relaxed),
+            misses: self.inner.misses.load(Ordering::Relaxed),
+            recycled: self.inner.recycled.load(Ordering::Relaxed),
+            discarded: self.inner.discarded.load(Ordering::Relaxed),
+            available: self.inner.free.lock().unwrap().len(),
+        }
+    }
+}
+
+impl std::fmt::Debug for BufferPool {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("BufferPool")
+            .field("buffer_size", &self.inner.buffer_size)
+            .field("stats", &self.stats())
+            .finish()
+    }
+}
+
+/// Buffer on loan from a [`BufferPool`], returned to it on drop
+pub struct PooledBuffer {
+    buf: Option<BytesMut>,
+    pool: Arc<PoolInner>,
+}
+
+impl PooledBuffer {
+    /// Convert into immutable `Bytes` without copying
+    ///
+    /// The chunk goes back to the pool once the last `Bytes` view of it
+    /// (including slices) is dropped.
+    pub fn freeze(self) -> Bytes {
+        Bytes::from_owner(self)
+    }
+}
+
+impl Deref for PooledBuffer {
+    type Target = BytesMut;
+
+    fn deref(&self) -> &BytesMut {
+        self.buf.as_ref().expect("buffer present until drop")
+    }
+}
+
+impl DerefMut for PooledBuffer {
+    fn deref_mut(&mut self) -> &mut BytesMut {
+        self.buf.as_mut().expect("buffer present until drop")
+    }
+}
+
+impl AsRef<[u8]> for PooledBuffer {
+    fn as_ref(&self) -> &[u8] {
+        self.buf.as_deref().unwrap_or(&[])
+    }
+}
+
+impl Drop for PooledBuffer {
+    fn drop(&mut self) {
+        let Some(mut buf) = self.buf.take() else {
+            return;
+        };
+
+        // Only standard-size chunks go back; anything split or grown is freed
+        let capacity = buf.capacity();
+        if capacity >= self.pool.buffer_size && capacity <= self.pool.buffer_size * 2 {
+            buf.clear();
+            let mut free = self.pool.free.lock().unwrap();
+            if free.len() < self.pool.max_idle {
+                free.push(buf);
+                self.pool.recycled.fetch_add(1, Ordering::Relaxed);
+                return;
+            }
+        }
+        self.pool.discarded.fetch_add(1, Ordering::Relaxed);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use bytes::BufMut;
+
+    #[test]
+    fn test_buffers_are_recycled() {
+        let pool = BufferPool::new(1564, 4);
+
+        let mut buf = pool.acquire();
+        buf.put_slice(b"packet");
+        drop(buf);
+
+        let buf = pool.acquire();
+        assert!(buf.is_empty());
+        assert!(buf.capacity() >= 1564);
+        drop(buf);
+
+        let stats = pool.stats();
+        assert_eq!(stats.misses, 1);
+        assert_eq!(stats.hits, 1);
+        assert_eq!(stats.recycled, 2);
+        assert_eq!(stats.available, 1);
+    }
+
+    #[test]
+    fn test_frozen_views_return_buffer_on_last_drop() {
+        let pool = BufferPool::new(128, 4);
+
+        let mut buf = pool.acquire();
+        buf.put_slice(b"header+payload");
+        let frozen = buf.freeze();
+        let payload = frozen.slice(7..);
+        drop(frozen);
+        assert_eq!(pool.stats().available, 0);
+
+        assert_eq!(&payload[..], b"payload");
+        drop(payload);
+        assert_eq!(pool.stats().available, 1);
+    }
+
+    #[test]
+    fn test_oversized_and_overflow_buffers_are_discarded() {
+        let pool = BufferPool::new(64, 1);
+
+        drop(pool.acquire_for(4096));
+        assert_eq!(pool.stats().discarded, 1);
+
+        let a = pool.acquire();
+        let b = pool.acquire();
+        drop(a);
+        drop(b);
+
+        let stats = pool.stats();
+        assert_eq!(stats.available, 1);
+        assert_eq!(stats.discarded, 2);
+        assert_eq!(stats.misses, 3);
+    }
+}
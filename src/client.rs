@@ -3,16 +3,23 @@
 //! This module provides the main VpnClient struct that handles `SoftEther` SSL-VPN
 //! protocol communication and tunnel management.
 
-use crate::config::Config;
+use crate::config::{ClusteringConfig, CompiledConfig, Config};
 use crate::error::{Result, VpnError};
 use crate::protocol::{AuthClient, ProtocolHandler};
 use crate::protocol::binary::BinaryProtocolClient;
+#[cfg(any(unix, target_os = "windows"))]
+use crate::protocol::connection::SessionConnection;
+use crate::protocol::keepalive::{KeepaliveScheduler, KeepaliveTimer};
 use crate::protocol::session::SessionManager;
 use crate::tunnel::{TunnelConfig, TunnelManager};
+#[cfg(any(unix, target_os = "windows"))]
+use crate::tunnel::DataChannelConnect;
+use bytes::Bytes;
 use std::collections::HashMap;
+use std::hash::{BuildHasher, RandomState};
 use std::net::{SocketAddr, ToSocketAddrs};
-use std::sync::atomic::{AtomicU32, Ordering};
-use std::sync::{Arc, Mutex};
+use std::sync::atomic::{AtomicU32, AtomicU64, Ordering};
+use std::sync::{Arc, Mutex, RwLock};
 use std::time::{Duration, Instant};
 
 /// Cluster node information
@@ -23,7 +30,156 @@ pub struct ClusterNode {
     pub is_healthy: bool,
     pub active_connections: u32,
     pub last_health_check: Instant,
+    /// Smoothed handshake RTT (EWMA over health check probes)
     pub response_time: Duration,
+    /// Number of RTT samples folded into `response_time`
+    pub rtt_samples: u32,
+    /// Relative share of new connections; 0 drains the node
+    pub weight: u32,
+    /// Running credit for smooth weighted round-robin
+    current_weight: i64,
+    /// When this client last failed to reach the node; outranks older probes
+    failed_at: Option<Instant>,
+}
+
+/// Fold an RTT sample into a smoothed estimate (gain 1/8, as TCP's SRTT)
+fn smooth_rtt(current: Duration, samples: u32, sample: Duration) -> Duration {
+    if samples == 0 {
+        sample
+    } else {
+        (current * 7 + sample) / 8
+    }
+}
+
+impl ClusterNode {
+    /// Fold a handshake RTT into the smoothed estimate
+    pub fn record_rtt(&mut self, sample: Duration) {
+        self.response_time = smooth_rtt(self.response_time, self.rtt_samples, sample);
+        self.rtt_samples = self.rtt_samples.saturating_add(1);
+    }
+
+    /// Mark the node unhealthy until a probe newer than this failure says otherwise
+    fn mark_failed(&mut self) {
+        self.is_healthy = false;
+        self.failed_at = Some(Instant::now());
+    }
+
+    /// Take over the health fields of a published probe result
+    ///
+    /// A local failure since the probe keeps the node unhealthy.
+    fn apply_health(&mut self, health: &NodeHealth) {
+        self.endpoint = health.endpoint.or(self.endpoint);
+        if self.failed_at.map_or(true, |failed_at| health.last_health_check > failed_at) {
+            self.is_healthy = health.is_healthy;
+            self.failed_at = None;
+        }
+        self.response_time = health.response_time;
+        self.rtt_samples = health.rtt_samples;
+        self.last_health_check = health.last_health_check;
+    }
+
+    /// Whether new connections may go to this node
+    fn is_selectable(&self) -> bool {
+        self.is_healthy && self.weight > 0
+    }
+
+    /// Expected cost of one more connection: RTT scaled by load over weight
+    ///
+    /// Nodes without an RTT sample score as if they had a one second RTT, so
+    /// measured nodes win until the health check has probed the rest.
+    fn load_score(&self) -> u128 {
+        let rtt = if self.rtt_samples == 0 { Duration::from_secs(1) } else { self.response_time };
+        rtt.as_micros().max(1) * u128::from(self.active_connections + 1) / u128::from(self.weight.max(1))
+    }
+}
+
+/// Health of one cluster node as last measured by the prober
+#[derive(Debug, Clone)]
+pub struct NodeHealth {
+    pub endpoint: Option<SocketAddr>,
+    pub is_healthy: bool,
+    /// Smoothed handshake RTT
+    pub response_time: Duration,
+    pub rtt_samples: u32,
+    pub last_health_check: Instant,
+    /// Whether the prober has tried this node yet, successful or not
+    pub probed: bool,
+}
+
+impl NodeHealth {
+    fn from_node(node: &ClusterNode) -> Self {
+        Self {
+            endpoint: node.endpoint,
+            is_healthy: node.is_healthy,
+            response_time: node.response_time,
+            rtt_samples: node.rtt_samples,
+            last_health_check: node.last_health_check,
+            probed: false,
+        }
+    }
+
+    /// Resolve `address` and time a TCP handshake to it
+    async fn probe(&mut self, address: &str, timeout: Duration) {
+        let resolved = tokio::net::lookup_host(address).await.ok().and_then(|mut addrs| addrs.next());
+        self.is_healthy = false;
+        if let Some(addr) = resolved {
+            self.endpoint = Some(addr);
+            let started = Instant::now();
+            if let Ok(Ok(_stream)) = tokio::time::timeout(timeout, tokio::net::TcpStream::connect(addr)).await {
+                self.response_time = smooth_rtt(self.response_time, self.rtt_samples, started.elapsed());
+                self.rtt_samples = self.rtt_samples.saturating_add(1);
+                self.is_healthy = true;
+            }
+        }
+        self.last_health_check = Instant::now();
+        self.probed = true;
+    }
+}
+
+/// Latest node health table, swapped in whole by the prober
+///
+/// Readers take the read lock only long enough to clone an `Arc`, and check
+/// the generation first, so selecting a node never waits on a probe.
+#[derive(Debug)]
+struct HealthBoard {
+    generation: AtomicU64,
+    nodes: RwLock<Arc<Vec<NodeHealth>>>,
+}
+
+impl HealthBoard {
+    fn new(nodes: Vec<NodeHealth>) -> Self {
+        Self {
+            generation: AtomicU64::new(0),
+            nodes: RwLock::new(Arc::new(nodes)),
+        }
+    }
+
+    fn load(&self) -> Arc<Vec<NodeHealth>> {
+        Arc::clone(&self.nodes.read().unwrap())
+    }
+
+    fn publish(&self, nodes: Vec<NodeHealth>) {
+        *self.nodes.write().unwrap() = Arc::new(nodes);
+        self.generation.fetch_add(1, Ordering::Release);
+    }
+}
+
+/// Probe every due node concurrently and return the new health table
+async fn sweep_health(
+    addresses: &[String],
+    previous: &[NodeHealth],
+    timeout: Duration,
+    is_due: impl Fn(&NodeHealth) -> bool,
+) -> Vec<NodeHealth> {
+    let mut next = previous.to_vec();
+    futures::future::join_all(
+        next.iter_mut()
+            .zip(addresses)
+            .filter(|(health, _)| is_due(health))
+            .map(|(health, address)| health.probe(address, timeout)),
+    )
+    .await;
+    next
 }
 
 /// Cluster manager for handling multiple VPN endpoints
@@ -32,22 +188,42 @@ pub struct ClusterManager {
     nodes: Vec<ClusterNode>,
     current_node_index: usize,
     total_connections: u32,
-    config: crate::config::ClusteringConfig,
+    config: Arc<ClusteringConfig>,
     last_failover: Instant,
+    /// Health results shared with the background prober
+    health: Arc<HealthBoard>,
+    /// Board generation last copied into `nodes`
+    health_generation: u64,
+    /// Background prober started by `spawn_health_checks`
+    health_task: Option<tokio::task::JoinHandle<()>>,
 }
 
 impl ClusterManager {
-    pub fn new(config: crate::config::ClusteringConfig) -> Self {
-        let nodes = config.cluster_nodes.iter().map(|addr| {
+    pub fn new(config: ClusteringConfig) -> Self {
+        Self::with_endpoints(Arc::new(config), &[])
+    }
+
+    /// Share a compiled config's clustering section and resolved node addresses
+    pub fn from_compiled(config: &CompiledConfig) -> Self {
+        Self::with_endpoints(Arc::clone(config.clustering()), config.cluster_endpoints())
+    }
+
+    fn with_endpoints(config: Arc<ClusteringConfig>, endpoints: &[Option<SocketAddr>]) -> Self {
+        let nodes = config.cluster_nodes.iter().enumerate().map(|(i, addr)| {
             ClusterNode {
                 address: addr.clone(),
-                endpoint: None,
+                endpoint: endpoints.get(i).copied().flatten(),
                 is_healthy: true,
                 active_connections: 0,
                 last_health_check: Instant::now(),
                 response_time: Duration::from_millis(0),
+                rtt_samples: 0,
+                weight: config.node_weights.get(i).copied().unwrap_or(1),
+                current_weight: 0,
+                failed_at: None,
             }
-        }).collect();
+        }).collect::<Vec<_>>();
+        let health = Arc::new(HealthBoard::new(nodes.iter().map(NodeHealth::from_node).collect()));
 
         Self {
             nodes,
@@ -55,14 +231,57 @@ impl ClusterManager {
             total_connections: 0,
             config,
             last_failover: Instant::now(),
+            health,
+            health_generation: 0,
+            health_task: None,
         }
     }
 
+    /// Start probing all nodes concurrently every `health_check_interval`
+    ///
+    /// Results are published to a shared snapshot that node selection picks
+    /// up without waiting. Must be called inside a tokio runtime; replaces
+    /// any prober already running.
+    pub fn spawn_health_checks(&mut self) {
+        let addresses: Vec<String> = self.nodes.iter().map(|n| n.address.clone()).collect();
+        let interval = Duration::from_secs(self.config.health_check_interval.max(1) as u64);
+        let timeout = Duration::from_millis(self.config.health_check_timeout_ms as u64);
+        let board = Arc::clone(&self.health);
+
+        let task = tokio::spawn(async move {
+            let mut ticker = tokio::time::interval(interval);
+            loop {
+                ticker.tick().await;
+                let next = sweep_health(&addresses, &board.load(), timeout, |_| true).await;
+                board.publish(next);
+            }
+        });
+        if let Some(previous) = self.health_task.replace(task) {
+            previous.abort();
+        }
+    }
+
+    /// Copy newly published health results into the node table
+    fn sync_health(&mut self) {
+        let generation = self.health.generation.load(Ordering::Acquire);
+        if generation == self.health_generation {
+            return;
+        }
+        let snapshot = self.health.load();
+        for (node, health) in self.nodes.iter_mut().zip(snapshot.iter()) {
+            node.apply_health(health);
+        }
+        self.health_generation = generation;
+    }
+
     /// Get the next available node based on load balancing strategy
+    ///
+    /// Uses the latest published health results; never waits on a probe.
     pub fn get_next_node(&mut self) -> Option<&mut ClusterNode> {
         if self.nodes.is_empty() {
             return None;
         }
+        self.sync_health();
 
         match self.config.load_balancing_strategy {
             crate::config::LoadBalancingStrategy::RoundRobin => {
@@ -91,8 +310,22 @@ impl ClusterManager {
                 let node_index = healthy_indices[idx];
                 Some(&mut self.nodes[node_index])
             },
-            _ => {
-                // Default to round-robin for other strategies
+            crate::config::LoadBalancingStrategy::WeightedRoundRobin => {
+                let index = self.next_weighted_index()?;
+                Some(&mut self.nodes[index])
+            },
+            crate::config::LoadBalancingStrategy::LeastLatency => {
+                // Unmeasured nodes sort last
+                self.nodes.iter_mut()
+                    .filter(|n| n.is_selectable())
+                    .min_by_key(|n| (n.rtt_samples == 0, n.response_time))
+            },
+            crate::config::LoadBalancingStrategy::PowerOfTwoChoices => {
+                let index = self.power_of_two_index()?;
+                Some(&mut self.nodes[index])
+            },
+            crate::config::LoadBalancingStrategy::ConsistentHashing => {
+                // No session key to hash on here; fall back to round-robin
                 let current_index = self.current_node_index;
                 self.current_node_index = (self.current_node_index + 1) % self.nodes.len();
                 Some(&mut self.nodes[current_index])
@@ -100,6 +333,85 @@ impl ClusterManager {
         }
     }
 
+    /// Smooth weighted round-robin: every pick, each node earns its weight in
+    /// credit and the richest node is chosen and pays back the total, which
+    /// interleaves nodes in proportion to weight
+    fn next_weighted_index(&mut self) -> Option<usize> {
+        let mut total = 0i64;
+        let mut best: Option<(usize, i64)> = None;
+        for (i, node) in self.nodes.iter_mut().enumerate() {
+            if !node.is_selectable() {
+                continue;
+            }
+            node.current_weight += i64::from(node.weight);
+            total += i64::from(node.weight);
+            if best.map_or(true, |(_, credit)| node.current_weight > credit) {
+                best = Some((i, node.current_weight));
+            }
+        }
+        let (best, _) = best?;
+        self.nodes[best].current_weight -= total;
+        Some(best)
+    }
+
+    /// Power of two choices: sample two selectable nodes, keep the cheaper
+    fn power_of_two_index(&self) -> Option<usize> {
+        let candidates: Vec<usize> = self.nodes.iter()
+            .enumerate()
+            .filter_map(|(i, n)| n.is_selectable().then_some(i))
+            .collect();
+        match candidates.len() {
+            0 => None,
+            1 => Some(candidates[0]),
+            n => {
+                let a = fastrand::usize(..n);
+                let b = (a + 1 + fastrand::usize(..n - 1)) % n;
+                let (a, b) = (candidates[a], candidates[b]);
+                Some(if self.nodes[b].load_score() < self.nodes[a].load_score() { b } else { a })
+            }
+        }
+    }
+
+    /// Addresses to race for a new connection, tagged with their node index
+    ///
+    /// Starts with the strategy's pick, then other selectable nodes by
+    /// smoothed RTT. Nodes not yet resolved are looked up now; those that
+    /// fail to resolve are marked unhealthy.
+    pub async fn connect_candidates(&mut self, max: usize) -> Vec<(usize, SocketAddr)> {
+        let Some(first) = self.get_next_node().map(|n| n.address.clone()) else {
+            return Vec::new();
+        };
+        let mut order: Vec<usize> = self.nodes.iter().position(|n| n.address == first).into_iter().collect();
+        let mut rest: Vec<usize> = (0..self.nodes.len())
+            .filter(|&i| !order.contains(&i) && self.nodes[i].is_selectable())
+            .collect();
+        rest.sort_by_key(|&i| (self.nodes[i].rtt_samples == 0, self.nodes[i].response_time));
+        order.extend(rest);
+
+        let mut candidates = Vec::with_capacity(max);
+        for index in order {
+            if candidates.len() >= max {
+                break;
+            }
+            let node = &mut self.nodes[index];
+            let addrs = match node.endpoint {
+                Some(endpoint) => vec![endpoint],
+                None => match tokio::net::lookup_host(node.address.clone()).await {
+                    Ok(addrs) => interleave_families(addrs.collect()),
+                    Err(e) => {
+                        log::warn!("Failed to resolve cluster node {}: {}", node.address, e);
+                        node.mark_failed();
+                        continue;
+                    }
+                },
+            };
+            node.endpoint = node.endpoint.or(addrs.first().copied());
+            candidates.extend(addrs.into_iter().map(|addr| (index, addr)));
+        }
+        candidates.truncate(max);
+        candidates
+    }
+
     /// Update peer count (current active peers across cluster)
     pub fn update_peer_count(&mut self, count: u32) {
         // Update the total peer count in the configuration
@@ -123,25 +435,23 @@ impl ClusterManager {
     }
 
     /// Perform health check on cluster nodes
+    ///
+    /// Resolves each due node and times a TCP handshake to it, all nodes in
+    /// parallel; the handshake RTT feeds the node's smoothed `response_time`.
+    /// Nodes that fail to resolve or connect within `health_check_timeout_ms`
+    /// are marked unhealthy. Nodes never probed are due at once; a node whose
+    /// first probe failed stays unhealthy until its next interval.
     pub async fn health_check(&mut self) -> Result<()> {
-        for node in &mut self.nodes {
-            if node.last_health_check.elapsed() > Duration::from_secs(self.config.health_check_interval as u64) {
-                // Simple health check - try to resolve the address
-                match node.address.to_socket_addrs() {
-                    Ok(mut addrs) => {
-                        if let Some(addr) = addrs.next() {
-                            node.endpoint = Some(addr);
-                            node.is_healthy = true;
-                            node.last_health_check = Instant::now();
-                        }
-                    },
-                    Err(_) => {
-                        node.is_healthy = false;
-                        node.last_health_check = Instant::now();
-                    }
-                }
-            }
-        }
+        let addresses: Vec<String> = self.nodes.iter().map(|n| n.address.clone()).collect();
+        let interval = Duration::from_secs(self.config.health_check_interval as u64);
+        let timeout = Duration::from_millis(self.config.health_check_timeout_ms as u64);
+
+        let next = sweep_health(&addresses, &self.health.load(), timeout, |health| {
+            !health.probed || health.last_health_check.elapsed() > interval
+        })
+        .await;
+        self.health.publish(next);
+        self.sync_health();
         Ok(())
     }
 
@@ -150,6 +460,7 @@ impl ClusterManager {
         if self.last_failover.elapsed() < Duration::from_secs(self.config.failover_timeout as u64) {
             return None; // Too soon for another failover
         }
+        self.sync_health();
 
         // Find next healthy node
         for _ in 0..self.nodes.len() {
@@ -165,6 +476,81 @@ impl ClusterManager {
     }
 }
 
+/// Head start each racing connect attempt gives the previous one
+const HAPPY_EYEBALLS_DELAY: Duration = Duration::from_millis(200);
+
+/// Most addresses a single connect races
+pub const MAX_RACING_CANDIDATES: usize = 4;
+
+/// Order addresses alternately by family, starting with the first one's
+fn interleave_families(addrs: Vec<SocketAddr>) -> Vec<SocketAddr> {
+    let Some(first) = addrs.first() else {
+        return addrs;
+    };
+    let first_is_v6 = first.is_ipv6();
+    let mut ordered = Vec::with_capacity(addrs.len());
+    let (preferred, other): (Vec<SocketAddr>, Vec<SocketAddr>) =
+        addrs.into_iter().partition(|a| a.is_ipv6() == first_is_v6);
+    let (mut preferred, mut other) = (preferred.into_iter(), other.into_iter());
+    loop {
+        match (preferred.next(), other.next()) {
+            (None, None) => break,
+            (a, b) => ordered.extend(a.into_iter().chain(b)),
+        }
+    }
+    ordered
+}
+
+/// Happy-eyeballs race (RFC 8305): start `connect` on each candidate in
+/// turn, giving each attempt a `stagger` head start before the next begins
+/// (or less, if it fails sooner). The first success wins and the attempts
+/// still running are dropped, which cancels them.
+async fn race_connects<T, F, Fut>(candidates: &[SocketAddr], stagger: Duration, connect: F) -> Result<T>
+where
+    F: Fn(SocketAddr) -> Fut,
+    Fut: std::future::Future<Output = Result<T>>,
+{
+    use futures::stream::{FuturesUnordered, StreamExt};
+
+    let mut pending = candidates.iter().copied();
+    let mut attempts = FuturesUnordered::new();
+    let mut last_error = None;
+    loop {
+        if attempts.is_empty() {
+            match pending.next() {
+                Some(addr) => attempts.push(connect(addr)),
+                None => break,
+            }
+        }
+        tokio::select! {
+            Some(result) = attempts.next() => match result {
+                Ok(connection) => return Ok(connection),
+                Err(e) => {
+                    log::debug!("Connect attempt failed: {}", e);
+                    last_error = Some(e);
+                    if let Some(addr) = pending.next() {
+                        attempts.push(connect(addr));
+                    }
+                }
+            },
+            _ = tokio::time::sleep(stagger), if pending.len() > 0 => {
+                if let Some(addr) = pending.next() {
+                    attempts.push(connect(addr));
+                }
+            }
+        }
+    }
+    Err(last_error.unwrap_or_else(|| VpnError::Connection("No addresses to connect to".to_string())))
+}
+
+impl Drop for ClusterManager {
+    fn drop(&mut self) {
+        if let Some(task) = self.health_task.take() {
+            task.abort();
+        }
+    }
+}
+
 /// Connection status enumeration
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
 pub enum ConnectionStatus {
@@ -185,10 +571,12 @@ pub enum ConnectionStatus {
 /// - Connection retry management
 /// - SSL-VPN clustering and RPC farm support
 pub struct VpnClient {
-    config: Config,
+    config: Arc<CompiledConfig>,
     auth_client: Option<AuthClient>,
     protocol_handler: Option<ProtocolHandler>,
     session_manager: Option<SessionManager>,
+    /// Idle timer on the shared keepalive wheel while the keepalive loop runs
+    keepalive_timer: Option<Arc<KeepaliveTimer>>,
     tunnel_manager: Option<TunnelManager>,
     status: ConnectionStatus,
     server_endpoint: Option<SocketAddr>,
@@ -198,6 +586,15 @@ pub struct VpnClient {
 
     /// Global connection tracker (shared across all clients if needed)
     connection_tracker: Arc<ConnectionTracker>,
+
+    /// Binary data channel created by start_tunneling_mode
+    binary_client: Option<BinaryProtocolClient>,
+
+    /// Runtime that owns the data channel socket for blocking (FFI) callers
+    data_runtime: Option<tokio::runtime::Runtime>,
+
+    /// Session the data channels joined (0 until one is established), for resuming
+    data_session_id: Arc<AtomicU32>,
 }
 
 impl VpnClient {
@@ -206,23 +603,15 @@ impl VpnClient {
     /// # Errors
     /// Returns an error if the configuration is invalid or connection tracking setup fails
     pub fn new(config: Config) -> Result<Self> {
-        let cluster_manager = if config.clustering.enabled {
-            Some(ClusterManager::new(config.clustering.clone()))
-        } else {
-            None
-        };
+        Ok(Self::from_compiled(CompiledConfig::compile(config)?))
+    }
 
-        Ok(VpnClient {
-            config,
-            auth_client: None,
-            protocol_handler: None,
-            session_manager: None,
-            tunnel_manager: None,
-            status: ConnectionStatus::Disconnected,
-            server_endpoint: None,
-            cluster_manager,
-            connection_tracker: Arc::new(ConnectionTracker::new()),
-        })
+    /// Create a new VPN client sharing an already compiled configuration
+    ///
+    /// Nothing is parsed, validated or cloned; use this to start many clients
+    /// from one template.
+    pub fn from_compiled(config: Arc<CompiledConfig>) -> Self {
+        Self::with_tracker(config, Arc::new(ConnectionTracker::new()))
     }
 
     /// Create a new VPN client with shared connection tracking
@@ -231,23 +620,31 @@ impl VpnClient {
         config: Config,
         tracker: Arc<ConnectionTracker>,
     ) -> Result<Self> {
+        Ok(Self::with_tracker(CompiledConfig::compile(config)?, tracker))
+    }
+
+    fn with_tracker(config: Arc<CompiledConfig>, tracker: Arc<ConnectionTracker>) -> Self {
         let cluster_manager = if config.clustering.enabled {
-            Some(ClusterManager::new(config.clustering.clone()))
+            Some(ClusterManager::from_compiled(&config))
         } else {
             None
         };
 
-        Ok(VpnClient {
+        VpnClient {
             config,
             auth_client: None,
             protocol_handler: None,
             session_manager: None,
+            keepalive_timer: None,
             tunnel_manager: None,
             status: ConnectionStatus::Disconnected,
             server_endpoint: None,
             cluster_manager,
             connection_tracker: tracker,
-        })
+            binary_client: None,
+            data_runtime: None,
+            data_session_id: Arc::new(AtomicU32::new(0)),
+        }
     }
 
     /// Connect to `SoftEther` VPN server using the correct SSL-VPN protocol
@@ -259,29 +656,41 @@ impl VpnClient {
     /// This does NOT handle platform networking (TUN/TAP, routing, DNS).
     /// Your application must handle those separately.
     pub async fn connect_async(&mut self, server: &str, port: u16) -> Result<()> {
+        // Resolve server address; hostnames may yield both IPv4 and IPv6 candidates.
+        // The configured server was resolved when the config was compiled.
+        let candidates = if server == self.config.server.address && port == self.config.server.port
+            && !self.config.server_endpoints().is_empty()
+        {
+            self.config.server_endpoints().to_vec()
+        } else {
+            Self::resolve_server_addresses(server, port).await?
+        };
+        self.connect_candidates(&format!("{server}:{port}"), &candidates).await
+    }
+
+    /// Race handshakes against `candidates` and keep the first that succeeds
+    ///
+    /// `endpoint_key` is the configured `host:port` of the target, used for
+    /// retry tracking. Fails unless the client is disconnected.
+    async fn connect_candidates(&mut self, endpoint_key: &str, candidates: &[SocketAddr]) -> Result<()> {
         if self.status != ConnectionStatus::Disconnected {
             return Err(VpnError::Connection(
                 "Already connected or connecting".to_string(),
             ));
         }
 
-        // Create endpoint identifier for retry tracking
-        let endpoint_key = format!("{server}:{port}");
-
         // Check connection limits and retry limits
         self.connection_tracker
             .can_connect(&self.config.connection_limits)?;
         self.connection_tracker
-            .can_retry(&endpoint_key, &self.config.connection_limits)?;
+            .can_retry(endpoint_key, &self.config.connection_limits)?;
 
         self.status = ConnectionStatus::Connecting;
-
-        // Resolve server address
-        let server_addr = Self::resolve_server_address(server, port)?;
-        self.server_endpoint = Some(server_addr);
+        // Set again by the handshake that wins the race
+        self.server_endpoint = None;
 
         // Attempt connection with proper SoftEther protocol
-        let result = self.attempt_connection_async(server_addr, &endpoint_key).await;
+        let result = self.attempt_connection_async(candidates, endpoint_key).await;
 
         match result {
             Ok(_) => {
@@ -298,28 +707,33 @@ impl VpnClient {
     }
 
     /// Attempt connection using SoftEther SSL-VPN protocol
-    async fn attempt_connection_async(&mut self, server_addr: SocketAddr, endpoint_key: &str) -> Result<()> {
+    ///
+    /// Handshakes (TCP, TLS and watermark) against the candidates race each
+    /// other happy-eyeballs style; the session continues with the winner.
+    async fn attempt_connection_async(&mut self, candidates: &[SocketAddr], endpoint_key: &str) -> Result<()> {
         // Add delay if this is a retry attempt
-        if self.config.connection_limits.retry_delay > 0 {
-            let retry_attempts = self.connection_tracker.retry_attempts.lock().unwrap();
-            if let Some((count, _)) = retry_attempts.get(endpoint_key) {
-                if *count > 0 {
-                    tokio::time::sleep(Duration::from_secs(
-                        self.config.connection_limits.retry_delay as u64,
-                    )).await;
-                }
-            }
+        let retry_delay = self.config.limits().retry_delay;
+        if !retry_delay.is_zero() && self.connection_tracker.retry_count(endpoint_key) > 0 {
+            tokio::time::sleep(retry_delay).await;
         }
 
-        // Initialize protocol handler
-        let mut protocol_handler = ProtocolHandler::new(server_addr, self.config.server.verify_certificate)?;
-        
-        // Step 1: HTTP watermark handshake
-        protocol_handler.establish_session().await?;
+        // Step 1: HTTP watermark handshake, raced across candidates
+        let verify_certificate = self.config.server.verify_certificate;
+        let hostname = &self.config.server.hostname;
+        let protocol_handler = race_connects(candidates, HAPPY_EYEBALLS_DELAY, |addr| {
+            let hostname = hostname.clone();
+            async move {
+                let mut protocol_handler = ProtocolHandler::with_hostname(addr, hostname, verify_certificate)?;
+                protocol_handler.establish_session().await?;
+                Ok(protocol_handler)
+            }
+        }).await?;
+        let server_addr = protocol_handler.server_address();
+        self.server_endpoint = Some(server_addr);
         
-        // Initialize auth client
-        let auth_client = AuthClient::new(
-            format!("{}:{}", self.config.server.address, self.config.server.port),
+        // Initialize auth client against the endpoint that won
+        let mut auth_client = AuthClient::new(
+            server_addr.to_string(),
             self.config.server.hostname.clone(),
             self.config.server.hub.clone(),
             self.config.auth.username.clone().unwrap_or_default(),
@@ -327,17 +741,33 @@ impl VpnClient {
             self.config.server.verify_certificate,
         )?;
         
+        // Authentication continues on the connection the watermark went over
+        if let Some(connection) = protocol_handler.connection() {
+            auth_client.attach_connection(connection);
+        }
+        
         self.protocol_handler = Some(protocol_handler);
         self.auth_client = Some(auth_client);
 
         Ok(())
     }
 
-    /// Parse server address - expects IP:port format
-    fn resolve_server_address(server: &str, port: u16) -> Result<SocketAddr> {
-        // Parse IP address directly - no DNS resolution needed
-        format!("{server}:{port}").parse::<SocketAddr>()
-            .map_err(|e| VpnError::Config(format!("Invalid server address '{server}:{port}': {e}")))
+    /// Resolve a server to connection candidates
+    ///
+    /// IP literals are used as-is. Hostnames are looked up and the results
+    /// interleaved by address family, so a racing connect alternates between
+    /// IPv6 and IPv4.
+    async fn resolve_server_addresses(server: &str, port: u16) -> Result<Vec<SocketAddr>> {
+        if let Ok(ip) = server.trim_matches(|c| c == '[' || c == ']').parse::<std::net::IpAddr>() {
+            return Ok(vec![SocketAddr::new(ip, port)]);
+        }
+        let addrs: Vec<SocketAddr> = tokio::net::lookup_host((server, port)).await
+            .map_err(|e| VpnError::Config(format!("Invalid server address '{server}:{port}': {e}")))?
+            .collect();
+        if addrs.is_empty() {
+            return Err(VpnError::Config(format!("Server address '{server}:{port}' resolved to nothing")));
+        }
+        Ok(interleave_families(addrs))
     }
 
     /// Authenticate with SoftEther VPN server using proper SSL-VPN protocol
@@ -399,7 +829,8 @@ impl VpnClient {
         log::info!("📝 Note: Using fallback IPs until DHCP implementation is fixed");
 
         // Initialize session manager after successful authentication
-        let session_manager = SessionManager::new(&self.config)?;
+        let mut session_manager = SessionManager::new(Arc::clone(&self.config))?;
+        session_manager.start_session()?;
         self.session_manager = Some(session_manager);
 
         // **CRITICAL SoftEther Architecture**: 
@@ -446,8 +877,11 @@ impl VpnClient {
 
         self.tunnel_manager = None;
         self.session_manager = None;
+        self.keepalive_timer = None;
         self.protocol_handler = None;
         self.auth_client = None;
+        self.binary_client = None;
+        self.data_session_id.store(0, Ordering::Relaxed);
         self.status = ConnectionStatus::Disconnected;
         self.server_endpoint = None;
         Ok(())
@@ -474,7 +908,17 @@ impl VpnClient {
     }
 
     /// Send keepalive packet (protocol level)
+    ///
+    /// Skipped while the session has carried traffic within the configured
+    /// keepalive interval, so callers may poll this on any schedule.
     pub async fn send_keepalive(&mut self) -> Result<()> {
+        if let Some(ref session_manager) = self.session_manager {
+            if !session_manager.keepalive_due(self.keepalive_interval()) {
+                log::debug!("Keepalive suppressed: session carried traffic recently");
+                return Ok(());
+            }
+        }
+
         // In tunneling mode, use binary keepalive instead of HTTP
         if self.status == ConnectionStatus::Tunneling {
             log::debug!("Sending binary VPN keepalive");
@@ -497,6 +941,21 @@ impl VpnClient {
         Ok(())
     }
 
+    /// Idle time after which the session needs a keepalive
+    fn keepalive_interval(&self) -> Duration {
+        self.config.limits().keepalive_interval
+    }
+
+    /// Note real traffic on the session, deferring its next keepalive
+    fn record_traffic(&mut self) {
+        if let Some(ref mut session_manager) = self.session_manager {
+            session_manager.record_traffic();
+        }
+        if let Some(ref timer) = self.keepalive_timer {
+            timer.touch();
+        }
+    }
+
     /// Send packet data using PACK binary format
     pub async fn send_packet_data(&mut self, packet_data: &[u8]) -> Result<()> {
         let protocol_handler = self
@@ -635,10 +1094,19 @@ impl VpnClient {
 
         // Create tunnel manager if not exists
         if self.tunnel_manager.is_none() {
-            let tunnel_manager = TunnelManager::new(tunnel_config);
+            let mut tunnel_manager = TunnelManager::new(tunnel_config);
+            tunnel_manager.set_tun_queues(self.config.limits().tun_queues);
+            tunnel_manager.set_tun_offload(self.config.network.tun_offload);
+            tunnel_manager.set_mss_clamp(self.config.network.mss_clamp);
+            tunnel_manager.set_adaptive_mtu(self.config.network.adaptive_mtu);
+            tunnel_manager.set_tun_io_uring(self.config.network.tun_io_uring);
+            tunnel_manager.set_wintun(self.config.network.wintun);
             self.tunnel_manager = Some(tunnel_manager);
         }
 
+        #[cfg(any(unix, target_os = "windows"))]
+        self.attach_data_channel()?;
+
         // Establish the actual tunnel with routing
         if let Some(ref mut tunnel_manager) = self.tunnel_manager {
             tunnel_manager.establish_tunnel()?;
@@ -658,6 +1126,12 @@ impl VpnClient {
                 .is_some_and(|tm| tm.is_established())
     }
 
+    /// Data path counters and latency histograms, while the tunnel's packet pump runs
+    #[cfg(unix)]
+    pub fn data_path_stats(&self) -> Option<crate::tunnel::pump::PumpSnapshot> {
+        self.tunnel_manager.as_ref()?.pump_stats().map(|stats| stats.snapshot())
+    }
+
     /// Get current public IP (for testing if traffic is routed through VPN)
     pub async fn get_current_public_ip(&self) -> Result<String> {
         if let Some(ref tunnel_manager) = self.tunnel_manager {
@@ -716,8 +1190,15 @@ impl VpnClient {
         
         log::debug!("Creating binary protocol client for endpoint: {:?}", server_endpoint);
         
-        // Initialize binary protocol client for high-performance VPN transmission
-        let binary_client = BinaryProtocolClient::new(server_endpoint);
+        // Initialize binary protocol client for high-performance VPN transmission.
+        // It carries on over the authenticated session connection, as the
+        // server expects; the socket is only opened anew if there is none.
+        let mut binary_client = BinaryProtocolClient::new(server_endpoint);
+        if let Some(connection) = auth_client.take_connection().await {
+            log::debug!("Data channel reuses the session connection after {} requests", connection.requests());
+            binary_client = binary_client.with_session_connection(connection);
+        }
+        self.binary_client = Some(binary_client);
         
         // TODO: Transfer session state from PACK auth to binary protocol
         // This includes:
@@ -743,7 +1224,9 @@ impl VpnClient {
     /// Start binary protocol keep-alive loop for VPN session maintenance
     /// 
     /// This replaces the HTTP-based keep-alive with binary protocol keep-alive
-    /// for high-performance VPN operation
+    /// for high-performance VPN operation. Keep-alives come off the shared
+    /// keepalive wheel and are only sent once the session has been idle for
+    /// the configured keepalive interval.
     pub async fn start_binary_keepalive_loop(&mut self) -> Result<()> {
         log::info!("🔄 Starting binary protocol keep-alive loop...");
         
@@ -752,16 +1235,21 @@ impl VpnClient {
             .ok_or_else(|| VpnError::Connection("Protocol handler not available".to_string()))?;
         
         // Start keep-alive and packet processing loop
-        let mut interval = tokio::time::interval(Duration::from_secs(30));
+        let due = Arc::new(tokio::sync::Notify::new());
+        let notify = Arc::clone(&due);
+        self.keepalive_timer = Some(KeepaliveScheduler::shared().register(self.keepalive_interval(), move || notify.notify_one()));
         
         loop {
             tokio::select! {
-                _ = interval.tick() => {
+                _ = due.notified() => {
                     // Send binary keep-alive packet
                     if let Err(e) = self.send_binary_keepalive().await {
                         log::error!("Keep-alive failed: {}", e);
                         break;
                     }
+                    if let Some(ref mut session_manager) = self.session_manager {
+                        let _ = session_manager.send_keepalive();
+                    }
                     log::debug!("Binary keep-alive sent");
                 }
                 
@@ -769,6 +1257,7 @@ impl VpnClient {
                 packet_result = self.receive_vpn_packet() => {
                     match packet_result {
                         Ok(packet) => {
+                            self.record_traffic();
                             if let Err(e) = self.process_vpn_packet(packet).await {
                                 log::error!("Failed to process VPN packet: {}", e);
                             }
@@ -781,6 +1270,7 @@ impl VpnClient {
                 }
             }
         }
+        self.keepalive_timer = None;
         
         log::info!("✅ Binary keep-alive loop started");
         Ok(())
@@ -815,25 +1305,226 @@ impl VpnClient {
     }
     
     /// Receive VPN packet from server
-    async fn receive_vpn_packet(&mut self) -> Result<Vec<u8>> {
-        // TODO: Implement actual packet reception from binary protocol
-        // For now, return empty to avoid infinite loop
-        tokio::time::sleep(Duration::from_millis(100)).await;
-        Ok(vec![])
+    ///
+    /// Reads from the binary data channel while this client still owns it.
+    /// Once the channel has been handed to the tunnel's packet pump, or before
+    /// it is connected, there is nothing to read here and this never resolves.
+    async fn receive_vpn_packet(&mut self) -> Result<Bytes> {
+        let binary_client = match self.binary_client.as_mut() {
+            Some(client) if client.is_connected() => client,
+            _ => return std::future::pending().await,
+        };
+
+        let mut packets = Vec::with_capacity(1);
+        binary_client.recv_vpn_packets(1, &mut packets).await?;
+        Ok(packets.pop().unwrap_or_default())
     }
     
     /// Process received VPN packet
-    async fn process_vpn_packet(&mut self, packet: Vec<u8>) -> Result<()> {
+    async fn process_vpn_packet(&mut self, packet: Bytes) -> Result<()> {
         if packet.is_empty() {
             return Ok(());
         }
         
-        // TODO: Route packet through tunnel interface
-        // This should:
-        // 1. Decrypt packet if needed
-        // 2. Extract IP packet
-        // 3. Write to TUN interface
-        log::debug!("Processing VPN packet of {} bytes", packet.len());
+        match self.tunnel_manager {
+            Some(ref mut tunnel_manager) if tunnel_manager.is_established() => {
+                tunnel_manager.write_to_tun(&packet)
+            }
+            _ => {
+                log::debug!("Dropping {} byte VPN packet - no tunnel established", packet.len());
+                Ok(())
+            }
+        }
+    }
+
+    /// Send a batch of packets over the binary data channel
+    ///
+    /// Blocking wrapper for FFI callers; must not be called from inside an
+    /// async runtime. Returns the number of packets sent.
+    pub fn send_packet_batch<'a, I>(&mut self, packets: I) -> Result<usize>
+    where
+        I: IntoIterator<Item = &'a [u8]>,
+    {
+        let (runtime, binary_client) = self.data_channel()?;
+        let sent = runtime.block_on(binary_client.send_vpn_batch(packets))?;
+        if sent > 0 {
+            self.record_traffic();
+        }
+        Ok(sent)
+    }
+
+    /// Receive up to `max_packets` packets from the binary data channel
+    ///
+    /// Waits at most `timeout` for the first packet and returns 0 if none
+    /// arrived. See [`BinaryProtocolClient::recv_vpn_batch`] for the sink contract.
+    pub fn recv_packet_batch<F>(&mut self, max_packets: usize, timeout: Duration, sink: F) -> Result<usize>
+    where
+        F: FnMut(usize, &[u8]) -> bool,
+    {
+        let (runtime, binary_client) = self.data_channel()?;
+        let received = runtime.block_on(async {
+            match tokio::time::timeout(timeout, binary_client.recv_vpn_batch(max_packets, sink)).await {
+                Ok(result) => result,
+                Err(_) => Ok(0),
+            }
+        })?;
+        if received > 0 {
+            self.record_traffic();
+        }
+        Ok(received)
+    }
+
+    /// Get the binary data channel, connecting it on first use
+    fn data_channel(&mut self) -> Result<(&tokio::runtime::Runtime, &mut BinaryProtocolClient)> {
+        if self.status != ConnectionStatus::Connected && self.status != ConnectionStatus::Tunneling {
+            return Err(VpnError::Connection("Not connected".to_string()));
+        }
+        let binary_client = self.binary_client.as_mut()
+            .ok_or_else(|| VpnError::InvalidState("Tunneling mode not started".to_string()))?;
+
+        let runtime = Self::ensure_data_runtime(&mut self.data_runtime)?;
+
+        if !binary_client.is_connected() {
+            let timeout = self.config.limits().connect_timeout;
+            let username = self.config.auth.username.as_deref().unwrap_or_default();
+            let password = self.config.auth.password.as_deref().unwrap_or_default();
+            runtime.block_on(binary_client.open(username, password, &self.config.server.hub, timeout))?;
+        }
+
+        Ok((runtime, binary_client))
+    }
+
+    /// Create the data channel runtime on first use
+    ///
+    /// A single worker keeps background packet forwarding running between
+    /// blocking calls from FFI callers.
+    fn ensure_data_runtime(slot: &mut Option<tokio::runtime::Runtime>) -> Result<&tokio::runtime::Runtime> {
+        if slot.is_none() {
+            let runtime = tokio::runtime::Builder::new_multi_thread()
+                .worker_threads(1)
+                .thread_name("rvpnse-data")
+                .enable_all()
+                .build()
+                .map_err(|e| VpnError::Connection(format!("Failed to create runtime: {}", e)))?;
+            *slot = Some(runtime);
+        }
+        Ok(slot.as_ref().unwrap())
+    }
+
+    /// Hand the binary data channel to the tunnel so its packet pump can forward TUN traffic
+    ///
+    /// On Windows only the Wintun backend has a packet pump; without it the
+    /// channel stays with the client.
+    #[cfg(any(unix, target_os = "windows"))]
+    fn attach_data_channel(&mut self) -> Result<()> {
+        #[cfg(target_os = "windows")]
+        if !self.config.network.wintun {
+            return Ok(());
+        }
+        let Some(binary_client) = self.binary_client.take() else {
+            log::warn!("No binary data channel available - tunnel will not forward packets");
+            return Ok(());
+        };
+
+        // Run on the caller's runtime when there is one, otherwise on our own
+        let handle = match tokio::runtime::Handle::try_current() {
+            Ok(handle) => handle,
+            Err(_) => Self::ensure_data_runtime(&mut self.data_runtime)?.handle().clone(),
+        };
+
+        let queues = self.config.limits().tun_queues;
+        // Wintun has a single pair of rings
+        #[cfg(target_os = "windows")]
+        let queues = 1;
+
+        // One data channel per TUN queue; the first reuses the existing client
+        let server_addr = binary_client.server_addr();
+        let mut lanes = vec![binary_client];
+        lanes.extend((1..queues).map(|_| BinaryProtocolClient::new(server_addr)));
+        let connects = self.data_channel_connects(lanes);
+
+        if let Some(ref mut tunnel_manager) = self.tunnel_manager {
+            tunnel_manager.attach_data_channels(handle, connects);
+        }
+        Ok(())
+    }
+
+    /// Turn data channel clients into connect futures for the packet pump
+    ///
+    /// Clients not yet connected are opened within the server timeout, over a
+    /// TLS session connection like the primary lane's when they have none.
+    /// Each records the session it joined so [`Self::resume_session`] can
+    /// rejoin it.
+    #[cfg(any(unix, target_os = "windows"))]
+    fn data_channel_connects(&self, lanes: Vec<BinaryProtocolClient>) -> Vec<DataChannelConnect> {
+        let timeout = self.config.limits().connect_timeout;
+        let username = self.config.auth.username.clone().unwrap_or_default();
+        let password = self.config.auth.password.clone().unwrap_or_default();
+        let hub = self.config.server.hub.clone();
+        let hostname = self.config.server.hostname.clone();
+        let verify_certificate = self.config.server.verify_certificate;
+
+        lanes
+            .into_iter()
+            .map(|mut lane| {
+                let (username, password, hub) = (username.clone(), password.clone(), hub.clone());
+                let hostname = hostname.clone();
+                let data_session_id = Arc::clone(&self.data_session_id);
+                Box::pin(async move {
+                    if !lane.is_connected() {
+                        if !lane.uses_session_connection() {
+                            let connection = tokio::time::timeout(
+                                timeout,
+                                SessionConnection::connect(lane.server_addr(), hostname.as_deref(), verify_certificate),
+                            )
+                            .await
+                            .map_err(|_| VpnError::Timeout("Data channel TLS connect timed out".to_string()))??;
+                            lane = lane.with_session_connection(connection);
+                        }
+                        lane.open(&username, &password, &hub, timeout).await?;
+                    }
+                    if let Some(session_id) = lane.session_id() {
+                        data_session_id.store(session_id, Ordering::Relaxed);
+                    }
+                    Ok(lane)
+                }) as DataChannelConnect
+            })
+            .collect()
+    }
+
+    /// Move the running tunnel onto fresh data channels after a network change
+    ///
+    /// Keeps the TUN device, routes, DNS and IP configuration, and rejoins the
+    /// existing server session rather than authenticating again. Packets the
+    /// TUN produces until the new channels are up are queued (bounded) and
+    /// sent once they are. Returns once the new channels are handed to the
+    /// tunnel; they connect in the background.
+    ///
+    /// # Errors
+    /// Returns an error if the client is not tunneling or the tunnel cannot
+    /// take new channels.
+    #[cfg(unix)]
+    pub fn resume_session(&mut self) -> Result<()> {
+        if self.status != ConnectionStatus::Tunneling {
+            return Err(VpnError::InvalidState("Session resume needs an established tunnel".to_string()));
+        }
+        let server_addr = self.server_endpoint
+            .ok_or_else(|| VpnError::InvalidState("No server endpoint to resume with".to_string()))?;
+
+        let session_id = self.data_session_id.load(Ordering::Relaxed);
+        let queues = self.config.limits().tun_queues;
+        let lanes = (0..queues)
+            .map(|_| {
+                let lane = BinaryProtocolClient::new(server_addr);
+                if session_id != 0 { lane.with_session_id(session_id) } else { lane }
+            })
+            .collect();
+        let connects = self.data_channel_connects(lanes);
+
+        let tunnel_manager = self.tunnel_manager.as_mut()
+            .ok_or_else(|| VpnError::InvalidState("No tunnel to resume".to_string()))?;
+        tunnel_manager.resume_data_channels(connects)?;
+        log::info!("Resuming session {} on new data channels to {}", session_id, server_addr);
         Ok(())
     }
 
@@ -887,6 +1578,25 @@ impl VpnClient {
         Ok(())
     }
 
+    /// Probe cluster nodes in the background from now on
+    ///
+    /// Node selection and failover then use the latest published results
+    /// instead of waiting for a health check. Runs on the ambient tokio
+    /// runtime, or on the client's data runtime when called outside one.
+    pub fn start_cluster_health_checks(&mut self) -> Result<()> {
+        let Some(cluster_manager) = self.cluster_manager.as_mut() else {
+            return Err(VpnError::Configuration("Clustering is not enabled".to_string()));
+        };
+        if tokio::runtime::Handle::try_current().is_ok() {
+            cluster_manager.spawn_health_checks();
+        } else {
+            let runtime = Self::ensure_data_runtime(&mut self.data_runtime)?;
+            let _guard = runtime.enter();
+            cluster_manager.spawn_health_checks();
+        }
+        Ok(())
+    }
+
     /// Get cluster node status information
     pub fn get_cluster_status(&self) -> Option<Vec<(String, bool, u32)>> {
         if let Some(ref cluster_manager) = self.cluster_manager {
@@ -898,7 +1608,11 @@ impl VpnClient {
         }
     }
 
-    /// Connect to next available cluster node
+    /// Connect to the best available cluster nodes
+    ///
+    /// The load balancing strategy's pick and the next healthy nodes by RTT
+    /// (up to [`MAX_RACING_CANDIDATES`] addresses) are raced; the node that
+    /// answers first gets the connection.
     pub async fn connect_to_cluster(&mut self) -> Result<()> {
         if !self.config.clustering.enabled {
             return Err(VpnError::Configuration(
@@ -906,42 +1620,61 @@ impl VpnClient {
             ));
         }
 
-        if let Some(ref mut cluster_manager) = self.cluster_manager {
-            if let Some(node) = cluster_manager.get_next_node() {
-                if let Some(endpoint) = node.endpoint {
-                    self.server_endpoint = Some(endpoint);
-                    node.active_connections += 1;
-                    cluster_manager.update_peer_count(cluster_manager.get_peer_count() + 1);
-                    
-                    // Use the endpoint to connect
-                    return self.connect_async(&endpoint.ip().to_string(), endpoint.port()).await;
-                } else {
-                    // Try to resolve the address
-                    match node.address.to_socket_addrs() {
-                        Ok(mut addrs) => {
-                            if let Some(addr) = addrs.next() {
-                                node.endpoint = Some(addr);
-                                self.server_endpoint = Some(addr);
-                                node.active_connections += 1;
-                                cluster_manager.update_peer_count(cluster_manager.get_peer_count() + 1);
-                                
-                                return self.connect_async(&addr.ip().to_string(), addr.port()).await;
-                            }
-                        },
-                        Err(e) => {
-                            node.is_healthy = false;
-                            return Err(VpnError::Connection(
-                                format!("Failed to resolve cluster node {}: {}", node.address, e)
-                            ));
-                        }
-                    }
-                }
+        let candidates = match self.cluster_manager.as_mut() {
+            Some(cluster_manager) => cluster_manager.connect_candidates(MAX_RACING_CANDIDATES).await,
+            None => Vec::new(),
+        };
+        // Retries are tracked per configured node address, not per resolved IP
+        let endpoint_key = match (candidates.first(), self.cluster_manager.as_ref()) {
+            (Some(&(index, _)), Some(cluster_manager)) => cluster_manager.nodes[index].address.clone(),
+            _ => {
+                return Err(VpnError::Connection(
+                    "No available cluster nodes".to_string(),
+                ));
+            }
+        };
+
+        let addrs: Vec<SocketAddr> = candidates.iter().map(|(_, addr)| *addr).collect();
+        if let Err(e) = self.connect_candidates(&endpoint_key, &addrs).await {
+            self.record_cluster_failure(&candidates, &e);
+            return Err(e);
+        }
+
+        if let (Some(cluster_manager), Some(winner)) = (self.cluster_manager.as_mut(), self.server_endpoint) {
+            if let Some((index, _)) = candidates.iter().find(|(_, addr)| *addr == winner) {
+                cluster_manager.nodes[*index].active_connections += 1;
+                cluster_manager.update_peer_count(cluster_manager.get_peer_count() + 1);
             }
         }
+        Ok(())
+    }
 
-        Err(VpnError::Connection(
-            "No available cluster nodes".to_string(),
-        ))
+    /// Mark the nodes a failed cluster connect could not use as unhealthy
+    ///
+    /// If a handshake won the race, only its node failed; otherwise every
+    /// raced node did. Local limits and bad credentials say nothing about
+    /// the nodes and mark none.
+    fn record_cluster_failure(&mut self, candidates: &[(usize, SocketAddr)], error: &VpnError) {
+        if self.status != ConnectionStatus::Disconnected
+            || matches!(
+                error,
+                VpnError::ConnectionLimitReached(_)
+                    | VpnError::RateLimitExceeded(_)
+                    | VpnError::RetryLimitExceeded(_)
+                    | VpnError::Authentication(_)
+            )
+        {
+            return;
+        }
+        let Some(cluster_manager) = self.cluster_manager.as_mut() else {
+            return;
+        };
+        let winner = self.server_endpoint;
+        for &(index, addr) in candidates {
+            if winner.map_or(true, |winner| winner == addr) {
+                cluster_manager.nodes[index].mark_failed();
+            }
+        }
     }
 
     /// Handle failover to next healthy cluster node
@@ -984,26 +1717,46 @@ impl Drop for VpnClient {
     }
 }
 
+/// Number of independently locked shards in the retry table
+const RETRY_SHARDS: usize = 16;
+
 /// Connection tracking for limits and rate limiting
+///
+/// Safe to share between many clients: the rate limiter is a single atomic
+/// and retry state is sharded by endpoint, so checks are O(1) and clients
+/// contend only when they retry the same shard at the same moment.
 #[derive(Debug)]
 pub struct ConnectionTracker {
     /// Active connection count
     active_connections: AtomicU32,
-    /// Connection attempts per minute tracking
-    connection_attempts: Arc<Mutex<Vec<Instant>>>,
+    /// Token bucket for connection attempts, kept as a GCRA theoretical
+    /// arrival time in nanoseconds since `epoch`
+    rate_limit_tat: AtomicU64,
+    /// Time origin for `rate_limit_tat`
+    epoch: Instant,
     /// Connection retry tracking per endpoint
-    retry_attempts: Arc<Mutex<HashMap<String, (u32, Instant)>>>,
+    retry_shards: [Mutex<HashMap<String, (u32, Instant)>>; RETRY_SHARDS],
+    /// Hasher picking an endpoint's shard
+    shard_hasher: RandomState,
 }
 
 impl ConnectionTracker {
     fn new() -> Self {
         Self {
             active_connections: AtomicU32::new(0),
-            connection_attempts: Arc::new(Mutex::new(Vec::new())),
-            retry_attempts: Arc::new(Mutex::new(HashMap::new())),
+            rate_limit_tat: AtomicU64::new(0),
+            epoch: Instant::now(),
+            retry_shards: std::array::from_fn(|_| Mutex::new(HashMap::new())),
+            shard_hasher: RandomState::new(),
         }
     }
 
+    /// Retry table shard holding `endpoint`
+    fn retry_shard(&self, endpoint: &str) -> &Mutex<HashMap<String, (u32, Instant)>> {
+        let hash = self.shard_hasher.hash_one(endpoint);
+        &self.retry_shards[hash as usize % RETRY_SHARDS]
+    }
+
     /// Check if we can make a new connection based on limits
     fn can_connect(&self, config: &crate::config::ConnectionLimitsConfig) -> Result<()> {
         // Check concurrent connection limit
@@ -1017,27 +1770,61 @@ impl ConnectionTracker {
             }
         }
 
-        // Check rate limiting (connections per minute)
+        // Check rate limiting (token bucket: rate_limit_rps refill, rate_limit_burst capacity)
         if config.rate_limit_rps > 0 {
-            let mut attempts = self.connection_attempts.lock().unwrap();
-            let now = Instant::now();
-            let one_minute_ago = now - Duration::from_secs(60);
+            self.take_rate_limit_token(config.rate_limit_rps, config.rate_limit_burst)?;
+        }
+
+        Ok(())
+    }
+
+    /// Take one token from the connection attempt bucket
+    ///
+    /// Implemented as GCRA: each attempt pushes the theoretical arrival time
+    /// forward by one emission interval, and an attempt conforms while the
+    /// arrival time is at most `burst - 1` intervals ahead of now.
+    fn take_rate_limit_token(&self, rate_per_sec: u32, burst: u32) -> Result<()> {
+        self.take_rate_limit_token_at(rate_per_sec, burst, self.epoch.elapsed().as_nanos() as u64)
+    }
 
-            // Remove old attempts
-            attempts.retain(|&attempt_time| attempt_time > one_minute_ago);
+    /// [`take_rate_limit_token`](Self::take_rate_limit_token) at `now`
+    /// nanoseconds since `epoch`
+    fn take_rate_limit_token_at(&self, rate_per_sec: u32, burst: u32, now: u64) -> Result<()> {
+        let interval = 1_000_000_000 / u64::from(rate_per_sec);
+        let burst = if burst == 0 { rate_per_sec } else { burst };
+        let tolerance = interval * u64::from(burst - 1);
 
-            if attempts.len() >= config.rate_limit_rps as usize {
+        let mut tat = self.rate_limit_tat.load(Ordering::Relaxed);
+        loop {
+            let start = tat.max(now);
+            if start - now > tolerance {
+                let wait = Duration::from_nanos(start - now - tolerance);
                 return Err(VpnError::RateLimitExceeded(format!(
-                    "Too many connection attempts: {}/{} per minute",
-                    attempts.len(),
-                    config.rate_limit_rps
+                    "Too many connection attempts: limit {}/s, burst {}. Retry in {} ms.",
+                    rate_per_sec,
+                    burst,
+                    wait.as_millis().max(1)
                 )));
             }
-
-            attempts.push(now);
+            match self.rate_limit_tat.compare_exchange_weak(
+                tat,
+                start + interval,
+                Ordering::Relaxed,
+                Ordering::Relaxed,
+            ) {
+                Ok(_) => return Ok(()),
+                Err(current) => tat = current,
+            }
         }
+    }
 
-        Ok(())
+    /// Failed attempts recorded for `endpoint` since its last reset
+    fn retry_count(&self, endpoint: &str) -> u32 {
+        self.retry_shard(endpoint)
+            .lock()
+            .unwrap()
+            .get(endpoint)
+            .map_or(0, |(count, _)| *count)
     }
 
     /// Check retry limits for a specific endpoint
@@ -1045,28 +1832,38 @@ impl ConnectionTracker {
         &self,
         endpoint: &str,
         config: &crate::config::ConnectionLimitsConfig,
+    ) -> Result<()> {
+        self.can_retry_at(endpoint, config, Instant::now())
+    }
+
+    /// [`can_retry`](Self::can_retry) at `now`
+    fn can_retry_at(
+        &self,
+        endpoint: &str,
+        config: &crate::config::ConnectionLimitsConfig,
+        now: Instant,
     ) -> Result<()> {
         if config.retry_attempts == 0 {
             return Ok(());
         }
 
-        let mut retries = self.retry_attempts.lock().unwrap();
-        let now = Instant::now();
+        let mut retries = self.retry_shard(endpoint).lock().unwrap();
 
         if let Some((count, last_attempt)) = retries.get(endpoint) {
             if *count >= config.retry_attempts {
                 let time_since_last = now.duration_since(*last_attempt);
-                let retry_cooldown = Duration::from_secs(
-                    config.retry_delay as u64 * (*count - config.retry_attempts + 1) as u64,
+                // `retry_delay` is in milliseconds, as for the connect backoff
+                let retry_cooldown = Duration::from_millis(
+                    u64::from(config.retry_delay) * u64::from(*count - config.retry_attempts + 1),
                 );
 
                 if time_since_last < retry_cooldown {
                     return Err(VpnError::RetryLimitExceeded(format!(
-                        "Too many retry attempts for {}: {}/{}. Wait {} seconds.",
+                        "Too many retry attempts for {}: {}/{}. Retry in {} ms.",
                         endpoint,
                         count,
                         config.retry_attempts,
-                        (retry_cooldown - time_since_last).as_secs()
+                        (retry_cooldown - time_since_last).as_millis().max(1)
                     )));
                 } else {
                     // Reset retry count after cooldown
@@ -1090,10 +1887,21 @@ impl ConnectionTracker {
 
     /// Record a retry attempt
     fn record_retry(&self, endpoint: &str) {
-        let mut retries = self.retry_attempts.lock().unwrap();
-        let now = Instant::now();
-        let count = retries.get(endpoint).map(|(c, _)| *c).unwrap_or(0);
-        retries.insert(endpoint.to_string(), (count + 1, now));
+        self.record_retry_at(endpoint, Instant::now());
+    }
+
+    /// [`record_retry`](Self::record_retry) at `now`
+    fn record_retry_at(&self, endpoint: &str, now: Instant) {
+        let mut retries = self.retry_shard(endpoint).lock().unwrap();
+        match retries.get_mut(endpoint) {
+            Some((count, last_attempt)) => {
+                *count += 1;
+                *last_attempt = now;
+            }
+            None => {
+                retries.insert(endpoint.to_string(), (1, now));
+            }
+        }
     }
 }
 
@@ -1101,6 +1909,226 @@ impl ConnectionTracker {
 mod tests {
     use super::*;
 
+    fn cluster(nodes: &[&str], strategy: crate::config::LoadBalancingStrategy) -> ClusterManager {
+        ClusterManager::new(crate::config::ClusteringConfig {
+            enabled: true,
+            cluster_nodes: nodes.iter().map(|n| n.to_string()).collect(),
+            load_balancing_strategy: strategy,
+            ..Default::default()
+        })
+    }
+
+    #[test]
+    fn test_weighted_round_robin_follows_weights() {
+        let mut config = (*cluster(&["a:443", "b:443", "c:443"], crate::config::LoadBalancingStrategy::WeightedRoundRobin).config).clone();
+        config.node_weights = vec![3, 1, 0];
+        let mut manager = ClusterManager::new(config);
+
+        let picks: Vec<String> = (0..8).map(|_| manager.get_next_node().unwrap().address.clone()).collect();
+        assert_eq!(picks.iter().filter(|a| *a == "a:443").count(), 6);
+        assert_eq!(picks.iter().filter(|a| *a == "b:443").count(), 2);
+        // Smooth: the light node is interleaved, not bunched at the end
+        assert_eq!(&picks[..4], ["a:443", "a:443", "b:443", "a:443"]);
+    }
+
+    #[test]
+    fn test_latency_strategies_prefer_fast_nodes() {
+        let mut manager = cluster(&["far:443", "near:443"], crate::config::LoadBalancingStrategy::LeastLatency);
+        manager.nodes[0].record_rtt(Duration::from_millis(120));
+        manager.nodes[1].record_rtt(Duration::from_millis(10));
+        manager.nodes[1].record_rtt(Duration::from_millis(18));
+        assert_eq!(manager.nodes[1].response_time, Duration::from_millis(11));
+        assert_eq!(manager.get_next_node().unwrap().address, "near:443");
+
+        // With two nodes, power of two choices always compares both
+        Arc::make_mut(&mut manager.config).load_balancing_strategy = crate::config::LoadBalancingStrategy::PowerOfTwoChoices;
+        for _ in 0..10 {
+            assert_eq!(manager.get_next_node().unwrap().address, "near:443");
+        }
+        // ... until load outweighs the RTT gap
+        manager.nodes[1].active_connections = 20;
+        assert_eq!(manager.get_next_node().unwrap().address, "far:443");
+
+        manager.nodes[0].is_healthy = false;
+        manager.nodes[1].is_healthy = false;
+        assert!(manager.get_next_node().is_none());
+    }
+
+    #[tokio::test]
+    async fn test_health_check_measures_handshake_rtt() {
+        let listener = tokio::net::TcpListener::bind("127.0.0.1:0").await.unwrap();
+        let live = listener.local_addr().unwrap().to_string();
+        let dead = {
+            let closed = std::net::TcpListener::bind("127.0.0.1:0").unwrap();
+            closed.local_addr().unwrap().to_string()
+        };
+        let mut manager = cluster(&[&live, &dead], crate::config::LoadBalancingStrategy::LeastLatency);
+
+        manager.health_check().await.unwrap();
+        assert!(manager.nodes[0].is_healthy);
+        assert_eq!(manager.nodes[0].rtt_samples, 1);
+        assert!(!manager.nodes[1].is_healthy);
+        assert_eq!(manager.get_next_node().unwrap().address, live);
+
+        // The unmeasured dead node is not re-probed before its interval
+        let probed_at = manager.nodes[1].last_health_check;
+        manager.health_check().await.unwrap();
+        assert_eq!(manager.nodes[1].last_health_check, probed_at);
+        assert_eq!(manager.nodes[1].rtt_samples, 0);
+    }
+
+    #[test]
+    fn test_local_failure_outlives_older_probe_results() {
+        let mut manager = cluster(&["a:443", "b:443"], crate::config::LoadBalancingStrategy::LeastConnections);
+        let stale = manager.health.load().to_vec();
+        manager.nodes[0].mark_failed();
+
+        // A new generation whose probe of the node predates the failure
+        manager.health.publish(stale.clone());
+        assert_eq!(manager.get_next_node().unwrap().address, "b:443");
+        assert!(!manager.nodes[0].is_healthy);
+
+        // A probe after the failure decides again
+        let mut fresh = stale;
+        fresh[0].last_health_check = Instant::now();
+        manager.health.publish(fresh);
+        manager.sync_health();
+        assert!(manager.nodes[0].is_healthy);
+    }
+
+    #[tokio::test]
+    async fn test_background_health_checks_publish_snapshot() {
+        let listener = tokio::net::TcpListener::bind("127.0.0.1:0").await.unwrap();
+        let live = listener.local_addr().unwrap().to_string();
+        let mut manager = cluster(&[&live, "unresolvable.invalid:443"], crate::config::LoadBalancingStrategy::LeastLatency);
+        manager.spawn_health_checks();
+
+        // Selection never blocks; results show up once the first sweep lands
+        for _ in 0..200 {
+            manager.get_next_node();
+            if manager.nodes[0].rtt_samples > 0 && !manager.nodes[1].is_healthy {
+                break;
+            }
+            tokio::time::sleep(Duration::from_millis(10)).await;
+        }
+        assert_eq!(manager.nodes[0].rtt_samples, 1);
+        assert!(manager.nodes[0].endpoint.is_some());
+        assert!(!manager.nodes[1].is_healthy);
+        assert_eq!(manager.get_next_node().unwrap().address, live);
+    }
+
+    #[test]
+    fn test_interleave_families_alternates() {
+        let addrs: Vec<SocketAddr> = ["[::1]:443", "[::2]:443", "10.0.0.1:443", "[::3]:443", "10.0.0.2:443"]
+            .iter()
+            .map(|a| a.parse().unwrap())
+            .collect();
+        let ordered: Vec<String> = interleave_families(addrs).iter().map(|a| a.to_string()).collect();
+        assert_eq!(ordered, ["[::1]:443", "10.0.0.1:443", "[::2]:443", "10.0.0.2:443", "[::3]:443"]);
+    }
+
+    #[tokio::test]
+    async fn test_race_connects_staggers_and_keeps_first_success() {
+        let candidates: Vec<SocketAddr> = ["10.0.0.1:443", "10.0.0.2:443", "10.0.0.3:443"]
+            .iter()
+            .map(|a| a.parse().unwrap())
+            .collect();
+        let first = candidates[0];
+
+        // A failure starts the next attempt without waiting out the stagger
+        let started = std::time::Instant::now();
+        let winner = race_connects(&candidates, Duration::from_secs(5), |addr| async move {
+            if addr == first {
+                Err(VpnError::Connection("refused".to_string()))
+            } else {
+                Ok(addr)
+            }
+        }).await.unwrap();
+        assert_eq!(winner, candidates[1]);
+        assert!(started.elapsed() < Duration::from_secs(1));
+
+        // A hung attempt is overtaken by the next one after the stagger
+        let started = std::time::Instant::now();
+        let winner = race_connects(&candidates, HAPPY_EYEBALLS_DELAY, |addr| async move {
+            if addr == first {
+                std::future::pending::<()>().await;
+            }
+            Ok(addr)
+        }).await.unwrap();
+        assert_eq!(winner, candidates[1]);
+        assert!(started.elapsed() >= HAPPY_EYEBALLS_DELAY);
+
+        let all_failed = race_connects(&candidates, HAPPY_EYEBALLS_DELAY, |_| async {
+            Err::<SocketAddr, _>(VpnError::Connection("refused".to_string()))
+        }).await;
+        assert!(all_failed.is_err());
+    }
+
+    #[test]
+    fn test_rate_limit_token_bucket() {
+        let tracker = ConnectionTracker::new();
+        let mut limits = Config::default_test().connection_limits;
+        limits.max_connections = 0;
+        limits.rate_limit_rps = 20;
+        limits.rate_limit_burst = 3;
+
+        // Driven by an explicit clock, in nanoseconds since the tracker's epoch
+        let ms = |ms: u64| ms * 1_000_000;
+        for _ in 0..3 {
+            assert!(tracker.take_rate_limit_token_at(20, 3, ms(1_000)).is_ok());
+        }
+        assert!(matches!(tracker.take_rate_limit_token_at(20, 3, ms(1_000)), Err(VpnError::RateLimitExceeded(_))));
+
+        // One token refills every 50 ms
+        assert!(tracker.take_rate_limit_token_at(20, 3, ms(1_049)).is_err());
+        assert!(tracker.take_rate_limit_token_at(20, 3, ms(1_050)).is_ok());
+        assert!(tracker.take_rate_limit_token_at(20, 3, ms(1_050)).is_err());
+
+        // can_connect takes from the same bucket at the real time
+        let fresh = ConnectionTracker::new();
+        assert!(fresh.can_connect(&limits).is_ok());
+        assert!(fresh.rate_limit_tat.load(Ordering::Relaxed) > 0);
+
+        limits.rate_limit_rps = 0;
+        assert!(fresh.can_connect(&limits).is_ok());
+    }
+
+    #[test]
+    fn test_retry_tracking_per_endpoint() {
+        let tracker = ConnectionTracker::new();
+        let mut limits = Config::default_test().connection_limits;
+        limits.retry_attempts = 2;
+        limits.retry_delay = 60_000;
+
+        tracker.record_retry("a:443");
+        assert!(tracker.can_retry("a:443", &limits).is_ok());
+        tracker.record_retry("a:443");
+        assert_eq!(tracker.retry_count("a:443"), 2);
+        assert!(matches!(tracker.can_retry("a:443", &limits), Err(VpnError::RetryLimitExceeded(_))));
+        assert_eq!(tracker.retry_count("b:443"), 0);
+        assert!(tracker.can_retry("b:443", &limits).is_ok());
+    }
+
+    #[test]
+    fn test_retry_cooldown_in_milliseconds() {
+        let tracker = ConnectionTracker::new();
+        let mut limits = Config::default_test().connection_limits;
+        limits.retry_attempts = 1;
+        limits.retry_delay = 50;
+
+        // Driven by an explicit clock
+        let start = Instant::now();
+        let ms = |ms: u64| start + Duration::from_millis(ms);
+        tracker.record_retry_at("a:443", start);
+        match tracker.can_retry_at("a:443", &limits, ms(20)) {
+            Err(VpnError::RetryLimitExceeded(message)) => assert!(message.ends_with("Retry in 30 ms."), "{message}"),
+            other => panic!("expected a retry cooldown, got {other:?}"),
+        }
+        assert!(tracker.can_retry_at("a:443", &limits, ms(49)).is_err());
+        assert!(tracker.can_retry_at("a:443", &limits, ms(50)).is_ok());
+        assert_eq!(tracker.retry_count("a:443"), 0);
+    }
+
     #[test]
     fn test_vpn_client_creation() {
         let config = Config::default_test();
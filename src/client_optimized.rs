@@ -8,13 +8,16 @@
 
 use crate::error::{Result, VpnError};
 use crate::config::VpnConfig;
-// Note: Binary protocol removed - using HTTP Watermark + PACK instead
-// use crate::protocol::binary::BinaryProtocolClient;
+use crate::crypto::{CryptoDirection, CryptoPipeline, PipelineConfig, SessionCipher};
+use crate::monitoring::{LatencyHistogram, LatencySummary, ShardedCounter};
+use crate::protocol::binary::{BinaryDataReader, BinaryDataWriter, BinaryProtocolClient};
+use crate::protocol::keepalive::KeepaliveScheduler;
 use crate::tunnel::real_tun::RealTunInterface;
 use bytes::Bytes;
 use std::sync::Arc;
 use std::net::SocketAddr;
-use tokio::sync::{RwLock, mpsc, Semaphore};
+use tokio::io::{AsyncRead, AsyncWrite};
+use tokio::sync::{Notify, RwLock, mpsc, Semaphore};
 use tokio::time::{Duration, Instant, interval};
 use std::sync::atomic::{AtomicU64, AtomicBool, Ordering};
 
@@ -25,16 +28,21 @@ pub struct PerformanceConfig {
     pub max_connections: usize,
     /// Packet batch size for bulk processing
     pub packet_batch_size: usize,
+    /// Longest a batch keeps absorbing queued packets before it is sent
+    pub max_batch_delay: Duration,
     /// Buffer sizes
     pub send_buffer_size: usize,
     pub receive_buffer_size: usize,
     /// Timeout settings
     pub connection_timeout: Duration,
+    /// Idle time after which the data channel sends a keepalive
     pub keepalive_interval: Duration,
     /// Performance tuning
     pub enable_compression: bool,
     pub enable_packet_batching: bool,
     pub adaptive_mtu: bool,
+    /// Crypto worker threads per direction when a session key is set
+    pub crypto_workers: usize,
     /// Monitoring
     pub stats_interval: Duration,
     pub enable_detailed_stats: bool,
@@ -45,6 +53,7 @@ impl Default for PerformanceConfig {
         Self {
             max_connections: 10,
             packet_batch_size: 32,
+            max_batch_delay: Duration::from_millis(10),
             send_buffer_size: 65536,
             receive_buffer_size: 65536,
             connection_timeout: Duration::from_secs(30),
@@ -52,30 +61,35 @@ impl Default for PerformanceConfig {
             enable_compression: true,
             enable_packet_batching: true,
             adaptive_mtu: true,
+            crypto_workers: default_crypto_workers(),
             stats_interval: Duration::from_secs(10),
             enable_detailed_stats: true,
         }
     }
 }
 
+/// One worker per core, up to four
+fn default_crypto_workers() -> usize {
+    std::thread::available_parallelism().map_or(1, |n| n.get().min(4))
+}
+
 /// Real-time performance statistics
+///
+/// Traffic counters are updated per packet by the send and receive tasks,
+/// so they are sharded per core; the rest change rarely.
 #[derive(Debug)]
 pub struct PerformanceStats {
     // Traffic statistics
-    pub bytes_sent: AtomicU64,
-    pub bytes_received: AtomicU64,
-    pub packets_sent: AtomicU64,
-    pub packets_received: AtomicU64,
+    pub bytes_sent: ShardedCounter,
+    pub bytes_received: ShardedCounter,
+    pub packets_sent: ShardedCounter,
+    pub packets_received: ShardedCounter,
     
     // Performance metrics
-    pub avg_latency_ms: AtomicU64,
+    /// How long each outbound batch took to write to the data channel
+    pub write_latency: LatencyHistogram,
     pub throughput_mbps: AtomicU64,
-    pub packet_loss_percent: AtomicU64,
     pub connection_drops: AtomicU64,
-    
-    // Resource usage
-    pub cpu_usage_percent: AtomicU64,
-    pub memory_usage_mb: AtomicU64,
     pub active_connections: AtomicU64,
     
     // Error statistics
@@ -91,16 +105,13 @@ pub struct PerformanceStats {
 impl Default for PerformanceStats {
     fn default() -> Self {
         Self {
-            bytes_sent: AtomicU64::new(0),
-            bytes_received: AtomicU64::new(0),
-            packets_sent: AtomicU64::new(0),
-            packets_received: AtomicU64::new(0),
-            avg_latency_ms: AtomicU64::new(0),
+            bytes_sent: ShardedCounter::new(),
+            bytes_received: ShardedCounter::new(),
+            packets_sent: ShardedCounter::new(),
+            packets_received: ShardedCounter::new(),
+            write_latency: LatencyHistogram::new(),
             throughput_mbps: AtomicU64::new(0),
-            packet_loss_percent: AtomicU64::new(0),
             connection_drops: AtomicU64::new(0),
-            cpu_usage_percent: AtomicU64::new(0),
-            memory_usage_mb: AtomicU64::new(0),
             active_connections: AtomicU64::new(0),
             protocol_errors: AtomicU64::new(0),
             network_errors: AtomicU64::new(0),
@@ -123,23 +134,15 @@ impl PerformanceStats {
 
     /// Update traffic statistics
     pub fn update_traffic(&self, bytes_sent: u64, bytes_received: u64, packets_sent: u64, packets_received: u64) {
-        self.bytes_sent.fetch_add(bytes_sent, Ordering::Relaxed);
-        self.bytes_received.fetch_add(bytes_received, Ordering::Relaxed);
-        self.packets_sent.fetch_add(packets_sent, Ordering::Relaxed);
-        self.packets_received.fetch_add(packets_received, Ordering::Relaxed);
-    }
-
-    /// Update performance metrics
-    pub fn update_performance(&self, latency_ms: u64, throughput_mbps: u64) {
-        // Use exponential moving average for smoother metrics
-        let current_latency = self.avg_latency_ms.load(Ordering::Relaxed);
-        let new_latency = if current_latency == 0 {
-            latency_ms
-        } else {
-            (current_latency * 7 + latency_ms) / 8 // 87.5% weight to history
-        };
-        self.avg_latency_ms.store(new_latency, Ordering::Relaxed);
-        
+        self.bytes_sent.add(bytes_sent);
+        self.bytes_received.add(bytes_received);
+        self.packets_sent.add(packets_sent);
+        self.packets_received.add(packets_received);
+    }
+
+    /// Fold a throughput sample into the smoothed throughput
+    pub fn update_throughput(&self, throughput_mbps: u64) {
+        // Exponential moving average, 87.5% weight to history
         let current_throughput = self.throughput_mbps.load(Ordering::Relaxed);
         let new_throughput = if current_throughput == 0 {
             throughput_mbps
@@ -152,16 +155,13 @@ impl PerformanceStats {
     /// Get current statistics as a snapshot
     pub fn snapshot(&self) -> PerformanceSnapshot {
         PerformanceSnapshot {
-            bytes_sent: self.bytes_sent.load(Ordering::Relaxed),
-            bytes_received: self.bytes_received.load(Ordering::Relaxed),
-            packets_sent: self.packets_sent.load(Ordering::Relaxed),
-            packets_received: self.packets_received.load(Ordering::Relaxed),
-            avg_latency_ms: self.avg_latency_ms.load(Ordering::Relaxed),
+            bytes_sent: self.bytes_sent.get(),
+            bytes_received: self.bytes_received.get(),
+            packets_sent: self.packets_sent.get(),
+            packets_received: self.packets_received.get(),
+            write_latency: self.write_latency.summary(),
             throughput_mbps: self.throughput_mbps.load(Ordering::Relaxed),
-            packet_loss_percent: self.packet_loss_percent.load(Ordering::Relaxed),
             connection_drops: self.connection_drops.load(Ordering::Relaxed),
-            cpu_usage_percent: self.cpu_usage_percent.load(Ordering::Relaxed),
-            memory_usage_mb: self.memory_usage_mb.load(Ordering::Relaxed),
             active_connections: self.active_connections.load(Ordering::Relaxed),
             protocol_errors: self.protocol_errors.load(Ordering::Relaxed),
             network_errors: self.network_errors.load(Ordering::Relaxed),
@@ -178,12 +178,9 @@ pub struct PerformanceSnapshot {
     pub bytes_received: u64,
     pub packets_sent: u64,
     pub packets_received: u64,
-    pub avg_latency_ms: u64,
+    pub write_latency: LatencySummary,
     pub throughput_mbps: u64,
-    pub packet_loss_percent: u64,
     pub connection_drops: u64,
-    pub cpu_usage_percent: u64,
-    pub memory_usage_mb: u64,
     pub active_connections: u64,
     pub protocol_errors: u64,
     pub network_errors: u64,
@@ -191,30 +188,52 @@ pub struct PerformanceSnapshot {
     pub timestamp: Instant,
 }
 
+/// Outbound queue depth between `send_packet` and the data channel writer
+const OUTBOUND_QUEUE_DEPTH: usize = 1024;
+
 /// Packet batch for optimized processing
 #[derive(Debug)]
 struct PacketBatch {
     packets: Vec<Bytes>,
     total_size: usize,
     created_at: Instant,
+    max_packets: usize,
+    max_bytes: usize,
+    max_delay: Duration,
 }
 
 impl PacketBatch {
-    fn new() -> Self {
+    fn with_limits(max_packets: usize, max_bytes: usize, max_delay: Duration) -> Self {
         Self {
-            packets: Vec::new(),
+            packets: Vec::with_capacity(max_packets),
             total_size: 0,
             created_at: Instant::now(),
+            max_packets: max_packets.max(1),
+            max_bytes,
+            max_delay,
         }
     }
 
     fn add_packet(&mut self, packet: Bytes) -> bool {
+        // The age limit counts from the oldest packet waiting, not the last flush
+        if self.packets.is_empty() {
+            self.created_at = Instant::now();
+        }
         self.total_size += packet.len();
         self.packets.push(packet);
         
         // Return true if batch should be flushed
-        self.packets.len() >= 32 || self.total_size >= 65536 || 
-        self.created_at.elapsed() > Duration::from_millis(10)
+        self.packets.len() >= self.max_packets || self.total_size >= self.max_bytes || 
+        self.created_at.elapsed() >= self.max_delay
+    }
+
+    fn packets(&self) -> &[Bytes] {
+        &self.packets
+    }
+
+    fn clear(&mut self) {
+        self.packets.clear();
+        self.total_size = 0;
     }
 
     fn is_empty(&self) -> bool {
@@ -228,13 +247,6 @@ impl PacketBatch {
     fn total_size(&self) -> usize {
         self.total_size
     }
-
-    fn drain(&mut self) -> Vec<Bytes> {
-        let packets = std::mem::take(&mut self.packets);
-        self.total_size = 0;
-        self.created_at = Instant::now();
-        packets
-    }
 }
 
 /// High-performance optimized VPN client
@@ -242,20 +254,19 @@ pub struct OptimizedVpnClient {
     config: VpnConfig,
     perf_config: PerformanceConfig,
     stats: Arc<PerformanceStats>,
-    // Note: Binary protocol removed - using HTTP Watermark + PACK instead
-    // protocol_client: Option<BinaryProtocolClient>,
     tun_interface: Option<RealTunInterface>,
     
-    // Async channels for packet processing
+    // Payload cipher; when set, packets pass through the crypto pipeline
+    session_cipher: Option<Arc<SessionCipher>>,
+    
+    // Outbound packets, drained in batches by the data channel writer
     outbound_tx: Option<mpsc::Sender<Bytes>>,
-    inbound_tx: Option<mpsc::Sender<Bytes>>,
     
     // Connection management
     connection_semaphore: Arc<Semaphore>,
     is_running: Arc<AtomicBool>,
     
     // Performance optimization
-    packet_batches: Arc<RwLock<PacketBatch>>,
     adaptive_mtu: Arc<AtomicU64>,
 }
 
@@ -270,11 +281,10 @@ impl OptimizedVpnClient {
             perf_config,
             stats: Arc::new(PerformanceStats::new()),
             tun_interface: None,
+            session_cipher: None,
             outbound_tx: None,
-            inbound_tx: None,
             connection_semaphore,
             is_running: Arc::new(AtomicBool::new(false)),
-            packet_batches: Arc::new(RwLock::new(PacketBatch::new())),
             adaptive_mtu: Arc::new(AtomicU64::new(1500)),
         }
     }
@@ -284,7 +294,7 @@ impl OptimizedVpnClient {
         log::info!("Connecting to VPN with performance optimizations");
         
         // Acquire connection permit
-        let _permit = self.connection_semaphore.acquire().await
+        let _permit = Arc::clone(&self.connection_semaphore).acquire_owned().await
             .map_err(|_| VpnError::Connection("Connection limit reached".to_string()))?;
         
         // Connect using binary protocol
@@ -292,102 +302,204 @@ impl OptimizedVpnClient {
             .parse()
             .map_err(|e| VpnError::Config(format!("Invalid server address: {}", e)))?;
         
-        // Note: Binary protocol removed - need to implement HTTP Watermark + PACK protocol
-        // TODO: Replace with proper SoftEther SSL-VPN implementation
-        return Err(VpnError::Network("Binary protocol no longer supported - use VpnClient instead".to_string()));
+        let mut channel = BinaryProtocolClient::new(server_addr);
+        let username = self.config.auth.username.clone().unwrap_or_default();
+        let password = self.config.auth.password.clone().unwrap_or_default();
+        channel.open(&username, &password, &self.config.server.hub, self.perf_config.connection_timeout).await?;
+        
+        self.start_data_channel(channel).await
+    }
+
+    /// Encrypt data channel payloads with `key` (32 bytes, AES-256-GCM)
+    ///
+    /// Takes effect for data channels started afterwards. Sealing and opening
+    /// run on [`PerformanceConfig::crypto_workers`] threads per direction, so
+    /// the peer must apply the same payload encryption. Setting the current
+    /// key again, as on reconnect, keeps its cipher and nonce counter.
+    pub fn set_session_key(&mut self, key: &[u8]) -> Result<()> {
+        if self.session_cipher.as_ref().is_some_and(|cipher| cipher.is_key(key)) {
+            return Ok(());
+        }
+        self.session_cipher = Some(Arc::new(SessionCipher::new(key)?));
+        Ok(())
+    }
+
+    /// Sizing for the crypto pipeline stages
+    fn pipeline_config(&self) -> PipelineConfig {
+        PipelineConfig {
+            workers: self.perf_config.crypto_workers,
+            batch_size: self.perf_config.packet_batch_size,
+            output_depth: OUTBOUND_QUEUE_DEPTH,
+        }
+    }
+
+    /// Start forwarding over an established binary data channel
+    ///
+    /// Outbound packets queued by [`send_packet`](Self::send_packet) are
+    /// batched and sent with vectored writes; inbound packets are read in
+    /// batches too.
+    pub async fn start_data_channel(&mut self, channel: BinaryProtocolClient) -> Result<()> {
+        let (reader, writer) = channel.into_split()?;
+        let (outbound_tx, mut outbound_rx) = mpsc::channel(OUTBOUND_QUEUE_DEPTH);
+        if let Some(cipher) = &self.session_cipher {
+            // The writer sees sealed packets in their original order
+            outbound_rx = CryptoPipeline::spawn(Arc::clone(cipher), CryptoDirection::Seal, self.pipeline_config(), outbound_rx)?
+                .into_output();
+        }
+        
+        self.is_running.store(true, Ordering::Relaxed);
+        self.stats.active_connections.fetch_add(1, Ordering::Relaxed);
+        self.start_packet_processors(outbound_rx, writer, reader).await?;
+        self.start_performance_monitor().await?;
+        self.outbound_tx = Some(outbound_tx);
+        
+        log::info!("Optimized data channel started");
+        Ok(())
     }
 
     /// Start packet processing tasks
-    async fn start_packet_processors(
+    async fn start_packet_processors<R, W>(
         &self,
         mut outbound_rx: mpsc::Receiver<Bytes>,
-        mut inbound_rx: mpsc::Receiver<Bytes>,
-    ) -> Result<()> {
+        mut writer: BinaryDataWriter<W>,
+        mut reader: BinaryDataReader<R>,
+    ) -> Result<()>
+    where
+        R: AsyncRead + Unpin + Send + 'static,
+        W: AsyncWrite + Unpin + Send + 'static,
+    {
         let stats = Arc::clone(&self.stats);
         let is_running = Arc::clone(&self.is_running);
-        let _packet_batches = Arc::clone(&self.packet_batches);
-        let enable_batching = self.perf_config.enable_packet_batching;
+        // Without batching every packet is its own write
+        let max_packets = if self.perf_config.enable_packet_batching { self.perf_config.packet_batch_size } else { 1 };
+        let max_bytes = self.perf_config.send_buffer_size;
+        let max_delay = self.perf_config.max_batch_delay;
+        // Keepalives only go out once the channel has been idle in both directions
+        let keepalive_due = Arc::new(Notify::new());
+        let notify = Arc::clone(&keepalive_due);
+        let keepalive = KeepaliveScheduler::shared().register(self.perf_config.keepalive_interval, move || notify.notify_one());
+        let inbound_keepalive = Arc::clone(&keepalive);
         
         // Outbound packet processor (TUN -> Server)
         tokio::spawn(async move {
-            let mut batch = PacketBatch::new();
-            let mut batch_timer = interval(Duration::from_millis(5));
+            let mut batch = PacketBatch::with_limits(max_packets, max_bytes, max_delay);
             
             while is_running.load(Ordering::Relaxed) {
                 tokio::select! {
                     packet = outbound_rx.recv() => {
-                        if let Some(packet) = packet {
-                            if enable_batching {
-                                if batch.add_packet(packet) {
-                                    // Process batch
-                                    let packets = batch.drain();
-                                    Self::process_outbound_batch(&stats, packets).await;
-                                }
-                            } else {
-                                // Process individual packet
-                                Self::process_outbound_packet(&stats, packet).await;
+                        let Some(packet) = packet else { break };
+                        
+                        // Take what queued up during the previous write, but never
+                        // wait for more: a lone interactive packet goes out at once
+                        let mut flush = batch.add_packet(packet);
+                        while !flush {
+                            match outbound_rx.try_recv() {
+                                Ok(packet) => flush = batch.add_packet(packet),
+                                Err(_) => break,
                             }
                         }
+                        if Self::process_outbound_batch(&stats, &mut writer, &mut batch).await.is_err() {
+                            break;
+                        }
+                        keepalive.touch();
                     }
-                    _ = batch_timer.tick() => {
-                        if !batch.is_empty() {
-                            // Flush pending batch
-                            let packets = batch.drain();
-                            Self::process_outbound_batch(&stats, packets).await;
+                    _ = keepalive_due.notified() => {
+                        if let Err(e) = writer.send_keepalive().await {
+                            log::error!("Keepalive failed: {}", e);
+                            stats.network_errors.fetch_add(1, Ordering::Relaxed);
+                            break;
                         }
+                        log::debug!("Sending optimized keepalive");
                     }
                 }
             }
+            is_running.store(false, Ordering::Relaxed);
         });
 
         // Inbound packet processor (Server -> TUN)
         let stats_clone = Arc::clone(&self.stats);
         let is_running_clone = Arc::clone(&self.is_running);
+        let inbound_batch = max_packets.max(32);
+        
+        // With a session key, inbound packets are opened by the crypto pipeline
+        // and delivered from its ordered output instead
+        let open_tx = match &self.session_cipher {
+            Some(cipher) => {
+                let (open_tx, open_rx) = mpsc::channel(OUTBOUND_QUEUE_DEPTH);
+                let mut opened = CryptoPipeline::spawn(Arc::clone(cipher), CryptoDirection::Open, self.pipeline_config(), open_rx)?;
+                let stats = Arc::clone(&self.stats);
+                tokio::spawn(async move {
+                    let mut dropped = 0;
+                    while let Some(packet) = opened.recv().await {
+                        Self::process_inbound_packet(&stats, packet).await;
+                        let now_dropped = opened.dropped();
+                        if now_dropped != dropped {
+                            stats.protocol_errors.fetch_add(now_dropped - dropped, Ordering::Relaxed);
+                            dropped = now_dropped;
+                        }
+                    }
+                });
+                Some(open_tx)
+            }
+            None => None,
+        };
         
         tokio::spawn(async move {
-            while is_running_clone.load(Ordering::Relaxed) {
-                if let Some(packet) = inbound_rx.recv().await {
-                    Self::process_inbound_packet(&stats_clone, packet).await;
+            let mut packets = Vec::with_capacity(inbound_batch);
+            'receive: while is_running_clone.load(Ordering::Relaxed) {
+                if let Err(e) = reader.recv_batch(inbound_batch, &mut packets).await {
+                    log::error!("Data channel receive failed: {}", e);
+                    stats_clone.network_errors.fetch_add(1, Ordering::Relaxed);
+                    break;
+                }
+                inbound_keepalive.touch();
+                for packet in packets.drain(..) {
+                    match &open_tx {
+                        Some(open_tx) => {
+                            if open_tx.send(packet).await.is_err() {
+                                log::error!("Inbound crypto pipeline stopped; ending data channel receive");
+                                break 'receive;
+                            }
+                        }
+                        None => Self::process_inbound_packet(&stats_clone, packet).await,
+                    }
                 }
             }
+            is_running_clone.store(false, Ordering::Relaxed);
         });
 
         Ok(())
     }
 
-    /// Process outbound packet batch
-    async fn process_outbound_batch(stats: &PerformanceStats, packets: Vec<Bytes>) {
+    /// Send the batched packets with one vectored write and reset the batch
+    async fn process_outbound_batch<W: AsyncWrite + Unpin>(
+        stats: &PerformanceStats,
+        writer: &mut BinaryDataWriter<W>,
+        batch: &mut PacketBatch,
+    ) -> Result<()> {
+        if batch.is_empty() {
+            return Ok(());
+        }
         let start_time = Instant::now();
-        let mut total_bytes = 0;
-        let packet_count = packets.len();
-        
-        for packet in packets {
-            total_bytes += packet.len();
-            // Send packet to VPN server
-            // In real implementation, this would use the protocol client
+        let total_bytes = batch.total_size();
+        let packet_count = batch.len();
+        
+        let result = writer.send_batch(batch.packets().iter().map(|p| p.as_ref())).await;
+        batch.clear();
+        if let Err(e) = result {
+            log::error!("Outbound batch send failed: {}", e);
+            stats.network_errors.fetch_add(1, Ordering::Relaxed);
+            return Err(e);
         }
         
         let processing_time = start_time.elapsed();
+        stats.write_latency.record(processing_time);
         stats.update_traffic(total_bytes as u64, 0, packet_count as u64, 0);
         
         if processing_time > Duration::from_millis(100) {
             log::warn!("Slow outbound batch processing: {:?} for {} packets", processing_time, packet_count);
         }
-    }
-
-    /// Process individual outbound packet
-    async fn process_outbound_packet(stats: &PerformanceStats, packet: Bytes) {
-        let start_time = Instant::now();
-        
-        // Send packet to VPN server
-        // In real implementation, this would use the protocol client
-        
-        let processing_time = start_time.elapsed();
-        stats.update_traffic(packet.len() as u64, 0, 1, 0);
-        
-        if processing_time > Duration::from_millis(10) {
-            log::warn!("Slow outbound packet processing: {:?}", processing_time);
-        }
+        Ok(())
     }
 
     /// Process inbound packet
@@ -428,13 +540,13 @@ impl OptimizedVpnClient {
                 
                 if time_diff.as_secs() > 0 {
                     let throughput_mbps = (bytes_diff * 8) / (time_diff.as_secs() * 1_000_000);
-                    stats.update_performance(0, throughput_mbps); // Latency updated elsewhere
+                    stats.update_throughput(throughput_mbps);
                 }
                 
                 if detailed_stats {
-                    log::info!("Performance: {}MB/s, {}ms latency, {} active connections",
+                    log::info!("Performance: {}MB/s, {:?} p99 write latency, {} active connections",
                         current_snapshot.throughput_mbps,
-                        current_snapshot.avg_latency_ms,
+                        current_snapshot.write_latency.p99,
                         current_snapshot.active_connections);
                 }
                 
@@ -445,26 +557,6 @@ impl OptimizedVpnClient {
         Ok(())
     }
 
-    /// Start keepalive task
-    async fn start_keepalive_task(&self) -> Result<()> {
-        let is_running = Arc::clone(&self.is_running);
-        let keepalive_interval = self.perf_config.keepalive_interval;
-        
-        tokio::spawn(async move {
-            let mut interval = interval(keepalive_interval);
-            
-            while is_running.load(Ordering::Relaxed) {
-                interval.tick().await;
-                
-                // Send keepalive
-                // In real implementation, this would use the protocol client
-                log::debug!("Sending optimized keepalive");
-            }
-        });
-
-        Ok(())
-    }
-
     /// Send packet through optimized pipeline
     pub async fn send_packet(&self, packet: Bytes) -> Result<()> {
         if let Some(ref tx) = self.outbound_tx {
@@ -488,10 +580,10 @@ impl OptimizedVpnClient {
         // Adaptive MTU adjustment
         if self.perf_config.adaptive_mtu {
             let current_mtu = self.adaptive_mtu.load(Ordering::Relaxed);
-            let new_mtu = if stats.packet_loss_percent > 5 {
-                // High packet loss - reduce MTU
+            let new_mtu = if stats.write_latency.p99 > Duration::from_millis(200) {
+                // Writes stalling - reduce MTU
                 std::cmp::max(current_mtu - 100, 1280)
-            } else if stats.avg_latency_ms < 50 && stats.throughput_mbps > 100 {
+            } else if stats.write_latency.p99 < Duration::from_millis(50) && stats.throughput_mbps > 100 {
                 // Good performance - try larger MTU
                 std::cmp::min(current_mtu + 100, 9000)
             } else {
@@ -505,18 +597,14 @@ impl OptimizedVpnClient {
         }
         
         // Log performance recommendations
-        if stats.avg_latency_ms > 200 {
-            log::warn!("High latency detected ({}ms). Consider server optimization.", stats.avg_latency_ms);
+        if stats.write_latency.p99 > Duration::from_millis(200) {
+            log::warn!("High write latency detected ({:?} p99). Consider server optimization.", stats.write_latency.p99);
         }
         
         if stats.throughput_mbps < 10 {
             log::warn!("Low throughput detected ({}MB/s). Check network conditions.", stats.throughput_mbps);
         }
         
-        if stats.cpu_usage_percent > 80 {
-            log::warn!("High CPU usage ({}%). Consider reducing packet batch size.", stats.cpu_usage_percent);
-        }
-        
         Ok(())
     }
 
@@ -527,12 +615,10 @@ impl OptimizedVpnClient {
         self.is_running.store(false, Ordering::Relaxed);
         self.stats.is_monitoring.store(false, Ordering::Relaxed);
         
-        // Close channels
-        self.outbound_tx = None;
-        self.inbound_tx = None;
-        
-        // Note: Binary protocol client removed
-        // Protocol client cleanup no longer needed
+        // Closing the outbound queue stops the writer, which closes the data channel
+        if self.outbound_tx.take().is_some() {
+            self.stats.active_connections.fetch_sub(1, Ordering::Relaxed);
+        }
         
         // Close TUN interface
         if let Some(mut tun) = self.tun_interface.take() {
@@ -545,7 +631,6 @@ impl OptimizedVpnClient {
 
     /// Check if client is connected
     pub fn is_connected(&self) -> bool {
-        // Note: Binary protocol client removed, using is_running status only
         self.is_running.load(Ordering::Relaxed)
     }
 }
@@ -556,7 +641,7 @@ mod tests {
 
     #[test]
     fn test_packet_batch() {
-        let mut batch = PacketBatch::new();
+        let mut batch = PacketBatch::with_limits(32, 65536, Duration::from_millis(10));
         assert!(batch.is_empty());
         
         let small_packet = Bytes::from(vec![0u8; 100]);
@@ -574,28 +659,131 @@ mod tests {
         assert!(batch.len() >= 32); // Should have triggered batch flush
     }
 
+    #[test]
+    fn test_packet_batch_age_counts_from_first_packet() {
+        let mut batch = PacketBatch::with_limits(32, 65536, Duration::from_millis(5));
+        std::thread::sleep(Duration::from_millis(10));
+
+        // An idle gap before the first packet does not force a flush
+        assert!(!batch.add_packet(Bytes::from_static(b"ping")));
+        std::thread::sleep(Duration::from_millis(10));
+        assert!(batch.add_packet(Bytes::from_static(b"pong")));
+
+        batch.clear();
+        assert!(batch.is_empty());
+        assert_eq!(batch.total_size(), 0);
+    }
+
+    #[tokio::test]
+    async fn test_outbound_packets_reach_data_channel() {
+        let listener = tokio::net::TcpListener::bind("127.0.0.1:0").await.unwrap();
+        let addr = listener.local_addr().unwrap();
+        let stream = tokio::net::TcpStream::connect(addr).await.unwrap();
+        let (peer, _) = listener.accept().await.unwrap();
+
+        let mut client = OptimizedVpnClient::new(VpnConfig::default_test(), None);
+        client.start_data_channel(BinaryProtocolClient::from_stream(stream, 9)).await.unwrap();
+        assert!(client.is_connected());
+
+        let payloads: Vec<Bytes> = (0..5u8).map(|i| Bytes::from(vec![i; 100 + usize::from(i) * 300])).collect();
+        for payload in &payloads {
+            client.send_packet(payload.clone()).await.unwrap();
+        }
+
+        let mut reader = BinaryDataReader::new(peer);
+        let mut received = Vec::new();
+        while received.len() < payloads.len() {
+            reader.recv_batch(8, &mut received).await.unwrap();
+        }
+        assert_eq!(received, payloads);
+
+        // Counters are bumped just after the write returns
+        for _ in 0..100 {
+            if client.get_stats().packets_sent == payloads.len() as u64 {
+                break;
+            }
+            tokio::time::sleep(Duration::from_millis(5)).await;
+        }
+        assert_eq!(client.get_stats().packets_sent, payloads.len() as u64);
+        client.disconnect().await.unwrap();
+    }
+
+    #[tokio::test]
+    async fn test_session_key_seals_outbound_and_opens_inbound() {
+        let listener = tokio::net::TcpListener::bind("127.0.0.1:0").await.unwrap();
+        let addr = listener.local_addr().unwrap();
+        let stream = tokio::net::TcpStream::connect(addr).await.unwrap();
+        let (peer, _) = listener.accept().await.unwrap();
+        let (peer_read, peer_write) = peer.into_split();
+
+        let key = [3u8; 32];
+        let perf_config = PerformanceConfig { crypto_workers: 3, packet_batch_size: 4, ..Default::default() };
+        let mut client = OptimizedVpnClient::new(VpnConfig::default_test(), Some(perf_config));
+        client.set_session_key(&key).unwrap();
+        client.start_data_channel(BinaryProtocolClient::from_stream(stream, 9)).await.unwrap();
+
+        let payloads: Vec<Bytes> = (0..64u16).map(|i| Bytes::from(i.to_be_bytes().repeat(usize::from(i) + 1))).collect();
+        for payload in &payloads {
+            client.send_packet(payload.clone()).await.unwrap();
+        }
+
+        // The peer sees sealed packets, in order, that open with the shared key
+        let peer_cipher = SessionCipher::new(&key).unwrap();
+        let mut reader = BinaryDataReader::new(peer_read);
+        let mut received = Vec::new();
+        while received.len() < payloads.len() {
+            reader.recv_batch(16, &mut received).await.unwrap();
+        }
+        for (sealed, payload) in received.iter().zip(&payloads) {
+            let mut sealed = sealed.to_vec();
+            assert_eq!(peer_cipher.open_in_place(&mut sealed).unwrap(), &payload[..]);
+        }
+
+        // Sealed inbound packets are opened; garbage is dropped and counted
+        // (drops are tallied as later packets are delivered)
+        let mut writer = BinaryDataWriter::new(peer_write, 9);
+        let mut sealed = bytes::BytesMut::new();
+        peer_cipher.seal_into(b"inbound", &mut sealed).unwrap();
+        let garbage = [0u8; 40];
+        writer.send_batch([&garbage[..], &sealed[..]]).await.unwrap();
+        for _ in 0..100 {
+            let stats = client.get_stats();
+            if stats.packets_received == 1 && stats.protocol_errors == 1 {
+                break;
+            }
+            tokio::time::sleep(Duration::from_millis(5)).await;
+        }
+        let stats = client.get_stats();
+        assert_eq!(stats.packets_received, 1);
+        assert_eq!(stats.bytes_received, b"inbound".len() as u64);
+        assert_eq!(stats.protocol_errors, 1);
+        client.disconnect().await.unwrap();
+    }
+
     #[test]
     fn test_performance_stats() {
         let stats = PerformanceStats::new();
         
         stats.update_traffic(1000, 2000, 10, 20);
-        assert_eq!(stats.bytes_sent.load(Ordering::Relaxed), 1000);
-        assert_eq!(stats.bytes_received.load(Ordering::Relaxed), 2000);
+        assert_eq!(stats.bytes_sent.get(), 1000);
+        assert_eq!(stats.bytes_received.get(), 2000);
         
-        stats.update_performance(50, 100);
-        assert_eq!(stats.avg_latency_ms.load(Ordering::Relaxed), 50);
+        stats.update_throughput(100);
         assert_eq!(stats.throughput_mbps.load(Ordering::Relaxed), 100);
         
+        stats.write_latency.record(Duration::from_millis(50));
         let snapshot = stats.snapshot();
         assert_eq!(snapshot.bytes_sent, 1000);
-        assert_eq!(snapshot.avg_latency_ms, 50);
+        assert_eq!(snapshot.write_latency.count, 1);
+        assert_eq!(snapshot.write_latency.max, Duration::from_millis(50));
     }
 
     #[tokio::test]
     async fn test_optimized_client_creation() {
         let config = VpnConfig {
             server: crate::config::ServerConfig {
-                hostname: "test.example.com".to_string(),
+                address: "127.0.0.1".to_string(),
+                hostname: Some("test.example.com".to_string()),
                 port: 443,
                 hub: "VPN".to_string(),
                 use_ssl: true,
@@ -614,6 +802,7 @@ mod tests {
             connection_limits: Default::default(),
             network: Default::default(),
             logging: Default::default(),
+            clustering: Default::default(),
         };
         
         let client = OptimizedVpnClient::new(config, None);
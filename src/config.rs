@@ -6,8 +6,15 @@
 use crate::error::{Result, VpnError};
 use serde::{Deserialize, Serialize};
 use std::fs;
+use std::net::{IpAddr, SocketAddr};
+use std::ops::Deref;
 use std::path::Path;
 use std::str::FromStr;
+use std::sync::Arc;
+use std::time::Duration;
+
+/// Upper bound on TUN queues, matching the Linux kernel's MAX_TAP_QUEUES
+pub const MAX_TUN_QUEUES: u32 = 256;
 
 /// Authentication methods supported by `SoftEther` VPN
 #[derive(Debug, Clone, PartialEq, Serialize, Deserialize, Default)]
@@ -107,6 +114,10 @@ pub struct ClusteringConfig {
     /// Load balancing strategy
     #[serde(default = "default_lb_strategy")]
     pub load_balancing_strategy: LoadBalancingStrategy,
+    /// Relative weight of each cluster node, in `cluster_nodes` order
+    /// (missing entries default to 1, 0 drains a node)
+    #[serde(default)]
+    pub node_weights: Vec<u32>,
     /// Number of connections per cluster node
     #[serde(default = "default_connections_per_node")]
     pub connections_per_node: u32,
@@ -119,6 +130,9 @@ pub struct ClusteringConfig {
     /// Health check interval for cluster nodes (seconds)
     #[serde(default = "default_cluster_health_interval")]
     pub health_check_interval: u32,
+    /// Timeout for the TCP handshake probe of a health check (milliseconds)
+    #[serde(default = "default_health_check_timeout")]
+    pub health_check_timeout_ms: u32,
     /// Failover timeout (seconds)
     #[serde(default = "default_failover_timeout")]
     pub failover_timeout: u32,
@@ -141,6 +155,10 @@ pub enum LoadBalancingStrategy {
     WeightedRoundRobin,
     Random,
     ConsistentHashing,
+    /// Lowest smoothed handshake RTT
+    LeastLatency,
+    /// Better of two random nodes, scored by RTT, load and weight
+    PowerOfTwoChoices,
 }
 
 /// Session distribution modes for clustering
@@ -208,6 +226,28 @@ pub struct NetworkConfig {
     pub tcp_nodelay: bool,
     /// Socket buffer sizes
     pub socket_buffer_size: Option<u32>,
+    /// Number of TUN queues (Linux IFF_MULTI_QUEUE); each queue gets its own
+    /// worker and data channel. 1 keeps the single-queue device.
+    #[serde(default = "default_tun_queues")]
+    pub tun_queues: u32,
+    /// TCP/UDP segmentation offload on the TUN device (Linux IFF_VNET_HDR):
+    /// reads return up to 64 KB super-packets and writes coalesce TCP segments
+    #[serde(default)]
+    pub tun_offload: bool,
+    /// Lower the MSS of TCP connections through the tunnel to fit its MTU
+    #[serde(default)]
+    pub mss_clamp: bool,
+    /// Follow the data channel's path MTU and resize the TUN MTU to match
+    #[serde(default)]
+    pub adaptive_mtu: bool,
+    /// Move TUN packets through io_uring with registered buffers (Linux 5.6+);
+    /// falls back to the poll-based pump on older kernels
+    #[serde(default)]
+    pub tun_io_uring: bool,
+    /// Run the tunnel on a Wintun adapter with its ring-buffer packet pump
+    /// (Windows, needs `wintun.dll`) instead of a TAP-Windows adapter
+    #[serde(default)]
+    pub wintun: bool,
 }
 
 /// Logging configuration
@@ -309,6 +349,12 @@ impl Config {
             }
         }
 
+        if self.network.tun_queues == 0 || self.network.tun_queues > MAX_TUN_QUEUES {
+            return Err(VpnError::Config(format!(
+                "TUN queue count must be between 1 and {MAX_TUN_QUEUES}"
+            )));
+        }
+
         // Validate connection limits
         if self.connection_limits.max_connections > 1000 {
             return Err(VpnError::Config(
@@ -337,6 +383,14 @@ impl Config {
                     )));
                 }
             }
+
+            if self.clustering.node_weights.len() > self.clustering.cluster_nodes.len() {
+                return Err(VpnError::Config(format!(
+                    "{} node weights given for {} cluster nodes",
+                    self.clustering.node_weights.len(),
+                    self.clustering.cluster_nodes.len()
+                )));
+            }
         }
 
         Ok(())
@@ -375,14 +429,130 @@ impl FromStr for Config {
     type Err = VpnError;
 
     fn from_str(s: &str) -> Result<Self> {
-        let config: Config = toml::from_str(s)
-            .map_err(|e| VpnError::Config(format!("Failed to parse TOML config: {e}")))?;
-
+        let config = parse_toml(s)?;
         config.validate()?;
         Ok(config)
     }
 }
 
+fn parse_toml(s: &str) -> Result<Config> {
+    toml::from_str(s).map_err(|e| VpnError::Config(format!("Failed to parse TOML config: {e}")))
+}
+
+/// Durations and counts derived from a [`Config`] once, at compile time
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct ConfigLimits {
+    /// `server.timeout`
+    pub connect_timeout: Duration,
+    /// `server.keepalive_interval`, at least one second
+    pub keepalive_interval: Duration,
+    /// `connection_limits.retry_delay`
+    pub retry_delay: Duration,
+    /// `connection_limits.idle_timeout`
+    pub idle_timeout: Duration,
+    /// `connection_limits.max_lifetime`
+    pub max_lifetime: Duration,
+    /// `network.tun_queues`
+    pub tun_queues: usize,
+}
+
+impl ConfigLimits {
+    fn new(config: &Config) -> Self {
+        Self {
+            connect_timeout: Duration::from_secs(u64::from(config.server.timeout)),
+            keepalive_interval: Duration::from_secs(u64::from(config.server.keepalive_interval.max(1))),
+            retry_delay: Duration::from_millis(u64::from(config.connection_limits.retry_delay)),
+            idle_timeout: Duration::from_secs(u64::from(config.connection_limits.idle_timeout)),
+            max_lifetime: Duration::from_secs(u64::from(config.connection_limits.max_lifetime)),
+            tun_queues: config.network.tun_queues.max(1) as usize,
+        }
+    }
+}
+
+/// A parsed and validated configuration, shared read-only between clients
+///
+/// Parsing and validation happen once; every client created from the same
+/// `Arc<CompiledConfig>` shares it instead of re-parsing or cloning a
+/// [`Config`]. IP literal server and cluster node addresses are resolved to
+/// socket addresses up front; hostnames are still looked up at connect time.
+/// Dereferences to the underlying [`Config`].
+#[derive(Debug)]
+pub struct CompiledConfig {
+    config: Config,
+    clustering: Arc<ClusteringConfig>,
+    server_endpoints: Vec<SocketAddr>,
+    cluster_endpoints: Vec<Option<SocketAddr>>,
+    limits: ConfigLimits,
+}
+
+impl CompiledConfig {
+    /// Validate `config` and precompute what clients derive from it
+    pub fn compile(config: Config) -> Result<Arc<Self>> {
+        config.validate()?;
+
+        let server = config.server.address.trim_matches(|c| c == '[' || c == ']');
+        let server_endpoints = server.parse::<IpAddr>()
+            .map(|ip| vec![SocketAddr::new(ip, config.server.port)])
+            .unwrap_or_default();
+        let cluster_endpoints = config.clustering.cluster_nodes.iter()
+            .map(|node| node.parse::<SocketAddr>().ok())
+            .collect();
+
+        Ok(Arc::new(Self {
+            clustering: Arc::new(config.clustering.clone()),
+            server_endpoints,
+            cluster_endpoints,
+            limits: ConfigLimits::new(&config),
+            config,
+        }))
+    }
+
+    /// Parse TOML and compile it, validating once
+    pub fn parse(s: &str) -> Result<Arc<Self>> {
+        Self::compile(parse_toml(s)?)
+    }
+
+    /// Load a TOML file and compile it
+    pub fn from_file<P: AsRef<Path>>(path: P) -> Result<Arc<Self>> {
+        let contents = fs::read_to_string(path)
+            .map_err(|e| VpnError::Config(format!("Failed to read config file: {e}")))?;
+        Self::parse(&contents)
+    }
+
+    /// The validated configuration
+    pub fn config(&self) -> &Config {
+        &self.config
+    }
+
+    /// Clustering section, shared with cluster managers
+    pub fn clustering(&self) -> &Arc<ClusteringConfig> {
+        &self.clustering
+    }
+
+    /// Server socket addresses, empty if `server.address` is a hostname
+    pub fn server_endpoints(&self) -> &[SocketAddr] {
+        &self.server_endpoints
+    }
+
+    /// Socket address of each cluster node that is given as `ip:port`
+    pub fn cluster_endpoints(&self) -> &[Option<SocketAddr>] {
+        &self.cluster_endpoints
+    }
+
+    /// Precomputed durations and counts
+    pub fn limits(&self) -> &ConfigLimits {
+        &self.limits
+    }
+}
+
+impl Deref for CompiledConfig {
+    type Target = Config;
+
+    fn deref(&self) -> &Config {
+        &self.config
+    }
+}
+
 impl Default for ConnectionLimitsConfig {
     fn default() -> Self {
         Self {
@@ -415,6 +585,12 @@ impl Default for NetworkConfig {
             tcp_keepalive: default_true(),
             tcp_nodelay: default_true(),
             socket_buffer_size: None,
+            tun_queues: default_tun_queues(),
+            tun_offload: false,
+            mss_clamp: false,
+            adaptive_mtu: false,
+            tun_io_uring: false,
+            wintun: false,
         }
     }
 }
@@ -436,10 +612,12 @@ impl Default for ClusteringConfig {
             enabled: default_false(),
             cluster_nodes: default_cluster_nodes(),
             load_balancing_strategy: default_lb_strategy(),
+            node_weights: Vec::new(),
             connections_per_node: default_connections_per_node(),
             current_peer_count: default_zero(),
             max_peers_per_cluster: default_max_peers(),
             health_check_interval: default_cluster_health_interval(),
+            health_check_timeout_ms: default_health_check_timeout(),
             failover_timeout: default_failover_timeout(),
             enable_failover: default_true(),
             rpc_protocol_version: default_rpc_version(),
@@ -465,6 +643,7 @@ fn default_max_retry_delay() -> u32 { 30 }
 fn default_health_check_interval() -> u32 { 30 }
 fn default_rate_limit() -> u32 { 100 }
 fn default_burst_size() -> u32 { 200 }
+fn default_tun_queues() -> u32 { 1 }
 fn default_user_agent() -> String { "rVPNSE/0.1.0".to_string() }
 fn default_log_level() -> String { "info".to_string() }
 fn default_cluster_nodes() -> Vec<String> { vec!["127.0.0.1:443".to_string()] }
@@ -473,6 +652,7 @@ fn default_connections_per_node() -> u32 { 10 }
 fn default_zero() -> u32 { 0 }
 fn default_max_peers() -> u32 { 100 }
 fn default_cluster_health_interval() -> u32 { 30 }
+fn default_health_check_timeout() -> u32 { 2000 }
 fn default_failover_timeout() -> u32 { 60 }
 fn default_rpc_version() -> String { "1.0".to_string() }
 fn default_session_distribution() -> SessionDistributionMode { SessionDistributionMode::Distributed }
@@ -519,6 +699,8 @@ json_format = false
         assert_eq!(config.auth.method, AuthMethod::Password);
         assert_eq!(config.auth.username, Some("testuser".to_string()));
         assert_eq!(config.network.user_agent, "TestClient/1.0");
+        assert_eq!(config.network.tun_queues, 1);
+        assert!(!config.network.tun_offload);
         assert_eq!(config.logging.level, "debug");
     }
 
@@ -537,6 +719,15 @@ json_format = false
         config.server.address = "127.0.0.1".to_string();
         config.server.port = 0;
         assert!(config.validate().is_err());
+
+        // TUN queue count must stay within the kernel limit
+        config.server.port = 443;
+        config.network.tun_queues = 4;
+        assert!(config.validate().is_ok());
+        config.network.tun_queues = 0;
+        assert!(config.validate().is_err());
+        config.network.tun_queues = MAX_TUN_QUEUES + 1;
+        assert!(config.validate().is_err());
     }
 
     #[test]
@@ -564,4 +755,23 @@ json_format = false
         assert_eq!(config.server.address, parsed_config.server.address);
         assert_eq!(config.server.hostname, parsed_config.server.hostname);
     }
+
+    #[test]
+    fn test_compiled_config_precomputes_endpoints_and_limits() {
+        let mut config = Config::default_test();
+        config.server.keepalive_interval = 0;
+        config.connection_limits.retry_delay = 250;
+        config.clustering.cluster_nodes = vec!["10.0.0.1:443".to_string(), "vpn.example.com:443".to_string()];
+
+        let compiled = CompiledConfig::compile(config).unwrap();
+        assert_eq!(compiled.server_endpoints(), ["127.0.0.1:443".parse::<SocketAddr>().unwrap()]);
+        assert_eq!(compiled.cluster_endpoints(), [Some("10.0.0.1:443".parse().unwrap()), None]);
+        assert_eq!(compiled.limits().keepalive_interval, Duration::from_secs(1));
+        assert_eq!(compiled.limits().retry_delay, Duration::from_millis(250));
+        assert_eq!(compiled.server.hub, "DEFAULT");
+
+        let toml = compiled.to_toml().unwrap();
+        assert!(CompiledConfig::parse(&toml).unwrap().server_endpoints().len() == 1);
+        assert!(CompiledConfig::parse(&toml.replace("port = 443", "port = 0")).is_err());
+    }
 }
@@ -0,0 +1,221 @@
+//! Session-bound AEAD cipher
+//!
+//! [`SessionCipher`] expands an AES-256-GCM key once and then seals and opens
+//! packets in place, in buffers the caller owns. Each nonce is a per-cipher
+//! random 96-bit base XORed with a counter, so per-packet cost is the AES-GCM
+//! work alone: no key schedule, no RNG call and no allocation.
+//!
+//! Sealed layout: `nonce (12) | ciphertext | tag (16)`.
+
+use super::{aead, digest, rand, SecureRandom};
+use crate::error::{Result, VpnError};
+use bytes::{BufMut, BytesMut};
+use std::sync::atomic::{AtomicU64, Ordering};
+
+/// Bytes of nonce in front of every sealed packet
+pub const NONCE_LEN: usize = 12;
+
+/// Bytes of authentication tag after every sealed packet
+pub const TAG_LEN: usize = 16;
+
+/// Total bytes sealing adds to a plaintext
+pub const SEAL_OVERHEAD: usize = NONCE_LEN + TAG_LEN;
+
+/// AES-256-GCM key length
+pub const KEY_LEN: usize = 32;
+
+/// AES-256-GCM cipher bound to one session key
+///
+/// Safe to share between threads: sealing only bumps an atomic counter.
+/// Nonces never repeat within a cipher, and two ciphers built for the same
+/// key collide only if their random 96-bit bases do. Keep one cipher per key
+/// anyway (see [`CryptoEngine::session_cipher`](super::CryptoEngine::session_cipher)).
+pub struct SessionCipher {
+    key: aead::LessSafeKey,
+    /// SHA-256 of the key, to recognise it without keeping the key itself
+    fingerprint: [u8; 32],
+    nonce_base: [u8; NONCE_LEN],
+    counter: AtomicU64,
+}
+
+impl SessionCipher {
+    /// Expand `key` (32 bytes) into a ready-to-use cipher
+    pub fn new(key: &[u8]) -> Result<Self> {
+        if key.len() != KEY_LEN {
+            return Err(VpnError::Network("Key must be 32 bytes for AES-256".into()));
+        }
+        let unbound = aead::UnboundKey::new(&aead::AES_256_GCM, key)
+            .map_err(|e| VpnError::Network(format!("Key creation failed: {e:?}")))?;
+
+        let mut nonce_base = [0u8; NONCE_LEN];
+        rand::SystemRandom::new()
+            .fill(&mut nonce_base)
+            .map_err(|e| VpnError::Network(format!("Nonce generation failed: {e:?}")))?;
+
+        Ok(Self {
+            key: aead::LessSafeKey::new(unbound),
+            fingerprint: fingerprint(key),
+            nonce_base,
+            counter: AtomicU64::new(0),
+        })
+    }
+
+    /// Whether this cipher was built for `key`, compared in constant time
+    pub fn is_key(&self, key: &[u8]) -> bool {
+        let other = fingerprint(key);
+        self.fingerprint.iter().zip(&other).fold(0u8, |diff, (a, b)| diff | (a ^ b)) == 0
+    }
+
+    /// Next unique nonce
+    fn next_nonce(&self) -> Result<[u8; NONCE_LEN]> {
+        let count = self.counter.fetch_add(1, Ordering::Relaxed);
+        if count == u64::MAX {
+            return Err(VpnError::Network(
+                "Nonce space exhausted; rekey required".into(),
+            ));
+        }
+        let mut nonce = self.nonce_base;
+        for (byte, count) in nonce[NONCE_LEN - 8..].iter_mut().zip(count.to_be_bytes()) {
+            *byte ^= count;
+        }
+        Ok(nonce)
+    }
+
+    /// Seal `buf[NONCE_LEN..NONCE_LEN + plaintext_len]` in place
+    ///
+    /// `buf` must have [`NONCE_LEN`] bytes of headroom before the plaintext
+    /// and [`TAG_LEN`] bytes of room after it. Returns the sealed length,
+    /// `plaintext_len + SEAL_OVERHEAD`.
+    pub fn seal_in_place(&self, buf: &mut [u8], plaintext_len: usize) -> Result<usize> {
+        let sealed_len = plaintext_len + SEAL_OVERHEAD;
+        if buf.len() < sealed_len {
+            return Err(VpnError::Network(format!(
+                "Buffer of {} bytes cannot hold {} sealed bytes",
+                buf.len(),
+                sealed_len
+            )));
+        }
+
+        let nonce_bytes = self.next_nonce()?;
+        let (nonce_room, rest) = buf.split_at_mut(NONCE_LEN);
+        let (payload, tag_room) = rest.split_at_mut(plaintext_len);
+        nonce_room.copy_from_slice(&nonce_bytes);
+
+        let tag = self
+            .key
+            .seal_in_place_separate_tag(
+                aead::Nonce::assume_unique_for_key(nonce_bytes),
+                aead::Aad::empty(),
+                payload,
+            )
+            .map_err(|e| VpnError::Network(format!("Encryption failed: {e:?}")))?;
+        tag_room[..TAG_LEN].copy_from_slice(tag.as_ref());
+        Ok(sealed_len)
+    }
+
+    /// Append the sealed form of `plaintext` to `out`
+    ///
+    /// The plaintext is copied once, straight into its final place.
+    pub fn seal_into(&self, plaintext: &[u8], out: &mut BytesMut) -> Result<()> {
+        let start = out.len();
+        out.reserve(plaintext.len() + SEAL_OVERHEAD);
+        out.put_bytes(0, NONCE_LEN);
+        out.extend_from_slice(plaintext);
+        out.put_bytes(0, TAG_LEN);
+        if let Err(e) = self.seal_in_place(&mut out[start..], plaintext.len()) {
+            out.truncate(start);
+            return Err(e);
+        }
+        Ok(())
+    }
+
+    /// Open a sealed packet in place and return the plaintext within `buf`
+    pub fn open_in_place<'a>(&self, buf: &'a mut [u8]) -> Result<&'a mut [u8]> {
+        if buf.len() < SEAL_OVERHEAD {
+            return Err(VpnError::Network(
+                "Data too short to contain nonce and tag".into(),
+            ));
+        }
+        let (nonce_bytes, sealed) = buf.split_at_mut(NONCE_LEN);
+        let nonce = aead::Nonce::try_assume_unique_for_key(nonce_bytes)
+            .map_err(|e| VpnError::Network(format!("Invalid nonce: {e:?}")))?;
+
+        self.key
+            .open_in_place(nonce, aead::Aad::empty(), sealed)
+            .map_err(|e| VpnError::Network(format!("Decryption failed: {e:?}")))
+    }
+
+    /// Packets sealed so far
+    pub fn sealed_count(&self) -> u64 {
+        self.counter.load(Ordering::Relaxed)
+    }
+}
+
+fn fingerprint(key: &[u8]) -> [u8; 32] {
+    let mut fingerprint = [0u8; 32];
+    fingerprint.copy_from_slice(digest::digest(&digest::SHA256, key).as_ref());
+    fingerprint
+}
+
+impl std::fmt::Debug for SessionCipher {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("SessionCipher")
+            .field("sealed_count", &self.sealed_count())
+            .finish_non_exhaustive()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_seal_and_open_in_place() {
+        let cipher = SessionCipher::new(&[7u8; KEY_LEN]).unwrap();
+        let plaintext = b"ip packet payload";
+
+        let mut buf = vec![0u8; plaintext.len() + SEAL_OVERHEAD];
+        buf[NONCE_LEN..NONCE_LEN + plaintext.len()].copy_from_slice(plaintext);
+        let sealed_len = cipher.seal_in_place(&mut buf, plaintext.len()).unwrap();
+        assert_eq!(sealed_len, buf.len());
+        assert_ne!(&buf[NONCE_LEN..NONCE_LEN + plaintext.len()], plaintext);
+
+        assert_eq!(cipher.open_in_place(&mut buf).unwrap(), plaintext);
+    }
+
+    #[test]
+    fn test_counter_nonces_are_unique_and_tampering_fails() {
+        let cipher = SessionCipher::new(&[1u8; KEY_LEN]).unwrap();
+        let mut first = BytesMut::new();
+        let mut second = BytesMut::new();
+        cipher.seal_into(b"same", &mut first).unwrap();
+        cipher.seal_into(b"same", &mut second).unwrap();
+
+        assert_ne!(&first[..NONCE_LEN], &second[..NONCE_LEN]);
+        assert_eq!(cipher.sealed_count(), 2);
+        // Only the low 64 bits carry the counter; the base stays random
+        let differing: Vec<usize> = (0..NONCE_LEN).filter(|&i| first[i] != second[i]).collect();
+        assert!(differing.iter().all(|&i| i >= NONCE_LEN - 8));
+
+        // A second cipher for the same key starts from a different base
+        let rebuilt = SessionCipher::new(&[1u8; KEY_LEN]).unwrap();
+        let mut third = BytesMut::new();
+        rebuilt.seal_into(b"same", &mut third).unwrap();
+        assert_ne!(&first[..NONCE_LEN], &third[..NONCE_LEN]);
+        assert!(rebuilt.is_key(&[1u8; KEY_LEN]));
+        assert!(!rebuilt.is_key(&[2u8; KEY_LEN]));
+
+        let last = second.len() - 1;
+        second[last] ^= 1;
+        assert!(cipher.open_in_place(&mut second).is_err());
+        assert!(SessionCipher::new(&[0u8; 16]).is_err());
+    }
+
+    #[test]
+    fn test_seal_rejects_missing_headroom() {
+        let cipher = SessionCipher::new(&[2u8; KEY_LEN]).unwrap();
+        let mut buf = vec![0u8; 20];
+        assert!(cipher.seal_in_place(&mut buf, 10).is_err());
+        assert_eq!(cipher.sealed_count(), 0);
+    }
+}
@@ -1,5 +1,6 @@
 /// Cryptographic operations and abstractions
 use crate::error::Result;
+use std::sync::{Arc, RwLock};
 
 // Conditional crypto imports - prioritize ring if both features are enabled
 #[cfg(all(feature = "ring-crypto", not(feature = "aws-lc-crypto")))]
@@ -18,11 +19,24 @@ use ring::rand::SecureRandom;
 #[cfg(all(feature = "ring-crypto", feature = "aws-lc-crypto"))]
 use ring::{aead, digest, pbkdf2, rand};
 
+pub mod cipher;
+pub mod pipeline;
 pub mod tls;
 
+pub use cipher::{SessionCipher, NONCE_LEN, SEAL_OVERHEAD, TAG_LEN};
+pub use pipeline::{CryptoDirection, CryptoPipeline, PipelineConfig};
+pub use tls::{TlsSessionCache, TlsSessionCacheStats};
+
+/// Keys whose ciphers a [`CryptoEngine`] keeps; the oldest is dropped beyond this
+const MAX_CACHED_CIPHERS: usize = 16;
+
 /// Cryptographic engine for VPN operations
 pub struct CryptoEngine {
     rng: rand::SystemRandom,
+    /// One cipher per recently used key, so a key keeps its nonce counter
+    /// and repeated calls skip key expansion. Ciphers hold only a key
+    /// fingerprint, never the key.
+    ciphers: RwLock<Vec<Arc<SessionCipher>>>,
 }
 
 impl CryptoEngine {
@@ -30,68 +44,59 @@ impl CryptoEngine {
     pub fn new() -> Result<Self> {
         Ok(Self {
             rng: rand::SystemRandom::new(),
+            ciphers: RwLock::new(Vec::new()),
         })
     }
 
-    /// Encrypt data using AES-GCM
-    pub fn encrypt(&self, data: &[u8], key: &[u8]) -> Result<Vec<u8>> {
-        if key.len() != 32 {
-            return Err(crate::error::VpnError::Network(
-                "Key must be 32 bytes for AES-256".into(),
-            ));
+    /// Session cipher for `key`, expanded on first use and cached after
+    ///
+    /// Callers on the packet path should hold on to the returned cipher and
+    /// use its in-place methods directly.
+    pub fn session_cipher(&self, key: &[u8]) -> Result<Arc<SessionCipher>> {
+        if let Some(cipher) = self.ciphers.read().unwrap().iter().find(|cipher| cipher.is_key(key)) {
+            return Ok(cipher.clone());
         }
+        let mut ciphers = self.ciphers.write().unwrap();
+        // Another caller may have added it meanwhile
+        if let Some(cipher) = ciphers.iter().find(|cipher| cipher.is_key(key)) {
+            return Ok(cipher.clone());
+        }
+        let cipher = Arc::new(SessionCipher::new(key)?);
+        if ciphers.len() == MAX_CACHED_CIPHERS {
+            ciphers.remove(0);
+        }
+        ciphers.push(cipher.clone());
+        Ok(cipher)
+    }
 
-        let key =
-            aead::LessSafeKey::new(aead::UnboundKey::new(&aead::AES_256_GCM, key).map_err(
-                |e| crate::error::VpnError::Network(format!("Key creation failed: {e:?}")),
-            )?);
-
-        let mut nonce_bytes = [0u8; 12];
-        self.rng.fill(&mut nonce_bytes).map_err(|e| {
-            crate::error::VpnError::Network(format!("Nonce generation failed: {e:?}"))
-        })?;
-
-        let nonce = aead::Nonce::assume_unique_for_key(nonce_bytes);
-
-        let mut in_out = data.to_vec();
-        key.seal_in_place_append_tag(nonce, aead::Aad::empty(), &mut in_out)
-            .map_err(|e| crate::error::VpnError::Network(format!("Encryption failed: {e:?}")))?;
+    /// Encrypt data using AES-GCM
+    ///
+    /// Output is `nonce | ciphertext | tag`, built in a single allocation.
+    pub fn encrypt(&self, data: &[u8], key: &[u8]) -> Result<Vec<u8>> {
+        let cipher = self.session_cipher(key)?;
 
-        // Prepend nonce to encrypted data
-        let mut result = nonce_bytes.to_vec();
-        result.extend_from_slice(&in_out);
+        let mut result = vec![0u8; data.len() + SEAL_OVERHEAD];
+        result[NONCE_LEN..NONCE_LEN + data.len()].copy_from_slice(data);
+        cipher.seal_in_place(&mut result, data.len())?;
         Ok(result)
     }
 
     /// Decrypt data using AES-GCM
     pub fn decrypt(&self, data: &[u8], key: &[u8]) -> Result<Vec<u8>> {
-        if key.len() != 32 {
-            return Err(crate::error::VpnError::Network(
-                "Key must be 32 bytes for AES-256".into(),
-            ));
-        }
+        let cipher = self.session_cipher(key)?;
 
-        if data.len() < 12 {
+        if data.len() < NONCE_LEN {
             return Err(crate::error::VpnError::Network(
                 "Data too short to contain nonce".into(),
             ));
         }
 
-        let key =
-            aead::LessSafeKey::new(aead::UnboundKey::new(&aead::AES_256_GCM, key).map_err(
-                |e| crate::error::VpnError::Network(format!("Key creation failed: {e:?}")),
-            )?);
-
-        let (nonce_bytes, encrypted_data) = data.split_at(12);
-        let nonce = aead::Nonce::try_assume_unique_for_key(nonce_bytes)
-            .map_err(|e| crate::error::VpnError::Network(format!("Invalid nonce: {e:?}")))?;
-
-        let mut in_out = encrypted_data.to_vec();
-        let decrypted = key
-            .open_in_place(nonce, aead::Aad::empty(), &mut in_out)
-            .map_err(|e| crate::error::VpnError::Network(format!("Decryption failed: {e:?}")))?;
-
-        Ok(decrypted.to_vec())
+        // Opened in place; the plaintext is then shifted over the nonce
+        let mut result = data.to_vec();
+        let plaintext_len = cipher.open_in_place(&mut result)?.len();
+        result.copy_within(NONCE_LEN..NONCE_LEN + plaintext_len, 0);
+        result.truncate(plaintext_len);
+        Ok(result)
     }
 
     /// Generate random bytes
@@ -129,3 +134,28 @@ impl Default for CryptoEngine {
         Self::new().expect("Failed to create default crypto engine")
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_encrypt_decrypt_reuses_cached_cipher() {
+        let engine = CryptoEngine::new().unwrap();
+        let key = [9u8; 32];
+
+        let sealed = engine.encrypt(b"hello tunnel", &key).unwrap();
+        assert_eq!(sealed.len(), b"hello tunnel".len() + SEAL_OVERHEAD);
+        assert_eq!(engine.decrypt(&sealed, &key).unwrap(), b"hello tunnel");
+
+        let cipher = engine.session_cipher(&key).unwrap();
+        assert_eq!(cipher.sealed_count(), 1);
+        assert!(Arc::ptr_eq(&cipher, &engine.session_cipher(&key).unwrap()));
+        assert!(engine.decrypt(&sealed, &[8u8; 32]).is_err());
+
+        // Switching keys and back keeps the first key's cipher and counter
+        let other = engine.session_cipher(&[8u8; 32]).unwrap();
+        assert!(!Arc::ptr_eq(&cipher, &other));
+        assert!(Arc::ptr_eq(&cipher, &engine.session_cipher(&key).unwrap()));
+    }
+}
@@ -0,0 +1,245 @@
+//! Parallel AEAD pipeline
+//!
+//! Fans packet batches out to a pool of crypto worker threads sharing one
+//! [`SessionCipher`], then restores the original order before handing the
+//! results on. Each batch gets a sequence number before fan-out; the reorder
+//! stage releases batches strictly in that order, so a tunnel keeps packet
+//! order while sealing or opening on as many cores as it has workers.
+//!
+//! Workers are plain OS threads: AES-GCM is pure CPU work and would otherwise
+//! stall the async runtime's threads.
+
+use super::cipher::{SessionCipher, NONCE_LEN, SEAL_OVERHEAD};
+use bytes::{Bytes, BytesMut};
+use std::collections::BTreeMap;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+use tokio::sync::mpsc;
+
+/// Batches queued per worker before the dispatcher waits
+const WORKER_QUEUE_DEPTH: usize = 4;
+
+/// What the pipeline does to each packet
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CryptoDirection {
+    /// Plaintext in, `nonce | ciphertext | tag` out
+    Seal,
+    /// Sealed packets in, plaintext out; packets that fail to open are dropped
+    Open,
+}
+
+/// Sizing of a [`CryptoPipeline`]
+#[derive(Debug, Clone, Copy)]
+pub struct PipelineConfig {
+    /// Number of crypto worker threads
+    pub workers: usize,
+    /// Most packets handed to a worker at once
+    pub batch_size: usize,
+    /// Depth of the ordered output queue
+    pub output_depth: usize,
+}
+
+/// Running pipeline: ordered output plus a count of dropped packets
+pub struct CryptoPipeline {
+    output: mpsc::Receiver<Bytes>,
+    dropped: Arc<AtomicU64>,
+}
+
+impl CryptoPipeline {
+    /// Start a pipeline processing everything sent on `input`
+    ///
+    /// Must be called inside a tokio runtime. The pipeline shuts down once
+    /// `input` is closed and drained, closing the output after the last batch.
+    pub fn spawn(
+        cipher: Arc<SessionCipher>,
+        direction: CryptoDirection,
+        config: PipelineConfig,
+        mut input: mpsc::Receiver<Bytes>,
+    ) -> std::io::Result<Self> {
+        let workers = config.workers.max(1);
+        let batch_size = config.batch_size.max(1);
+        let dropped = Arc::new(AtomicU64::new(0));
+        let (done_tx, mut done_rx) = mpsc::channel::<(u64, Vec<Bytes>)>(workers * WORKER_QUEUE_DEPTH);
+        let (output_tx, output) = mpsc::channel(config.output_depth.max(batch_size));
+
+        let mut worker_txs = Vec::with_capacity(workers);
+        for index in 0..workers {
+            let (tx, mut rx) = mpsc::channel::<(u64, Vec<Bytes>)>(WORKER_QUEUE_DEPTH);
+            let cipher = Arc::clone(&cipher);
+            let done_tx = done_tx.clone();
+            let dropped = Arc::clone(&dropped);
+            std::thread::Builder::new()
+                .name(format!("rvpnse-crypto-{index}"))
+                .spawn(move || {
+                    while let Some((seq, packets)) = rx.blocking_recv() {
+                        let processed = process_batch(&cipher, direction, &packets, &dropped);
+                        if done_tx.blocking_send((seq, processed)).is_err() {
+                            break;
+                        }
+                    }
+                })?;
+            worker_txs.push(tx);
+        }
+        drop(done_tx);
+
+        // Dispatcher: number batches, then hand them out round-robin
+        tokio::spawn(async move {
+            let mut seq = 0u64;
+            while let Some(first) = input.recv().await {
+                let mut batch = Vec::with_capacity(batch_size);
+                batch.push(first);
+                while batch.len() < batch_size {
+                    match input.try_recv() {
+                        Ok(packet) => batch.push(packet),
+                        Err(_) => break,
+                    }
+                }
+                let worker = &worker_txs[(seq % workers as u64) as usize];
+                if worker.send((seq, batch)).await.is_err() {
+                    break;
+                }
+                seq += 1;
+            }
+        });
+
+        // Reorder stage: release batches in sequence order
+        tokio::spawn(async move {
+            let mut reorder = ReorderBuffer::default();
+            while let Some((seq, packets)) = done_rx.recv().await {
+                reorder.insert(seq, packets);
+                while let Some(packets) = reorder.pop_ready() {
+                    for packet in packets {
+                        if output_tx.send(packet).await.is_err() {
+                            return;
+                        }
+                    }
+                }
+            }
+        });
+
+        Ok(Self { output, dropped })
+    }
+
+    /// Next processed packet, in input order; `None` once the pipeline has shut down
+    pub async fn recv(&mut self) -> Option<Bytes> {
+        self.output.recv().await
+    }
+
+    /// Packets dropped because they could not be sealed or opened
+    pub fn dropped(&self) -> u64 {
+        self.dropped.load(Ordering::Relaxed)
+    }
+
+    /// Give up the handle and keep only the ordered output queue
+    pub fn into_output(self) -> mpsc::Receiver<Bytes> {
+        self.output
+    }
+}
+
+/// Seal or open one batch, using a single allocation for all of its output
+fn process_batch(
+    cipher: &SessionCipher,
+    direction: CryptoDirection,
+    packets: &[Bytes],
+    dropped: &AtomicU64,
+) -> Vec<Bytes> {
+    let mut out = Vec::with_capacity(packets.len());
+    match direction {
+        CryptoDirection::Seal => {
+            let total: usize = packets.iter().map(|p| p.len() + SEAL_OVERHEAD).sum();
+            let mut buf = BytesMut::with_capacity(total);
+            for packet in packets {
+                match cipher.seal_into(packet, &mut buf) {
+                    Ok(()) => out.push(buf.split().freeze()),
+                    Err(e) => {
+                        log::debug!("Dropping packet that failed to seal: {}", e);
+                        dropped.fetch_add(1, Ordering::Relaxed);
+                    }
+                }
+            }
+        }
+        CryptoDirection::Open => {
+            let total: usize = packets.iter().map(|p| p.len()).sum();
+            let mut buf = BytesMut::with_capacity(total);
+            for packet in packets {
+                buf.extend_from_slice(packet);
+                let opened = cipher.open_in_place(&mut buf).map(|plaintext| plaintext.len());
+                let sealed = buf.split().freeze();
+                match opened {
+                    Ok(len) => out.push(sealed.slice(NONCE_LEN..NONCE_LEN + len)),
+                    Err(_) => {
+                        dropped.fetch_add(1, Ordering::Relaxed);
+                    }
+                }
+            }
+        }
+    }
+    out
+}
+
+/// Holds batches that finished ahead of their turn
+#[derive(Debug, Default)]
+struct ReorderBuffer {
+    next: u64,
+    pending: BTreeMap<u64, Vec<Bytes>>,
+}
+
+impl ReorderBuffer {
+    fn insert(&mut self, seq: u64, packets: Vec<Bytes>) {
+        self.pending.insert(seq, packets);
+    }
+
+    /// The next batch in sequence, if it has arrived
+    fn pop_ready(&mut self) -> Option<Vec<Bytes>> {
+        let packets = self.pending.remove(&self.next)?;
+        self.next += 1;
+        Some(packets)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_reorder_buffer_releases_in_sequence() {
+        let mut reorder = ReorderBuffer::default();
+        reorder.insert(1, vec![Bytes::from_static(b"b")]);
+        reorder.insert(2, vec![Bytes::from_static(b"c")]);
+        assert!(reorder.pop_ready().is_none());
+
+        reorder.insert(0, vec![Bytes::from_static(b"a")]);
+        let released: Vec<Bytes> = std::iter::from_fn(|| reorder.pop_ready()).flatten().collect();
+        assert_eq!(released, vec![&b"a"[..], &b"b"[..], &b"c"[..]]);
+    }
+
+    #[tokio::test]
+    async fn test_parallel_seal_then_open_preserves_order() {
+        let cipher = Arc::new(SessionCipher::new(&[5u8; 32]).unwrap());
+        let config = PipelineConfig { workers: 4, batch_size: 3, output_depth: 64 };
+
+        let (plain_tx, plain_rx) = mpsc::channel(64);
+        let sealed = CryptoPipeline::spawn(cipher.clone(), CryptoDirection::Seal, config, plain_rx).unwrap();
+        let mut opened =
+            CryptoPipeline::spawn(cipher.clone(), CryptoDirection::Open, config, sealed.into_output()).unwrap();
+
+        let payloads: Vec<Bytes> = (0..200u32).map(|i| Bytes::from(i.to_be_bytes().repeat(1 + (i as usize % 7)))).collect();
+        let sender = {
+            let payloads = payloads.clone();
+            tokio::spawn(async move {
+                for payload in payloads {
+                    plain_tx.send(payload).await.unwrap();
+                }
+            })
+        };
+
+        let mut received = Vec::new();
+        while let Some(packet) = opened.recv().await {
+            received.push(packet);
+        }
+        sender.await.unwrap();
+        assert_eq!(received, payloads);
+        assert_eq!(opened.dropped(), 0);
+        assert_eq!(cipher.sealed_count(), payloads.len() as u64);
+    }
+}
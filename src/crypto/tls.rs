@@ -1,11 +1,136 @@
 //! TLS/SSL handling for secure connections
+//!
+//! All client TLS configurations share one bounded [`TlsSessionCache`], so a
+//! reconnect to a server seen before resumes its session from a ticket
+//! instead of running a full handshake. [`http_client_builder`] hands the same
+//! configuration to reqwest.
 
 use crate::error::Result;
+use rustls::client::{ClientSessionMemoryCache, ClientSessionStore, Resumption};
+use rustls::client::{Tls12ClientSessionValue, Tls13ClientSessionValue};
 use rustls::pki_types::ServerName;
-use rustls::{ClientConfig, ClientConnection, RootCertStore, StreamOwned};
+use rustls::{ClientConfig, ClientConnection, NamedGroup, RootCertStore, StreamOwned};
 use std::io::{Read, Write};
 use std::net::TcpStream;
-use std::sync::Arc;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, OnceLock};
+
+/// Servers the shared session cache remembers tickets for
+pub const SESSION_CACHE_SIZE: usize = 256;
+
+/// Counters of the shared TLS session cache
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct TlsSessionCacheStats {
+    /// Handshakes that found a ticket or session to resume
+    pub hits: u64,
+    /// Handshakes that had to start from scratch
+    pub misses: u64,
+}
+
+/// Bounded TLS client session store that counts hits and misses
+#[derive(Debug)]
+pub struct TlsSessionCache {
+    inner: ClientSessionMemoryCache,
+    hits: AtomicU64,
+    misses: AtomicU64,
+}
+
+impl TlsSessionCache {
+    /// Create a cache holding sessions for up to `size` servers
+    pub fn new(size: usize) -> Self {
+        Self {
+            inner: ClientSessionMemoryCache::new(size),
+            hits: AtomicU64::new(0),
+            misses: AtomicU64::new(0),
+        }
+    }
+
+    /// Process-wide cache used by every [`TlsConfig`]
+    pub fn shared() -> Arc<Self> {
+        static SHARED: OnceLock<Arc<TlsSessionCache>> = OnceLock::new();
+        SHARED
+            .get_or_init(|| Arc::new(Self::new(SESSION_CACHE_SIZE)))
+            .clone()
+    }
+
+    /// Current hit and miss counts
+    pub fn stats(&self) -> TlsSessionCacheStats {
+        TlsSessionCacheStats {
+            hits: self.hits.load(Ordering::Relaxed),
+            misses: self.misses.load(Ordering::Relaxed),
+        }
+    }
+
+    fn count<T>(&self, found: Option<T>) -> Option<T> {
+        let counter = if found.is_some() { &self.hits } else { &self.misses };
+        counter.fetch_add(1, Ordering::Relaxed);
+        found
+    }
+}
+
+// rustls asks for a TLS 1.3 ticket first and falls back to a TLS 1.2
+// session, so a lookup is a hit when either is found and a miss only once
+// the TLS 1.2 lookup comes back empty too.
+impl ClientSessionStore for TlsSessionCache {
+    fn set_kx_hint(&self, server_name: ServerName<'static>, group: NamedGroup) {
+        self.inner.set_kx_hint(server_name, group)
+    }
+
+    fn kx_hint(&self, server_name: &ServerName<'_>) -> Option<NamedGroup> {
+        self.inner.kx_hint(server_name)
+    }
+
+    fn set_tls12_session(&self, server_name: ServerName<'static>, value: Tls12ClientSessionValue) {
+        self.inner.set_tls12_session(server_name, value)
+    }
+
+    fn tls12_session(&self, server_name: &ServerName<'_>) -> Option<Tls12ClientSessionValue> {
+        self.count(self.inner.tls12_session(server_name))
+    }
+
+    fn remove_tls12_session(&self, server_name: &ServerName<'static>) {
+        self.inner.remove_tls12_session(server_name)
+    }
+
+    fn insert_tls13_ticket(&self, server_name: ServerName<'static>, value: Tls13ClientSessionValue) {
+        self.inner.insert_tls13_ticket(server_name, value)
+    }
+
+    fn take_tls13_ticket(&self, server_name: &ServerName<'static>) -> Option<Tls13ClientSessionValue> {
+        let ticket = self.inner.take_tls13_ticket(server_name);
+        if ticket.is_some() {
+            self.hits.fetch_add(1, Ordering::Relaxed);
+        }
+        ticket
+    }
+}
+
+/// Shared session cache counters
+pub fn session_cache_stats() -> TlsSessionCacheStats {
+    TlsSessionCache::shared().stats()
+}
+
+/// Shared client configuration for the given verification mode
+///
+/// Built once per mode; every caller gets the same configuration and with
+/// it the shared session cache.
+pub fn shared_client_config(verify_certificate: bool) -> Result<Arc<ClientConfig>> {
+    static VERIFYING: OnceLock<Arc<ClientConfig>> = OnceLock::new();
+    static ACCEPT_ALL: OnceLock<Arc<ClientConfig>> = OnceLock::new();
+
+    let cell = if verify_certificate { &VERIFYING } else { &ACCEPT_ALL };
+    if let Some(config) = cell.get() {
+        return Ok(config.clone());
+    }
+    let config = TlsConfig::new(verify_certificate)?.client_config();
+    Ok(cell.get_or_init(|| config).clone())
+}
+
+/// reqwest client builder using the shared TLS configuration
+pub fn http_client_builder(verify_certificate: bool) -> Result<reqwest::ClientBuilder> {
+    let config = shared_client_config(verify_certificate)?;
+    Ok(reqwest::Client::builder().use_preconfigured_tls(ClientConfig::clone(&config)))
+}
 
 /// Custom certificate verifier that accepts all certificates (for VPN Gate testing)
 #[derive(Debug)]
@@ -61,6 +186,32 @@ impl rustls::client::danger::ServerCertVerifier for AcceptAllVerifier {
     }
 }
 
+/// Install the rustls crypto provider selected by feature flags, once
+///
+/// Prioritizes ring if both features are enabled (for CI --all-features).
+fn install_crypto_provider() -> Result<()> {
+    if rustls::crypto::CryptoProvider::get_default().is_some() {
+        return Ok(());
+    }
+
+    #[cfg(any(feature = "ring-crypto", feature = "aws-lc-crypto"))]
+    {
+        #[cfg(feature = "ring-crypto")]
+        let (provider, name) = (rustls::crypto::ring::default_provider(), "ring");
+        #[cfg(all(feature = "aws-lc-crypto", not(feature = "ring-crypto")))]
+        let (provider, name) = (rustls::crypto::aws_lc_rs::default_provider(), "aws-lc-rs");
+
+        // Losing the race to another thread's install is fine
+        if provider.install_default().is_err() && rustls::crypto::CryptoProvider::get_default().is_none() {
+            return Err(crate::error::VpnError::Network(format!(
+                "Failed to install {name} crypto provider"
+            )));
+        }
+    }
+
+    Ok(())
+}
+
 /// TLS configuration for VPN connections
 pub struct TlsConfig {
     client_config: Arc<ClientConfig>,
@@ -69,39 +220,9 @@ pub struct TlsConfig {
 impl TlsConfig {
     /// Create a new TLS configuration
     pub fn new(verify_certificate: bool) -> Result<Self> {
-        // Install crypto provider based on feature flags
-        // Prioritize ring if both features are enabled (for CI --all-features)
-        #[cfg(all(feature = "ring-crypto", not(feature = "aws-lc-crypto")))]
-        {
-            rustls::crypto::ring::default_provider()
-                .install_default()
-                .map_err(|_| {
-                    crate::error::VpnError::Network("Failed to install ring crypto provider".into())
-                })?;
-        }
-
-        #[cfg(all(feature = "aws-lc-crypto", not(feature = "ring-crypto")))]
-        {
-            rustls::crypto::aws_lc_rs::default_provider()
-                .install_default()
-                .map_err(|_| {
-                    crate::error::VpnError::Network(
-                        "Failed to install aws-lc-rs crypto provider".into(),
-                    )
-                })?;
-        }
-
-        // If both features are enabled, prefer ring (for CI --all-features)
-        #[cfg(all(feature = "ring-crypto", feature = "aws-lc-crypto"))]
-        {
-            rustls::crypto::ring::default_provider()
-                .install_default()
-                .map_err(|_| {
-                    crate::error::VpnError::Network("Failed to install ring crypto provider".into())
-                })?;
-        }
+        install_crypto_provider()?;
 
-        let client_config = if verify_certificate {
+        let mut client_config = if verify_certificate {
             // Use standard certificate verification
             let mut root_store = RootCertStore::empty();
             root_store.extend(webpki_roots::TLS_SERVER_ROOTS.iter().cloned());
@@ -116,6 +237,7 @@ impl TlsConfig {
                 .with_custom_certificate_verifier(Arc::new(AcceptAllVerifier))
                 .with_no_client_auth()
         };
+        client_config.resumption = Resumption::store(TlsSessionCache::shared());
 
         Ok(Self {
             client_config: Arc::new(client_config),
@@ -153,10 +275,12 @@ impl TlsConfig {
         let mut root_store = RootCertStore::empty();
         root_store.extend(webpki_roots::TLS_SERVER_ROOTS.iter().cloned());
 
-        let client_config = ClientConfig::builder()
+        install_crypto_provider()?;
+        let mut client_config = ClientConfig::builder()
             .with_root_certificates(root_store)
             .with_client_auth_cert(certs, private_key)
             .map_err(|e| crate::error::VpnError::Config(format!("TLS config error: {e}")))?;
+        client_config.resumption = Resumption::store(TlsSessionCache::shared());
 
         Ok(Self {
             client_config: Arc::new(client_config),
@@ -228,3 +352,34 @@ impl TlsConnection {
         Ok(())
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_shared_config_is_built_once_per_mode() {
+        let verifying = shared_client_config(true).unwrap();
+        let accept_all = shared_client_config(false).unwrap();
+        assert!(Arc::ptr_eq(&verifying, &shared_client_config(true).unwrap()));
+        assert!(!Arc::ptr_eq(&verifying, &accept_all));
+        assert!(http_client_builder(false).unwrap().build().is_ok());
+    }
+
+    #[test]
+    fn test_concurrent_configs_share_one_provider() {
+        let threads: Vec<_> = (0..8).map(|_| std::thread::spawn(|| TlsConfig::new(true).is_ok())).collect();
+        assert!(threads.into_iter().all(|thread| thread.join().unwrap()));
+    }
+
+    #[test]
+    fn test_session_cache_counts_misses_once_per_lookup() {
+        let cache = TlsSessionCache::new(4);
+        let server = ServerName::try_from("vpn.example.com").unwrap().to_owned();
+
+        // A fresh handshake looks for a TLS 1.3 ticket, then a TLS 1.2 session
+        assert!(cache.take_tls13_ticket(&server).is_none());
+        assert!(cache.tls12_session(&server).is_none());
+        assert_eq!(cache.stats(), TlsSessionCacheStats { hits: 0, misses: 1 });
+    }
+}
@@ -0,0 +1,421 @@
+//! Multi-session engine: many tunnels in one process
+//!
+//! [`VpnClient`](crate::VpnClient) is built around one session per object,
+//! each with its own runtime, tunnel manager and background tasks. A
+//! [`SessionEngine`] hosts thousands of data channels instead:
+//!
+//! - All sessions run on one runtime with a fixed worker pool.
+//! - TLS connections use the process-wide client config and session cache
+//!   ([`crate::crypto::tls`]), so reconnects resume instead of doing full
+//!   handshakes.
+//! - Keepalives for every session come off the process-wide keepalive wheel
+//!   ([`crate::protocol::keepalive`]) instead of an `interval` task per
+//!   session, and only once a session has been idle for the interval.
+//! - A session is a compact slot (its send half, counters and key) plus one
+//!   receive task. Inbound packets of all sessions go to one handler.
+//! - Receive buffers keep only [`EngineConfig::read_reserve`] bytes free
+//!   while waiting, so idle sessions cost kilobytes.
+//!
+//! Sessions are addressed by [`SessionKey`]: a slot index plus a generation,
+//! so the key of a closed session never reaches the slot's next occupant.
+
+use crate::config::Config;
+use crate::error::{Result, VpnError};
+use crate::protocol::auth::AuthClient;
+use crate::protocol::binary::{BinaryDataReader, BinaryDataWriter, BinaryProtocolClient, DataReadHalf, DataWriteHalf};
+use crate::protocol::keepalive::{KeepaliveScheduler, KeepaliveTimer};
+use crate::protocol::watermark::WatermarkClient;
+use bytes::Bytes;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex, RwLock};
+use std::time::Duration;
+
+/// Called with each batch of packets received on a session
+///
+/// Runs on the engine's workers: it should hand the packets on (taking them
+/// out of the vector if it keeps them) rather than block.
+pub type PacketHandler = Arc<dyn Fn(SessionKey, &mut Vec<Bytes>) + Send + Sync>;
+
+/// Engine tuning
+#[derive(Debug, Clone)]
+pub struct EngineConfig {
+    /// Runtime worker threads shared by all sessions
+    pub worker_threads: usize,
+    /// Idle time after which a session sends a keepalive
+    pub keepalive_interval: Duration,
+    /// Most packets received per batch handed to the handler
+    pub batch_size: usize,
+    /// Free receive buffer space a session keeps while waiting for data
+    pub read_reserve: usize,
+}
+
+impl Default for EngineConfig {
+    fn default() -> Self {
+        Self {
+            worker_threads: std::thread::available_parallelism().map_or(4, |n| n.get()),
+            keepalive_interval: Duration::from_secs(30),
+            batch_size: 32,
+            read_reserve: 4 * 1024,
+        }
+    }
+}
+
+/// Handle of a session hosted by a [`SessionEngine`]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct SessionKey {
+    index: u32,
+    generation: u32,
+}
+
+impl std::fmt::Display for SessionKey {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(f, "{}.{}", self.index, self.generation)
+    }
+}
+
+/// Traffic counters of one session
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct SessionStats {
+    pub packets_sent: u64,
+    pub bytes_sent: u64,
+    pub packets_received: u64,
+    pub bytes_received: u64,
+}
+
+/// Per-session state
+struct Session {
+    key: SessionKey,
+    writer: tokio::sync::Mutex<BinaryDataWriter<DataWriteHalf>>,
+    receiver: Mutex<Option<tokio::task::AbortHandle>>,
+    keepalive: Arc<KeepaliveTimer>,
+    packets_sent: AtomicU64,
+    bytes_sent: AtomicU64,
+    packets_received: AtomicU64,
+    bytes_received: AtomicU64,
+}
+
+impl Session {
+    fn stats(&self) -> SessionStats {
+        SessionStats {
+            packets_sent: self.packets_sent.load(Ordering::Relaxed),
+            bytes_sent: self.bytes_sent.load(Ordering::Relaxed),
+            packets_received: self.packets_received.load(Ordering::Relaxed),
+            bytes_received: self.bytes_received.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// Session slots, reused through a free list
+#[derive(Default)]
+struct Slab {
+    slots: Vec<(u32, Option<Arc<Session>>)>,
+    free: Vec<u32>,
+}
+
+impl Slab {
+    fn get(&self, key: SessionKey) -> Option<&Arc<Session>> {
+        match self.slots.get(key.index as usize) {
+            Some((generation, Some(session))) if *generation == key.generation => Some(session),
+            _ => None,
+        }
+    }
+
+    fn insert(&mut self, session: impl FnOnce(SessionKey) -> Arc<Session>) -> Arc<Session> {
+        let index = self.free.pop().unwrap_or_else(|| {
+            self.slots.push((0, None));
+            (self.slots.len() - 1) as u32
+        });
+        let slot = &mut self.slots[index as usize];
+        let session = session(SessionKey { index, generation: slot.0 });
+        slot.1 = Some(session.clone());
+        session
+    }
+
+    fn remove(&mut self, key: SessionKey) -> Option<Arc<Session>> {
+        self.get(key)?;
+        let slot = &mut self.slots[key.index as usize];
+        slot.0 = slot.0.wrapping_add(1);
+        self.free.push(key.index);
+        slot.1.take()
+    }
+}
+
+struct Shared {
+    config: EngineConfig,
+    handler: PacketHandler,
+    sessions: RwLock<Slab>,
+}
+
+impl Shared {
+    fn session(&self, key: SessionKey) -> Option<Arc<Session>> {
+        self.sessions.read().unwrap().get(key).cloned()
+    }
+
+    fn remove(&self, key: SessionKey) -> bool {
+        let Some(session) = self.sessions.write().unwrap().remove(key) else {
+            return false;
+        };
+        if let Some(receiver) = session.receiver.lock().unwrap().take() {
+            receiver.abort();
+        }
+        true
+    }
+}
+
+/// Hosts many VPN sessions on one runtime
+pub struct SessionEngine {
+    shared: Arc<Shared>,
+    runtime: Option<tokio::runtime::Runtime>,
+}
+
+impl SessionEngine {
+    /// Start the engine's runtime
+    pub fn new(config: EngineConfig, handler: PacketHandler) -> Result<Self> {
+        let runtime = tokio::runtime::Builder::new_multi_thread()
+            .worker_threads(config.worker_threads.max(1))
+            .thread_name("rvpnse-engine")
+            .enable_all()
+            .build()
+            .map_err(|e| VpnError::Connection(format!("Failed to create runtime: {}", e)))?;
+
+        let shared = Arc::new(Shared {
+            config,
+            handler,
+            sessions: RwLock::new(Slab::default()),
+        });
+        Ok(Self { shared, runtime: Some(runtime) })
+    }
+
+    /// The engine's runtime; futures of this engine should run on it
+    pub fn runtime(&self) -> &tokio::runtime::Handle {
+        self.runtime.as_ref().expect("engine runtime").handle()
+    }
+
+    /// Log in with `config` and host the resulting session
+    ///
+    /// Runs watermark, PACK authentication and the binary data channel setup
+    /// over one TLS connection, as [`VpnClient`](crate::VpnClient) does.
+    pub async fn open(&self, config: &Config) -> Result<SessionKey> {
+        let server = &config.server;
+        let addr = tokio::net::lookup_host((server.address.as_str(), server.port))
+            .await
+            .map_err(|e| VpnError::Config(format!("Invalid server address '{}:{}': {}", server.address, server.port, e)))?
+            .next()
+            .ok_or_else(|| VpnError::Config(format!("Server address '{}:{}' resolved to nothing", server.address, server.port)))?;
+        let username = config.auth.username.clone().unwrap_or_default();
+        let password = config.auth.password.clone().unwrap_or_default();
+        let timeout = Duration::from_secs(u64::from(server.timeout));
+
+        let mut watermark = WatermarkClient::new(addr, server.hostname.clone(), server.verify_certificate)?;
+        let connection = watermark.open_connection().await?;
+        watermark.send_watermark_handshake().await?;
+
+        let mut auth = AuthClient::new(
+            addr.to_string(),
+            server.hostname.clone(),
+            server.hub.clone(),
+            username.clone(),
+            password.clone(),
+            server.verify_certificate,
+        )?;
+        auth.attach_connection(connection);
+        auth.authenticate(&username, &password).await?;
+        let session = auth
+            .take_connection()
+            .await
+            .ok_or_else(|| VpnError::InvalidState("Session connection was dropped".to_string()))?;
+
+        let mut channel = BinaryProtocolClient::new(addr).with_session_connection(session);
+        channel.open(&username, &password, &server.hub, timeout).await?;
+        self.attach(channel)
+    }
+
+    /// Host an established data channel
+    pub fn attach(&self, channel: BinaryProtocolClient) -> Result<SessionKey> {
+        let (reader, writer) = channel.into_split()?;
+        let reader = reader.with_read_reserve(self.shared.config.read_reserve);
+        let runtime = self.runtime().clone();
+        let interval = self.shared.config.keepalive_interval;
+
+        let session = self.shared.sessions.write().unwrap().insert(|key| {
+            Arc::new_cyclic(|session: &std::sync::Weak<Session>| Session {
+                key,
+                writer: tokio::sync::Mutex::new(writer),
+                receiver: Mutex::new(None),
+                keepalive: KeepaliveScheduler::shared().register(interval, keepalive_sender(runtime, session.clone())),
+                packets_sent: AtomicU64::new(0),
+                bytes_sent: AtomicU64::new(0),
+                packets_received: AtomicU64::new(0),
+                bytes_received: AtomicU64::new(0),
+            })
+        });
+        let key = session.key;
+
+        let receiver = self.runtime().spawn(receive_loop(self.shared.clone(), session.clone(), reader));
+        *session.receiver.lock().unwrap() = Some(receiver.abort_handle());
+        log::debug!("Engine session {} attached", key);
+        Ok(key)
+    }
+
+    /// Send a batch of packets on a session; returns the number sent
+    ///
+    /// A session whose channel fails is closed.
+    pub async fn send<'a, I>(&self, key: SessionKey, packets: I) -> Result<usize>
+    where
+        I: IntoIterator<Item = &'a [u8]>,
+    {
+        let session = self.shared.session(key)
+            .ok_or_else(|| VpnError::InvalidState(format!("No engine session {}", key)))?;
+        let mut bytes = 0;
+        let packets = packets.into_iter().inspect(|packet| bytes += packet.len() as u64);
+        let sent = session.writer.lock().await.send_batch(packets).await;
+        match sent {
+            Ok(count) => {
+                session.keepalive.touch();
+                session.packets_sent.fetch_add(count as u64, Ordering::Relaxed);
+                session.bytes_sent.fetch_add(bytes, Ordering::Relaxed);
+                Ok(count)
+            }
+            Err(e) => {
+                self.close(key);
+                Err(e)
+            }
+        }
+    }
+
+    /// Stop hosting a session, dropping its connection
+    ///
+    /// Returns `false` if the session was already gone.
+    pub fn close(&self, key: SessionKey) -> bool {
+        let closed = self.shared.remove(key);
+        if closed {
+            log::debug!("Engine session {} closed", key);
+        }
+        closed
+    }
+
+    /// Whether `key` names a session this engine still hosts
+    pub fn contains(&self, key: SessionKey) -> bool {
+        self.shared.session(key).is_some()
+    }
+
+    /// Traffic counters of a session
+    pub fn session_stats(&self, key: SessionKey) -> Option<SessionStats> {
+        self.shared.session(key).map(|session| session.stats())
+    }
+
+    /// Number of hosted sessions
+    pub fn session_count(&self) -> usize {
+        let sessions = self.shared.sessions.read().unwrap();
+        sessions.slots.len() - sessions.free.len()
+    }
+}
+
+impl Drop for SessionEngine {
+    fn drop(&mut self) {
+        if let Some(runtime) = self.runtime.take() {
+            runtime.shutdown_background();
+        }
+    }
+}
+
+/// Receive batches on one session and hand them to the engine's handler
+async fn receive_loop(shared: Arc<Shared>, session: Arc<Session>, mut reader: BinaryDataReader<DataReadHalf>) {
+    let mut packets = Vec::with_capacity(shared.config.batch_size);
+    loop {
+        match reader.recv_batch(shared.config.batch_size, &mut packets).await {
+            Ok(count) => {
+                let bytes: usize = packets.iter().map(Bytes::len).sum();
+                session.keepalive.touch();
+                session.packets_received.fetch_add(count as u64, Ordering::Relaxed);
+                session.bytes_received.fetch_add(bytes as u64, Ordering::Relaxed);
+                (shared.handler)(session.key, &mut packets);
+                packets.clear();
+            }
+            Err(e) => {
+                log::info!("Engine session {} lost its data channel: {}", session.key, e);
+                break;
+            }
+        }
+    }
+    // Drops the session unless it was closed (and possibly replaced) already
+    shared.sessions.write().unwrap().remove(session.key);
+}
+
+/// Keepalive callback for one session: sends on the engine's runtime
+///
+/// Holds the session weakly so a closed session's timer simply lapses.
+fn keepalive_sender(runtime: tokio::runtime::Handle, session: std::sync::Weak<Session>) -> impl Fn() + Send + Sync + 'static {
+    move || {
+        let Some(session) = session.upgrade() else {
+            return;
+        };
+        runtime.spawn(async move {
+            if let Err(e) = session.writer.lock().await.send_keepalive().await {
+                log::debug!("Keepalive on engine session {} failed: {}", session.key, e);
+            }
+        });
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::protocol::binary::protocol_constants::{PACKET_HEADER_SIZE, PACKET_TYPE_KEEPALIVE};
+    use tokio::io::AsyncReadExt;
+    use tokio::net::{TcpListener, TcpStream};
+
+    #[test]
+    fn test_engine_session_round_trip_and_stale_keys() {
+        let (handler_tx, handler_rx) = std::sync::mpsc::channel();
+        let handler: PacketHandler = Arc::new(move |key, packets: &mut Vec<Bytes>| {
+            for packet in packets.drain(..) {
+                handler_tx.send((key, packet)).unwrap();
+            }
+        });
+        let config = EngineConfig { worker_threads: 1, keepalive_interval: Duration::from_millis(20), ..EngineConfig::default() };
+        let engine = SessionEngine::new(config, handler).unwrap();
+
+        let (first, mut peer) = engine.runtime().block_on(async {
+            let listener = TcpListener::bind("127.0.0.1:0").await.unwrap();
+            let stream = TcpStream::connect(listener.local_addr().unwrap()).await.unwrap();
+            let key = engine.attach(BinaryProtocolClient::from_stream(stream, 7)).unwrap();
+            (key, listener.accept().await.unwrap().0)
+        });
+
+        // Data both ways, then a keepalive once the session goes idle
+        engine.runtime().block_on(async {
+            assert_eq!(engine.send(first, [&b"uplink"[..]]).await.unwrap(), 1);
+            let mut frame = vec![0u8; PACKET_HEADER_SIZE + 6];
+            peer.read_exact(&mut frame).await.unwrap();
+            assert_eq!(&frame[PACKET_HEADER_SIZE..], b"uplink");
+
+            let downlink = crate::protocol::binary::SoftEtherPacket::create_data_packet(7, 1, Bytes::from_static(b"downlink"));
+            tokio::io::AsyncWriteExt::write_all(&mut peer, &downlink.to_bytes()).await.unwrap();
+
+            let mut header = [0u8; PACKET_HEADER_SIZE];
+            peer.read_exact(&mut header).await.unwrap();
+            assert_eq!(header[0], PACKET_TYPE_KEEPALIVE);
+        });
+        let (from, packet) = handler_rx.recv_timeout(Duration::from_secs(5)).unwrap();
+        assert_eq!((from, &packet[..]), (first, &b"downlink"[..]));
+        let stats = engine.session_stats(first).unwrap();
+        assert_eq!((stats.packets_sent, stats.packets_received), (1, 1));
+
+        assert!(engine.close(first));
+        assert!(!engine.close(first));
+        assert_eq!(engine.session_count(), 0);
+
+        // The slot is reused, but the old key does not reach the new session
+        let (second, _peer) = engine.runtime().block_on(async {
+            let listener = TcpListener::bind("127.0.0.1:0").await.unwrap();
+            let stream = TcpStream::connect(listener.local_addr().unwrap()).await.unwrap();
+            let key = engine.attach(BinaryProtocolClient::from_stream(stream, 8)).unwrap();
+            (key, listener.accept().await.unwrap().0)
+        });
+        assert_eq!(second.index, first.index);
+        assert!(engine.contains(second));
+        assert!(!engine.contains(first));
+        assert!(engine.runtime().block_on(engine.send(first, [&b"stale"[..]])).is_err());
+    }
+}
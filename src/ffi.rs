@@ -9,7 +9,9 @@ use std::ffi::{CStr, CString};
 use std::os::raw::{c_char, c_int};
 use std::ptr;
 
-use crate::{Config, VpnClient, VpnError};
+use std::sync::Arc;
+
+use crate::{CompiledConfig, Config, VpnClient, VpnError};
 
 /// Error codes returned by C FFI functions
 #[repr(C)]
@@ -39,6 +41,68 @@ impl From<VpnError> for VPNSEError {
     }
 }
 
+/// Caller-owned packet buffer used by the batched packet I/O functions
+#[repr(C)]
+pub struct VPNSEIovec {
+    /// Start of the packet buffer
+    pub data: *mut u8,
+    /// Packet length on send; buffer capacity in, packet length out on receive
+    pub len: usize,
+}
+
+/// Latency percentiles of one data path direction, in microseconds
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+pub struct VPNSELatency {
+    /// Packets measured
+    pub count: u64,
+    pub mean_us: u64,
+    pub p50_us: u64,
+    pub p90_us: u64,
+    pub p99_us: u64,
+    pub max_us: u64,
+}
+
+/// Data path counters filled in by `vpnse_client_get_stats`
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+pub struct VPNSEStats {
+    /// 1 while the packet pump runs, else 0 (and all else is 0)
+    pub active: u64,
+    /// Packets and bytes read from the TUN device and sent to the server
+    pub uplink_packets: u64,
+    pub uplink_bytes: u64,
+    /// Packets and bytes received from the server and written to the TUN device
+    pub downlink_packets: u64,
+    pub downlink_bytes: u64,
+    /// TUN read -> data channel write
+    pub uplink_latency: VPNSELatency,
+    /// Data channel read -> TUN write
+    pub downlink_latency: VPNSELatency,
+    /// Times a pipeline stage waited on a full queue
+    pub backpressure_events: u64,
+    /// Data channels lost under the running tunnel, and replacements taken
+    pub transport_losses: u64,
+    pub resumes: u64,
+    /// Current tunnel MTU and TCP SYNs whose MSS was clamped to it
+    pub tunnel_mtu: u64,
+    pub mss_clamped: u64,
+}
+
+impl From<crate::monitoring::LatencySummary> for VPNSELatency {
+    fn from(summary: crate::monitoring::LatencySummary) -> Self {
+        let micros = |d: std::time::Duration| d.as_micros() as u64;
+        Self {
+            count: summary.count,
+            mean_us: micros(summary.mean),
+            p50_us: micros(summary.p50),
+            p90_us: micros(summary.p90),
+            p99_us: micros(summary.p99),
+            max_us: micros(summary.max),
+        }
+    }
+}
+
 /// Parse and validate a SoftEther VPN configuration
 ///
 /// # Parameters
@@ -67,24 +131,29 @@ pub unsafe extern "C" fn vpnse_parse_config(
     match config_str.parse::<Config>() {
         Ok(_) => VPNSEError::Success as c_int,
         Err(err) => {
-            if !error_msg.is_null() && error_msg_len > 0 {
-                let error_str = format!("{err}");
-                let error_cstr = CString::new(error_str).unwrap_or_default();
-                let error_bytes = error_cstr.as_bytes_with_nul();
-                let copy_len = std::cmp::min(error_bytes.len(), error_msg_len - 1);
-
-                ptr::copy_nonoverlapping(
-                    error_bytes.as_ptr() as *const c_char,
-                    error_msg,
-                    copy_len,
-                );
-                *error_msg.add(copy_len) = 0; // Null terminate
-            }
+            write_error_message(&err, error_msg, error_msg_len);
             VPNSEError::from(err) as c_int
         }
     }
 }
 
+/// Copy `err` into a caller's error buffer (nullable), truncating as needed
+unsafe fn write_error_message(err: &VpnError, error_msg: *mut c_char, error_msg_len: usize) {
+    if !error_msg.is_null() && error_msg_len > 0 {
+        let error_str = format!("{err}");
+        let error_cstr = CString::new(error_str).unwrap_or_default();
+        let error_bytes = error_cstr.as_bytes_with_nul();
+        let copy_len = std::cmp::min(error_bytes.len(), error_msg_len - 1);
+
+        ptr::copy_nonoverlapping(
+            error_bytes.as_ptr() as *const c_char,
+            error_msg,
+            copy_len,
+        );
+        *error_msg.add(copy_len) = 0; // Null terminate
+    }
+}
+
 /// Create a new VPN client instance
 ///
 /// # Parameters
@@ -104,14 +173,76 @@ pub unsafe extern "C" fn vpnse_client_new(config_str: *const c_char) -> *mut Vpn
         Err(_) => return ptr::null_mut(),
     };
 
-    let config = match config_str.parse::<Config>() {
-        Ok(config) => config,
-        Err(_) => return ptr::null_mut(),
+    match CompiledConfig::parse(config_str) {
+        Ok(config) => Box::into_raw(Box::new(VpnClient::from_compiled(config))),
+        Err(_) => ptr::null_mut(),
+    }
+}
+
+/// Parse and validate a configuration once, for creating many clients
+///
+/// # Parameters
+/// - `config_str`: TOML configuration string
+/// - `error_msg`: Output buffer for error messages (nullable)
+/// - `error_msg_len`: Size of error message buffer
+///
+/// # Returns
+/// - Configuration handle on success, to be freed with `vpnse_config_free`
+/// - NULL on failure
+#[no_mangle]
+pub unsafe extern "C" fn vpnse_config_compile(
+    config_str: *const c_char,
+    error_msg: *mut c_char,
+    error_msg_len: usize,
+) -> *const CompiledConfig {
+    if config_str.is_null() {
+        return ptr::null();
+    }
+
+    let config_str = match CStr::from_ptr(config_str).to_str() {
+        Ok(s) => s,
+        Err(_) => return ptr::null(),
     };
 
-    match VpnClient::new(config) {
-        Ok(client) => Box::into_raw(Box::new(client)),
-        Err(_) => ptr::null_mut(),
+    match CompiledConfig::parse(config_str) {
+        Ok(config) => Arc::into_raw(config),
+        Err(err) => {
+            write_error_message(&err, error_msg, error_msg_len);
+            ptr::null()
+        }
+    }
+}
+
+/// Create a new VPN client from a compiled configuration
+///
+/// The client shares the configuration rather than copying it; the handle
+/// stays owned by the caller and may be freed while the client lives.
+///
+/// # Parameters
+/// - `config`: Handle from vpnse_config_compile
+///
+/// # Returns
+/// - Opaque pointer to VPN client on success
+/// - NULL on failure
+#[no_mangle]
+pub unsafe extern "C" fn vpnse_client_new_from_config(config: *const CompiledConfig) -> *mut VpnClient {
+    if config.is_null() {
+        return ptr::null_mut();
+    }
+
+    Arc::increment_strong_count(config);
+    let config = Arc::from_raw(config);
+    Box::into_raw(Box::new(VpnClient::from_compiled(config)))
+}
+
+/// Free a compiled configuration handle
+///
+/// # Parameters
+/// - `config`: Handle from vpnse_config_compile (nullable)
+#[no_mangle]
+pub unsafe extern "C" fn vpnse_config_free(config: *const CompiledConfig) {
+    if !config.is_null() {
+        drop(Arc::from_raw(config));
     }
 }
 
@@ -256,6 +387,120 @@ pub unsafe extern "C" fn vpnse_client_status(client: *const VpnClient) -> c_int
     }
 }
 
+/// Send a batch of packets through the VPN data channel
+///
+/// The whole batch is framed and written in one call; packet buffers are
+/// only read and remain owned by the caller.
+///
+/// # Parameters
+/// - `client`: VPN client instance (must be authenticated)
+/// - `pkts`: Array of `n` packet buffers
+/// - `n`: Number of packets in the batch
+///
+/// # Returns
+/// - 0 on success
+/// - Error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn vpnse_client_send_batch(
+    client: *mut VpnClient,
+    pkts: *const VPNSEIovec,
+    n: usize,
+) -> c_int {
+    if client.is_null() || (pkts.is_null() && n > 0) {
+        return VPNSEError::InvalidParameter as c_int;
+    }
+    if n == 0 {
+        return VPNSEError::Success as c_int;
+    }
+
+    let iovecs = std::slice::from_raw_parts(pkts, n);
+    if iovecs.iter().any(|iov| iov.data.is_null() && iov.len > 0) {
+        return VPNSEError::InvalidParameter as c_int;
+    }
+
+    let client = &mut *client;
+    let packets = iovecs.iter().map(|iov| {
+        if iov.len == 0 {
+            &[][..]
+        } else {
+            std::slice::from_raw_parts(iov.data as *const u8, iov.len)
+        }
+    });
+
+    match client.send_packet_batch(packets) {
+        Ok(_) => VPNSEError::Success as c_int,
+        Err(err) => VPNSEError::from(err) as c_int,
+    }
+}
+
+/// Receive a batch of packets from the VPN data channel
+///
+/// Packets are copied straight into the caller's buffers. On input each
+/// `pkts[i].len` is the buffer capacity; on output it is the packet length
+/// for the first `*received` entries. A packet that does not fit is kept
+/// for the next call.
+///
+/// # Parameters
+/// - `client`: VPN client instance (must be authenticated)
+/// - `pkts`: Array of `n` caller-owned packet buffers
+/// - `n`: Number of buffers available
+/// - `received`: Output for the number of packets stored
+/// - `timeout_ms`: Maximum time to wait for the first packet (0 polls)
+///
+/// # Returns
+/// - 0 on success (including timeout with `*received == 0`)
+/// - `BufferTooSmall` if the next packet does not fit in `pkts[0]`
+/// - Error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn vpnse_client_recv_batch(
+    client: *mut VpnClient,
+    pkts: *mut VPNSEIovec,
+    n: usize,
+    received: *mut usize,
+    timeout_ms: u32,
+) -> c_int {
+    if client.is_null() || pkts.is_null() || n == 0 || received.is_null() {
+        return VPNSEError::InvalidParameter as c_int;
+    }
+    *received = 0;
+
+    let iovecs = std::slice::from_raw_parts_mut(pkts, n);
+    if iovecs.iter().any(|iov| iov.data.is_null() && iov.len > 0) {
+        return VPNSEError::InvalidParameter as c_int;
+    }
+
+    let client = &mut *client;
+    let mut too_small = false;
+    let result = client.recv_packet_batch(
+        n,
+        std::time::Duration::from_millis(u64::from(timeout_ms)),
+        |index, packet| {
+            let iov = &mut iovecs[index];
+            if packet.len() > iov.len {
+                too_small = index == 0;
+                return false;
+            }
+            if !packet.is_empty() {
+                ptr::copy_nonoverlapping(packet.as_ptr(), iov.data, packet.len());
+            }
+            iov.len = packet.len();
+            true
+        },
+    );
+
+    match result {
+        Ok(count) => {
+            *received = count;
+            if too_small {
+                VPNSEError::BufferTooSmall as c_int
+            } else {
+                VPNSEError::Success as c_int
+            }
+        }
+        Err(err) => VPNSEError::from(err) as c_int,
+    }
+}
+
 /// Establish VPN tunnel (routing layer)
 ///
 /// This function attempts to create a TUN interface and configure routing
@@ -280,6 +525,79 @@ pub unsafe extern "C" fn vpnse_client_establish_tunnel(client: *mut VpnClient) -
     }
 }
 
+/// Read the data path counters and latency percentiles
+///
+/// Cheap enough to poll every second: counters are summed and percentiles
+/// read from the histograms on the spot, nothing is formatted or allocated
+/// per call.
+///
+/// # Parameters
+/// - `client`: VPN client instance
+/// - `stats`: Output structure, fully overwritten
+///
+/// # Returns
+/// - 0 on success (with `active == 0` unless the packet pump is running)
+/// - Error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn vpnse_client_get_stats(client: *const VpnClient, stats: *mut VPNSEStats) -> c_int {
+    if client.is_null() || stats.is_null() {
+        return VPNSEError::InvalidParameter as c_int;
+    }
+
+    let mut out = VPNSEStats::default();
+    #[cfg(unix)]
+    if let Some(pump) = (*client).data_path_stats() {
+        out = VPNSEStats {
+            active: 1,
+            uplink_packets: pump.uplink_packets,
+            uplink_bytes: pump.uplink_bytes,
+            downlink_packets: pump.downlink_packets,
+            downlink_bytes: pump.downlink_bytes,
+            uplink_latency: pump.uplink_latency.into(),
+            downlink_latency: pump.downlink_latency.into(),
+            backpressure_events: pump.backpressure_events,
+            transport_losses: pump.transport_losses,
+            resumes: pump.resumes,
+            tunnel_mtu: pump.tunnel_mtu,
+            mss_clamped: pump.mss_clamped,
+        };
+    }
+    stats.write(out);
+    VPNSEError::Success as c_int
+}
+
+/// Resume the tunnel on new data channels after a network change
+///
+/// Keeps the TUN interface, routes, DNS and assigned IP, and rejoins the
+/// existing session. Call when the device's network path changes (Wi-Fi to
+/// cellular, new address); traffic resumes once the new channels connect.
+///
+/// # Parameters
+/// - `client`: VPN client instance with an established tunnel
+///
+/// # Returns
+/// - 0 on success
+/// - Error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn vpnse_client_resume_session(client: *mut VpnClient) -> c_int {
+    if client.is_null() {
+        return VPNSEError::InvalidParameter as c_int;
+    }
+
+    #[cfg(unix)]
+    {
+        let client = &mut *client;
+        match client.resume_session() {
+            Ok(_) => VPNSEError::Success as c_int,
+            Err(err) => VPNSEError::from(err) as c_int,
+        }
+    }
+    #[cfg(not(unix))]
+    {
+        VPNSEError::TunnelError as c_int
+    }
+}
+
 /// Establish a VPN tunnel
 ///
 /// # Parameters
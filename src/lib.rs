@@ -9,6 +9,7 @@
 //! - Cross-platform error handling system
 //! - C FFI bindings for integration with other languages
 //! - Platform abstraction layer structure
+//! - A multi-session engine hosting many tunnels on one runtime
 //! - Example integration patterns
 //!
 //! ## What Your Application Must Implement
@@ -23,18 +24,22 @@
 //! See the `examples/` directory for integration patterns and the
 //! documentation in `docs/integration/` for platform-specific guides.
 
+pub mod buffer_pool;
 pub mod client;
 pub mod client_optimized;
 pub mod config;
 pub mod crypto;
+pub mod engine;
 pub mod error;
+pub mod monitoring;
 pub mod protocol;
 pub mod tunnel;
 
 // Re-export core types for static library interface
 pub use client::{ConnectionStatus, VpnClient};
 pub use client_optimized::{OptimizedVpnClient, PerformanceConfig, PerformanceSnapshot};
-pub use config::Config;
+pub use config::{CompiledConfig, Config};
+pub use engine::{EngineConfig, SessionEngine, SessionKey};
 pub use error::{Result, VpnError};
 
 /// Library version information
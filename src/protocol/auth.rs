@@ -1,6 +1,9 @@
 use crate::error::VpnError;
 use crate::protocol::watermark::WatermarkClient;
 use crate::protocol::pack::{Pack, Value};
+use crate::protocol::connection::{HttpResponse, SessionConnection, SharedConnection};
+use crate::protocol::constants::{HTTP_CONTENT_TYPE_PACK, WATERMARK_ENDPOINT};
+use bytes::Bytes;
 use crate::tunnel::TunnelConfig;
 use reqwest::Client as HttpClient;
 use std::collections::HashMap;
@@ -17,8 +20,6 @@ pub struct AuthClient {
     hub_name: String,
     username: String,
     password: String,
-    verify_certificate: bool,
-    stream: Option<TcpStream>,
     session_id: Option<String>,
     is_authenticated: bool,
     pack_data: Option<Pack>,  // Store the authentication response PACK data
@@ -42,14 +43,14 @@ impl AuthClient {
         
         Ok(Self {
             watermark_client: WatermarkClient::new(addr, hostname, verify_certificate)?,
-            http_client: HttpClient::new(),
+            http_client: crate::crypto::tls::http_client_builder(verify_certificate)?
+                .build()
+                .map_err(|e| VpnError::Network(format!("Failed to create HTTP client: {}", e)))?,
             server_address,
             server_endpoint,
             hub_name,
             username,
             password,
-            verify_certificate,
-            stream: None,
             session_id: None,
             is_authenticated: false,
             pack_data: None,
@@ -57,20 +58,20 @@ impl AuthClient {
         })
     }
 
-    /// Internal method for authentication with stream
-    async fn authenticate_with_stream(&mut self, stream: &mut TcpStream) -> Result<String, VpnError> {
+    /// Watermark handshake followed by hub authentication over HTTP
+    async fn authenticate_via_watermark(&mut self) -> Result<String, VpnError> {
         // Step 1: HTTP Watermark handshake
         log::info!("Starting HTTP Watermark handshake");
         let _watermark_response = self.watermark_client.send_watermark_handshake().await?;
         
         // Step 2: Authenticate directly (no session establishment needed)
-        self.perform_hub_authentication(stream).await?;
+        self.perform_hub_authentication().await?;
         
         Ok("authenticated".to_string())
     }
 
     /// Establish a session with the server
-    async fn establish_session(&mut self, stream: &mut TcpStream) -> Result<String, VpnError> {
+    async fn establish_session(&mut self) -> Result<String, VpnError> {
         log::info!("Establishing session with server");
         
         // Create session establishment packet
@@ -79,28 +80,18 @@ impl AuthClient {
         pack.add_str("hub", &self.hub_name);
         
         // Send via HTTP POST to the same connect.cgi endpoint
-        let url = format!("https://{}:{}/vpnsvc/connect.cgi", stream.peer_addr().unwrap().ip(), 443);
-        
         let data = pack.to_bytes()?;
-        let response = self.watermark_client.http_client
-            .post(&url)
-            .header("Content-Type", "application/octet-stream")
-            .header("Content-Length", &data.len().to_string())
-            .header("Connection", "Keep-Alive")
-            .body(data)
-            .send()
-            .await
+        let response = self.post_pack(data).await
             .map_err(|e| VpnError::Network(format!("Failed to send session request: {}", e)))?;
 
-        if !response.status().is_success() {
+        if !response.is_success() {
             return Err(VpnError::Protocol(format!(
                 "Session establishment failed: HTTP {}",
                 response.status()
             )));
         }
 
-        let response_data = response.bytes().await
-            .map_err(|e| VpnError::Network(format!("Failed to read session response: {}", e)))?;
+        let response_data = response.into_body();
         
         log::debug!("Session response data length: {}", response_data.len());
         log::debug!("Session response data (first 100 bytes): {:?}", &response_data[..std::cmp::min(100, response_data.len())]);
@@ -195,7 +186,7 @@ impl AuthClient {
                     Ok(pencore.clone())
                 } else if response_pack.get_elements().len() > 0 {
                     // If we have elements but no explicit error, assume success
-                    let elements: Vec<String> = response_pack.get_elements().keys().cloned().collect();
+                    let elements: Vec<String> = response_pack.get_elements().keys().map(|name| name.to_string()).collect();
                     log::info!("Authentication response contains elements: {:?}", elements);
                     
                     // Use the first non-error element as session identifier
@@ -227,7 +218,7 @@ impl AuthClient {
     }
 
     /// Perform hub authentication
-    async fn perform_hub_authentication(&mut self, _stream: &mut TcpStream) -> Result<(), VpnError> {
+    async fn perform_hub_authentication(&mut self) -> Result<(), VpnError> {
         log::info!("Authenticating with hub: {}", self.hub_name);
         
         // Create authentication packet for clustered SoftEther server
@@ -249,36 +240,19 @@ impl AuthClient {
         pack.add_int("use_encrypt", 1);  // Use encryption
         pack.add_int("use_compress", 1);  // Use compression
         
-        // Send via HTTP POST to the same connect.cgi endpoint  
-        let url = format!("{}/vpnsvc/connect.cgi", self.server_endpoint);
-        
+        // Send via HTTP POST to the same connect.cgi endpoint, on the session connection
         let data = pack.to_bytes()?;
-        let mut auth_request = self.watermark_client.http_client
-            .post(&url)
-            .header("Content-Type", "application/octet-stream")
-            .header("Content-Length", &data.len().to_string())
-            .header("Connection", "Keep-Alive");
-            
-        // Add Host header if hostname is available
-        if let Some(hostname) = &self.watermark_client.hostname {
-            auth_request = auth_request.header("Host", hostname);
-        }
-        
-        let response = auth_request
-            .body(data)
-            .send()
-            .await
+        let response = self.post_pack(data).await
             .map_err(|e| VpnError::Network(format!("Failed to send auth request: {}", e)))?;
 
-        if !response.status().is_success() {
+        if !response.is_success() {
             return Err(VpnError::Protocol(format!(
                 "Hub authentication failed: HTTP {}",
                 response.status()
             )));
         }
 
-        let response_data = response.bytes().await
-            .map_err(|e| VpnError::Network(format!("Failed to read auth response: {}", e)))?;
+        let response_data = response.into_body();
         
         log::debug!("Auth response data length: {}", response_data.len());
         log::debug!("Auth response data (first 100 bytes): {:?}", &response_data[..std::cmp::min(100, response_data.len())]);
@@ -424,24 +398,43 @@ impl AuthClient {
             self.password = password.to_string();
         }
 
-        // Connect to server if not already connected
-        if self.stream.is_none() {
-            let stream = TcpStream::connect(&self.server_address).await
-                .map_err(|e| VpnError::Network(format!("Failed to connect to server: {}", e)))?;
-            self.stream = Some(stream);
+        // On the session connection the watermark has already been sent;
+        // authentication continues right behind it
+        if self.watermark_client.connection().is_some() {
+            self.perform_hub_authentication().await?;
+            self.session_id = Some("authenticated".to_string());
+            self.is_authenticated = true;
+            return Ok(());
         }
 
         // Perform the full authentication flow
-        if let Some(mut stream) = self.stream.take() {
-            let session_id = self.authenticate_with_stream(&mut stream).await?;
-            self.session_id = Some(session_id);
-            self.is_authenticated = true;
-            self.stream = Some(stream);
-        }
+        let session_id = self.authenticate_via_watermark().await?;
+        self.session_id = Some(session_id);
+        self.is_authenticated = true;
 
         Ok(())
     }
 
+    /// Carry on over the connection the watermark handshake was sent on
+    pub fn attach_connection(&mut self, connection: SharedConnection) {
+        self.watermark_client.attach_connection(connection);
+    }
+
+    /// Take the session connection for the binary data channel
+    ///
+    /// Later HTTP requests on this client fail; the connection they would
+    /// have used now carries the data channel.
+    pub async fn take_connection(&self) -> Option<SessionConnection> {
+        let connection = self.watermark_client.connection()?;
+        let mut slot = connection.lock().await;
+        slot.take()
+    }
+
+    /// POST a serialized PACK to the session endpoint
+    async fn post_pack(&self, data: Bytes) -> Result<HttpResponse, VpnError> {
+        self.watermark_client.post(WATERMARK_ENDPOINT, HTTP_CONTENT_TYPE_PACK, data).await
+    }
+
     /// Check if authenticated
     pub fn is_authenticated(&self) -> bool {
         self.is_authenticated
@@ -477,24 +470,13 @@ impl AuthClient {
             .as_secs());
 
         // Send via HTTP POST to maintain compatibility with clustering
-        let url = format!("{}/vpnsvc/keepalive.cgi", self.server_endpoint);
         let data = pack.to_bytes()?;
-        
-        let mut request = self.watermark_client.http_client
-            .post(&url)
-            .header("Content-Type", "application/octet-stream")
-            .header("Content-Length", &data.len().to_string())
-            .header("Connection", "Keep-Alive");
-            
-        // Add Host header if hostname is available
-        if let Some(hostname) = &self.watermark_client.hostname {
-            request = request.header("Host", hostname);
-        }
-        
-        let response = request.body(data.to_vec()).send().await
+        let response = self.watermark_client
+            .post("/vpnsvc/keepalive.cgi", HTTP_CONTENT_TYPE_PACK, data)
+            .await
             .map_err(|e| VpnError::Network(format!("Keepalive request failed: {}", e)))?;
 
-        if response.status().is_success() {
+        if response.is_success() {
             log::debug!("HTTP keepalive sent successfully to SoftEther server");
             Ok(())
         } else {
@@ -540,34 +522,18 @@ impl AuthClient {
         pack.add_str("request_type", "dhcp_ip");
         pack.add_int("use_dhcp", 1);
         
-        let url = format!("{}/vpnsvc/connect.cgi", self.server_endpoint);
         let data = pack.to_bytes()?;
-        
-        let mut request = self.watermark_client.http_client
-            .post(&url)
-            .header("Content-Type", "application/octet-stream")
-            .header("Content-Length", &data.len().to_string())
-            .header("Connection", "Keep-Alive");
-            
-        if let Some(hostname) = &self.watermark_client.hostname {
-            request = request.header("Host", hostname);
-        }
-        
-        let response = request
-            .body(data)
-            .send()
-            .await
+        let response = self.post_pack(data).await
             .map_err(|e| VpnError::Network(format!("Failed to request IP config: {}", e)))?;
 
-        if !response.status().is_success() {
+        if !response.is_success() {
             return Err(VpnError::Protocol(format!(
                 "IP config request failed: HTTP {}",
                 response.status()
             )));
         }
 
-        let response_data = response.bytes().await
-            .map_err(|e| VpnError::Network(format!("Failed to read IP config response: {}", e)))?;
+        let response_data = response.into_body();
         
         // Parse IP configuration response
         match Pack::from_bytes(response_data.to_vec().into()) {
@@ -716,7 +682,7 @@ impl AuthClient {
         pack.add_str("request_dhcp", "1");
         pack.add_str("dhcp_hostname", "rvpnse-client");
         
-        let url = format!("{}/vpnsvc/connect.cgi", self.server_endpoint);
+        let url = format!("{}{}", self.server_endpoint, WATERMARK_ENDPOINT);
         log::debug!("📡 SSL-VPN handshake URL: {}", url);
         
         let data = pack.to_bytes()?;
@@ -735,55 +701,17 @@ impl AuthClient {
             log::debug!("  Host: {}", hostname);
         }
         
-        // CRITICAL FIX: Create a fresh HTTP client for SSL-VPN handshake
-        // The original client might have connection state issues after authentication
-        log::debug!("🔄 Creating fresh HTTP client for SSL-VPN handshake...");
-        let mut fresh_client_builder = reqwest::Client::builder()
-            .user_agent("SoftEther VPN Client");
-
-        // Match the TLS verification settings from the original client
-        if !self.verify_certificate {
-            fresh_client_builder = fresh_client_builder.danger_accept_invalid_certs(true);
-            log::debug!("🔓 SSL certificate verification disabled");
-        } else {
-            log::debug!("🔒 SSL certificate verification enabled");
-        }
-
-        let fresh_http_client = fresh_client_builder.build()
-            .map_err(|e| VpnError::Network(format!("Failed to create fresh HTTP client: {}", e)))?;
-        
-        let mut fresh_request = fresh_http_client
-            .post(&url)
-            .header("Content-Type", "application/octet-stream")
-            .header("Content-Length", &data.len().to_string())
-            .header("Connection", "Keep-Alive");
-            
-        if let Some(hostname) = &self.watermark_client.hostname {
-            fresh_request = fresh_request.header("Host", hostname);
-        }
-        
-        let response = fresh_request
-            .body(data)
-            .send()
-            .await
+        // The switch to SSL-VPN mode must arrive on the connection the session
+        // was authenticated on; a fresh connection is only used without one
+        let response = self.post_pack(data).await
             .map_err(|e| {
                 log::error!("❌ SSL-VPN handshake failed to send: {}", e);
-                log::error!("🔍 Error details: {:?}", e);
-                if e.is_connect() {
-                    log::error!("🌐 Connection error - cannot reach server");
-                } else if e.is_timeout() {
-                    log::error!("⏰ Timeout error - server not responding");
-                } else if e.is_request() {
-                    log::error!("📤 Request error - malformed request");
-                } else {
-                    log::error!("❓ Other network error");
-                }
                 VpnError::Network(format!("Failed to send SSL-VPN start: {}", e))
             })?;
 
         log::info!("📥 SSL-VPN handshake response status: {}", response.status());
 
-        if !response.status().is_success() {
+        if !response.is_success() {
             log::error!("❌ SSL-VPN handshake failed: HTTP {}", response.status());
             log::error!("🔧 This will cause server to stay in 'initializing' state");
             return Err(VpnError::Protocol(format!(
@@ -792,11 +720,7 @@ impl AuthClient {
             )));
         }
 
-        let response_data = response.bytes().await
-            .map_err(|e| {
-                log::error!("❌ Failed to read SSL-VPN response: {}", e);
-                VpnError::Network(format!("Failed to read SSL-VPN response: {}", e))
-            })?;
+        let response_data = response.into_body();
         
         log::info!("📥 SSL-VPN handshake response received: {} bytes", response_data.len());
         log::debug!("📦 SSL-VPN response (first 200 bytes): {:02x?}", 
@@ -911,7 +835,7 @@ impl AuthClient {
         pack.add_str("requested_ip", "0.0.0.0"); // Let server assign
         pack.add_int("use_dhcp", 1);
         
-        let url = format!("{}/vpnsvc/connect.cgi", self.server_endpoint);
+        let url = format!("{}{}", self.server_endpoint, WATERMARK_ENDPOINT);
         log::debug!("📡 DHCP request URL: {}", url);
         
         let data = pack.to_bytes()?;
@@ -919,22 +843,12 @@ impl AuthClient {
         log::debug!("📦 DHCP request packet (first 100 bytes): {:02x?}", 
             &data[..std::cmp::min(100, data.len())]);
         
-        let mut request = self.watermark_client.http_client
-            .post(&url)
-            .header("Content-Type", "application/octet-stream")
-            .header("Content-Length", &data.len().to_string())
-            .header("Connection", "Keep-Alive");
-            
         if let Some(hostname) = &self.watermark_client.hostname {
-            request = request.header("Host", hostname);
             log::debug!("🏠 Using hostname: {}", hostname);
         }
         
         log::info!("📡 Sending DHCP request to server...");
-        let response = request
-            .body(data)
-            .send()
-            .await
+        let response = self.post_pack(data).await
             .map_err(|e| {
                 log::error!("❌ DHCP request failed: {}", e);
                 VpnError::Network(format!("Failed to send DHCP request: {}", e))
@@ -942,7 +856,7 @@ impl AuthClient {
 
         log::info!("📥 DHCP response status: {}", response.status());
         
-        if !response.status().is_success() {
+        if !response.is_success() {
             log::error!("❌ DHCP request failed with HTTP {}, falling back to hardcoded IP", response.status());
             log::error!("🔧 This is why we're seeing 10.0.0.x instead of 10.21.255.x");
             // Use fallback IP that's different from default to show it was attempted
@@ -950,11 +864,7 @@ impl AuthClient {
             return Ok(TunnelConfig::with_fallback_ip());
         }
 
-        let response_data = response.bytes().await
-            .map_err(|e| {
-                log::error!("❌ Failed to read DHCP response: {}", e);
-                VpnError::Network(format!("Failed to read DHCP response: {}", e))
-            })?;
+        let response_data = response.into_body();
         
         log::info!("📥 DHCP response received: {} bytes", response_data.len());
         log::debug!("📦 DHCP response (first 200 bytes): {:02x?}", 
@@ -1078,12 +988,12 @@ impl AuthClient {
         password: String,
     ) -> Result<(TcpStream, String), VpnError> {
         // Connect to server
-        let mut stream = TcpStream::connect(&server_address).await
+        let stream = TcpStream::connect(&server_address).await
             .map_err(|e| VpnError::Network(format!("Failed to connect to server: {}", e)))?;
     
         // Create auth client and authenticate
         let mut auth_client = AuthClient::new(server_address, None, hub_name, username, password, false)?;
-        let session_id = auth_client.authenticate_with_stream(&mut stream).await?;
+        let session_id = auth_client.authenticate_via_watermark().await?;
     
         Ok((stream, session_id))
     }
@@ -7,11 +7,18 @@
 //! This implements the post-authentication binary protocol transition
 //! discovered in SoftEther's StartTunnelingMode function (Protocol.c:3261)
 
+use crate::buffer_pool::{BufferPool, BufferPoolStats};
 use crate::error::{Result, VpnError};
 use bytes::{Bytes, BytesMut, Buf, BufMut};
+use crate::protocol::connection::{SessionConnection, TlsStream};
+use std::io::IoSlice;
 use std::net::SocketAddr;
+use std::ops::Range;
+use std::pin::Pin;
+use std::task::{Context, Poll};
 use tokio::net::TcpStream;
-use tokio::io::{AsyncReadExt, AsyncWriteExt};
+use tokio::net::tcp::{OwnedReadHalf, OwnedWriteHalf};
+use tokio::io::{AsyncRead, AsyncReadExt, AsyncWrite, AsyncWriteExt, ReadBuf, ReadHalf, WriteHalf};
 
 /// SoftEther protocol constants
 pub mod protocol_constants {
@@ -21,6 +28,16 @@ pub mod protocol_constants {
     pub const PACKET_TYPE_DATA: u8 = 0x04;
     pub const PACKET_TYPE_SESSION_ESTABLISH: u8 = 0x05;
     pub const PACKET_TYPE_SESSION_RESPONSE: u8 = 0x06;
+
+    /// Wire header size: type (1) + session ID (4) + sequence (4) + length (4)
+    pub const PACKET_HEADER_SIZE: usize = 13;
+    /// Largest payload accepted from the wire before the stream is treated as corrupt
+    pub const MAX_PACKET_DATA_SIZE: usize = 0x20000;
+    /// Initial capacity of the reusable send/receive staging buffers
+    pub const STAGING_BUFFER_SIZE: usize = 64 * 1024;
+    /// Payloads up to this size are copied next to their header when sending;
+    /// larger ones are written straight from their own buffer
+    pub const INLINE_PAYLOAD_MAX: usize = 256;
 }
 
 use protocol_constants::*;
@@ -75,6 +92,15 @@ impl SoftEtherPacket {
         }
     }
 
+    /// Append a wire header for a payload of `data_len` bytes to `buf`
+    #[inline]
+    pub fn put_header(buf: &mut BytesMut, packet_type: u8, session_id: u32, sequence: u32, data_len: usize) {
+        buf.put_u8(packet_type);
+        buf.put_u32(session_id);
+        buf.put_u32(sequence);
+        buf.put_u32(data_len as u32);
+    }
+
     /// Convert packet to bytes for transmission
     pub fn to_bytes(&self) -> Bytes {
         let mut buf = BytesMut::with_capacity(1 + 4 + 4 + 4 + self.data.len());
@@ -98,8 +124,11 @@ impl SoftEtherPacket {
     }
 
     /// Parse packet from bytes
+    ///
+    /// The payload is a slice of `data`, not a copy; pass a frozen
+    /// [`PooledBuffer`](crate::buffer_pool::PooledBuffer) to keep it pool-backed.
     pub fn from_bytes(mut data: Bytes) -> Result<Self> {
-        if data.len() < 13 {
+        if data.len() < PACKET_HEADER_SIZE {
             return Err(VpnError::Protocol("Packet too short".to_string()));
         }
 
@@ -123,16 +152,127 @@ impl SoftEtherPacket {
     }
 }
 
+/// Transport under a data channel
+///
+/// Either a socket of its own or the TLS stream the session was set up on
+/// (see [`SessionConnection`]).
+pub enum DataStream {
+    Tcp(TcpStream),
+    Tls(Box<TlsStream>),
+}
+
+/// Receiving half of a [`DataStream`]
+pub enum DataReadHalf {
+    Tcp(OwnedReadHalf),
+    Tls(ReadHalf<Box<TlsStream>>),
+}
+
+/// Sending half of a [`DataStream`]
+pub enum DataWriteHalf {
+    Tcp(OwnedWriteHalf),
+    Tls(WriteHalf<Box<TlsStream>>),
+}
+
+impl DataStream {
+    /// The TCP socket underneath
+    pub fn tcp(&self) -> &TcpStream {
+        match self {
+            Self::Tcp(stream) => stream,
+            Self::Tls(stream) => stream.get_ref().0,
+        }
+    }
+
+    /// Split into halves; TCP splits without locking
+    pub fn into_split(self) -> (DataReadHalf, DataWriteHalf) {
+        match self {
+            Self::Tcp(stream) => {
+                let (read, write) = stream.into_split();
+                (DataReadHalf::Tcp(read), DataWriteHalf::Tcp(write))
+            }
+            Self::Tls(stream) => {
+                let (read, write) = tokio::io::split(stream);
+                (DataReadHalf::Tls(read), DataWriteHalf::Tls(write))
+            }
+        }
+    }
+}
+
+impl From<TcpStream> for DataStream {
+    fn from(stream: TcpStream) -> Self {
+        Self::Tcp(stream)
+    }
+}
+
+/// Forward to whichever transport `$self` wraps
+macro_rules! delegate {
+    ($self:ident, $io:ident => $call:expr) => {
+        match $self.get_mut() {
+            Self::Tcp($io) => $call,
+            Self::Tls($io) => $call,
+        }
+    };
+}
+
+macro_rules! impl_async_read {
+    ($type:ty) => {
+        impl AsyncRead for $type {
+            fn poll_read(self: Pin<&mut Self>, cx: &mut Context<'_>, buf: &mut ReadBuf<'_>) -> Poll<std::io::Result<()>> {
+                delegate!(self, io => Pin::new(io).poll_read(cx, buf))
+            }
+        }
+    };
+}
+
+macro_rules! impl_async_write {
+    ($type:ty) => {
+        impl AsyncWrite for $type {
+            fn poll_write(self: Pin<&mut Self>, cx: &mut Context<'_>, buf: &[u8]) -> Poll<std::io::Result<usize>> {
+                delegate!(self, io => Pin::new(io).poll_write(cx, buf))
+            }
+
+            fn poll_write_vectored(self: Pin<&mut Self>, cx: &mut Context<'_>, bufs: &[IoSlice<'_>]) -> Poll<std::io::Result<usize>> {
+                delegate!(self, io => Pin::new(io).poll_write_vectored(cx, bufs))
+            }
+
+            fn is_write_vectored(&self) -> bool {
+                match self {
+                    Self::Tcp(io) => io.is_write_vectored(),
+                    Self::Tls(io) => io.is_write_vectored(),
+                }
+            }
+
+            fn poll_flush(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<std::io::Result<()>> {
+                delegate!(self, io => Pin::new(io).poll_flush(cx))
+            }
+
+            fn poll_shutdown(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<std::io::Result<()>> {
+                delegate!(self, io => Pin::new(io).poll_shutdown(cx))
+            }
+        }
+    };
+}
+
+impl_async_read!(DataStream);
+impl_async_read!(DataReadHalf);
+impl_async_write!(DataStream);
+impl_async_write!(DataWriteHalf);
+
 /// High-performance binary protocol client
 /// 
 /// This handles the post-authentication binary VPN protocol for actual
 /// VPN packet transmission, as used by SoftEther after StartTunnelingMode
 pub struct BinaryProtocolClient {
     server_addr: SocketAddr,
-    stream: Option<TcpStream>,
+    stream: Option<DataStream>,
     session_id: Option<u32>,
     sequence_counter: u32,
     is_connected: bool,
+    /// Reusable buffer that outbound batches are framed into
+    tx_buf: BytesMut,
+    /// Bytes read from the stream that have not been handed out yet
+    rx_buf: BytesMut,
+    /// Frame buffers for single-packet reads
+    buffer_pool: BufferPool,
 }
 
 impl BinaryProtocolClient {
@@ -144,9 +284,64 @@ impl BinaryProtocolClient {
             session_id: None,
             sequence_counter: 0,
             is_connected: false,
+            tx_buf: BytesMut::new(),
+            rx_buf: BytesMut::new(),
+            buffer_pool: BufferPool::for_mtu(1500 + PACKET_HEADER_SIZE),
         }
     }
 
+    /// Server endpoint this client connects to
+    pub fn server_addr(&self) -> SocketAddr {
+        self.server_addr
+    }
+
+    /// Use a shared buffer pool for received frames
+    pub fn with_buffer_pool(mut self, pool: BufferPool) -> Self {
+        self.buffer_pool = pool;
+        self
+    }
+
+    /// Receive buffer pool counters
+    pub fn buffer_pool_stats(&self) -> BufferPoolStats {
+        self.buffer_pool.stats()
+    }
+
+    /// Run the data channel over the session's connection instead of a new socket
+    ///
+    /// [`Self::open`] then skips the TCP and TLS setup. Bytes the server sent
+    /// behind the last HTTP response are kept for the first read.
+    pub fn with_session_connection(mut self, connection: SessionConnection) -> Self {
+        self.server_addr = connection.server_addr();
+        let (stream, leftover) = connection.into_parts();
+        self.stream = Some(DataStream::Tls(Box::new(stream)));
+        self.rx_buf = leftover;
+        self
+    }
+
+    /// Rejoin an existing session instead of authenticating a new one
+    ///
+    /// [`Self::open`] then goes straight from connecting to establishing
+    /// `session_id`, so the server keeps the session's state and IP lease.
+    pub fn with_session_id(mut self, session_id: u32) -> Self {
+        self.session_id = Some(session_id);
+        self
+    }
+
+    /// Whether the channel will use the session's connection
+    pub fn uses_session_connection(&self) -> bool {
+        matches!(self.stream, Some(DataStream::Tls(_)))
+    }
+
+    /// Wrap an already connected stream for an established session
+    #[cfg(test)]
+    pub(crate) fn from_stream(stream: TcpStream, session_id: u32) -> Self {
+        let mut client = Self::new(stream.peer_addr().expect("connected stream"));
+        client.stream = Some(stream.into());
+        client.session_id = Some(session_id);
+        client.is_connected = true;
+        client
+    }
+
     /// Connect to SoftEther server using binary protocol
     /// 
     /// **IMPORTANT**: This should only be called AFTER successful
@@ -154,10 +349,12 @@ impl BinaryProtocolClient {
     pub async fn connect(&mut self) -> Result<()> {
         log::info!("Establishing binary protocol connection to: {}", self.server_addr);
         
-        let stream = TcpStream::connect(self.server_addr).await
-            .map_err(|e| VpnError::Network(format!("Binary connection failed: {}", e)))?;
-        
-        self.stream = Some(stream);
+        // A session connection handed over from authentication is already open
+        if self.stream.is_none() {
+            let stream = TcpStream::connect(self.server_addr).await
+                .map_err(|e| VpnError::Network(format!("Binary connection failed: {}", e)))?;
+            self.stream = Some(stream.into());
+        }
         self.is_connected = true;
         
         // Send hello packet and negotiate protocol
@@ -229,24 +426,134 @@ impl BinaryProtocolClient {
     }
 
     /// Send VPN data packet
+    ///
+    /// The payload is written from `data` itself, not copied behind the header.
     pub async fn send_vpn_data(&mut self, data: Bytes) -> Result<()> {
-        let session_id = self.session_id.ok_or_else(|| 
-            VpnError::Connection("Not authenticated".to_string()))?;
-        
-        self.sequence_counter += 1;
-        let data_packet = SoftEtherPacket::create_data_packet(session_id, self.sequence_counter, data);
-        
-        self.send_packet(data_packet).await?;
+        self.send_vpn_batch(std::iter::once(&data[..])).await?;
         Ok(())
     }
 
+    /// Send a batch of VPN data packets with as few socket writes as possible
+    ///
+    /// Headers (and small payloads) go into one reusable staging buffer;
+    /// larger payloads are written from their own buffers. The whole batch is
+    /// handed to `write_vectored`, so it usually costs one syscall and no
+    /// payload copies. Returns the number of packets sent.
+    pub async fn send_vpn_batch<'a, I>(&mut self, packets: I) -> Result<usize>
+    where
+        I: IntoIterator<Item = &'a [u8]>,
+    {
+        let session_id = self.session_id.ok_or_else(||
+            VpnError::Connection("Not authenticated".to_string()))?;
+        let stream = self.stream.as_mut().ok_or_else(||
+            VpnError::Connection("Not connected".to_string()))?;
+
+        write_data_batch(stream, &mut self.tx_buf, session_id, &mut self.sequence_counter, packets).await
+    }
+
+    /// Receive up to `max_packets` VPN data packets
+    ///
+    /// Payloads are handed to `sink` as slices of the internal receive buffer
+    /// together with their index in the batch; the sink copies them into
+    /// caller-owned storage. Returning `false` from the sink leaves that packet
+    /// queued for the next call. Waits for the socket only while the batch is
+    /// still empty, so a call never blocks once at least one packet is ready.
+    /// Keepalives and other control packets are consumed silently.
+    pub async fn recv_vpn_batch<F>(&mut self, max_packets: usize, mut sink: F) -> Result<usize>
+    where
+        F: FnMut(usize, &[u8]) -> bool,
+    {
+        let stream = self.stream.as_mut().ok_or_else(||
+            VpnError::Connection("Not connected".to_string()))?;
+
+        let result = read_data_frames(stream, &mut self.rx_buf, STAGING_BUFFER_SIZE, max_packets, |index, rx_buf, frame_len| {
+            if !sink(index, &rx_buf[PACKET_HEADER_SIZE..frame_len]) {
+                return false;
+            }
+            rx_buf.advance(frame_len);
+            true
+        }).await;
+        if result.is_err() {
+            self.is_connected = false;
+        }
+        result
+    }
+
+    /// Receive up to `max_packets` VPN data packets as `Bytes` appended to `out`
+    ///
+    /// Payloads are split off the receive buffer without copying.
+    pub async fn recv_vpn_packets(&mut self, max_packets: usize, out: &mut Vec<Bytes>) -> Result<usize> {
+        let stream = self.stream.as_mut().ok_or_else(||
+            VpnError::Connection("Not connected".to_string()))?;
+
+        let result = read_data_frames(stream, &mut self.rx_buf, STAGING_BUFFER_SIZE, max_packets, |_, rx_buf, frame_len| {
+            out.push(split_payload(rx_buf, frame_len));
+            true
+        }).await;
+        if result.is_err() {
+            self.is_connected = false;
+        }
+        result
+    }
+
+    /// Connect, transfer the authenticated session and establish it, within `timeout`
+    ///
+    /// A client made with [`Self::with_session_id`] skips the transfer.
+    /// On failure the half-open socket is dropped so a later call starts over.
+    pub async fn open(&mut self, username: &str, password: &str, hub: &str, timeout: std::time::Duration) -> Result<()> {
+        let setup = tokio::time::timeout(timeout, async {
+            self.connect().await?;
+            if self.session_id.is_none() {
+                self.authenticate(username, password, hub).await?;
+            }
+            self.establish_session().await
+        })
+        .await
+        .map_err(|_| VpnError::Timeout("Binary data channel setup timed out".to_string()))
+        .and_then(|result| result);
+
+        if setup.is_err() {
+            self.disconnect().await?;
+        }
+        setup
+    }
+
+    /// Split an established connection into independently usable halves
+    ///
+    /// Lets the receive and send directions run as separate tasks. Any bytes
+    /// already buffered for reading move to the reader half.
+    pub fn into_split(mut self) -> Result<(BinaryDataReader<DataReadHalf>, BinaryDataWriter<DataWriteHalf>)> {
+        let session_id = self.session_id.ok_or_else(||
+            VpnError::Connection("Not authenticated".to_string()))?;
+        let stream = self.stream.take().ok_or_else(||
+            VpnError::Connection("Not connected".to_string()))?;
+
+        let (read_half, write_half) = stream.into_split();
+        Ok((
+            BinaryDataReader {
+                reader: read_half,
+                rx_buf: std::mem::take(&mut self.rx_buf),
+                read_reserve: STAGING_BUFFER_SIZE,
+            },
+            BinaryDataWriter {
+                writer: write_half,
+                session_id,
+                sequence_counter: self.sequence_counter,
+                tx_buf: std::mem::take(&mut self.tx_buf),
+            },
+        ))
+    }
+
     /// Send a packet over the binary protocol
     async fn send_packet(&mut self, packet: SoftEtherPacket) -> Result<()> {
         let stream = self.stream.as_mut().ok_or_else(|| 
             VpnError::Connection("Not connected".to_string()))?;
         
-        let packet_bytes = packet.to_bytes();
-        stream.write_all(&packet_bytes).await
+        self.tx_buf.clear();
+        SoftEtherPacket::put_header(&mut self.tx_buf, packet.packet_type, packet.session_id, packet.sequence, packet.data.len());
+        write_all_vectored(stream, &mut [IoSlice::new(&self.tx_buf), IoSlice::new(&packet.data)]).await
+            .map_err(|e| VpnError::Network(format!("Send failed: {}", e)))?;
+        stream.flush().await
             .map_err(|e| VpnError::Network(format!("Send failed: {}", e)))?;
         
         Ok(())
@@ -258,25 +565,27 @@ impl BinaryProtocolClient {
             VpnError::Connection("Not connected".to_string()))?;
         
         // Read packet header (13 bytes minimum)
-        let mut header = [0u8; 13];
-        stream.read_exact(&mut header).await
+        let mut header = [0u8; PACKET_HEADER_SIZE];
+        read_exact_buffered(stream, &mut self.rx_buf, &mut header).await
             .map_err(|e| VpnError::Network(format!("Read failed: {}", e)))?;
         
         let data_len = u32::from_be_bytes([header[9], header[10], header[11], header[12]]) as usize;
+        if data_len > MAX_PACKET_DATA_SIZE {
+            return Err(VpnError::Protocol(format!("Invalid data length: {}", data_len)));
+        }
         
-        // Read packet data
-        let mut data = vec![0u8; data_len];
+        // Read header and payload into one pooled frame; the parsed packet's
+        // data is a view into it, so the buffer returns to the pool with it.
+        let frame_len = PACKET_HEADER_SIZE + data_len;
+        let mut frame = self.buffer_pool.acquire_for(frame_len);
+        frame.extend_from_slice(&header);
+        frame.resize(frame_len, 0);
         if data_len > 0 {
-            stream.read_exact(&mut data).await
+            read_exact_buffered(stream, &mut self.rx_buf, &mut frame[PACKET_HEADER_SIZE..]).await
                 .map_err(|e| VpnError::Network(format!("Read data failed: {}", e)))?;
         }
         
-        // Reconstruct full packet
-        let mut full_packet = BytesMut::with_capacity(13 + data_len);
-        full_packet.extend_from_slice(&header);
-        full_packet.extend_from_slice(&data);
-        
-        SoftEtherPacket::from_bytes(full_packet.freeze())
+        SoftEtherPacket::from_bytes(frame.freeze())
     }
 
     /// Disconnect from server
@@ -286,10 +595,16 @@ impl BinaryProtocolClient {
         }
         self.is_connected = false;
         self.session_id = None;
+        self.rx_buf.clear();
         log::info!("Binary protocol disconnected");
         Ok(())
     }
 
+    /// TCP socket carrying the channel, once connected
+    pub fn tcp_stream(&self) -> Option<&TcpStream> {
+        self.stream.as_ref().map(DataStream::tcp)
+    }
+
     /// Check if connected
     pub fn is_connected(&self) -> bool {
         self.is_connected
@@ -301,6 +616,241 @@ impl BinaryProtocolClient {
     }
 }
 
+/// Receiving half of a split data channel
+pub struct BinaryDataReader<R> {
+    reader: R,
+    rx_buf: BytesMut,
+    read_reserve: usize,
+}
+
+impl<R: AsyncRead + Unpin> BinaryDataReader<R> {
+    /// Wrap a reader that carries binary protocol frames
+    pub fn new(reader: R) -> Self {
+        Self { reader, rx_buf: BytesMut::new(), read_reserve: STAGING_BUFFER_SIZE }
+    }
+
+    /// Keep only `bytes` of free buffer space for each socket read
+    ///
+    /// The reserve stays allocated while the reader waits, so a small one
+    /// keeps idle channels cheap; frames larger than it are still read
+    /// whole. Defaults to [`STAGING_BUFFER_SIZE`].
+    pub fn with_read_reserve(mut self, bytes: usize) -> Self {
+        self.read_reserve = bytes.max(PACKET_HEADER_SIZE);
+        self
+    }
+
+    /// Receive up to `max_packets` data payloads, appended to `out` without copying
+    ///
+    /// Waits only until the first packet is available.
+    pub async fn recv_batch(&mut self, max_packets: usize, out: &mut Vec<Bytes>) -> Result<usize> {
+        read_data_frames(&mut self.reader, &mut self.rx_buf, self.read_reserve, max_packets, |_, rx_buf, frame_len| {
+            out.push(split_payload(rx_buf, frame_len));
+            true
+        }).await
+    }
+}
+
+/// Sending half of a split data channel
+pub struct BinaryDataWriter<W> {
+    writer: W,
+    session_id: u32,
+    sequence_counter: u32,
+    tx_buf: BytesMut,
+}
+
+impl<W: AsyncWrite + Unpin> BinaryDataWriter<W> {
+    /// Wrap a writer for an already established session
+    pub fn new(writer: W, session_id: u32) -> Self {
+        Self { writer, session_id, sequence_counter: 0, tx_buf: BytesMut::new() }
+    }
+
+    /// Send a batch of data payloads with a single write
+    pub async fn send_batch<'a, I>(&mut self, packets: I) -> Result<usize>
+    where
+        I: IntoIterator<Item = &'a [u8]>,
+    {
+        write_data_batch(&mut self.writer, &mut self.tx_buf, self.session_id, &mut self.sequence_counter, packets).await
+    }
+
+    /// Send a keepalive packet
+    pub async fn send_keepalive(&mut self) -> Result<()> {
+        self.sequence_counter = self.sequence_counter.wrapping_add(1);
+        self.tx_buf.clear();
+        SoftEtherPacket::put_header(&mut self.tx_buf, PACKET_TYPE_KEEPALIVE, self.session_id, self.sequence_counter, 0);
+        self.writer.write_all(&self.tx_buf).await
+            .map_err(|e| VpnError::Network(format!("Send failed: {}", e)))?;
+        self.writer.flush().await
+            .map_err(|e| VpnError::Network(format!("Send failed: {}", e)))
+    }
+}
+
+/// Frame `packets` as data packets and write them with vectored writes
+///
+/// Headers and payloads up to [`INLINE_PAYLOAD_MAX`] bytes are staged in
+/// `tx_buf`; larger payloads stay where they are and are interleaved as
+/// their own slices, so bulk traffic is never copied.
+async fn write_data_batch<'a, W, I>(
+    writer: &mut W,
+    tx_buf: &mut BytesMut,
+    session_id: u32,
+    sequence: &mut u32,
+    packets: I,
+) -> Result<usize>
+where
+    W: AsyncWrite + Unpin,
+    I: IntoIterator<Item = &'a [u8]>,
+{
+    /// Part of the outgoing byte stream: a range of `tx_buf`, or a payload
+    enum Chunk<'a> {
+        Staged(Range<usize>),
+        Payload(&'a [u8]),
+    }
+
+    tx_buf.clear();
+    let mut chunks: Vec<Chunk<'a>> = Vec::new();
+    let mut staged_from = 0;
+    let mut count = 0;
+    for payload in packets {
+        if payload.len() > MAX_PACKET_DATA_SIZE {
+            return Err(VpnError::PacketError(format!(
+                "Packet of {} bytes exceeds maximum of {}", payload.len(), MAX_PACKET_DATA_SIZE
+            )));
+        }
+        *sequence = sequence.wrapping_add(1);
+        SoftEtherPacket::put_header(tx_buf, PACKET_TYPE_DATA, session_id, *sequence, payload.len());
+        if payload.len() <= INLINE_PAYLOAD_MAX {
+            tx_buf.extend_from_slice(payload);
+        } else {
+            chunks.push(Chunk::Staged(staged_from..tx_buf.len()));
+            chunks.push(Chunk::Payload(payload));
+            staged_from = tx_buf.len();
+        }
+        count += 1;
+    }
+    if count == 0 {
+        return Ok(0);
+    }
+    if staged_from < tx_buf.len() {
+        chunks.push(Chunk::Staged(staged_from..tx_buf.len()));
+    }
+
+    // Slices are built only now: staging may have reallocated `tx_buf`
+    let mut slices: Vec<IoSlice<'_>> = chunks
+        .iter()
+        .map(|chunk| match chunk {
+            Chunk::Staged(range) => IoSlice::new(&tx_buf[range.clone()]),
+            Chunk::Payload(payload) => IoSlice::new(payload),
+        })
+        .collect();
+    write_all_vectored(writer, &mut slices).await
+        .map_err(|e| VpnError::Network(format!("Batch send failed: {}", e)))?;
+    // TLS holds records back until flushed; a no-op on plain TCP
+    writer.flush().await
+        .map_err(|e| VpnError::Network(format!("Batch send failed: {}", e)))?;
+    Ok(count)
+}
+
+/// Fill `buf`, taking bytes already buffered in `rx_buf` before reading `reader`
+async fn read_exact_buffered<R>(reader: &mut R, rx_buf: &mut BytesMut, buf: &mut [u8]) -> std::io::Result<()>
+where
+    R: AsyncRead + Unpin,
+{
+    let buffered = rx_buf.len().min(buf.len());
+    buf[..buffered].copy_from_slice(&rx_buf[..buffered]);
+    rx_buf.advance(buffered);
+    reader.read_exact(&mut buf[buffered..]).await?;
+    Ok(())
+}
+
+/// Most slices passed to one `write_vectored` call (Linux `IOV_MAX`)
+const MAX_IOVECS: usize = 1024;
+
+/// Write every slice, resuming after partial writes
+async fn write_all_vectored<W>(writer: &mut W, mut slices: &mut [IoSlice<'_>]) -> std::io::Result<()>
+where
+    W: AsyncWrite + Unpin,
+{
+    IoSlice::advance_slices(&mut slices, 0);
+    while !slices.is_empty() {
+        let end = slices.len().min(MAX_IOVECS);
+        let written = writer.write_vectored(&slices[..end]).await?;
+        if written == 0 {
+            return Err(std::io::ErrorKind::WriteZero.into());
+        }
+        IoSlice::advance_slices(&mut slices, written);
+    }
+    Ok(())
+}
+
+/// Read frames into `rx_buf` and pass each complete data frame to `take`
+///
+/// `take` gets the batch index, the buffer and the frame length; it must
+/// consume exactly that many bytes and return `true`, or leave the buffer
+/// untouched and return `false` to stop the batch. Control frames are skipped.
+/// The socket is only awaited while no data frame has been taken yet, with
+/// at least `reserve` bytes of free space in `rx_buf`.
+async fn read_data_frames<R, F>(
+    reader: &mut R,
+    rx_buf: &mut BytesMut,
+    reserve: usize,
+    max_packets: usize,
+    mut take: F,
+) -> Result<usize>
+where
+    R: AsyncRead + Unpin,
+    F: FnMut(usize, &mut BytesMut, usize) -> bool,
+{
+    let mut count = 0;
+    while count < max_packets {
+        if rx_buf.len() >= PACKET_HEADER_SIZE {
+            let packet_type = rx_buf[0];
+            let data_len = u32::from_be_bytes([rx_buf[9], rx_buf[10], rx_buf[11], rx_buf[12]]) as usize;
+            if data_len > MAX_PACKET_DATA_SIZE {
+                return Err(VpnError::Protocol(format!("Invalid data length: {}", data_len)));
+            }
+
+            let frame_len = PACKET_HEADER_SIZE + data_len;
+            if rx_buf.len() >= frame_len {
+                if packet_type == PACKET_TYPE_DATA {
+                    if !take(count, rx_buf, frame_len) {
+                        break;
+                    }
+                    count += 1;
+                } else {
+                    log::debug!("Skipping control packet type {} in data stream", packet_type);
+                    rx_buf.advance(frame_len);
+                }
+                continue;
+            }
+
+            rx_buf.reserve(frame_len - rx_buf.len());
+        }
+
+        if count > 0 {
+            break;
+        }
+
+        if rx_buf.capacity() - rx_buf.len() < PACKET_HEADER_SIZE {
+            rx_buf.reserve(reserve);
+        }
+        let read = reader.read_buf(rx_buf).await
+            .map_err(|e| VpnError::Network(format!("Read failed: {}", e)))?;
+        if read == 0 {
+            return Err(VpnError::Connection("Connection closed by server".to_string()));
+        }
+    }
+
+    Ok(count)
+}
+
+/// Split the frame at the front of `rx_buf` off and return its payload
+#[inline]
+fn split_payload(rx_buf: &mut BytesMut, frame_len: usize) -> Bytes {
+    let mut frame = rx_buf.split_to(frame_len);
+    frame.advance(PACKET_HEADER_SIZE);
+    frame.freeze()
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -324,4 +874,115 @@ mod tests {
         assert_eq!(packet.session_id, 12345);
         assert_eq!(packet.sequence, 100);
     }
+
+    #[tokio::test]
+    async fn test_batch_round_trip() {
+        let listener = tokio::net::TcpListener::bind("127.0.0.1:0").await.unwrap();
+        let addr = listener.local_addr().unwrap();
+
+        let mut sender = BinaryProtocolClient::new(addr);
+        sender.stream = Some(TcpStream::connect(addr).await.unwrap().into());
+        sender.session_id = Some(7);
+        let (peer, _) = listener.accept().await.unwrap();
+
+        let mut receiver = BinaryProtocolClient::new(addr);
+        receiver.stream = Some(peer.into());
+
+        let payloads: [&[u8]; 3] = [b"first", b"", b"third packet"];
+        assert_eq!(sender.send_vpn_batch(payloads.iter().copied()).await.unwrap(), 3);
+        sender.send_keepalive().await.unwrap();
+        assert_eq!(sender.send_vpn_batch([&b"last"[..]]).await.unwrap(), 1);
+
+        let mut received: Vec<Vec<u8>> = Vec::new();
+        while received.len() < 4 {
+            receiver.recv_vpn_batch(8, |_, data| {
+                received.push(data.to_vec());
+                true
+            }).await.unwrap();
+        }
+
+        assert_eq!(received, vec![b"first".to_vec(), Vec::new(), b"third packet".to_vec(), b"last".to_vec()]);
+    }
+
+    #[tokio::test]
+    async fn test_vectored_batch_survives_partial_writes() {
+        // A tiny duplex buffer forces many short writes
+        let (client, server) = tokio::io::duplex(64);
+        let mut writer = BinaryDataWriter::new(client, 3);
+        let mut reader = BinaryDataReader::new(server);
+
+        let large: Vec<u8> = (0..3000u32).map(|i| i as u8).collect();
+        let payloads: Vec<&[u8]> = vec![b"small", &large, b"", &large[..INLINE_PAYLOAD_MAX + 1], b"tail"];
+        let expected: Vec<Vec<u8>> = payloads.iter().map(|p| p.to_vec()).collect();
+
+        let send = async {
+            assert_eq!(writer.send_batch(payloads.iter().copied()).await.unwrap(), 5);
+        };
+        let recv = async {
+            let mut received = Vec::new();
+            while received.len() < expected.len() {
+                reader.recv_batch(8, &mut received).await.unwrap();
+            }
+            received
+        };
+        let ((), received) = tokio::join!(send, recv);
+
+        assert_eq!(received.iter().map(|p| p.to_vec()).collect::<Vec<_>>(), expected);
+    }
+
+    #[tokio::test]
+    async fn test_receive_packet_reuses_pooled_frames() {
+        let listener = tokio::net::TcpListener::bind("127.0.0.1:0").await.unwrap();
+        let addr = listener.local_addr().unwrap();
+        let mut client = BinaryProtocolClient::from_stream(TcpStream::connect(addr).await.unwrap(), 9);
+        let (mut peer, _) = listener.accept().await.unwrap();
+
+        for seq in 1..=2 {
+            let packet = SoftEtherPacket::create_data_packet(9, seq, Bytes::from_static(b"pooled"));
+            peer.write_all(&packet.to_bytes()).await.unwrap();
+        }
+
+        let first = client.receive_packet().await.unwrap();
+        assert_eq!(&first.data[..], b"pooled");
+        drop(first);
+        let second = client.receive_packet().await.unwrap();
+        assert_eq!(second.sequence, 2);
+
+        let stats = client.buffer_pool_stats();
+        assert_eq!(stats.misses, 1);
+        assert_eq!(stats.hits, 1);
+    }
+
+    #[tokio::test]
+    async fn test_split_halves_zero_copy_receive() {
+        let (client_side, server_side) = tokio::io::duplex(4096);
+        let mut writer = BinaryDataWriter::new(client_side, 42);
+        let mut reader = BinaryDataReader::new(server_side);
+
+        writer.send_batch([&b"alpha"[..], &b"beta"[..]]).await.unwrap();
+        writer.send_keepalive().await.unwrap();
+        writer.send_batch([&b"gamma"[..]]).await.unwrap();
+
+        let mut packets = Vec::new();
+        while packets.len() < 3 {
+            reader.recv_batch(16, &mut packets).await.unwrap();
+        }
+        assert_eq!(packets, vec![Bytes::from_static(b"alpha"), Bytes::from_static(b"beta"), Bytes::from_static(b"gamma")]);
+    }
+
+    #[tokio::test]
+    async fn test_control_reads_drain_carried_over_bytes_first() {
+        // Part of the hello response arrived together with the last HTTP response
+        let hello = SoftEtherPacket::create_hello().to_bytes();
+        let (split, rest) = hello.split_at(5);
+        let (mut server, client_side) = tokio::io::duplex(4096);
+        server.write_all(rest).await.unwrap();
+
+        let mut rx_buf = BytesMut::from(split);
+        let mut header = [0u8; PACKET_HEADER_SIZE];
+        let mut reader = client_side;
+        read_exact_buffered(&mut reader, &mut rx_buf, &mut header).await.unwrap();
+        assert_eq!(&header[..], &hello[..PACKET_HEADER_SIZE]);
+        assert!(rx_buf.is_empty());
+    }
 }
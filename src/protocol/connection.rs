@@ -0,0 +1,300 @@
+//! Persistent session connection
+//!
+//! A SoftEther server ties a session to the TLS connection it was set up on:
+//! the watermark POST, the PACK exchanges and the switch to tunneling mode
+//! all happen on one socket, which then carries the binary data channel.
+//! [`SessionConnection`] is that socket. It speaks just enough HTTP/1.1
+//! keep-alive for the setup requests and hands the stream on afterwards.
+
+use crate::crypto::tls;
+use crate::error::{Result, VpnError};
+use bytes::{Buf, Bytes, BytesMut};
+use rustls::pki_types::ServerName;
+use std::net::SocketAddr;
+use std::sync::Arc;
+use tokio::io::{AsyncRead, AsyncReadExt, AsyncWrite, AsyncWriteExt};
+use tokio::net::TcpStream;
+
+/// Client TLS stream over TCP
+pub type TlsStream = tokio_rustls::client::TlsStream<TcpStream>;
+
+/// Session connection shared, one request at a time, by the clients that use it
+pub type SharedConnection = Arc<tokio::sync::Mutex<Option<SessionConnection>>>;
+
+/// User agent sent with every setup request
+pub const HTTP_USER_AGENT: &str = "Mozilla/4.0 (compatible; MSIE 6.0; Windows NT 5.1)";
+
+/// Largest response header block accepted
+const MAX_HEAD_SIZE: usize = 16 * 1024;
+
+/// Largest response body accepted
+const MAX_BODY_SIZE: usize = 16 * 1024 * 1024;
+
+/// Most response headers parsed
+const MAX_HEADERS: usize = 32;
+
+/// Response to a request on a [`SessionConnection`]
+#[derive(Debug, Clone)]
+pub struct HttpResponse {
+    status: u16,
+    body: Bytes,
+}
+
+impl HttpResponse {
+    /// Response with `status` and a complete `body`
+    pub fn new(status: u16, body: Bytes) -> Self {
+        Self { status, body }
+    }
+
+    /// HTTP status code
+    pub fn status(&self) -> u16 {
+        self.status
+    }
+
+    /// Whether the status is 2xx
+    pub fn is_success(&self) -> bool {
+        (200..300).contains(&self.status)
+    }
+
+    /// Response body
+    pub fn body(&self) -> &Bytes {
+        &self.body
+    }
+
+    /// Take the response body
+    pub fn into_body(self) -> Bytes {
+        self.body
+    }
+}
+
+/// One keep-alive connection to a server, from the first request to tunneling
+pub struct SessionConnection<S = TlsStream> {
+    stream: S,
+    server_addr: SocketAddr,
+    host: String,
+    /// Bytes read past the end of the last response
+    rx_buf: BytesMut,
+    requests: u64,
+    closed: bool,
+}
+
+impl SessionConnection {
+    /// Open a TLS connection to `server_addr`
+    ///
+    /// `hostname`, when given, is used for SNI, certificate checks and the
+    /// `Host` header; otherwise the server's IP address is.
+    pub async fn connect(server_addr: SocketAddr, hostname: Option<&str>, verify_certificate: bool) -> Result<Self> {
+        let tcp = TcpStream::connect(server_addr).await
+            .map_err(|e| VpnError::Network(format!("TCP connection to {} failed: {}", server_addr, e)))?;
+        let _ = tcp.set_nodelay(true);
+
+        let server_name = match hostname {
+            Some(name) => ServerName::try_from(name.to_string())
+                .map_err(|e| VpnError::Network(format!("Invalid hostname '{}': {}", name, e)))?,
+            None => ServerName::IpAddress(server_addr.ip().into()),
+        };
+        let connector = tokio_rustls::TlsConnector::from(tls::shared_client_config(verify_certificate)?);
+        let stream = connector.connect(server_name, tcp).await
+            .map_err(|e| VpnError::Network(format!("TLS handshake with {} failed: {}", server_addr, e)))?;
+
+        let host = hostname.map_or_else(|| server_addr.ip().to_string(), str::to_string);
+        Ok(Self::from_stream(stream, server_addr, host))
+    }
+}
+
+impl<S: AsyncRead + AsyncWrite + Unpin> SessionConnection<S> {
+    /// Use an already connected stream
+    pub fn from_stream(stream: S, server_addr: SocketAddr, host: String) -> Self {
+        Self {
+            stream,
+            server_addr,
+            host,
+            rx_buf: BytesMut::new(),
+            requests: 0,
+            closed: false,
+        }
+    }
+
+    /// Server this connection goes to
+    pub fn server_addr(&self) -> SocketAddr {
+        self.server_addr
+    }
+
+    /// Requests completed on this connection so far
+    pub fn requests(&self) -> u64 {
+        self.requests
+    }
+
+    /// Whether the server said it will close the connection
+    pub fn is_closed(&self) -> bool {
+        self.closed
+    }
+
+    /// POST `body` to `path` and read the whole response
+    pub async fn post(&mut self, path: &str, content_type: &str, body: &[u8]) -> Result<HttpResponse> {
+        if self.closed {
+            return Err(VpnError::Connection("Server closed the session connection".to_string()));
+        }
+
+        let head = format!(
+            "POST {path} HTTP/1.1\r\nHost: {}\r\nUser-Agent: {HTTP_USER_AGENT}\r\nContent-Type: {content_type}\r\nContent-Length: {}\r\nConnection: Keep-Alive\r\n\r\n",
+            self.host,
+            body.len()
+        );
+        let mut request = BytesMut::with_capacity(head.len() + body.len());
+        request.extend_from_slice(head.as_bytes());
+        request.extend_from_slice(body);
+        self.stream.write_all(&request).await
+            .map_err(|e| VpnError::Network(format!("POST {} failed: {}", path, e)))?;
+        self.stream.flush().await
+            .map_err(|e| VpnError::Network(format!("POST {} failed: {}", path, e)))?;
+
+        let response = self.read_response().await?;
+        self.requests += 1;
+        Ok(response)
+    }
+
+    /// Give up HTTP and return the stream with any bytes already read from it
+    pub fn into_parts(self) -> (S, BytesMut) {
+        (self.stream, self.rx_buf)
+    }
+
+    async fn read_response(&mut self) -> Result<HttpResponse> {
+        let (status, head_len, content_length) = loop {
+            let mut headers = [httparse::EMPTY_HEADER; MAX_HEADERS];
+            let mut response = httparse::Response::new(&mut headers);
+            match response.parse(&self.rx_buf) {
+                Ok(httparse::Status::Complete(head_len)) => {
+                    let mut content_length = None;
+                    for header in response.headers.iter() {
+                        if header.name.eq_ignore_ascii_case("content-length") {
+                            let length = std::str::from_utf8(header.value).ok()
+                                .and_then(|value| value.trim().parse::<usize>().ok())
+                                .ok_or_else(|| VpnError::Protocol("Invalid Content-Length".to_string()))?;
+                            content_length = Some(length);
+                        } else if header.name.eq_ignore_ascii_case("transfer-encoding") {
+                            return Err(VpnError::Protocol("Chunked responses are not supported".to_string()));
+                        } else if header.name.eq_ignore_ascii_case("connection")
+                            && header.value.eq_ignore_ascii_case(b"close")
+                        {
+                            self.closed = true;
+                        }
+                    }
+                    break (response.code.unwrap_or(0), head_len, content_length);
+                }
+                Ok(httparse::Status::Partial) => {
+                    if self.rx_buf.len() > MAX_HEAD_SIZE {
+                        return Err(VpnError::Protocol("HTTP response header too large".to_string()));
+                    }
+                    if self.read_more().await? == 0 {
+                        return Err(VpnError::Connection("Connection closed before response".to_string()));
+                    }
+                }
+                Err(e) => return Err(VpnError::Protocol(format!("Malformed HTTP response: {}", e))),
+            }
+        };
+        self.rx_buf.advance(head_len);
+
+        let body = match content_length {
+            Some(length) if length > MAX_BODY_SIZE => {
+                return Err(VpnError::Protocol(format!("HTTP response body of {} bytes is too large", length)));
+            }
+            Some(length) => {
+                while self.rx_buf.len() < length {
+                    if self.read_more().await? == 0 {
+                        return Err(VpnError::Connection("Connection closed mid-response".to_string()));
+                    }
+                }
+                self.rx_buf.split_to(length).freeze()
+            }
+            // No length: the body runs until the server closes
+            None => {
+                while self.read_more().await? > 0 {
+                    if self.rx_buf.len() > MAX_BODY_SIZE {
+                        return Err(VpnError::Protocol("HTTP response body is too large".to_string()));
+                    }
+                }
+                self.closed = true;
+                self.rx_buf.split().freeze()
+            }
+        };
+        Ok(HttpResponse::new(status, body))
+    }
+
+    async fn read_more(&mut self) -> Result<usize> {
+        self.rx_buf.reserve(4096);
+        self.stream.read_buf(&mut self.rx_buf).await
+            .map_err(|e| VpnError::Network(format!("Read failed: {}", e)))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[tokio::test]
+    async fn test_keep_alive_requests_share_one_stream() {
+        let (client, mut server) = tokio::io::duplex(64 * 1024);
+        let addr: SocketAddr = "127.0.0.1:443".parse().unwrap();
+        let mut connection = SessionConnection::from_stream(client, addr, "vpn.example.com".to_string());
+
+        let server = tokio::spawn(async move {
+            let mut seen = Vec::new();
+            let mut buf = vec![0u8; 4096];
+            for reply in ["first", "second"] {
+                let read = server.read(&mut buf).await.unwrap();
+                seen.push(String::from_utf8_lossy(&buf[..read]).to_string());
+                let response = format!("HTTP/1.1 200 OK\r\nContent-Length: {}\r\n\r\n{}", reply.len(), reply);
+                server.write_all(response.as_bytes()).await.unwrap();
+            }
+            // The data channel starts right behind the last response
+            server.write_all(b"\x01binary").await.unwrap();
+            seen
+        });
+
+        let first = connection.post("/vpnsvc/connect.cgi", "image/jpeg", b"VPNCONNECT").await.unwrap();
+        assert!(first.is_success());
+        assert_eq!(&first.body()[..], b"first");
+        let second = connection.post("/vpnsvc/vpn.cgi", "application/octet-stream", b"pack").await.unwrap();
+        assert_eq!(&second.body()[..], b"second");
+        assert_eq!(connection.requests(), 2);
+
+        let seen = server.await.unwrap();
+        assert!(seen[0].starts_with("POST /vpnsvc/connect.cgi HTTP/1.1\r\nHost: vpn.example.com\r\n"));
+        assert!(seen[0].ends_with("\r\n\r\nVPNCONNECT"));
+
+        let (mut stream, mut leftover) = connection.into_parts();
+        while leftover.len() < 7 {
+            stream.read_buf(&mut leftover).await.unwrap();
+        }
+        assert_eq!(&leftover[..], b"\x01binary");
+    }
+
+    #[tokio::test]
+    async fn test_connection_close_and_oversized_bodies() {
+        let (client, mut server) = tokio::io::duplex(4096);
+        let addr: SocketAddr = "127.0.0.1:443".parse().unwrap();
+        let mut connection = SessionConnection::from_stream(client, addr, "127.0.0.1".to_string());
+
+        tokio::spawn(async move {
+            let mut buf = vec![0u8; 1024];
+            let _ = server.read(&mut buf).await.unwrap();
+            server.write_all(b"HTTP/1.1 403 Forbidden\r\nConnection: close\r\nContent-Length: 0\r\n\r\n").await.unwrap();
+        });
+
+        let response = connection.post("/vpnsvc/connect.cgi", "image/jpeg", b"x").await.unwrap();
+        assert_eq!(response.status(), 403);
+        assert!(!response.is_success());
+        assert!(connection.is_closed());
+        assert!(connection.post("/vpnsvc/connect.cgi", "image/jpeg", b"x").await.is_err());
+
+        let (client, mut server) = tokio::io::duplex(4096);
+        let mut connection = SessionConnection::from_stream(client, addr, "127.0.0.1".to_string());
+        tokio::spawn(async move {
+            let mut buf = vec![0u8; 1024];
+            let _ = server.read(&mut buf).await.unwrap();
+            server.write_all(b"HTTP/1.1 200 OK\r\nContent-Length: 999999999\r\n\r\n").await.unwrap();
+        });
+        assert!(connection.post("/vpnsvc/connect.cgi", "image/jpeg", b"x").await.is_err());
+    }
+}
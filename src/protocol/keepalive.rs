@@ -0,0 +1,391 @@
+//! Keepalive scheduling on one process-wide timer wheel
+//!
+//! Every session registers a [`KeepaliveTimer`] with the shared
+//! [`KeepaliveScheduler`] instead of running an `interval` of its own. A
+//! keepalive falls due only after the session has been idle for its interval:
+//! traffic calls [`KeepaliveTimer::touch`], which just stores a timestamp, and
+//! when the timer expires the scheduler re-arms it for the rest of the idle
+//! interval instead of firing. A busy session therefore sends no keepalives
+//! and costs at most one wheel hop per interval.
+//!
+//! The wheel is driven by a single thread that sleeps until the next expiry,
+//! so a process with many idle sessions wakes once per deadline rather than
+//! once per session per interval.
+
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Condvar, Mutex, OnceLock, Weak};
+use std::time::{Duration, Instant};
+
+/// Scheduler resolution
+pub const TICK: Duration = Duration::from_millis(10);
+
+/// Slots per wheel level, as a power of two
+const LEVEL_BITS: u32 = 6;
+const LEVEL_SLOTS: usize = 1 << LEVEL_BITS;
+
+/// Levels in the wheel; deadlines beyond `64^4` ticks (about 46 h) are clamped
+const LEVELS: usize = 4;
+
+/// Hierarchical timer wheel
+///
+/// Level `l` has 64 slots of `64^l` ticks each. An entry sits on the lowest
+/// level whose span covers its deadline and is moved down a level each time
+/// the wheel reaches its slot, until it expires from level 0. Inserting and
+/// expiring are O(1) per entry; each entry is cascaded at most `LEVELS - 1`
+/// times.
+pub struct TimerWheel<T> {
+    levels: Vec<Vec<Vec<(u64, T)>>>,
+    now: u64,
+    len: usize,
+}
+
+impl<T> TimerWheel<T> {
+    pub fn new() -> Self {
+        Self {
+            levels: (0..LEVELS).map(|_| (0..LEVEL_SLOTS).map(|_| Vec::new()).collect()).collect(),
+            now: 0,
+            len: 0,
+        }
+    }
+
+    /// Current tick
+    pub fn now(&self) -> u64 {
+        self.now
+    }
+
+    /// Number of pending entries
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    /// Expire `value` at tick `deadline`, or at the next tick if that has passed
+    pub fn insert(&mut self, deadline: u64, value: T) {
+        let max = self.now + (1u64 << (LEVEL_BITS * LEVELS as u32)) - 1;
+        let deadline = deadline.clamp(self.now + 1, max);
+        self.len += 1;
+        self.place(deadline, value);
+    }
+
+    fn place(&mut self, deadline: u64, value: T) {
+        // The highest 6-bit group in which the deadline differs from now;
+        // a deadline cascaded down at its own tick goes to level 0. Past the
+        // top group it still lies within one turn of the top level, which
+        // `insert` guarantees by clamping
+        let differs = 63 - ((self.now ^ deadline) | 1).leading_zeros();
+        let level = ((differs / LEVEL_BITS) as usize).min(LEVELS - 1);
+        let slot = (deadline >> (LEVEL_BITS * level as u32)) as usize & (LEVEL_SLOTS - 1);
+        self.levels[level][slot].push((deadline, value));
+    }
+
+    /// Advance to tick `now`, appending everything that expired to `due`
+    pub fn advance_to(&mut self, now: u64, due: &mut Vec<T>) {
+        while self.now < now {
+            if self.is_empty() {
+                self.now = now;
+                return;
+            }
+            self.now += 1;
+            // Cascade from the top so entries land on the level they now belong to
+            for level in (1..LEVELS).rev() {
+                let shift = LEVEL_BITS * level as u32;
+                if self.now & ((1 << shift) - 1) == 0 {
+                    let slot = (self.now >> shift) as usize & (LEVEL_SLOTS - 1);
+                    for (deadline, value) in std::mem::take(&mut self.levels[level][slot]) {
+                        self.place(deadline, value);
+                    }
+                }
+            }
+            let slot = self.now as usize & (LEVEL_SLOTS - 1);
+            let expired = &mut self.levels[0][slot];
+            self.len -= expired.len();
+            due.extend(expired.drain(..).map(|(_, value)| value));
+        }
+    }
+
+    /// Tick of the next expiry or cascade, if anything is pending
+    ///
+    /// Sleeping until then and calling [`advance_to`](Self::advance_to)
+    /// never misses a deadline.
+    pub fn next_event(&self) -> Option<u64> {
+        if self.is_empty() {
+            return None;
+        }
+        let mut next: Option<u64> = None;
+        for (level, slots) in self.levels.iter().enumerate() {
+            let shift = LEVEL_BITS * level as u32;
+            let current = self.now >> shift;
+            // The first occupied slot after the current one, in wheel order
+            let ahead = (1..=LEVEL_SLOTS as u64)
+                .find(|ahead| !slots[((current + ahead) as usize) & (LEVEL_SLOTS - 1)].is_empty());
+            if let Some(ahead) = ahead {
+                let at = (current + ahead) << shift;
+                next = Some(next.map_or(at, |next| next.min(at)));
+            }
+        }
+        next
+    }
+}
+
+impl<T> Default for TimerWheel<T> {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Milliseconds since the scheduler's epoch
+fn now_millis() -> u64 {
+    static EPOCH: OnceLock<Instant> = OnceLock::new();
+    EPOCH.get_or_init(Instant::now).elapsed().as_millis() as u64
+}
+
+const TICK_MILLIS: u64 = TICK.as_millis() as u64;
+
+/// One session's keepalive deadline
+///
+/// Dropping the last handle cancels it; the scheduler forgets the timer at
+/// its next expiry.
+pub struct KeepaliveTimer {
+    interval: u64,
+    last_traffic: AtomicU64,
+    on_due: Box<dyn Fn() + Send + Sync>,
+}
+
+impl KeepaliveTimer {
+    fn new(interval: Duration, now: u64, on_due: impl Fn() + Send + Sync + 'static) -> Arc<Self> {
+        Arc::new(Self {
+            interval: (interval.as_millis() as u64).max(1),
+            last_traffic: AtomicU64::new(now),
+            on_due: Box::new(on_due),
+        })
+    }
+
+    /// Record real traffic on the session, pushing the next keepalive out
+    pub fn touch(&self) {
+        self.touch_at(now_millis());
+    }
+
+    /// [`touch`](Self::touch) at `now` milliseconds since the epoch
+    fn touch_at(&self, now: u64) {
+        self.last_traffic.store(now, Ordering::Relaxed);
+    }
+
+    /// Time since the session last sent or received anything
+    pub fn idle(&self) -> Duration {
+        Duration::from_millis(now_millis().saturating_sub(self.last_traffic.load(Ordering::Relaxed)))
+    }
+
+    /// Idle time after which a keepalive falls due
+    pub fn interval(&self) -> Duration {
+        Duration::from_millis(self.interval)
+    }
+}
+
+struct SchedulerState {
+    wheel: TimerWheel<Weak<KeepaliveTimer>>,
+    /// Scratch space for the timers each advance expires
+    expired: Vec<Weak<KeepaliveTimer>>,
+    /// Tick the driver thread sleeps until, if it is running and asleep
+    wake_at: Option<u64>,
+    driver: bool,
+}
+
+impl SchedulerState {
+    fn new() -> Self {
+        Self { wheel: TimerWheel::new(), expired: Vec::new(), wake_at: None, driver: false }
+    }
+
+    /// Put `timer` on the wheel one interval after `now`; returns its tick
+    fn arm(&mut self, timer: &Arc<KeepaliveTimer>, now: u64) -> u64 {
+        if self.wheel.is_empty() {
+            // An idle wheel is not advanced; catch it up before inserting
+            self.wheel.advance_to(now / TICK_MILLIS, &mut Vec::new());
+        }
+        let deadline = (now + timer.interval).div_ceil(TICK_MILLIS);
+        self.wheel.insert(deadline, Arc::downgrade(timer));
+        deadline
+    }
+
+    /// Advance to `now`, re-arming every live timer that expired and adding
+    /// those idle for their whole interval to `fired`
+    fn expire(&mut self, now: u64, fired: &mut Vec<Arc<KeepaliveTimer>>) {
+        self.wheel.advance_to(now / TICK_MILLIS, &mut self.expired);
+        for timer in self.expired.drain(..).filter_map(|timer| timer.upgrade()) {
+            let idle = now.saturating_sub(timer.last_traffic.load(Ordering::Relaxed));
+            let next = if idle >= timer.interval {
+                timer.last_traffic.store(now, Ordering::Relaxed);
+                now + timer.interval
+            } else {
+                // Traffic since the timer was armed: wait out the rest
+                now + timer.interval - idle
+            };
+            self.wheel.insert(next.div_ceil(TICK_MILLIS), Arc::downgrade(&timer));
+            if idle >= timer.interval {
+                fired.push(timer);
+            }
+        }
+    }
+}
+
+/// Process-wide keepalive scheduler
+pub struct KeepaliveScheduler {
+    state: Mutex<SchedulerState>,
+    wake: Condvar,
+}
+
+impl KeepaliveScheduler {
+    /// The scheduler every client and engine session shares
+    pub fn shared() -> &'static Self {
+        static SHARED: OnceLock<KeepaliveScheduler> = OnceLock::new();
+        SHARED.get_or_init(|| Self {
+            state: Mutex::new(SchedulerState::new()),
+            wake: Condvar::new(),
+        })
+    }
+
+    /// Call `on_due` whenever the session has been idle for `interval`
+    ///
+    /// `on_due` runs on the scheduler thread and must not block: notify or
+    /// spawn the task that sends the keepalive. The timer counts the
+    /// keepalive itself as traffic, so the next one is a full interval later.
+    pub fn register(&'static self, interval: Duration, on_due: impl Fn() + Send + Sync + 'static) -> Arc<KeepaliveTimer> {
+        let now = now_millis();
+        let timer = KeepaliveTimer::new(interval, now, on_due);
+
+        let mut state = self.state.lock().unwrap();
+        let deadline = state.arm(&timer, now);
+        if !state.driver {
+            state.driver = true;
+            std::thread::Builder::new()
+                .name("rvpnse-keepalive".to_string())
+                .spawn(move || self.drive())
+                .expect("spawn keepalive scheduler thread");
+        } else if state.wake_at.is_some_and(|wake_at| deadline < wake_at) {
+            self.wake.notify_one();
+        }
+        timer
+    }
+
+    /// Number of timers on the wheel, including dropped ones not yet expired
+    pub fn pending(&self) -> usize {
+        self.state.lock().unwrap().wheel.len()
+    }
+
+    fn drive(&self) {
+        let mut fired = Vec::new();
+        let mut state = self.state.lock().unwrap();
+        loop {
+            let now = now_millis();
+            state.expire(now, &mut fired);
+
+            if !fired.is_empty() {
+                drop(state);
+                for timer in fired.drain(..) {
+                    (timer.on_due)();
+                }
+                state = self.state.lock().unwrap();
+                continue;
+            }
+
+            state.wake_at = state.wheel.next_event();
+            state = match state.wake_at {
+                Some(wake_at) => {
+                    let sleep = Duration::from_millis((wake_at * TICK_MILLIS).saturating_sub(now));
+                    self.wake.wait_timeout(state, sleep).unwrap().0
+                }
+                None => self.wake.wait(state).unwrap(),
+            };
+            state.wake_at = None;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_timer_wheel_expires_on_time_across_levels() {
+        let mut wheel = TimerWheel::new();
+        let deadlines = [1, 63, 64, 65, 4095, 4096, 4097, 300_000];
+        for &deadline in &deadlines {
+            wheel.insert(deadline, deadline);
+        }
+
+        // Jump from event to event as the scheduler thread does
+        let mut fired = Vec::new();
+        while let Some(next) = wheel.next_event() {
+            let mut due = Vec::new();
+            wheel.advance_to(next, &mut due);
+            fired.extend(due.into_iter().map(|deadline| (wheel.now(), deadline)));
+        }
+        assert_eq!(fired, deadlines.map(|deadline| (deadline, deadline)));
+        assert!(wheel.is_empty());
+    }
+
+    #[test]
+    fn test_timer_wheel_crosses_top_level_boundary() {
+        let top = 1u64 << (LEVEL_BITS * LEVELS as u32);
+        let mut wheel = TimerWheel::new();
+        wheel.advance_to(top - 3, &mut Vec::new());
+
+        // These differ from now above the top 6-bit group
+        let now = wheel.now();
+        let deadlines = [top - 1, top, top + 1, top + 64, top + 4097, now + top - 1];
+        for &deadline in &deadlines {
+            wheel.insert(deadline, deadline);
+        }
+        // Clamped to the last tick the wheel can hold
+        wheel.insert(now + 2 * top, now + top - 1);
+
+        let mut fired = Vec::new();
+        while let Some(next) = wheel.next_event() {
+            let mut due = Vec::new();
+            wheel.advance_to(next, &mut due);
+            fired.extend(due.into_iter().map(|deadline| (wheel.now(), deadline)));
+        }
+        let mut expected: Vec<_> = deadlines.iter().map(|&deadline| (deadline, deadline)).collect();
+        expected.push((now + top - 1, now + top - 1));
+        assert_eq!(fired, expected);
+        assert!(wheel.is_empty());
+    }
+
+    #[test]
+    fn test_keepalive_suppressed_while_traffic_flows() {
+        // Driven by an explicit clock, in milliseconds since the epoch
+        let mut state = SchedulerState::new();
+        let timer = KeepaliveTimer::new(Duration::from_millis(100), 0, || {});
+        assert_eq!(state.arm(&timer, 0), 100 / TICK_MILLIS);
+        let mut fired = Vec::new();
+
+        // Traffic every 10 ms keeps pushing the keepalive out
+        for now in (10..=300).step_by(10) {
+            timer.touch_at(now);
+            state.expire(now, &mut fired);
+            assert!(fired.is_empty());
+        }
+
+        // Once idle, it fires one interval after the last traffic
+        state.expire(399, &mut fired);
+        assert!(fired.is_empty());
+        state.expire(400, &mut fired);
+        assert_eq!(fired.len(), 1);
+        fired.clear();
+
+        // The keepalive counts as traffic, so the next is a full interval later
+        state.expire(499, &mut fired);
+        assert!(fired.is_empty());
+        state.expire(500, &mut fired);
+        assert_eq!(fired.len(), 1);
+        fired.clear();
+
+        // A dropped timer never fires again and leaves the wheel
+        drop(timer);
+        state.expire(1_000, &mut fired);
+        assert!(fired.is_empty());
+        assert!(state.wheel.is_empty());
+    }
+}
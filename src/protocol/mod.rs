@@ -5,15 +5,20 @@ use std::net::SocketAddr;
 
 pub mod auth;
 pub mod session;
+pub mod keepalive;
 pub mod watermark;
 pub mod pack;
+pub mod pack_view;
 pub mod binary;
+pub mod connection;
 
 // Re-export main types
 pub use auth::AuthClient;
 pub use pack::{Pack, Element, Value, ElementType};
+pub use pack_view::{PackView, ValueView};
 pub use watermark::{WatermarkClient, WatermarkResponse, SOFTETHER_WATERMARK};
 pub use binary::BinaryProtocolClient;
+pub use connection::{HttpResponse, SessionConnection, SharedConnection};
 
 // Protocol constants
 pub mod constants {
@@ -41,7 +46,12 @@ pub struct ProtocolHandler {
 impl ProtocolHandler {
     /// Create a new protocol handler
     pub fn new(server_addr: SocketAddr, verify_certificate: bool) -> Result<Self> {
-        let watermark_client = WatermarkClient::new(server_addr, None, verify_certificate)?;
+        Self::with_hostname(server_addr, None, verify_certificate)
+    }
+
+    /// Create a protocol handler that names the server `hostname` (SNI and `Host`)
+    pub fn with_hostname(server_addr: SocketAddr, hostname: Option<String>, verify_certificate: bool) -> Result<Self> {
+        let watermark_client = WatermarkClient::new(server_addr, hostname, verify_certificate)?;
         
         Ok(ProtocolHandler {
             server_addr,
@@ -57,11 +67,15 @@ impl ProtocolHandler {
     }
 
     /// Establish VPN session using HTTP watermark handshake
+    ///
+    /// Opens the session connection; authentication and the data channel
+    /// continue on it (see [`Self::connection`]).
     pub async fn establish_session(&mut self) -> Result<()> {
-        let watermark_client = self.watermark_client.as_ref().ok_or_else(|| {
+        let watermark_client = self.watermark_client.as_mut().ok_or_else(|| {
             VpnError::Protocol("Watermark client not initialized".to_string())
         })?;
 
+        watermark_client.open_connection().await?;
         let response = watermark_client.send_watermark_handshake().await?;
         
         if response.is_session_established() {
@@ -74,6 +88,11 @@ impl ProtocolHandler {
         }
     }
 
+    /// Connection the session was established on
+    pub fn connection(&self) -> Option<SharedConnection> {
+        self.watermark_client.as_ref().and_then(WatermarkClient::connection)
+    }
+
     /// Check if session is established
     pub fn has_session(&self) -> bool {
         self.session_established
@@ -98,29 +117,19 @@ impl ProtocolHandler {
         let pack_data = pack.to_bytes()?;
 
         // Send via HTTP POST with binary PACK data
-        let response = watermark_client.http_client
-            .post(&format!("{}{}", watermark_client.base_url, constants::WATERMARK_ENDPOINT))
-            .header("Content-Type", constants::HTTP_CONTENT_TYPE_PACK)
-            .header("Connection", "Keep-Alive")
-            .header("Keep-Alive", constants::HTTP_KEEP_ALIVE)
-            .body(pack_data.to_vec())
-            .send()
+        let response = watermark_client
+            .post(constants::WATERMARK_ENDPOINT, constants::HTTP_CONTENT_TYPE_PACK, pack_data)
             .await
             .map_err(|e| VpnError::Network(format!("PACK send failed: {}", e)))?;
 
-        if !response.status().is_success() {
+        if !response.is_success() {
             return Err(VpnError::Protocol(format!(
                 "PACK communication failed: HTTP {}",
                 response.status()
             )));
         }
 
-        // Read and parse response PACK
-        let response_bytes = response.bytes().await.map_err(|e| {
-            VpnError::Network(format!("Failed to read PACK response: {}", e))
-        })?;
-
-        Pack::from_bytes(response_bytes)
+        Pack::from_bytes(response.into_body())
     }
 
     /// Create a data PACK for VPN communication
@@ -5,7 +5,8 @@
 //! proprietary binary serialization format for key-value data structures.
 
 use crate::error::{Result, VpnError};
-use bytes::{Buf, BufMut, Bytes, BytesMut};
+use super::pack_view::PackView;
+use bytes::{BufMut, Bytes, BytesMut};
 use std::collections::HashMap;
 use std::net::{IpAddr, Ipv4Addr, Ipv6Addr};
 
@@ -19,13 +20,9 @@ pub struct IpConfiguration {
 }
 
 /// Check if 4 bytes could represent a valid IP address
-fn is_valid_ip_bytes(bytes: &[u8]) -> bool {
-    if bytes.len() != 4 {
-        return false;
-    }
-    
+fn is_valid_ip_bytes(bytes: [u8; 4]) -> bool {
     // Reject clearly invalid patterns
-    if bytes.iter().all(|&b| b == 0) || bytes.iter().all(|&b| b == 255) {
+    if bytes == [0; 4] || bytes == [255; 4] {
         return false;
     }
     
@@ -39,6 +36,158 @@ fn is_valid_ip_bytes(bytes: &[u8]) -> bool {
     }
 }
 
+/// How likely `bytes` is to be a VPN-assigned address; `None` if not at all
+fn vpn_priority(bytes: [u8; 4]) -> Option<u8> {
+    if !is_valid_ip_bytes(bytes) {
+        return None;
+    }
+    let [a, b, c, d] = bytes;
+    let priority = match a {
+        // 10.251.x.x is a very specific VPN server range
+        10 if b == 251 => 100,
+        10 if b == 21 && c == 255 => 90,
+        // High 10.x ranges are likely VPN assigned
+        10 if b >= 200 => 80,
+        10 if b >= 100 => 60,
+        10 if b > 0 => 40,
+        192 if b == 168 => 30,
+        172 if (16..=31).contains(&b) => 35,
+        // Often used for VPN (including CGNAT space)
+        100..=127 => 70,
+        // High public ranges that might be VPN endpoints
+        208..=223 => 50,
+        10 => return None,
+        _ if b > 10 && c > 10 && d > 10 && d < 250 => 25,
+        _ => return None,
+    };
+    Some(priority)
+}
+
+/// Highest [`vpn_priority`]; nothing found later can beat it
+const TOP_PRIORITY: u8 = 100;
+
+/// Highest [`vpn_priority`] an address with each first byte can have
+///
+/// Lets the scan skip windows that can't beat the best address so far
+/// without decoding them.
+const PRIORITY_CEILING: [u8; 256] = {
+    let mut ceiling = [0u8; 256];
+    let mut a = 1;
+    while a <= 223 {
+        ceiling[a] = match a {
+            10 => TOP_PRIORITY,
+            100..=127 => 70,
+            208..=223 => 50,
+            172 => 35,
+            192 => 30,
+            _ => 25,
+        };
+        a += 1;
+    }
+    ceiling
+};
+
+/// IPv4 assignment found in binary session data
+///
+/// Plain addresses rather than strings, so scanning allocates nothing;
+/// convert to an [`IpConfiguration`] where one is needed.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct IpAssignment {
+    pub local_ip: Ipv4Addr,
+    pub gateway_ip: Ipv4Addr,
+    pub netmask: Ipv4Addr,
+    /// Where `local_ip` starts in the session data
+    pub offset: usize,
+}
+
+impl IpAssignment {
+    fn new(offset: usize, local: [u8; 4], gateway: [u8; 4]) -> Self {
+        Self {
+            local_ip: Ipv4Addr::from(local),
+            gateway_ip: Ipv4Addr::from(gateway),
+            netmask: Ipv4Addr::new(255, 255, 255, 0),
+            offset,
+        }
+    }
+
+    /// Most likely VPN assignment among every 4-byte window of `data`
+    ///
+    /// One pass, stopping early at a top-priority address. Ties go to the
+    /// earliest address. The gateway is taken to be .1 of the address's /24.
+    pub fn scan(data: &[u8]) -> Option<Self> {
+        let mut best_priority = 0;
+        let mut best = None;
+        for (offset, window) in data.windows(4).enumerate() {
+            if PRIORITY_CEILING[window[0] as usize] <= best_priority {
+                continue;
+            }
+            let bytes: [u8; 4] = window.try_into().unwrap();
+            match vpn_priority(bytes) {
+                Some(priority) if priority > best_priority => {
+                    best_priority = priority;
+                    best = Some(offset);
+                    if priority == TOP_PRIORITY {
+                        break;
+                    }
+                }
+                _ => {}
+            }
+        }
+        let offset = best?;
+        let [a, b, c, d] = data[offset..offset + 4].try_into().unwrap();
+        Some(Self::new(offset, [a, b, c, d], [a, b, c, 1]))
+    }
+
+    /// First 10.21.255.x address in `data`, else the first 10.x.x.x one
+    ///
+    /// Only windows starting with a 10 byte are looked at. A 10.21.255.x
+    /// address gets the address below it as gateway, any other 10.0.0.1.
+    pub fn scan_ten_net(data: &[u8]) -> Option<Self> {
+        let mut first = None;
+        let mut from = 0;
+        while let Some(found) = data[from..].iter().position(|&b| b == 10) {
+            let offset = from + found;
+            from = offset + 1;
+            let Some(window) = data.get(offset..offset + 4) else { break };
+            let bytes: [u8; 4] = window.try_into().unwrap();
+            if bytes[1] == 21 && bytes[2] == 255 {
+                let gateway = bytes[3].saturating_sub(1).max(1);
+                return Some(Self::new(offset, bytes, [10, 21, 255, gateway]));
+            }
+            first.get_or_insert(Self::new(offset, bytes, [10, 0, 0, 1]));
+        }
+        first
+    }
+}
+
+impl From<IpAssignment> for IpConfiguration {
+    fn from(assignment: IpAssignment) -> Self {
+        Self {
+            local_ip: assignment.local_ip.to_string(),
+            gateway_ip: assignment.gateway_ip.to_string(),
+            netmask: assignment.netmask.to_string(),
+            source: "binary_session_data".to_string(),
+        }
+    }
+}
+
+/// Hex dump of `data`, 16 bytes to a line
+fn hex_dump(data: &[u8]) -> String {
+    use std::fmt::Write;
+
+    let mut out = String::with_capacity(data.len() * 3 + data.len() / 16 * 8);
+    for (i, b) in data.iter().enumerate() {
+        let _ = if i % 16 == 0 {
+            write!(out, "\n{:04x}: {:02x}", i, b)
+        } else if i % 8 == 0 {
+            write!(out, "  {:02x}", b)
+        } else {
+            write!(out, " {:02x}", b)
+        };
+    }
+    out
+}
+
 /// PACK element types (from SoftEther VPN source)
 #[derive(Debug, Clone, Copy, PartialEq)]
 #[repr(u32)]
@@ -115,6 +264,32 @@ impl Value {
         }
     }
 
+    /// Length of the serialized value, without its length prefix
+    pub fn encoded_len(&self) -> usize {
+        match self {
+            Value::Int(_) => 4,
+            Value::Int64(_) => 8,
+            Value::Data(data) => data.len(),
+            Value::Str(s) => s.len(),
+            Value::UniStr(s) => s.encode_utf16().count() * 2,
+        }
+    }
+
+    /// Serialize the value straight into `buf`
+    pub fn write_to(&self, buf: &mut BytesMut) {
+        match self {
+            Value::Int(i) => buf.put_u32(*i),
+            Value::Int64(i) => buf.put_u64(*i),
+            Value::Data(data) => buf.put_slice(data),
+            Value::Str(s) => buf.put_slice(s.as_bytes()),
+            Value::UniStr(s) => {
+                for code_unit in s.encode_utf16() {
+                    buf.put_u16_le(code_unit);
+                }
+            }
+        }
+    }
+
     /// Deserialize value from bytes
     pub fn from_bytes(element_type: ElementType, data: &[u8]) -> Result<Self> {
         match element_type {
@@ -199,6 +374,13 @@ impl Element {
         Ok(element_type)
     }
     
+    /// Length of the serialized element
+    pub fn encoded_len(&self) -> usize {
+        // Name length, name, null terminator, type, value count
+        let header = 4 + self.name.len() + 1 + 4 + 4;
+        header + self.values.iter().map(|v| 4 + v.encoded_len()).sum::<usize>()
+    }
+
     /// Get all data values from this element
     pub fn get_data_values(&self) -> Vec<&Vec<u8>> {
         self.values.iter().filter_map(|v| match v {
@@ -323,27 +505,46 @@ impl Pack {
     }
 
     /// Get all elements as a HashMap for easy iteration
-    pub fn get_elements(&self) -> std::collections::HashMap<String, &Element> {
-        self.elements.iter().map(|e| (e.name.clone(), e)).collect()
+    pub fn get_elements(&self) -> HashMap<&str, &Element> {
+        self.elements.iter().map(|e| (e.name.as_str(), e)).collect()
+    }
+
+    /// Exact length of [`to_bytes`](Self::to_bytes) output
+    pub fn encoded_len(&self) -> usize {
+        4 + self.elements.iter().map(Element::encoded_len).sum::<usize>()
     }
 
     /// Serialize PACK to binary format (compatible with SoftEther)
     pub fn to_bytes(&self) -> Result<Bytes> {
-        let mut buf = BytesMut::new();
+        let mut buf = BytesMut::with_capacity(self.encoded_len());
+        self.encode_into(&mut buf)?;
+        Ok(buf.freeze())
+    }
+
+    /// Append the serialized PACK to `buf`, growing it at most once
+    ///
+    /// Lets callers keep one buffer across requests. On error `buf` is left
+    /// as it was.
+    pub fn encode_into(&self, buf: &mut BytesMut) -> Result<()> {
+        let start = buf.len();
+        buf.reserve(self.encoded_len());
 
         // Write number of elements (4 bytes, big-endian - SoftEther format)
         buf.put_u32(self.elements.len() as u32);
 
         // Write each element
         for element in &self.elements {
-            self.write_element(&mut buf, element)?;
+            if let Err(e) = Self::write_element(buf, element) {
+                buf.truncate(start);
+                return Err(e);
+            }
         }
 
-        Ok(buf.freeze())
+        Ok(())
     }
 
     /// Write a single element to the buffer
-    fn write_element(&self, buf: &mut BytesMut, element: &Element) -> Result<()> {
+    fn write_element(buf: &mut BytesMut, element: &Element) -> Result<()> {
         let element_type = element.element_type()?;
 
         // Write element name length and name (with null terminator, big-endian)
@@ -360,266 +561,22 @@ impl Pack {
 
         // Write each value
         for value in &element.values {
-            let value_bytes = value.to_bytes();
-            buf.put_u32(value_bytes.len() as u32); // value length (big-endian)
-            buf.put_slice(&value_bytes);
+            buf.put_u32(value.encoded_len() as u32); // value length (big-endian)
+            value.write_to(buf);
         }
 
         Ok(())
     }
 
     /// Deserialize PACK from binary format
-    pub fn from_bytes(mut data: Bytes) -> Result<Self> {
-        log::debug!("Parsing PACK from {} bytes", data.len());
-        log::debug!("Raw bytes (first 64): {:?}", &data[..std::cmp::min(64, data.len())]);
-        
-        // Let's examine the entire PACK structure first
-        if data.len() >= 16 {
-            log::debug!("Detailed byte analysis:");
-            log::debug!("Bytes 0-3 (num elements): {:?} = {}", &data[0..4], u32::from_be_bytes([data[0], data[1], data[2], data[3]]));
-            log::debug!("Bytes 4-7 (first name len): {:?} = {}", &data[4..8], u32::from_be_bytes([data[4], data[5], data[6], data[7]]));
-            if data.len() >= 32 {
-                log::debug!("Bytes 8-31: {:?}", &data[8..32]);
-            }
-        }
-        
-        let original_len = data.len();
-        
-        if data.len() < 4 {
-            return Err(VpnError::Protocol("PACK data too short".to_string()));
-        }
-
-        // Read number of elements (SoftEther uses big-endian)
-        let num_elements = data.get_u32();
-        log::debug!("PACK contains {} elements (big-endian), consumed 4 bytes, {} remaining", num_elements, data.len());
-        
-        // Sanity check: element count shouldn't be too large
-        if num_elements > 10000 {
-            return Err(VpnError::Protocol(format!("Element count {} seems too large", num_elements)));
-        }
-        
-        let mut elements = Vec::with_capacity(num_elements as usize);
-
-        // Read each element with graceful error handling for SoftEther's mixed PACK + binary format
-        for i in 0..num_elements {
-            let bytes_before = data.len();
-            log::debug!("Parsing element {} of {}, bytes remaining before element: {}", 
-                       i + 1, num_elements, data.len());
-        
-            // Add detailed hex dump of the next 16 bytes for debugging
-            if data.len() >= 16 {
-                let debug_bytes = &data[..16];
-                log::debug!("Next 16 bytes at element start: {:02x?}", debug_bytes);
-            }
-            
-            // Check if we're dealing with binary session data (common in SoftEther auth responses)
-            // Look ahead at the element type to see if it's a valid PACK type (0-4)
-            if data.len() >= 8 {
-                // Skip name length and name to get to element type
-                let name_len = u32::from_be_bytes([data[0], data[1], data[2], data[3]]) as usize;
-                let bytes_to_skip = 4 + ((name_len + 3) & !3); // name length + padded name
-                
-                if data.len() > bytes_to_skip + 4 {
-                    let element_type_raw = u32::from_be_bytes([
-                        data[bytes_to_skip], 
-                        data[bytes_to_skip + 1], 
-                        data[bytes_to_skip + 2], 
-                        data[bytes_to_skip + 3]
-                    ]);
-                    
-                    // If element type is way out of range (0-4), this is likely binary session data
-                    if element_type_raw > 10000 {
-                        log::info!("🔍 Detected binary session data at element {} (type {}), capturing remaining {} bytes", 
-                                  i + 1, element_type_raw, data.len());
-                        break;
-                    }
-                }
-            }
-            
-            // Try to parse element
-            match Self::read_element(&mut data) {
-                Ok(element) => {
-                    let bytes_after = data.len();
-                    log::debug!("Parsed element: name={}, values={}, consumed {} bytes", 
-                               element.name, element.values.len(), bytes_before - bytes_after);
-                    elements.push(element);
-
-                    // After parsing first element, show what's next for debugging
-                    if i == 0 && data.len() >= 16 {
-                        log::debug!("After first element: {} bytes remaining", data.len());
-                        log::debug!("Next 16 bytes after first element: {:02x?}", &data[..16]);
-                    }
-                }
-                Err(e) => {
-                    // In SoftEther authentication responses, it's normal for later elements to contain
-                    // binary session data that doesn't conform to PACK format
-                    log::info!("🔍 Element {} parsing failed (likely binary data): {}", i + 1, e);
-                    log::info!("🔍 Successfully parsed {} of {} elements, capturing remaining {} bytes as binary session data", 
-                              i, num_elements, data.len());
-                    break;
-                }
-            }
-        }
-
-        log::debug!("Successfully parsed PACK with {} elements", elements.len());
-        
-        // Capture any remaining binary session data 
-        let binary_session_data = if data.is_empty() {
-            None
-        } else {
-            log::info!("🔍 Captured {} bytes of binary session data after PACK parsing", data.len());
-            Some(data.clone())
-        };
-        
-        Ok(Self { 
-            elements,
-            binary_session_data,
-        })
-    }
-
-    /// Read a single element from the buffer
-    fn read_element(data: &mut Bytes) -> Result<Element> {
-        let bytes_before = data.len();
-        let _original_len = bytes_before; // For offset calculation
-        
-        if data.len() < 4 {
-            return Err(VpnError::Protocol("Not enough data for element name length".to_string()));
-        }
-
-        // Read element name length (big-endian, includes null terminator)
-        let name_len_raw = data.get_u32();
-        log::debug!("Element name length raw: {} (includes null terminator), consumed 4 bytes, {} remaining", name_len_raw, data.len());
-        
-        // Safety check: reject unreasonably large name lengths
-        if name_len_raw > 1000 { // 1KB limit for element names
-            return Err(VpnError::Protocol(format!("Element name length {} is unreasonably large", name_len_raw)));
-        }
-        
-        let name_len = name_len_raw as usize;
-        
-        if name_len == 0 {
-            return Err(VpnError::Protocol("Element name length is zero".to_string()));
-        }
-        
-        if data.len() < name_len {
-            return Err(VpnError::Protocol("Not enough data for element name".to_string()));
-        }
-
-        // Read element name (SoftEther format: length includes +1 for null, but data doesn't include null)
-        let name_bytes = data.copy_to_bytes(name_len);
-        // SoftEther string format: length includes +1 for null terminator, but actual data is just the string
-        let actual_name_len = name_len.saturating_sub(1);
-        let name = String::from_utf8(name_bytes[..actual_name_len].to_vec())
-            .map_err(|_| VpnError::Protocol("Invalid element name UTF-8".to_string()))?;
-        log::debug!("Element name: '{}', consumed {} bytes, {} remaining", name, name_len, data.len());
-        
-        // SoftEther PACK format: element name data is padded to 4-byte boundary
-        // We need to pad just the name data (not including the length field)
-        let padded_name_len = (name_len + 3) & !3; // Round name_len up to 4-byte boundary
-        let padding_needed = padded_name_len - name_len;
-        
-        if padding_needed > 0 && data.len() >= padding_needed {
-            let padding = data.copy_to_bytes(padding_needed);
-            log::debug!("Skipped {} name padding bytes: {:?}, {} remaining", padding_needed, padding, data.len());
-        }
-        
-        // Additional alignment: SoftEther appears to need one more byte alignment after string padding
-        // Based on the binary analysis, there's an extra 0x00 byte that we need to skip
-        if data.len() > 0 && data[0] == 0 {
-            let extra_byte = data.get_u8();
-            log::debug!("Skipped extra alignment byte: 0x{:02x}, {} remaining", extra_byte, data.len());
-        }
-        
-        log::debug!("After name + padding, next 12 bytes: {:?}", &data[..std::cmp::min(12, data.len())]);
-
-        if data.len() < 8 {
-            return Err(VpnError::Protocol("Not enough data for element type and value count".to_string()));
-        }
-
-        // Read element type (big-endian)
-        log::debug!("About to read element type, next 12 bytes: {:?}", 
-                   &data[..std::cmp::min(12, data.len())]);
-        log::debug!("Element type raw bytes (hex): {:02x} {:02x} {:02x} {:02x}", 
-                   data[0], data[1], data[2], data[3]);
-        let element_type_raw = data.get_u32();
-        log::debug!("Element type raw: {} (0x{:08x}), consumed 4 bytes, {} remaining", 
-                   element_type_raw, element_type_raw, data.len());
-        
-        // Convert to decimal to see what we're getting
-        log::debug!("Expected element type range: 0-4, got: {}", element_type_raw);
-        
-        let element_type = ElementType::try_from(element_type_raw)?;
-        log::debug!("Element type: {:?}", element_type);
-
-        // Read number of values (big-endian)
-        log::debug!("About to read num values, next 8 bytes: {:?}", 
-                   &data[..std::cmp::min(8, data.len())]);
-        let num_values_raw = data.get_u32();
-        log::debug!("Number of values raw: {}, consumed 4 bytes, {} remaining", num_values_raw, data.len());
-        let num_values = num_values_raw as usize;
-        log::debug!("Number of values: {}", num_values);
-        
-        let mut values = Vec::with_capacity(num_values);
-
-        // Read each value
-        for j in 0..num_values {
-            if data.len() < 4 {
-                return Err(VpnError::Protocol("Not enough data for value length".to_string()));
-            }
-
-            let value_len_raw = data.get_u32();
-            log::debug!("Value {} length raw: {}, consumed 4 bytes, {} remaining", j, value_len_raw, data.len());
-            
-            // Safety check: reject unreasonably large values to prevent memory allocation attacks
-            if value_len_raw > 10_000_000 { // 10MB limit per value
-                log::error!("Value {} length {} is unreasonably large, likely corrupted data", j, value_len_raw);
-                return Err(VpnError::Protocol(format!("Value length {} exceeds safety limit", value_len_raw)));
-            }
-            
-            let value_len = value_len_raw as usize;
-            log::debug!("Value {} length: {}", j, value_len);
-            
-            if data.len() < value_len {
-                log::error!("Value {} claims length {} but only {} bytes remaining. Raw bytes around position: {:?}", 
-                           j, value_len, data.len(), &data[..std::cmp::min(16, data.len())]);
-                return Err(VpnError::Protocol(format!("Not enough data for value {} (need {}, have {})", j, value_len, data.len())));
-            }
-
-            let value_bytes = data.copy_to_bytes(value_len);
-            log::debug!("Value {} bytes: {:?}", j, &value_bytes[..std::cmp::min(8, value_bytes.len())]);
-            let value = Value::from_bytes(element_type, &value_bytes)?;
-            log::debug!("Value {}: {:?}, consumed {} bytes, {} remaining", j, value, value_len, data.len());
-            values.push(value);
-            
-            // SoftEther PACK format: values are padded to 4-byte boundary
-            let padded_value_len = (value_len + 3) & !3; // Round up to 4-byte boundary
-            let value_padding_needed = padded_value_len - value_len;
-            
-            if value_padding_needed > 0 && data.len() >= value_padding_needed {
-                let value_padding = data.copy_to_bytes(value_padding_needed);
-                log::debug!("Skipped {} value padding bytes: {:?}, {} remaining", value_padding_needed, value_padding, data.len());
-            }
-        }
-
-        let bytes_after = data.len();
-        log::debug!("Element '{}' parsing complete, total consumed: {} bytes", name, bytes_before - bytes_after);
-
-        // SoftEther PACK format: Try exactly 3 bytes of inter-element padding
-        // This should get us from [00, 00, 01, 00] to [00, 00, 00, ??] for the next name length
-        if data.len() >= 3 && data[0] == 0x00 && data[1] == 0x00 {
-            let padding1 = data.get_u8();
-            let padding2 = data.get_u8();
-            let padding3 = data.get_u8();
-            log::debug!("Applied 3 bytes inter-element padding: 0x{:02x} 0x{:02x} 0x{:02x}, {} remaining", 
-                       padding1, padding2, padding3, data.len());
-        }
-
-        let total_element_size = bytes_before - data.len();
-        log::debug!("Total element size with padding: {}, consumed {} bytes", total_element_size, bytes_before - data.len());
-
-        Ok(Element {
-            name,
-            values,
+    ///
+    /// Parses through [`PackView`]; the binary session data shares `data`'s
+    /// allocation.
+    pub fn from_bytes(data: Bytes) -> Result<Self> {
+        let view = PackView::parse(&data)?;
+        Ok(Self {
+            elements: view.to_elements(),
+            binary_session_data: view.binary_session_data().map(|rest| data.slice_ref(rest)),
         })
     }
 
@@ -631,72 +588,20 @@ impl Pack {
         self
     }
     
-    /// Analyze binary session data for IP configuration
-    /// SoftEther embeds IP assignments in the authentication response
+    /// Look for a 10.x.x.x address in the binary session data
+    ///
+    /// Takes the first address in 10.21.255.0/24 if there is one, else the
+    /// first 10.x.x.x address. See [`IpAssignment::scan_ten_net`].
     pub fn extract_ip_configuration(&self) -> Option<IpConfiguration> {
         let binary_data = self.binary_session_data.as_ref()?;
-        
-        log::info!("🔍 Analyzing {} bytes of binary session data for IP configuration...", binary_data.len());
-        
-        // Look for IP address patterns in the binary data
-        let mut potential_ips = Vec::new();
-        
-        // Search for 4-byte sequences that could be IPv4 addresses
-        for i in 0..binary_data.len().saturating_sub(4) {
-            let bytes = &binary_data[i..i+4];
-            
-            // Check if this could be a valid IP address
-            if is_valid_ip_bytes(bytes) {
-                let ip = format!("{}.{}.{}.{}", bytes[0], bytes[1], bytes[2], bytes[3]);
-                potential_ips.push((i, ip.clone()));
-                
-                // Check for specific ranges we expect
-                if bytes[0] == 10 && bytes[1] == 21 && bytes[2] == 255 {
-                    log::info!("🎯 Found expected IP range 10.21.255.{} at offset {}", bytes[3], i);
-                    
-                    // Look for gateway IP nearby (usually the next or previous IP)
-                    let gateway = if bytes[3] > 1 {
-                        format!("10.21.255.{}", bytes[3] - 1)
-                    } else {
-                        "10.21.255.1".to_string()
-                    };
-                    
-                    return Some(IpConfiguration {
-                        local_ip: ip,
-                        gateway_ip: gateway,
-                        netmask: "255.255.255.0".to_string(),
-                        source: "binary_session_data".to_string(),
-                    });
-                }
-                
-                // Also check for other common VPN ranges
-                if bytes[0] == 192 && bytes[1] == 168 {
-                    log::info!("🌐 Found 192.168.x.x IP: {} at offset {}", ip, i);
-                } else if bytes[0] == 10 {
-                    log::info!("🌐 Found 10.x.x.x IP: {} at offset {}", ip, i);
-                }
-            }
-        }
-        
-        log::debug!("📊 Found {} potential IP addresses in binary data", potential_ips.len());
-        for (offset, ip) in &potential_ips {
-            log::debug!("  📍 Offset {}: {}", offset, ip);
-        }
-        
-        // If we found any 10.x.x.x IPs, use the first one
-        for (_, ip) in potential_ips {
-            if ip.starts_with("10.") {
-                log::info!("🎯 Using IP from binary session data: {}", ip);
-                return Some(IpConfiguration {
-                    local_ip: ip,
-                    gateway_ip: "10.0.0.1".to_string(), // Default gateway
-                    netmask: "255.255.255.0".to_string(),
-                    source: "binary_session_data".to_string(),
-                });
-            }
-        }
-        
-        None
+        let assignment = IpAssignment::scan_ten_net(binary_data)?;
+        log::info!(
+            "🎯 Using IP {} from binary session data (offset {} of {})",
+            assignment.local_ip,
+            assignment.offset,
+            binary_data.len()
+        );
+        Some(assignment.into())
     }
 
     /// Get binary session data if available
@@ -710,145 +615,123 @@ impl Pack {
     }
 
     /// Analyze binary session data for IP addresses
+    ///
+    /// Picks the address most likely to be the VPN assignment, see
+    /// [`IpAssignment::scan`].
     pub fn analyze_for_ip_addresses(&self) -> Option<IpConfiguration> {
-        if let Some(binary_data) = &self.binary_session_data {
-            log::info!("🔍 Analyzing {} bytes of binary session data for IP addresses", binary_data.len());
-            
-            // First, dump hex of binary data for debugging
-            let hex_dump: String = binary_data.iter().enumerate()
-                .map(|(i, &b)| {
-                    if i % 16 == 0 {
-                        format!("\n{:04x}: {:02x}", i, b)
-                    } else if i % 8 == 0 {
-                        format!("  {:02x}", b)
-                    } else {
-                        format!(" {:02x}", b)
-                    }
-                })
-                .collect();
-            log::debug!("Binary session data hex dump:{}", hex_dump);
-            
-            let mut potential_ips = Vec::new();
-            
-            // Scan for 4-byte sequences that could be IP addresses
-            for i in 0..binary_data.len().saturating_sub(3) {
-                let bytes = &binary_data[i..i+4];
-                if is_valid_ip_bytes(bytes) {
-                    let ip = format!("{}.{}.{}.{}", bytes[0], bytes[1], bytes[2], bytes[3]);
-                    log::info!("🔍 Found potential IP {} at offset {} (hex: {:02x}{:02x}{:02x}{:02x})", 
-                              ip, i, bytes[0], bytes[1], bytes[2], bytes[3]);
-                    potential_ips.push((i, ip.clone(), bytes.to_vec()));
-                }
-            }
-            
-            log::info!("📊 Found {} potential IP addresses in binary data", potential_ips.len());
-            for (offset, ip, bytes) in &potential_ips {
-                log::info!("  📍 Offset {}: {} (bytes: {:?})", offset, ip, bytes);
-            }
-            
-            // Look for common VPN IP patterns and choose the best one
-            let mut best_ip = None;
-            let mut best_gateway = "10.0.0.1".to_string();
-            let mut best_priority = 0;
-            
-            for (offset, ip, bytes) in potential_ips {
-                let mut priority = 0;
-                let mut gateway = "10.0.0.1".to_string();
-                
-                // Check for specific VPN server IP ranges with priority scoring
-                match bytes[0] {
-                    10 => {
-                        // 10.x.x.x range - very common for VPN
-                        if bytes[1] == 251 {
-                            // 10.251.x.x - very specific VPN server range
-                            priority = 100;
-                            gateway = format!("10.251.{}.1", bytes[2]);
-                            log::info!("🎯 Found 10.251.x.x VPN IP (PRIORITY 100): {} at offset {}", ip, offset);
-                        } else if bytes[1] == 21 && bytes[2] == 255 {
-                            // Specific server range 10.21.255.x
-                            priority = 90;
-                            gateway = "10.21.255.1".to_string();
-                            log::info!("🎯 Found VPN server IP range 10.21.255.x (PRIORITY 90): {} at offset {}", ip, offset);
-                        } else if bytes[1] >= 200 {
-                            // High 10.x range, likely VPN assigned
-                            priority = 80;
-                            gateway = format!("10.{}.{}.1", bytes[1], bytes[2]);
-                            log::info!("🎯 Found high 10.x IP (PRIORITY 80): {} at offset {}", ip, offset);
-                        } else if bytes[1] >= 100 {
-                            // Medium 10.x range
-                            priority = 60;
-                            gateway = format!("10.{}.{}.1", bytes[1], bytes[2]);
-                            log::info!("🌐 Found medium 10.x IP (PRIORITY 60): {} at offset {}", ip, offset);
-                        } else if bytes[1] > 0 {
-                            // Any other 10.x IP as fallback
-                            priority = 40;
-                            gateway = format!("10.{}.{}.1", bytes[1], bytes[2]);
-                            log::info!("🌐 Found 10.x IP (PRIORITY 40): {} at offset {}", ip, offset);
-                        }
-                    }
-                    192 if bytes[1] == 168 => {
-                        // 192.168.x.x range
-                        priority = 30;
-                        gateway = format!("192.168.{}.1", bytes[2]);
-                        log::info!("🌐 Found 192.168.x.x IP (PRIORITY 30): {} at offset {}", ip, offset);
-                    }
-                    172 if bytes[1] >= 16 && bytes[1] <= 31 => {
-                        // 172.16-31.x.x range
-                        priority = 35;
-                        gateway = format!("172.{}.{}.1", bytes[1], bytes[2]);
-                        log::info!("🌐 Found 172.x.x.x IP (PRIORITY 35): {} at offset {}", ip, offset);
-                    }
-                    // Add support for other common VPN ranges that appeared in the data
-                    100..=127 => {
-                        // 100-127.x.x.x range - often used for VPN
-                        priority = 70;
-                        gateway = format!("{}.{}.{}.1", bytes[0], bytes[1], bytes[2]);
-                        log::info!("🎯 Found 100-127.x.x.x VPN IP (PRIORITY 70): {} at offset {}", ip, offset);
-                    }
-                    208..=223 => {
-                        // High public ranges that might be VPN endpoints
-                        priority = 50;
-                        gateway = format!("{}.{}.{}.1", bytes[0], bytes[1], bytes[2]);
-                        log::info!("🌐 Found high public IP (PRIORITY 50): {} at offset {}", ip, offset);
-                    }
-                    _ => {
-                        // For other ranges, check if they look like valid VPN assignments
-                        // Look for IPs that are likely to be VPN-assigned based on patterns
-                        if bytes[1] > 10 && bytes[2] > 10 && bytes[3] > 10 && bytes[3] < 250 {
-                            priority = 25;
-                            gateway = format!("{}.{}.{}.1", bytes[0], bytes[1], bytes[2]);
-                            log::info!("🌐 Found potential VPN IP (PRIORITY 25): {} at offset {}", ip, offset);
-                        } else {
-                            continue;
-                        }
-                    }
-                }
-                
-                // Update best IP if this one has higher priority
-                if priority > best_priority {
-                    best_ip = Some(ip.clone());
-                    best_gateway = gateway;
-                    best_priority = priority;
-                    log::info!("🏆 New best IP: {} (priority {})", ip, priority);
-                }
-            }
-            
-            if let Some(local_ip) = best_ip {
-                log::info!("🎯 Selected IP configuration from binary session data:");
-                log::info!("   Local IP: {}", local_ip);
-                log::info!("   Gateway IP: {}", best_gateway);
-                return Some(IpConfiguration {
-                    local_ip,
-                    gateway_ip: best_gateway,
-                    netmask: "255.255.255.0".to_string(),
-                    source: "binary_session_data".to_string(),
-                });
+        let Some(assignment) = self.ip_assignment() else {
+            log::warn!("⚠️ No valid IP configuration found in binary session data");
+            return None;
+        };
+        log::info!(
+            "🎯 Selected IP configuration from binary session data: local {}, gateway {} (offset {})",
+            assignment.local_ip,
+            assignment.gateway_ip,
+            assignment.offset
+        );
+        Some(assignment.into())
+    }
+
+    /// Address assignment in the binary session data, without allocating
+    pub fn ip_assignment(&self) -> Option<IpAssignment> {
+        let binary_data = self.binary_session_data.as_ref()?;
+        if log::log_enabled!(log::Level::Debug) {
+            log::debug!("Binary session data hex dump ({} bytes):{}", binary_data.len(), hex_dump(binary_data));
+        }
+        IpAssignment::scan(binary_data)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn sample_pack() -> Pack {
+        let mut pack = Pack::new();
+        pack.add_str("method", "login");
+        pack.add_unistr("hub", "VPN✓");
+        pack.add_int_array("ports", vec![443, 992]);
+        pack.add_int64("ticks", 1 << 40);
+        pack.add_data("secure_password", vec![0xaa; 20]);
+        pack
+    }
+
+    #[test]
+    fn test_encoder_allocates_exact_size() {
+        let pack = sample_pack();
+        let bytes = pack.to_bytes().unwrap();
+        assert_eq!(bytes.len(), pack.encoded_len());
+
+        // Layout of the first element
+        assert_eq!(&bytes[..4], &5u32.to_be_bytes());
+        assert_eq!(&bytes[4..8], &7u32.to_be_bytes());
+        assert_eq!(&bytes[8..15], b"method\0");
+        assert_eq!(&bytes[15..19], &(ElementType::Str as u32).to_be_bytes());
+        assert_eq!(&bytes[19..23], &1u32.to_be_bytes());
+        assert_eq!(&bytes[23..27], &5u32.to_be_bytes());
+        assert_eq!(&bytes[27..32], b"login");
+
+        // Values are written exactly as Value::to_bytes renders them
+        for element in &pack.elements {
+            for value in &element.values {
+                assert_eq!(value.encoded_len(), value.to_bytes().len());
             }
         }
-        
-        log::warn!("⚠️ No valid IP configuration found in binary session data");
-        None
     }
 
-    // ...existing code...
+    #[test]
+    fn test_encode_into_reuses_buffer() {
+        let pack = sample_pack();
+        let mut buf = BytesMut::with_capacity(1024);
+        buf.put_slice(b"prefix");
+        pack.encode_into(&mut buf).unwrap();
+        assert_eq!(&buf[..6], b"prefix");
+        assert_eq!(&buf[6..], &pack.to_bytes().unwrap()[..]);
+
+        // A mixed-type element is rejected without touching the buffer
+        let mut bad = Pack::new();
+        bad.add_element(Element::new_array("mixed".to_string(), vec![Value::Int(1), Value::Int64(2)]));
+        let before = buf.len();
+        assert!(bad.encode_into(&mut buf).is_err());
+        assert_eq!(buf.len(), before);
+    }
+
+    #[test]
+    fn test_ip_scan_prefers_likely_vpn_ranges() {
+        let mut data = vec![0u8; 64];
+        data[4..8].copy_from_slice(&[192, 168, 7, 20]);
+        data[12..16].copy_from_slice(&[10, 210, 4, 9]);
+        // Same priority later on: the earlier address wins
+        data[20..24].copy_from_slice(&[10, 220, 4, 9]);
+        data[60..64].copy_from_slice(&[10, 251, 8, 33]);
+
+        let assignment = IpAssignment::scan(&data).unwrap();
+        assert_eq!(assignment.local_ip, Ipv4Addr::new(10, 251, 8, 33));
+        assert_eq!(assignment.gateway_ip, Ipv4Addr::new(10, 251, 8, 1));
+        assert_eq!(assignment.offset, 60);
+        assert_eq!(IpAssignment::scan(&data[..59]).unwrap().local_ip, Ipv4Addr::new(10, 210, 4, 9));
+        assert_eq!(IpAssignment::scan(&[0; 16]), None);
+
+        let pack = Pack::new().with_binary_session_data(Bytes::from(data));
+        let config = pack.analyze_for_ip_addresses().unwrap();
+        assert_eq!((config.local_ip.as_str(), config.gateway_ip.as_str()), ("10.251.8.33", "10.251.8.1"));
+        assert_eq!(config.netmask, "255.255.255.0");
+        assert!(Pack::new().analyze_for_ip_addresses().is_none());
+    }
+
+    #[test]
+    fn test_ten_net_scan_finds_expected_range() {
+        let mut data = vec![0u8; 32];
+        data[3..7].copy_from_slice(&[10, 1, 2, 3]);
+        data[28..32].copy_from_slice(&[10, 21, 255, 23]);
+
+        let assignment = IpAssignment::scan_ten_net(&data).unwrap();
+        assert_eq!(assignment.local_ip, Ipv4Addr::new(10, 21, 255, 23));
+        assert_eq!(assignment.gateway_ip, Ipv4Addr::new(10, 21, 255, 22));
+
+        let fallback = IpAssignment::scan_ten_net(&data[..30]).unwrap();
+        assert_eq!((fallback.local_ip, fallback.offset), (Ipv4Addr::new(10, 1, 2, 3), 3));
+        assert_eq!(fallback.gateway_ip, Ipv4Addr::new(10, 0, 0, 1));
+        assert_eq!(IpAssignment::scan_ten_net(&[0, 0, 10]), None);
+    }
 }
@@ -0,0 +1,477 @@
+//! Borrowed PACK decoder
+//!
+//! [`PackView`] parses a PACK in place: element names are `&str` slices and
+//! values are slices of the input, so decoding allocates only the element
+//! table, one shared value table and a name index. Lookups by name are O(1).
+//! [`Pack::from_bytes`](super::pack::Pack::from_bytes) is built on top of it.
+//!
+//! The layout accepted is exactly that of the owned decoder, including the
+//! padding SoftEther puts around names, values and elements, and the rule
+//! that everything from the first unparsable element on is binary session
+//! data.
+
+use super::pack::{Element, ElementType, Pack, Value};
+use crate::error::{Result, VpnError};
+use std::borrow::Cow;
+use std::collections::HashMap;
+use std::ops::Range;
+
+/// Most elements a PACK may declare
+const MAX_ELEMENTS: u32 = 10000;
+
+/// Longest element name, including its null terminator
+const MAX_NAME_LEN: u32 = 1000;
+
+/// Longest single value
+const MAX_VALUE_LEN: u32 = 10_000_000;
+
+/// Element type values above this mark binary session data, not an element
+const SESSION_DATA_TYPE_MIN: u32 = 10000;
+
+/// PACK value borrowed from the input
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum ValueView<'a> {
+    Int(u32),
+    Int64(u64),
+    Data(&'a [u8]),
+    Str(&'a str),
+    /// UTF-16LE code units, already validated
+    UniStr(&'a [u8]),
+}
+
+impl<'a> ValueView<'a> {
+    /// Validate and borrow one value of `element_type`
+    fn parse(element_type: ElementType, data: &'a [u8]) -> Result<Self> {
+        match element_type {
+            ElementType::Int => {
+                let bytes: [u8; 4] = data
+                    .try_into()
+                    .map_err(|_| VpnError::Protocol("Invalid Int data length".to_string()))?;
+                Ok(ValueView::Int(u32::from_be_bytes(bytes)))
+            }
+            ElementType::Int64 => {
+                let bytes: [u8; 8] = data
+                    .try_into()
+                    .map_err(|_| VpnError::Protocol("Invalid Int64 data length".to_string()))?;
+                Ok(ValueView::Int64(u64::from_be_bytes(bytes)))
+            }
+            ElementType::Data => Ok(ValueView::Data(data)),
+            ElementType::Str => std::str::from_utf8(data)
+                .map(ValueView::Str)
+                .map_err(|_| VpnError::Protocol("Invalid UTF-8 string".to_string())),
+            ElementType::UniStr => {
+                if data.len() % 2 != 0 {
+                    return Err(VpnError::Protocol("Invalid UniStr data length".to_string()));
+                }
+                if char::decode_utf16(utf16_units(data)).any(|c| c.is_err()) {
+                    return Err(VpnError::Protocol("Invalid UTF-16 string".to_string()));
+                }
+                Ok(ValueView::UniStr(data))
+            }
+        }
+    }
+
+    /// Element type of the value
+    pub fn element_type(&self) -> ElementType {
+        match self {
+            ValueView::Int(_) => ElementType::Int,
+            ValueView::Int64(_) => ElementType::Int64,
+            ValueView::Data(_) => ElementType::Data,
+            ValueView::Str(_) => ElementType::Str,
+            ValueView::UniStr(_) => ElementType::UniStr,
+        }
+    }
+
+    /// String contents; borrowed for `Str`, decoded for `UniStr`
+    pub fn as_str(&self) -> Option<Cow<'a, str>> {
+        match *self {
+            ValueView::Str(s) => Some(Cow::Borrowed(s)),
+            ValueView::UniStr(units) => Some(Cow::Owned(decode_utf16(units))),
+            _ => None,
+        }
+    }
+
+    /// Owned copy of the value
+    pub fn to_value(&self) -> Value {
+        match *self {
+            ValueView::Int(i) => Value::Int(i),
+            ValueView::Int64(i) => Value::Int64(i),
+            ValueView::Data(data) => Value::Data(data.to_vec()),
+            ValueView::Str(s) => Value::Str(s.to_string()),
+            ValueView::UniStr(units) => Value::UniStr(decode_utf16(units)),
+        }
+    }
+}
+
+fn utf16_units(data: &[u8]) -> impl Iterator<Item = u16> + '_ {
+    data.chunks_exact(2).map(|unit| u16::from_le_bytes([unit[0], unit[1]]))
+}
+
+/// Decode UTF-16LE that [`ValueView::parse`] has already validated
+fn decode_utf16(data: &[u8]) -> String {
+    char::decode_utf16(utf16_units(data))
+        .map(|c| c.unwrap_or(char::REPLACEMENT_CHARACTER))
+        .collect()
+}
+
+/// Element entry: name plus its range in the shared value table
+#[derive(Debug, Clone)]
+struct ElementEntry<'a> {
+    name: &'a str,
+    values: Range<usize>,
+}
+
+/// PACK parsed in place over a byte slice
+#[derive(Debug, Clone)]
+pub struct PackView<'a> {
+    elements: Vec<ElementEntry<'a>>,
+    values: Vec<ValueView<'a>>,
+    /// First element with each name, as `Pack::get_element` would find it
+    index: HashMap<&'a str, usize>,
+    binary_session_data: Option<&'a [u8]>,
+}
+
+impl<'a> PackView<'a> {
+    /// Parse `data` without copying it
+    pub fn parse(data: &'a [u8]) -> Result<Self> {
+        let mut reader = Reader { buf: data, pos: 0 };
+        if reader.remaining() < 4 {
+            return Err(VpnError::Protocol("PACK data too short".to_string()));
+        }
+
+        // Element count (SoftEther uses big-endian)
+        let num_elements = reader.get_u32();
+        if num_elements > MAX_ELEMENTS {
+            return Err(VpnError::Protocol(format!("Element count {} seems too large", num_elements)));
+        }
+
+        let mut view = Self {
+            elements: Vec::with_capacity(num_elements as usize),
+            values: Vec::with_capacity(num_elements as usize),
+            index: HashMap::with_capacity(num_elements as usize),
+            binary_session_data: None,
+        };
+
+        for _ in 0..num_elements {
+            // An element type far out of range means binary session data follows
+            if let Some(element_type) = reader.peek_element_type() {
+                if element_type > SESSION_DATA_TYPE_MIN {
+                    break;
+                }
+            }
+
+            // Later elements of SoftEther auth responses may not be PACK at
+            // all; whatever is left after the failure is session data
+            let values_before = view.values.len();
+            match Self::read_element(&mut reader, &mut view.values) {
+                Ok(element) => {
+                    view.index.entry(element.name).or_insert(view.elements.len());
+                    view.elements.push(element);
+                }
+                Err(e) => {
+                    log::debug!("PACK element {} unparsable, keeping rest as session data: {}", view.elements.len() + 1, e);
+                    view.values.truncate(values_before);
+                    break;
+                }
+            }
+        }
+
+        if reader.remaining() > 0 {
+            view.binary_session_data = Some(reader.rest());
+        }
+        Ok(view)
+    }
+
+    /// Read one element, appending its values to `values`
+    ///
+    /// On error the reader is left wherever parsing stopped.
+    fn read_element(reader: &mut Reader<'a>, values: &mut Vec<ValueView<'a>>) -> Result<ElementEntry<'a>> {
+        if reader.remaining() < 4 {
+            return Err(VpnError::Protocol("Not enough data for element name length".to_string()));
+        }
+
+        // Name length includes the null terminator
+        let name_len_raw = reader.get_u32();
+        if name_len_raw > MAX_NAME_LEN {
+            return Err(VpnError::Protocol(format!("Element name length {} is unreasonably large", name_len_raw)));
+        }
+        let name_len = name_len_raw as usize;
+        if name_len == 0 {
+            return Err(VpnError::Protocol("Element name length is zero".to_string()));
+        }
+        if reader.remaining() < name_len {
+            return Err(VpnError::Protocol("Not enough data for element name".to_string()));
+        }
+        let name_bytes = reader.take(name_len);
+        let name = std::str::from_utf8(&name_bytes[..name_len - 1])
+            .map_err(|_| VpnError::Protocol("Invalid element name UTF-8".to_string()))?;
+
+        // Name is padded to a 4-byte boundary, then usually followed by one more zero byte
+        reader.skip_padding(name_len);
+        if reader.peek() == Some(0) {
+            reader.skip(1);
+        }
+
+        if reader.remaining() < 8 {
+            return Err(VpnError::Protocol("Not enough data for element type and value count".to_string()));
+        }
+        let element_type = ElementType::try_from(reader.get_u32())?;
+        let num_values = reader.get_u32() as usize;
+
+        let start = values.len();
+        values.reserve(num_values.min(reader.remaining() / 4));
+        for j in 0..num_values {
+            if reader.remaining() < 4 {
+                return Err(VpnError::Protocol("Not enough data for value length".to_string()));
+            }
+            let value_len_raw = reader.get_u32();
+            if value_len_raw > MAX_VALUE_LEN {
+                return Err(VpnError::Protocol(format!("Value length {} exceeds safety limit", value_len_raw)));
+            }
+            let value_len = value_len_raw as usize;
+            if reader.remaining() < value_len {
+                return Err(VpnError::Protocol(format!(
+                    "Not enough data for value {} (need {}, have {})",
+                    j,
+                    value_len,
+                    reader.remaining()
+                )));
+            }
+            values.push(ValueView::parse(element_type, reader.take(value_len))?);
+            reader.skip_padding(value_len);
+        }
+
+        // Three bytes of inter-element padding
+        if reader.remaining() >= 3 && reader.peek() == Some(0) && reader.buf[reader.pos + 1] == 0 {
+            reader.skip(3);
+        }
+
+        Ok(ElementEntry { name, values: start..values.len() })
+    }
+
+    /// Number of parsed elements
+    pub fn len(&self) -> usize {
+        self.elements.len()
+    }
+
+    /// True if no elements were parsed
+    pub fn is_empty(&self) -> bool {
+        self.elements.is_empty()
+    }
+
+    /// Elements in wire order, as name and values
+    pub fn elements(&self) -> impl Iterator<Item = (&'a str, &[ValueView<'a>])> + '_ {
+        self.elements.iter().map(|e| (e.name, &self.values[e.values.clone()]))
+    }
+
+    /// All values of the element called `name`
+    pub fn values(&self, name: &str) -> Option<&[ValueView<'a>]> {
+        let element = &self.elements[*self.index.get(name)?];
+        Some(&self.values[element.values.clone()])
+    }
+
+    /// First value of the element called `name`
+    pub fn get(&self, name: &str) -> Option<&ValueView<'a>> {
+        self.values(name)?.first()
+    }
+
+    /// Get an integer value
+    pub fn get_int(&self, name: &str) -> Option<u32> {
+        match self.get(name)? {
+            ValueView::Int(i) => Some(*i),
+            _ => None,
+        }
+    }
+
+    /// Get a 64-bit integer value
+    pub fn get_int64(&self, name: &str) -> Option<u64> {
+        match self.get(name)? {
+            ValueView::Int64(i) => Some(*i),
+            _ => None,
+        }
+    }
+
+    /// Get binary data
+    pub fn get_data(&self, name: &str) -> Option<&'a [u8]> {
+        match self.get(name)? {
+            ValueView::Data(data) => Some(data),
+            _ => None,
+        }
+    }
+
+    /// Get a string value (`Str` or `UniStr`)
+    pub fn get_str(&self, name: &str) -> Option<Cow<'a, str>> {
+        self.get(name)?.as_str()
+    }
+
+    /// Trailing bytes that did not parse as PACK elements
+    pub fn binary_session_data(&self) -> Option<&'a [u8]> {
+        self.binary_session_data
+    }
+
+    /// Owned copies of the elements
+    pub fn to_elements(&self) -> Vec<Element> {
+        self.elements()
+            .map(|(name, values)| Element::new_array(name.to_string(), values.iter().map(ValueView::to_value).collect()))
+            .collect()
+    }
+
+    /// Owned copy of the whole PACK
+    pub fn to_pack(&self) -> Pack {
+        Pack {
+            elements: self.to_elements(),
+            binary_session_data: self.binary_session_data.map(bytes::Bytes::copy_from_slice),
+        }
+    }
+}
+
+/// Big-endian cursor over the input
+struct Reader<'a> {
+    buf: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> Reader<'a> {
+    fn remaining(&self) -> usize {
+        self.buf.len() - self.pos
+    }
+
+    fn rest(&self) -> &'a [u8] {
+        &self.buf[self.pos..]
+    }
+
+    fn peek(&self) -> Option<u8> {
+        self.buf.get(self.pos).copied()
+    }
+
+    /// Caller checks that 4 bytes remain
+    fn get_u32(&mut self) -> u32 {
+        let bytes = self.take(4);
+        u32::from_be_bytes([bytes[0], bytes[1], bytes[2], bytes[3]])
+    }
+
+    /// Caller checks that `len` bytes remain
+    fn take(&mut self, len: usize) -> &'a [u8] {
+        let bytes = &self.buf[self.pos..self.pos + len];
+        self.pos += len;
+        bytes
+    }
+
+    fn skip(&mut self, len: usize) {
+        self.pos += len;
+    }
+
+    /// Skip the padding after a field of `len` bytes, if it is there
+    fn skip_padding(&mut self, len: usize) {
+        let padding = ((len + 3) & !3) - len;
+        if padding > 0 && self.remaining() >= padding {
+            self.skip(padding);
+        }
+    }
+
+    /// Type of the element starting here, read past its name without consuming anything
+    fn peek_element_type(&self) -> Option<u32> {
+        let rest = self.rest();
+        if rest.len() < 8 {
+            return None;
+        }
+        let name_len = u32::from_be_bytes([rest[0], rest[1], rest[2], rest[3]]) as usize;
+        let at = 4 + ((name_len + 3) & !3);
+        let bytes = rest.get(at..at + 4).filter(|_| rest.len() > at + 4)?;
+        Some(u32::from_be_bytes([bytes[0], bytes[1], bytes[2], bytes[3]]))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use bytes::{BufMut, Bytes, BytesMut};
+
+    /// Lay out one element the way SoftEther servers send it
+    fn put_element(out: &mut BytesMut, name: &str, element_type: u32, values: &[&[u8]]) {
+        let name_len = name.len() + 1;
+        out.put_u32(name_len as u32);
+        out.put_slice(name.as_bytes());
+        out.put_u8(0);
+        out.put_bytes(0, ((name_len + 3) & !3) - name_len);
+        out.put_u8(0);
+        out.put_u32(element_type);
+        out.put_u32(values.len() as u32);
+        for value in values {
+            out.put_u32(value.len() as u32);
+            out.put_slice(value);
+            out.put_bytes(0, ((value.len() + 3) & !3) - value.len());
+        }
+        out.put_bytes(0, 3);
+    }
+
+    fn sample_pack() -> Bytes {
+        let unistr: Vec<u8> = "hub✓".encode_utf16().flat_map(u16::to_le_bytes).collect();
+        let mut out = BytesMut::new();
+        out.put_u32(5);
+        put_element(&mut out, "pencore", 1, &[b"\x01\x02\x03"]);
+        put_element(&mut out, "max_connection", 0, &[&8u32.to_be_bytes()]);
+        put_element(&mut out, "hub", 3, &[&unistr]);
+        put_element(&mut out, "max_connection", 0, &[&1u32.to_be_bytes()]);
+        // Not an element: type far out of range, so the rest is session data
+        out.put_u32(4);
+        out.put_slice(b"key\0");
+        out.put_slice(&[0xff; 12]);
+        out.freeze()
+    }
+
+    #[test]
+    fn test_view_borrows_values_and_indexes_names() {
+        let data = sample_pack();
+        let view = PackView::parse(&data).unwrap();
+
+        assert_eq!(view.len(), 4);
+        assert_eq!(view.get_int("max_connection"), Some(8));
+        assert_eq!(view.get_str("hub").unwrap(), "hub✓");
+        assert_eq!(view.get_data("pencore"), Some(&b"\x01\x02\x03"[..]));
+        assert!(view.get("missing").is_none());
+
+        let pencore = view.get_data("pencore").unwrap();
+        assert!(data.as_ptr_range().contains(&pencore.as_ptr()));
+
+        let session = view.binary_session_data().unwrap();
+        assert_eq!(&session[..4], &4u32.to_be_bytes());
+        assert_eq!(session.len(), 20);
+    }
+
+    #[test]
+    fn test_owned_pack_matches_view() {
+        let data = sample_pack();
+        let pack = Pack::from_bytes(data.clone()).unwrap();
+
+        assert_eq!(pack.elements.len(), 4);
+        assert_eq!(pack.get_int("max_connection"), Some(8));
+        assert_eq!(pack.get_str("hub").map(String::as_str), Some("hub✓"));
+        assert_eq!(pack.get_data("pencore").map(Vec::as_slice), Some(&b"\x01\x02\x03"[..]));
+        assert_eq!(pack.get_binary_session_data().map(Bytes::len), Some(20));
+        assert_eq!(pack.get_elements().len(), 3);
+    }
+
+    #[test]
+    fn test_bad_element_becomes_session_data() {
+        let mut out = BytesMut::new();
+        out.put_u32(2);
+        put_element(&mut out, "ok", 0, &[&7u32.to_be_bytes()]);
+        // Claims a value longer than the input
+        put_element(&mut out, "bad", 1, &[]);
+        out.truncate(out.len() - 3);
+        let num_values_at = out.len() - 4;
+        out[num_values_at..].copy_from_slice(&1u32.to_be_bytes());
+        out.put_u32(64);
+        out.put_slice(&[0xab; 8]);
+
+        let view = PackView::parse(&out).unwrap();
+        assert_eq!(view.len(), 1);
+        assert_eq!(view.get_int("ok"), Some(7));
+        assert_eq!(view.binary_session_data(), Some(&[0xab; 8][..]));
+        assert!(view.values("bad").is_none());
+
+        assert!(PackView::parse(&[0, 0]).is_err());
+        assert!(PackView::parse(&20000u32.to_be_bytes()).is_err());
+    }
+}
@@ -1,7 +1,8 @@
 //! Session management for `SoftEther` SSL-VPN protocol
 
-use crate::config::Config;
+use crate::config::CompiledConfig;
 use crate::error::{Result, VpnError};
+use std::sync::Arc;
 use std::time::{Duration, Instant};
 use uuid::Uuid;
 
@@ -13,17 +14,17 @@ pub struct SessionManager {
     start_time: Option<Instant>,
     last_keepalive: Option<Instant>,
     #[allow(dead_code)]
-    config: Config,
+    config: Arc<CompiledConfig>,
 }
 
 impl SessionManager {
-    /// Create a new session manager
-    pub fn new(config: &Config) -> Result<Self> {
+    /// Create a new session manager sharing the client's configuration
+    pub fn new(config: Arc<CompiledConfig>) -> Result<Self> {
         Ok(Self {
             session_id: None,
             start_time: None,
             last_keepalive: None,
-            config: config.clone(),
+            config,
         })
     }
 
@@ -65,11 +66,25 @@ impl SessionManager {
         self.start_time.map(|start| start.elapsed())
     }
 
-    /// Get time since last keepalive
+    /// Record real traffic on the session; it defers the next keepalive
+    pub fn record_traffic(&mut self) {
+        if self.session_id.is_some() {
+            self.last_keepalive = Some(Instant::now());
+        }
+    }
+
+    /// Get time since last keepalive or traffic
     pub fn time_since_keepalive(&self) -> Option<Duration> {
         self.last_keepalive.map(|last| last.elapsed())
     }
 
+    /// Whether the session has been idle for `interval` and needs a keepalive
+    ///
+    /// A session that has never sent a keepalive or carried traffic is due.
+    pub fn keepalive_due(&self, interval: Duration) -> bool {
+        self.time_since_keepalive().map_or(true, |idle| idle >= interval)
+    }
+
     /// End the session
     pub fn end_session(&mut self) {
         self.session_id = None;
@@ -77,3 +92,25 @@ impl SessionManager {
         self.last_keepalive = None;
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::config::Config;
+
+    #[test]
+    fn test_keepalive_due_until_stamped() {
+        let config = CompiledConfig::compile(Config::default_test()).unwrap();
+        let mut session = SessionManager::new(config).unwrap();
+        let interval = Duration::from_secs(60);
+        assert!(session.keepalive_due(interval));
+
+        session.start_session().unwrap();
+        assert!(!session.keepalive_due(interval));
+        assert!(session.keepalive_due(Duration::ZERO));
+        session.send_keepalive().unwrap();
+
+        session.end_session();
+        assert!(session.keepalive_due(interval));
+    }
+}
@@ -4,9 +4,14 @@
 //! to establish VPN sessions. The watermark is a GIF89a binary data that must
 //! be sent via HTTP POST to /vpnsvc/connect.cgi to validate the VPN client.
 
+use crate::crypto::tls;
 use crate::error::{Result, VpnError};
+use crate::protocol::constants::WATERMARK_ENDPOINT;
+use crate::protocol::connection::{HttpResponse, SessionConnection, SharedConnection, HTTP_USER_AGENT};
+use bytes::Bytes;
 use reqwest::Client;
 use std::net::SocketAddr;
+use std::sync::Arc;
 
 /// SoftEther VPN Watermark (GIF89a binary data)
 /// This is the exact watermark from SoftEtherVPN/src/Cedar/WaterMark.c
@@ -22,24 +27,25 @@ pub const SOFTETHER_WATERMARK: &[u8] = &[
 ];
 
 /// HTTP watermark handshake client
+///
+/// Requests go over the attached [`SessionConnection`] when there is one,
+/// and through a pooled reqwest client otherwise.
 pub struct WatermarkClient {
     pub(crate) http_client: Client,
     pub(crate) server_addr: SocketAddr,
     pub(crate) base_url: String,
     pub(crate) hostname: Option<String>,
+    verify_certificate: bool,
+    connection: Option<SharedConnection>,
 }
 
 impl WatermarkClient {
     /// Create a new watermark client
     pub fn new(server_addr: SocketAddr, hostname: Option<String>, verify_certificate: bool) -> Result<Self> {
-        let mut client_builder = Client::builder()
+        // Shared TLS configuration, so repeat handshakes resume cached sessions
+        let client_builder = tls::http_client_builder(verify_certificate)?
             .user_agent("SoftEther VPN Client");
 
-        // Configure TLS verification
-        if !verify_certificate {
-            client_builder = client_builder.danger_accept_invalid_certs(true);
-        }
-
         let http_client = client_builder.build().map_err(|e| {
             VpnError::Network(format!("Failed to create HTTP client: {}", e))
         })?;
@@ -51,83 +57,101 @@ impl WatermarkClient {
             server_addr,
             base_url,
             hostname,
+            verify_certificate,
+            connection: None,
         })
     }
 
-    /// Send HTTP watermark handshake to establish VPN session
+    /// Open the session connection that later requests and the data channel reuse
+    pub async fn open_connection(&mut self) -> Result<SharedConnection> {
+        let connection = SessionConnection::connect(self.server_addr, self.hostname.as_deref(), self.verify_certificate).await?;
+        let shared: SharedConnection = Arc::new(tokio::sync::Mutex::new(Some(connection)));
+        self.connection = Some(shared.clone());
+        Ok(shared)
+    }
+
+    /// Send requests over an existing session connection
+    pub fn attach_connection(&mut self, connection: SharedConnection) {
+        self.connection = Some(connection);
+    }
+
+    /// The session connection requests go over, if any
+    pub fn connection(&self) -> Option<SharedConnection> {
+        self.connection.clone()
+    }
+
+    /// POST `body` to `path` on the server
     ///
-    /// This sends either "VPNCONNECT" or the SoftEther watermark (GIF89a binary data) 
-    /// via HTTP POST to /vpnsvc/connect.cgi to validate the VPN client and establish session.
-    pub async fn send_watermark_handshake(&self) -> Result<WatermarkResponse> {
-        let url = format!("{}/vpnsvc/connect.cgi", self.base_url);
-        
-        // First try with "VPNCONNECT" - this is simpler and more commonly used
+    /// A failed request on the session connection drops it, and later
+    /// requests fail too rather than going out on a new socket: the server's
+    /// session state lives on the connection.
+    pub async fn post(&self, path: &str, content_type: &str, body: Bytes) -> Result<HttpResponse> {
+        if let Some(connection) = &self.connection {
+            let mut slot = connection.lock().await;
+            let Some(session) = slot.as_mut() else {
+                return Err(VpnError::Connection(format!("POST {}: session connection is closed", path)));
+            };
+            let result = session.post(path, content_type, &body).await;
+            if result.is_err() || session.is_closed() {
+                *slot = None;
+            }
+            return result;
+        }
+
         let mut request = self.http_client
-            .post(&url)
-            .header("Content-Type", "application/x-www-form-urlencoded")
-            .header("Content-Length", "10")
+            .post(format!("{}{}", self.base_url, path))
+            .header("Content-Type", content_type)
+            .header("Content-Length", body.len().to_string())
             .header("Connection", "Keep-Alive")
-            .header("User-Agent", "Mozilla/4.0 (compatible; MSIE 6.0; Windows NT 5.1)");
-        
-        // Add Host header if hostname is provided
+            .header("User-Agent", HTTP_USER_AGENT);
         if let Some(hostname) = &self.hostname {
             request = request.header("Host", hostname);
         }
-        
         let response = request
-            .body("VPNCONNECT")
+            .body(body)
             .send()
             .await
-            .map_err(|e| VpnError::Network(format!("Watermark handshake failed: {}", e)))?;
+            .map_err(|e| VpnError::Network(format!("POST {} failed: {}", path, e)))?;
+        let status = response.status().as_u16();
+        let body = response.bytes().await
+            .map_err(|e| VpnError::Network(format!("Failed to read response to {}: {}", path, e)))?;
+        Ok(HttpResponse::new(status, body))
+    }
 
-        if response.status().is_success() {
-            // Read response body
-            let response_body = response.bytes().await.map_err(|e| {
-                VpnError::Network(format!("Failed to read watermark response: {}", e))
-            })?;
+    /// Send HTTP watermark handshake to establish VPN session
+    ///
+    /// This sends either "VPNCONNECT" or the SoftEther watermark (GIF89a binary data) 
+    /// via HTTP POST to /vpnsvc/connect.cgi to validate the VPN client and establish session.
+    pub async fn send_watermark_handshake(&self) -> Result<WatermarkResponse> {
+        // First try with "VPNCONNECT" - this is simpler and more commonly used
+        let response = self
+            .post(WATERMARK_ENDPOINT, "application/x-www-form-urlencoded", Bytes::from_static(b"VPNCONNECT"))
+            .await
+            .map_err(|e| VpnError::Network(format!("Watermark handshake failed: {}", e)))?;
 
+        if response.is_success() {
             return Ok(WatermarkResponse {
                 session_established: true,
-                response_data: response_body.to_vec(),
+                response_data: response.into_body().to_vec(),
             });
         }
 
         // If VPNCONNECT fails, try with the GIF watermark
-        let watermark_data = SOFTETHER_WATERMARK.to_vec();
-
-        let mut gif_request = self.http_client
-            .post(&url)
-            .header("Content-Type", "image/gif")
-            .header("Content-Length", &watermark_data.len().to_string())
-            .header("Connection", "Keep-Alive")
-            .header("User-Agent", "Mozilla/4.0 (compatible; MSIE 6.0; Windows NT 5.1)");
-            
-        // Add Host header if hostname is provided
-        if let Some(hostname) = &self.hostname {
-            gif_request = gif_request.header("Host", hostname);
-        }
-
-        let response = gif_request
-            .body(watermark_data)
-            .send()
+        let response = self
+            .post(WATERMARK_ENDPOINT, "image/gif", Bytes::from_static(SOFTETHER_WATERMARK))
             .await
             .map_err(|e| VpnError::Network(format!("Watermark handshake failed: {}", e)))?;
 
-        if !response.status().is_success() {
+        if !response.is_success() {
             return Err(VpnError::Protocol(format!(
                 "Watermark handshake rejected: HTTP {}",
                 response.status()
             )));
         }
 
-        // Read response body
-        let response_body = response.bytes().await.map_err(|e| {
-            VpnError::Network(format!("Failed to read watermark response: {}", e))
-        })?;
-
         Ok(WatermarkResponse {
             session_established: true,
-            response_data: response_body.to_vec(),
+            response_data: response.into_body().to_vec(),
         })
     }
 
@@ -173,7 +197,16 @@ mod tests {
     #[test]
     fn test_watermark_client_creation() {
         let addr = "127.0.0.1:443".parse().unwrap();
-        let client = WatermarkClient::new(addr, false);
+        let client = WatermarkClient::new(addr, None, false);
         assert!(client.is_ok());
     }
+
+    #[tokio::test]
+    async fn test_post_on_dropped_session_connection_fails() {
+        // Port 9 (discard) would refuse a fallback request; it must not be tried
+        let mut client = WatermarkClient::new("127.0.0.1:9".parse().unwrap(), None, false).unwrap();
+        client.attach_connection(Arc::new(tokio::sync::Mutex::new(None)));
+        let result = client.post(WATERMARK_ENDPOINT, "image/gif", Bytes::new()).await;
+        assert!(matches!(result, Err(VpnError::Connection(_))));
+    }
 }
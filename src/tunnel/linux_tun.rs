@@ -1,14 +1,25 @@
 //! Linux TUN Interface Implementation
 //! 
 //! Provides Linux-specific TUN interface management using the native TUN/TAP driver
+//!
+//! The `async` methods and the `AsyncRead`/`AsyncWrite` impls wait for the
+//! device through tokio's reactor (epoll); the first of them switches the
+//! descriptor to non-blocking mode. The `_blocking` methods work in either
+//! mode, waiting in poll(2) when the device would block.
 
+use super::netlink::Netlink;
+use super::offload::{self, GroCoalescer, VirtioNetHdr, MAX_SUPER_PACKET, VIRTIO_NET_HDR_LEN};
+use crate::buffer_pool::{BufferPool, BufferPoolStats};
 use crate::error::{Result, VpnError};
+use std::collections::VecDeque;
 use std::os::unix::io::{AsRawFd, RawFd};
+use std::sync::Arc;
 use std::ffi::CString;
 use libc::{self, c_int, c_void, c_short, c_char};
+use tokio::io::unix::AsyncFd;
 use tokio::io::{AsyncRead, AsyncWrite, ReadBuf};
 use std::pin::Pin;
-use std::task::{Context, Poll};
+use std::task::{ready, Context, Poll};
 use bytes::{Bytes, BytesMut};
 use std::io;
 use std::mem;
@@ -25,10 +36,19 @@ const IFF_TUN: c_short = 0x0001;
 const IFF_TAP: c_short = 0x0002;
 const IFF_NO_PI: c_short = 0x1000;
 const IFF_MULTI_QUEUE: c_short = 0x0100;
+const IFF_VNET_HDR: c_short = 0x4000;
 const TUNSETIFF: u64 = 0x400454ca;
 const TUNSETPERSIST: u64 = 0x400454cb;
 const TUNSETOWNER: u64 = 0x400454cc;
 const TUNSETGROUP: u64 = 0x400454ce;
+const TUNSETOFFLOAD: u64 = 0x400454d0;
+
+/// TUNSETOFFLOAD flags
+const TUN_F_CSUM: libc::c_ulong = 0x01;
+const TUN_F_TSO4: libc::c_ulong = 0x02;
+const TUN_F_TSO6: libc::c_ulong = 0x04;
+const TUN_F_USO4: libc::c_ulong = 0x20;
+const TUN_F_USO6: libc::c_ulong = 0x40;
 
 /// Linux TUN interface
 pub struct LinuxTunInterface {
@@ -37,6 +57,19 @@ pub struct LinuxTunInterface {
     is_tun: bool, // true for TUN, false for TAP
     is_connected: bool,
     mtu: u32,
+    buffer_pool: BufferPool,
+    /// Additional queue fds beyond `fd` in multi-queue mode
+    extra_queues: Vec<RawFd>,
+    /// Frames carry a virtio_net_hdr (IFF_VNET_HDR)
+    vnet_hdr: bool,
+    /// Segments of the last super-packet not yet returned by `read_packet`
+    pending: VecDeque<Bytes>,
+    /// Read buffer for super-packets, and the buffer segments are cut into
+    super_buf: Vec<u8>,
+    segment_buf: BytesMut,
+    gro: GroCoalescer,
+    /// Reactor registration of `fd`, made by the first async call
+    async_fd: Option<Arc<AsyncFd<RawFd>>>,
 }
 
 impl LinuxTunInterface {
@@ -45,17 +78,115 @@ impl LinuxTunInterface {
         log::info!("Initializing Linux {} interface", if is_tun { "TUN" } else { "TAP" });
         
         let fd = Self::create_tun_tap_fd()?;
-        let actual_name = Self::setup_interface(fd, interface_name, is_tun)?;
+        let actual_name = Self::setup_interface(fd, interface_name, is_tun, 0)?;
         
         log::info!("Created {} interface: {}", if is_tun { "TUN" } else { "TAP" }, actual_name);
         
-        Ok(Self {
+        Ok(Self::from_queues(fd, Vec::new(), actual_name, is_tun, false))
+    }
+
+    /// Create a multi-queue (IFF_MULTI_QUEUE) interface with `queues` file descriptors
+    ///
+    /// The kernel steers each flow to one queue by hash, so one worker per
+    /// queue sees every packet of its flows in order.
+    pub fn new_multi_queue(interface_name: Option<String>, is_tun: bool, queues: usize) -> Result<Self> {
+        Self::open_queues(interface_name, is_tun, queues, false)
+    }
+
+    /// Create a TUN interface with segmentation offload (IFF_VNET_HDR)
+    ///
+    /// The kernel then hands over TCP/UDP super-packets of up to 64 KB, which
+    /// `read_packet` segments lazily, and `write_packets` coalesces TCP
+    /// segments back into super-packets. If the kernel refuses TSO the device
+    /// still works, just with one segment per read.
+    pub fn new_offloaded(interface_name: Option<String>, queues: usize) -> Result<Self> {
+        Self::open_queues(interface_name, true, queues, true)
+    }
+
+    fn open_queues(interface_name: Option<String>, is_tun: bool, queues: usize, vnet_hdr: bool) -> Result<Self> {
+        if queues == 0 {
+            return Err(VpnError::TunTap("Queue count must be at least 1".to_string()));
+        }
+        log::info!("Initializing Linux {} interface with {} queues", if is_tun { "TUN" } else { "TAP" }, queues);
+        
+        let mut flags = if queues > 1 { IFF_MULTI_QUEUE } else { 0 };
+        if vnet_hdr {
+            flags |= IFF_VNET_HDR;
+        }
+        let open_queue = |name: Option<String>| -> Result<(RawFd, String)> {
+            let queue_fd = Self::create_tun_tap_fd()?;
+            let name = Self::setup_interface(queue_fd, name, is_tun, flags)?;
+            if vnet_hdr {
+                Self::enable_offload(queue_fd);
+            }
+            Ok((queue_fd, name))
+        };
+        
+        let (fd, actual_name) = open_queue(interface_name)?;
+        
+        let mut extra_queues = Vec::with_capacity(queues - 1);
+        for _ in 1..queues {
+            let attached = open_queue(Some(actual_name.clone())).map(|(queue_fd, _)| queue_fd);
+            match attached {
+                Ok(queue_fd) => extra_queues.push(queue_fd),
+                Err(e) => {
+                    for queue_fd in extra_queues.into_iter().chain(std::iter::once(fd)) {
+                        unsafe { libc::close(queue_fd); }
+                    }
+                    return Err(e);
+                }
+            }
+        }
+        
+        log::info!("Created {} interface: {} ({} queues)", if is_tun { "TUN" } else { "TAP" }, actual_name, queues);
+        
+        Ok(Self::from_queues(fd, extra_queues, actual_name, is_tun, vnet_hdr))
+    }
+
+    fn from_queues(fd: RawFd, extra_queues: Vec<RawFd>, interface_name: String, is_tun: bool, vnet_hdr: bool) -> Self {
+        Self {
             fd,
-            interface_name: actual_name,
+            interface_name,
             is_tun,
             is_connected: false,
             mtu: 1500, // Default MTU
-        })
+            buffer_pool: BufferPool::for_mtu(1500),
+            extra_queues,
+            vnet_hdr,
+            pending: VecDeque::new(),
+            super_buf: if vnet_hdr { vec![0u8; VIRTIO_NET_HDR_LEN + MAX_SUPER_PACKET] } else { Vec::new() },
+            segment_buf: BytesMut::new(),
+            gro: GroCoalescer::new(),
+            async_fd: None,
+        }
+    }
+
+    /// Ask the kernel for checksum, TSO and (where supported) USO offload
+    fn enable_offload(fd: RawFd) {
+        let tso = TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6;
+        // USO needs Linux 6.2; fall back to TSO only, then to no offload
+        for offloads in [tso | TUN_F_USO4 | TUN_F_USO6, tso] {
+            if unsafe { libc::ioctl(fd, TUNSETOFFLOAD, offloads) } == 0 {
+                log::debug!("TUN offloads enabled: {:#x}", offloads);
+                return;
+            }
+        }
+        log::warn!("TUN offload unavailable: {}", io::Error::last_os_error());
+    }
+
+    /// Whether frames on this interface carry a virtio_net_hdr
+    pub fn vnet_hdr(&self) -> bool {
+        self.vnet_hdr
+    }
+
+    /// All queue file descriptors, primary first
+    pub fn queue_fds(&self) -> Vec<RawFd> {
+        std::iter::once(self.fd).chain(self.extra_queues.iter().copied()).collect()
+    }
+
+    /// Number of queues
+    pub fn queue_count(&self) -> usize {
+        1 + self.extra_queues.len()
     }
 
     /// Create TUN/TAP file descriptor
@@ -73,7 +204,7 @@ impl LinuxTunInterface {
     }
 
     /// Setup TUN/TAP interface
-    fn setup_interface(fd: RawFd, name: Option<String>, is_tun: bool) -> Result<String> {
+    fn setup_interface(fd: RawFd, name: Option<String>, is_tun: bool, extra_flags: c_short) -> Result<String> {
         let mut ifr: IfReq = unsafe { mem::zeroed() };
         
         // Set interface name if provided
@@ -91,6 +222,7 @@ impl LinuxTunInterface {
         // Set interface flags
         ifr.ifr_flags = if is_tun { IFF_TUN } else { IFF_TAP };
         ifr.ifr_flags |= IFF_NO_PI; // No packet info header
+        ifr.ifr_flags |= extra_flags;
         
         // Create interface
         unsafe {
@@ -113,8 +245,19 @@ impl LinuxTunInterface {
     }
 
     /// Configure interface with IP addresses
+    ///
+    /// Uses rtnetlink, falling back to `ip` commands when that fails.
     pub fn configure(&mut self, local_ip: &str, remote_ip: &str, netmask: &str) -> Result<()> {
         log::info!("Configuring TUN interface: {} -> {} ({})", local_ip, remote_ip, netmask);
+
+        match self.configure_netlink(local_ip, remote_ip, netmask) {
+            Ok(()) => {
+                self.is_connected = true;
+                log::info!("TUN interface configured successfully");
+                return Ok(());
+            }
+            Err(e) => log::debug!("Netlink configuration failed, using ip commands: {}", e),
+        }
         
         // Bring interface up
         let up_cmd = format!("sudo ip link set dev {} up", self.interface_name);
@@ -169,6 +312,19 @@ impl LinuxTunInterface {
         Ok(())
     }
 
+    /// Bring the interface up and assign its address over rtnetlink
+    fn configure_netlink(&self, local_ip: &str, remote_ip: &str, netmask: &str) -> Result<()> {
+        let parse = |ip: &str| ip.parse::<std::net::Ipv4Addr>()
+            .map_err(|_| VpnError::Configuration(format!("Invalid IPv4 address '{}'", ip)));
+        let local = parse(local_ip)?;
+        let peer = if self.is_tun { Some(parse(remote_ip)?) } else { None };
+
+        let index = Netlink::link_index(&self.interface_name)?;
+        let mut netlink = Netlink::open()?;
+        netlink.set_link_up(index, true)?;
+        netlink.add_address(index, local, Self::netmask_to_cidr(netmask)?, peer)
+    }
+
     /// Convert netmask to CIDR notation
     fn netmask_to_cidr(netmask: &str) -> Result<u8> {
         let addr = netmask.parse::<std::net::Ipv4Addr>()
@@ -181,43 +337,203 @@ impl LinuxTunInterface {
         Ok(cidr)
     }
 
+    /// Register `fd` with the tokio reactor, switching it to non-blocking mode
+    ///
+    /// Must be called within a tokio runtime.
+    fn async_fd(&mut self) -> Result<Arc<AsyncFd<RawFd>>> {
+        if let Some(async_fd) = &self.async_fd {
+            return Ok(async_fd.clone());
+        }
+        let flags = unsafe { libc::fcntl(self.fd, libc::F_GETFL) };
+        if flags < 0 || unsafe { libc::fcntl(self.fd, libc::F_SETFL, flags | libc::O_NONBLOCK) } < 0 {
+            return Err(VpnError::TunTap(format!(
+                "Failed to make TUN interface non-blocking: {}",
+                io::Error::last_os_error()
+            )));
+        }
+        let async_fd = AsyncFd::new(self.fd)
+            .map_err(|e| VpnError::TunTap(format!("Failed to register TUN interface with the runtime: {}", e)))?;
+        let async_fd = Arc::new(async_fd);
+        self.async_fd = Some(async_fd.clone());
+        Ok(async_fd)
+    }
+
     /// Read packet from TUN interface
+    ///
+    /// Waits for the device through the runtime, never blocking its thread.
     pub async fn read_packet(&mut self) -> Result<Bytes> {
-        let mut buffer = vec![0u8; self.mtu as usize];
+        if let Some(packet) = self.pending.pop_front() {
+            return Ok(packet);
+        }
+        let async_fd = self.async_fd()?;
+        loop {
+            let mut guard = async_fd.readable().await.map_err(read_error)?;
+            match guard.try_io(|_| self.read_once()) {
+                Ok(Ok(packet)) => return Ok(packet),
+                Ok(Err(e)) if e.kind() == io::ErrorKind::Interrupted => {}
+                Ok(Err(e)) => return Err(read_error(e)),
+                Err(_would_block) => {}
+            }
+        }
+    }
+
+    /// Read the next packet, blocking until one is available
+    ///
+    /// With offload enabled one read may return a super-packet; its segments
+    /// are handed out by this and the following calls.
+    pub fn read_packet_blocking(&mut self) -> Result<Bytes> {
+        if let Some(packet) = self.pending.pop_front() {
+            return Ok(packet);
+        }
+        loop {
+            match self.read_once() {
+                Ok(packet) => return Ok(packet),
+                Err(e) if e.kind() == io::ErrorKind::WouldBlock => wait_fd(self.fd, libc::POLLIN).map_err(read_error)?,
+                Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
+                Err(e) => return Err(read_error(e)),
+            }
+        }
+    }
+
+    /// One read(2): a packet, or the first segment of a super-packet
+    fn read_once(&mut self) -> io::Result<Bytes> {
+        if self.vnet_hdr {
+            return self.read_offloaded();
+        }
+        
+        let capacity = self.mtu as usize;
+        let mut buffer = self.buffer_pool.acquire_for(capacity);
         
         let bytes_read = unsafe {
-            libc::read(self.fd, buffer.as_mut_ptr() as *mut c_void, buffer.len())
+            libc::read(self.fd, buffer.spare_capacity_mut().as_mut_ptr() as *mut c_void, capacity)
         };
         
         if bytes_read < 0 {
-            return Err(VpnError::TunTap("Failed to read from TUN interface".to_string()));
+            return Err(io::Error::last_os_error());
         }
         
-        buffer.truncate(bytes_read as usize);
-        Ok(Bytes::from(buffer))
+        // The kernel initialised exactly bytes_read bytes of spare capacity
+        unsafe { buffer.set_len(bytes_read as usize) };
+        Ok(buffer.freeze())
+    }
+
+    fn read_offloaded(&mut self) -> io::Result<Bytes> {
+        let bytes_read = unsafe {
+            libc::read(self.fd, self.super_buf.as_mut_ptr() as *mut c_void, self.super_buf.len())
+        };
+        
+        if bytes_read < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        
+        let frame = &self.super_buf[..bytes_read as usize];
+        let hdr = VirtioNetHdr::decode(frame)
+            .ok_or_else(|| io::Error::new(io::ErrorKind::InvalidData, "short read from offloaded TUN interface"))?;
+        let mut segments = Vec::new();
+        offload::segment(&hdr, &frame[VIRTIO_NET_HDR_LEN..], &mut self.segment_buf, &mut segments)
+            .map_err(|e| io::Error::new(io::ErrorKind::InvalidData, e.to_string()))?;
+        
+        let mut segments = segments.into_iter();
+        let first = segments.next().unwrap_or_default();
+        self.pending.extend(segments);
+        Ok(first)
     }
 
     /// Write packet to TUN interface
+    ///
+    /// Waits for the device through the runtime, never blocking its thread.
     pub async fn write_packet(&mut self, packet: Bytes) -> Result<()> {
-        let bytes_written = unsafe {
-            libc::write(
-                self.fd,
-                packet.as_ptr() as *const c_void,
-                packet.len(),
-            )
+        let async_fd = self.async_fd()?;
+        loop {
+            let mut guard = async_fd.writable().await.map_err(write_error)?;
+            match guard.try_io(|_| self.write_once(&packet)) {
+                Ok(Ok(())) => return Ok(()),
+                Ok(Err(e)) if e.kind() == io::ErrorKind::Interrupted => {}
+                Ok(Err(e)) => return Err(write_error(e)),
+                Err(_would_block) => {}
+            }
+        }
+    }
+
+    /// Write one packet, blocking while the device is busy
+    pub fn write_packet_blocking(&mut self, packet: &[u8]) -> Result<()> {
+        loop {
+            match self.write_once(packet) {
+                Ok(()) => return Ok(()),
+                Err(e) if e.kind() == io::ErrorKind::WouldBlock => wait_fd(self.fd, libc::POLLOUT).map_err(write_error)?,
+                Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
+                Err(e) => return Err(write_error(e)),
+            }
+        }
+    }
+
+    /// One write(2) of `packet`, behind a virtio_net_hdr when offload is enabled
+    fn write_once(&self, packet: &[u8]) -> io::Result<()> {
+        let expected = packet.len() + if self.vnet_hdr { VIRTIO_NET_HDR_LEN } else { 0 };
+        let bytes_written = if self.vnet_hdr {
+            let hdr = VirtioNetHdr::default().encode();
+            let iov = [
+                libc::iovec { iov_base: hdr.as_ptr() as *mut c_void, iov_len: hdr.len() },
+                libc::iovec { iov_base: packet.as_ptr() as *mut c_void, iov_len: packet.len() },
+            ];
+            unsafe { libc::writev(self.fd, iov.as_ptr(), iov.len() as c_int) }
+        } else {
+            unsafe {
+                libc::write(
+                    self.fd,
+                    packet.as_ptr() as *const c_void,
+                    packet.len(),
+                )
+            }
         };
         
         if bytes_written < 0 {
-            return Err(VpnError::TunTap("Failed to write to TUN interface".to_string()));
+            return Err(io::Error::last_os_error());
         }
         
-        if bytes_written != packet.len() as isize {
-            return Err(VpnError::TunTap("Incomplete write to TUN interface".to_string()));
+        if bytes_written != expected as isize {
+            return Err(io::Error::new(io::ErrorKind::WriteZero, "incomplete write"));
         }
         
         Ok(())
     }
 
+    /// Write a batch of packets, coalescing TCP segments when offload is enabled
+    ///
+    /// Returns the number of writes issued.
+    pub fn write_packets<I: IntoIterator<Item = Bytes>>(&mut self, packets: I) -> Result<usize> {
+        if !self.vnet_hdr {
+            let mut writes = 0;
+            for packet in packets {
+                self.write_packet_blocking(&packet)?;
+                writes += 1;
+            }
+            return Ok(writes);
+        }
+        
+        for packet in packets {
+            self.gro.push(packet);
+        }
+        let mut device = TunFd(self.fd);
+        let mut writes = 0;
+        let mut result = Ok(());
+        for frame in self.gro.drain() {
+            if result.is_err() {
+                continue;
+            }
+            result = frame
+                .write_to(&mut device)
+                .map(|_| writes += 1)
+                .map_err(|e| VpnError::TunTap(format!("Failed to write to TUN interface: {}", e)));
+        }
+        result.map(|()| writes)
+    }
+
+    /// Read buffer pool counters
+    pub fn buffer_pool_stats(&self) -> BufferPoolStats {
+        self.buffer_pool.stats()
+    }
+
     /// Set interface as persistent
     pub fn set_persistent(&self, persistent: bool) -> Result<()> {
         let value = if persistent { 1 } else { 0 };
@@ -271,6 +587,16 @@ impl LinuxTunInterface {
 
     /// Set MTU
     pub fn set_mtu(&mut self, mtu: u32) -> Result<()> {
+        let netlink_result = Netlink::link_index(&self.interface_name)
+            .and_then(|index| Netlink::open()?.set_mtu(index, mtu));
+        match netlink_result {
+            Ok(()) => {
+                self.apply_mtu(mtu);
+                return Ok(());
+            }
+            Err(e) => log::debug!("Netlink MTU change failed, using ip commands: {}", e),
+        }
+
         let mtu_cmd = format!("sudo ip link set dev {} mtu {}", self.interface_name, mtu);
         
         let output = std::process::Command::new("sh")
@@ -280,8 +606,7 @@ impl LinuxTunInterface {
             .map_err(|e| VpnError::TunTap(format!("Failed to set MTU: {}", e)))?;
         
         if output.status.success() {
-            self.mtu = mtu;
-            log::info!("MTU set to {}", mtu);
+            self.apply_mtu(mtu);
         } else {
             let error_msg = String::from_utf8_lossy(&output.stderr);
             log::warn!("Failed to set MTU: {}", error_msg);
@@ -290,6 +615,15 @@ impl LinuxTunInterface {
         Ok(())
     }
 
+    /// Record a new MTU, growing receive buffers to fit
+    fn apply_mtu(&mut self, mtu: u32) {
+        self.mtu = mtu;
+        if mtu as usize > self.buffer_pool.buffer_size() {
+            self.buffer_pool = BufferPool::for_mtu(mtu as usize);
+        }
+        log::info!("MTU set to {}", mtu);
+    }
+
     /// Check if interface is up
     pub fn is_connected(&self) -> bool {
         self.is_connected
@@ -336,10 +670,17 @@ impl LinuxTunInterface {
             log::info!("Cleaning up TUN interface: {}", self.interface_name);
             
             // Remove interface - it's usually cleaned up automatically when the fd is closed
-            // Just close the file descriptor
+            // Just close the file descriptor, after leaving the reactor
+            self.async_fd = None;
             unsafe {
                 libc::close(self.fd);
             }
+            for queue_fd in self.extra_queues.drain(..) {
+                unsafe {
+                    libc::close(queue_fd);
+                }
+            }
+            self.fd = -1;
             
             self.is_connected = false;
             log::info!("TUN interface cleaned up successfully");
@@ -356,47 +697,127 @@ impl AsRawFd for LinuxTunInterface {
 
 impl Drop for LinuxTunInterface {
     fn drop(&mut self) {
+        self.async_fd = None;
         if self.fd >= 0 {
             unsafe {
                 libc::close(self.fd);
             }
             log::info!("Linux TUN interface closed: {}", self.interface_name);
         }
+        for &queue_fd in &self.extra_queues {
+            unsafe {
+                libc::close(queue_fd);
+            }
+        }
     }
 }
 
 // Async I/O traits implementation
+//
+// Raw frames, one per read or write: with offload enabled they carry the
+// virtio_net_hdr, and super-packets are not segmented.
 impl AsyncRead for LinuxTunInterface {
     fn poll_read(
-        mut self: Pin<&mut Self>,
+        self: Pin<&mut Self>,
         cx: &mut Context<'_>,
         buf: &mut ReadBuf<'_>,
     ) -> Poll<io::Result<()>> {
-        // This would use epoll for real async implementation
-        // For now, return pending to avoid blocking
-        Poll::Pending
+        let async_fd = self.get_mut().async_fd().map_err(io::Error::other)?;
+        loop {
+            let mut guard = ready!(async_fd.poll_read_ready(cx))?;
+            let unfilled = buf.initialize_unfilled();
+            let read = guard.try_io(|fd| {
+                let n = unsafe { libc::read(*fd.get_ref(), unfilled.as_mut_ptr() as *mut c_void, unfilled.len()) };
+                if n < 0 { Err(io::Error::last_os_error()) } else { Ok(n as usize) }
+            });
+            if let Ok(n) = read {
+                buf.advance(n?);
+                return Poll::Ready(Ok(()));
+            }
+        }
     }
 }
 
 impl AsyncWrite for LinuxTunInterface {
     fn poll_write(
-        mut self: Pin<&mut Self>,
+        self: Pin<&mut Self>,
         cx: &mut Context<'_>,
         buf: &[u8],
     ) -> Poll<io::Result<usize>> {
-        // This would use epoll for real async implementation
-        Poll::Pending
+        let async_fd = self.get_mut().async_fd().map_err(io::Error::other)?;
+        loop {
+            let mut guard = ready!(async_fd.poll_write_ready(cx))?;
+            let written = guard.try_io(|fd| {
+                let n = unsafe { libc::write(*fd.get_ref(), buf.as_ptr() as *const c_void, buf.len()) };
+                if n < 0 { Err(io::Error::last_os_error()) } else { Ok(n as usize) }
+            });
+            if let Ok(result) = written {
+                return Poll::Ready(result);
+            }
+        }
     }
 
-    fn poll_flush(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<io::Result<()>> {
+    fn poll_flush(self: Pin<&mut Self>, _cx: &mut Context<'_>) -> Poll<io::Result<()>> {
         Poll::Ready(Ok(()))
     }
 
-    fn poll_shutdown(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<io::Result<()>> {
+    fn poll_shutdown(self: Pin<&mut Self>, _cx: &mut Context<'_>) -> Poll<io::Result<()>> {
         Poll::Ready(Ok(()))
     }
 }
 
+/// Wait until `fd` has `events` (POLLIN / POLLOUT) ready
+fn wait_fd(fd: RawFd, events: libc::c_short) -> io::Result<()> {
+    let mut pollfd = libc::pollfd { fd, events, revents: 0 };
+    loop {
+        if unsafe { libc::poll(&mut pollfd, 1, -1) } >= 0 {
+            return Ok(());
+        }
+        let err = io::Error::last_os_error();
+        if err.kind() != io::ErrorKind::Interrupted {
+            return Err(err);
+        }
+    }
+}
+
+fn read_error(e: io::Error) -> VpnError {
+    VpnError::TunTap(format!("Failed to read from TUN interface: {}", e))
+}
+
+fn write_error(e: io::Error) -> VpnError {
+    VpnError::TunTap(format!("Failed to write to TUN interface: {}", e))
+}
+
+/// Borrowed TUN descriptor usable as a `Write`
+struct TunFd(RawFd);
+
+impl io::Write for TunFd {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        self.write_vectored(&[io::IoSlice::new(buf)])
+    }
+
+    fn write_vectored(&mut self, bufs: &[io::IoSlice<'_>]) -> io::Result<usize> {
+        loop {
+            // IoSlice is ABI-compatible with iovec on unix
+            let written = unsafe { libc::writev(self.0, bufs.as_ptr() as *const libc::iovec, bufs.len() as c_int) };
+            if written >= 0 {
+                return Ok(written as usize);
+            }
+            let err = io::Error::last_os_error();
+            match err.kind() {
+                // Non-blocking after an async call; wait like a blocking write would
+                io::ErrorKind::WouldBlock => wait_fd(self.0, libc::POLLOUT)?,
+                io::ErrorKind::Interrupted => {}
+                _ => return Err(err),
+            }
+        }
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        Ok(())
+    }
+}
+
 /// Interface statistics
 #[derive(Debug, Default)]
 pub struct InterfaceStats {
@@ -411,6 +832,7 @@ pub struct InterfaceStats {
 /// Linux-specific TUN utilities
 pub mod linux_utils {
     use super::*;
+    use crate::tunnel::netlink::{Route, RouteBatch};
     
     /// Check if running with root privileges
     pub fn is_root() -> bool {
@@ -450,6 +872,11 @@ pub mod linux_utils {
     
     /// List network interfaces
     pub fn list_interfaces() -> Result<Vec<String>> {
+        match Netlink::open().and_then(|mut netlink| netlink.link_names()) {
+            Ok(names) => return Ok(names),
+            Err(e) => log::debug!("Netlink link dump failed, using ip commands: {}", e),
+        }
+
         let output = std::process::Command::new("ip")
             .arg("link")
             .arg("show")
@@ -477,6 +904,13 @@ pub mod linux_utils {
     
     /// Get interface IP addresses
     pub fn get_interface_ips(interface: &str) -> Result<Vec<String>> {
+        let dumped = Netlink::link_index(interface)
+            .and_then(|index| Netlink::open()?.ipv4_addresses(index));
+        match dumped {
+            Ok(ips) => return Ok(ips.iter().map(|ip| ip.to_string()).collect()),
+            Err(e) => log::debug!("Netlink address dump failed, using ip commands: {}", e),
+        }
+
         let output = std::process::Command::new("ip")
             .arg("addr")
             .arg("show")
@@ -507,6 +941,14 @@ pub mod linux_utils {
     
     /// Add route via interface
     pub fn add_route(destination: &str, interface: &str) -> Result<()> {
+        match apply_route(destination, interface, RouteBatch::add) {
+            Ok(()) => {
+                log::info!("Route added: {} via {}", destination, interface);
+                return Ok(());
+            }
+            Err(e) => log::debug!("Netlink route add failed, using ip commands: {}", e),
+        }
+
         let route_cmd = format!("sudo ip route add {} dev {}", destination, interface);
         
         let output = std::process::Command::new("sh")
@@ -526,6 +968,14 @@ pub mod linux_utils {
     
     /// Delete route via interface
     pub fn delete_route(destination: &str, interface: &str) -> Result<()> {
+        match apply_route(destination, interface, RouteBatch::delete) {
+            Ok(()) => {
+                log::info!("Route deleted: {} via {}", destination, interface);
+                return Ok(());
+            }
+            Err(e) => log::debug!("Netlink route delete failed, using ip commands: {}", e),
+        }
+
         let route_cmd = format!("sudo ip route del {} dev {}", destination, interface);
         
         let output = std::process::Command::new("sh")
@@ -543,6 +993,29 @@ pub mod linux_utils {
         
         Ok(())
     }
+
+    /// Parse `a.b.c.d[/len]` (or `default`) and apply one route change over rtnetlink
+    fn apply_route(
+        destination: &str,
+        interface: &str,
+        change: fn(&mut RouteBatch, Route) -> &mut RouteBatch,
+    ) -> Result<()> {
+        let invalid = || VpnError::Routing(format!("Invalid route destination '{}'", destination));
+        let route = if destination == "default" {
+            Route::default_route()
+        } else {
+            let (address, prefix_len) = destination.split_once('/').unwrap_or((destination, "32"));
+            let prefix_len: u8 = prefix_len.parse().ok().filter(|len| *len <= 32).ok_or_else(invalid)?;
+            Route::new(address.parse().map_err(|_| invalid())?, prefix_len)
+        };
+
+        let mut batch = RouteBatch::new();
+        change(&mut batch, route.dev(Netlink::link_index(interface)?));
+        match Netlink::open()?.apply(&batch)?.into_iter().next() {
+            Some(failure) => Err(VpnError::Routing(failure)),
+            None => Ok(()),
+        }
+    }
 }
 
 /// Extension trait for piping values
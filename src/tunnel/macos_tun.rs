@@ -1,6 +1,12 @@
 //! macOS utun Interface Implementation
 //! 
 //! Provides macOS-specific TUN interface management using the native utun driver
+//!
+//! Every utun frame starts with a 4-byte address family header. Reads leave
+//! it in the buffer and hand out the packet behind it; writes send it as a
+//! separate iovec, so packets are never shifted to add or strip it.
+//! [`UtunBatch`] moves many frames per system call with Darwin's
+//! `recvmsg_x`/`sendmsg_x`.
 
 use crate::error::{Result, VpnError};
 use std::os::unix::io::{AsRawFd, RawFd};
@@ -20,12 +26,20 @@ use std::mem;
 const UTUN_CONTROL_NAME: &str = "com.apple.net.utun_control";
 const UTUN_OPT_IFNAME: c_int = 2;
 
+/// Length of the address family header on every utun frame
+pub const UTUN_HEADER_LEN: usize = 4;
+
+/// Packets moved per batched read or write of the interface
+const INTERFACE_BATCH: usize = 32;
+
 /// macOS utun interface
 pub struct MacOSUtunInterface {
     fd: RawFd,
     interface_name: String,
     is_connected: bool,
     mtu: u32,
+    batch: UtunBatch,
+    read_buf: BytesMut,
 }
 
 impl MacOSUtunInterface {
@@ -43,6 +57,8 @@ impl MacOSUtunInterface {
             interface_name,
             is_connected: false,
             mtu: 1500, // Default MTU
+            batch: UtunBatch::new(INTERFACE_BATCH),
+            read_buf: BytesMut::new(),
         })
     }
 
@@ -172,7 +188,8 @@ impl MacOSUtunInterface {
 
     /// Read packet from utun interface
     pub async fn read_packet(&mut self) -> Result<Bytes> {
-        let mut buffer = vec![0u8; self.mtu as usize + 4]; // +4 for protocol family
+        let frame_size = self.mtu as usize + UTUN_HEADER_LEN;
+        let mut buffer = BytesMut::zeroed(frame_size);
         
         let bytes_read = unsafe {
             libc::read(self.fd, buffer.as_mut_ptr() as *mut c_void, buffer.len())
@@ -182,41 +199,41 @@ impl MacOSUtunInterface {
             return Err(VpnError::TunTap("Failed to read from utun".to_string()));
         }
         
-        if bytes_read < 4 {
+        if (bytes_read as usize) < UTUN_HEADER_LEN {
             return Err(VpnError::TunTap("Packet too short".to_string()));
         }
         
-        // Skip the 4-byte protocol family header
-        buffer.drain(0..4);
-        buffer.truncate(bytes_read as usize - 4);
-        
-        Ok(Bytes::from(buffer))
+        // The packet starts behind the protocol family header
+        buffer.truncate(bytes_read as usize);
+        Ok(buffer.freeze().slice(UTUN_HEADER_LEN..))
     }
 
     /// Write packet to utun interface
-    pub async fn write_packet(&mut self, mut packet: Bytes) -> Result<()> {
-        // Prepend 4-byte protocol family (AF_INET = 2)
-        let mut full_packet = BytesMut::with_capacity(packet.len() + 4);
-        full_packet.extend_from_slice(&[0, 0, 0, 2]); // AF_INET in network byte order
-        full_packet.extend_from_slice(&packet);
-        
-        let bytes_written = unsafe {
-            libc::write(
-                self.fd,
-                full_packet.as_ptr() as *const c_void,
-                full_packet.len(),
-            )
-        };
-        
-        if bytes_written < 0 {
-            return Err(VpnError::TunTap("Failed to write to utun".to_string()));
-        }
-        
-        if bytes_written != full_packet.len() as isize {
-            return Err(VpnError::TunTap("Incomplete write to utun".to_string()));
+    pub async fn write_packet(&mut self, packet: Bytes) -> Result<()> {
+        write_frame(self.fd, &packet).map_err(|e| VpnError::TunTap(format!("Failed to write to utun: {}", e)))
+    }
+
+    /// Read the packets that are ready, waiting until there is at least one
+    ///
+    /// Packets are appended to `out`; returns how many frames were read.
+    pub fn read_packets(&mut self, out: &mut Vec<Bytes>) -> Result<usize> {
+        let frame_size = self.mtu as usize + UTUN_HEADER_LEN;
+        loop {
+            match self.batch.recv(self.fd, &mut self.read_buf, frame_size, out) {
+                Ok(frames) => return Ok(frames),
+                Err(e) if e.kind() == io::ErrorKind::WouldBlock => wait_readable(self.fd)
+                    .map_err(|e| VpnError::TunTap(format!("Failed to wait for utun: {}", e)))?,
+                Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
+                Err(e) => return Err(VpnError::TunTap(format!("Failed to read from utun: {}", e))),
+            }
         }
-        
-        Ok(())
+    }
+
+    /// Write a batch of packets; returns how many the kernel accepted
+    pub fn write_packets(&mut self, packets: &[Bytes]) -> Result<usize> {
+        self.batch.send(self.fd, packets)
+            .map(|(accepted, _)| accepted)
+            .map_err(|e| VpnError::TunTap(format!("Failed to write to utun: {}", e)))
     }
 
     /// Get interface name
@@ -352,6 +369,257 @@ pub struct InterfaceStats {
 /// macOS-specific constants (should be defined in libc but may be missing)
 const AF_SYS_CONTROL: u8 = 2;
 
+/// `struct msghdr_x` from Darwin's sys/socket.h
+#[repr(C)]
+struct MsgHdrX {
+    msg_name: *mut c_void,
+    msg_namelen: libc::socklen_t,
+    msg_iov: *mut libc::iovec,
+    msg_iovlen: c_int,
+    msg_control: *mut c_void,
+    msg_controllen: libc::socklen_t,
+    msg_flags: c_int,
+    msg_datalen: libc::size_t,
+}
+
+extern "C" {
+    // Darwin's batch socket calls; private, but exported by libSystem since 10.10
+    fn recvmsg_x(s: c_int, msgp: *const MsgHdrX, cnt: libc::c_uint, flags: c_int) -> libc::ssize_t;
+    fn sendmsg_x(s: c_int, msgp: *const MsgHdrX, cnt: libc::c_uint, flags: c_int) -> libc::ssize_t;
+}
+
+/// Batched utun reads and writes: many frames per system call
+///
+/// Holds the message headers and iovecs the calls need so a batch costs no
+/// allocation. Descriptors that do not support the batch calls (older
+/// kernels, pipes in tests) fall back to one read or writev per frame.
+pub struct UtunBatch {
+    max_packets: usize,
+    msgs: Vec<MsgHdrX>,
+    iovecs: Vec<libc::iovec>,
+    headers: Vec<[u8; UTUN_HEADER_LEN]>,
+    batched: bool,
+}
+
+// The raw pointers in `msgs` and `iovecs` only live for the duration of a call
+unsafe impl Send for UtunBatch {}
+
+impl UtunBatch {
+    pub fn new(max_packets: usize) -> Self {
+        let max_packets = max_packets.max(1);
+        Self {
+            max_packets,
+            msgs: Vec::with_capacity(max_packets),
+            iovecs: Vec::with_capacity(2 * max_packets),
+            headers: Vec::with_capacity(max_packets),
+            batched: true,
+        }
+    }
+
+    /// Read the frames that are ready, up to the batch size, without waiting
+    ///
+    /// Frames of up to `frame_size` bytes land next to each other in the
+    /// spare capacity of `buf`, which grows by a batch only when it runs low;
+    /// their packets are appended to `out` as slices of it, behind the address
+    /// family header. Returns the number of frames read, runts included.
+    /// Batch reads fail with `WouldBlock` when nothing is ready; the
+    /// one-frame fallback blocks on a blocking descriptor.
+    pub fn recv(&mut self, fd: RawFd, buf: &mut BytesMut, frame_size: usize, out: &mut Vec<Bytes>) -> io::Result<usize> {
+        let slots = if self.batched { self.max_packets } else { 1 };
+        buf.clear();
+        // Reuse the tail left by earlier reads until it holds under a quarter batch
+        if buf.capacity() < frame_size * slots.div_ceil(4) {
+            buf.reserve(slots * frame_size);
+        }
+        let slots = slots.min(buf.capacity() / frame_size);
+        // Frames are read into spare capacity; only what the kernel wrote joins `buf`
+        let base = buf.as_mut_ptr();
+
+        let frames = if self.batched {
+            self.iovecs.clear();
+            self.msgs.clear();
+            for slot in 0..slots {
+                self.iovecs.push(libc::iovec {
+                    iov_base: unsafe { base.add(slot * frame_size) } as *mut c_void,
+                    iov_len: frame_size,
+                });
+            }
+            let iovecs = self.iovecs.as_mut_ptr();
+            for slot in 0..slots {
+                self.msgs.push(MsgHdrX::for_iov(unsafe { iovecs.add(slot) }, 1));
+            }
+            let received = unsafe { recvmsg_x(fd, self.msgs.as_ptr(), slots as libc::c_uint, libc::MSG_DONTWAIT) };
+            if received < 0 {
+                let err = io::Error::last_os_error();
+                if !batch_unsupported(&err) {
+                    return Err(err);
+                }
+                log::info!("utun batch reads unavailable ({}); reading one frame at a time", err);
+                self.batched = false;
+                return self.recv(fd, buf, frame_size, out);
+            }
+            received as usize
+        } else {
+            let n = unsafe { libc::read(fd, base as *mut c_void, frame_size) };
+            if n < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            if n == 0 {
+                return Err(io::ErrorKind::UnexpectedEof.into());
+            }
+            let n = n as usize;
+            if n > UTUN_HEADER_LEN {
+                // Safety: the kernel wrote `n` bytes at `base`
+                unsafe { buf.set_len(n) };
+                out.push(buf.split().freeze().slice(UTUN_HEADER_LEN..));
+            }
+            return Ok(1);
+        };
+
+        let end = match frames {
+            0 => 0,
+            n => (n - 1) * frame_size + self.msgs[n - 1].msg_datalen,
+        };
+        // The kernel leaves the tail of each slot but the last unwritten;
+        // zero those gaps so every byte up to `end` is initialised
+        for (slot, msg) in self.msgs[..frames.saturating_sub(1)].iter().enumerate() {
+            unsafe { std::ptr::write_bytes(base.add(slot * frame_size + msg.msg_datalen), 0, frame_size - msg.msg_datalen) };
+        }
+        // Safety: `end` is within the reserved capacity and initialised
+        unsafe { buf.set_len(end) };
+        let chunk = buf.split().freeze();
+        for (slot, msg) in self.msgs[..frames].iter().enumerate() {
+            if msg.msg_datalen > UTUN_HEADER_LEN {
+                let start = slot * frame_size;
+                out.push(chunk.slice(start + UTUN_HEADER_LEN..start + msg.msg_datalen));
+            }
+        }
+        Ok(frames)
+    }
+
+    /// Write `packets`, each behind its address family header
+    ///
+    /// Returns how many packets, and how many of their bytes, the kernel
+    /// accepted; packets it rejects as invalid are dropped, as a NIC would.
+    pub fn send(&mut self, fd: RawFd, packets: &[Bytes]) -> io::Result<(usize, usize)> {
+        let mut sent = 0;
+        while self.batched && sent < packets.len() {
+            let batch = &packets[sent..packets.len().min(sent + self.max_packets)];
+            self.headers.clear();
+            self.headers.extend(batch.iter().map(|packet| af_header(packet)));
+            self.iovecs.clear();
+            for (header, packet) in self.headers.iter().zip(batch) {
+                self.iovecs.push(libc::iovec { iov_base: header.as_ptr() as *mut c_void, iov_len: header.len() });
+                self.iovecs.push(libc::iovec { iov_base: packet.as_ptr() as *mut c_void, iov_len: packet.len() });
+            }
+            let iovecs = self.iovecs.as_mut_ptr();
+            self.msgs.clear();
+            for index in 0..batch.len() {
+                self.msgs.push(MsgHdrX::for_iov(unsafe { iovecs.add(2 * index) }, 2));
+            }
+
+            let n = unsafe { sendmsg_x(fd, self.msgs.as_ptr(), batch.len() as libc::c_uint, 0) };
+            if n > 0 {
+                sent += n as usize;
+                continue;
+            }
+            let err = if n == 0 { io::ErrorKind::WriteZero.into() } else { io::Error::last_os_error() };
+            if err.kind() == io::ErrorKind::Interrupted {
+                continue;
+            }
+            if batch_unsupported(&err) {
+                log::info!("utun batch writes unavailable ({}); writing one frame at a time", err);
+                self.batched = false;
+            }
+            // Finish frame by frame, which tells which packet was refused
+            break;
+        }
+
+        let mut accepted = sent;
+        let mut bytes: usize = packets[..sent].iter().map(|packet| packet.len()).sum();
+        for packet in &packets[sent..] {
+            loop {
+                match write_frame(fd, packet) {
+                    Ok(()) => {
+                        accepted += 1;
+                        bytes += packet.len();
+                    }
+                    Err(e) if e.kind() == io::ErrorKind::Interrupted => continue,
+                    Err(e) if e.kind() == io::ErrorKind::InvalidInput => {
+                        log::debug!("utun rejected {} byte packet: {}", packet.len(), e);
+                    }
+                    Err(e) => return Err(e),
+                }
+                break;
+            }
+        }
+        Ok((accepted, bytes))
+    }
+}
+
+impl MsgHdrX {
+    fn for_iov(iov: *mut libc::iovec, iovlen: c_int) -> Self {
+        Self {
+            msg_name: std::ptr::null_mut(),
+            msg_namelen: 0,
+            msg_iov: iov,
+            msg_iovlen: iovlen,
+            msg_control: std::ptr::null_mut(),
+            msg_controllen: 0,
+            msg_flags: 0,
+            msg_datalen: 0,
+        }
+    }
+}
+
+/// Whether `err` says the descriptor cannot do batch calls at all
+fn batch_unsupported(err: &io::Error) -> bool {
+    matches!(
+        err.raw_os_error(),
+        Some(libc::ENOSYS) | Some(libc::ENOTSUP) | Some(libc::EOPNOTSUPP) | Some(libc::ENOTSOCK)
+    )
+}
+
+/// Address family header for `packet`, from its IP version
+fn af_header(packet: &[u8]) -> [u8; UTUN_HEADER_LEN] {
+    let family = match packet.first().map(|b| b >> 4) {
+        Some(6) => libc::AF_INET6,
+        _ => libc::AF_INET,
+    };
+    (family as u32).to_be_bytes()
+}
+
+/// Write one frame: the address family header, then `packet`
+fn write_frame(fd: RawFd, packet: &[u8]) -> io::Result<()> {
+    let header = af_header(packet);
+    let iov = [
+        libc::iovec { iov_base: header.as_ptr() as *mut c_void, iov_len: header.len() },
+        libc::iovec { iov_base: packet.as_ptr() as *mut c_void, iov_len: packet.len() },
+    ];
+    let written = unsafe { libc::writev(fd, iov.as_ptr(), iov.len() as c_int) };
+    if written < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    if written as usize != header.len() + packet.len() {
+        return Err(io::Error::new(io::ErrorKind::WriteZero, "incomplete write to utun"));
+    }
+    Ok(())
+}
+
+/// Wait until `fd` is readable
+fn wait_readable(fd: RawFd) -> io::Result<()> {
+    let mut pollfd = libc::pollfd { fd, events: libc::POLLIN, revents: 0 };
+    loop {
+        if unsafe { libc::poll(&mut pollfd, 1, -1) } >= 0 {
+            return Ok(());
+        }
+        let err = io::Error::last_os_error();
+        if err.kind() != io::ErrorKind::Interrupted {
+            return Err(err);
+        }
+    }
+}
+
 /// macOS-specific TUN utilities
 pub mod macos_utils {
     use super::*;
@@ -443,6 +711,36 @@ mod tests {
         println!("Found utun interfaces: {:?}", interfaces);
     }
 
+    #[test]
+    fn test_utun_batch_round_trip_strips_af_header() {
+        let mut fds = [0; 2];
+        assert_eq!(unsafe { libc::socketpair(libc::AF_UNIX, libc::SOCK_DGRAM, 0, fds.as_mut_ptr()) }, 0);
+        let packets = [Bytes::from_static(&[0x45, 1, 2, 3]), Bytes::from_static(&[0x60, 4, 5])];
+
+        let mut batch = UtunBatch::new(8);
+        assert_eq!(batch.send(fds[0], &packets).unwrap(), (2, 7));
+
+        let mut buf = BytesMut::with_capacity(4096);
+        let chunk = buf.as_ptr() as usize..buf.as_ptr() as usize + 4096;
+        let mut received = Vec::new();
+        while received.len() < packets.len() {
+            batch.recv(fds[1], &mut buf, 64, &mut received).unwrap();
+        }
+        assert_eq!(received, packets);
+
+        // Later wakeups read into the tail of the same chunk
+        assert_eq!(batch.send(fds[0], &packets[..1]).unwrap(), (1, 4));
+        while received.len() < 3 {
+            batch.recv(fds[1], &mut buf, 64, &mut received).unwrap();
+        }
+        assert_eq!(received[2], packets[0]);
+        assert!(received.iter().all(|packet| chunk.contains(&(packet.as_ptr() as usize))));
+        unsafe {
+            libc::close(fds[0]);
+            libc::close(fds[1]);
+        }
+    }
+
     #[test]
     fn test_routing_table() {
         let routes = macos_utils::get_routing_table().unwrap_or_default();
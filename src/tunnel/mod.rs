@@ -15,6 +15,10 @@ use regex::Regex;
 mod linux;
 #[cfg(target_os = "linux")]
 pub mod linux_tun;
+#[cfg(target_os = "linux")]
+pub mod netlink;
+#[cfg(target_os = "linux")]
+pub mod uring;
 
 #[cfg(target_os = "macos")]
 mod macos;
@@ -25,9 +29,30 @@ pub mod macos_tun;
 mod windows;
 #[cfg(target_os = "windows")]
 pub mod windows_tun;
+#[cfg(target_os = "windows")]
+pub mod wintun;
 
 pub mod real_tun;
 pub mod packet_framing;
+#[cfg(unix)]
+pub mod pump;
+#[cfg(unix)]
+pub mod mtu;
+#[cfg(unix)]
+pub mod offload;
+
+/// Future that opens the data channel a packet pump forwards to
+#[cfg(any(unix, target_os = "windows"))]
+pub type DataChannelConnect =
+    std::pin::Pin<Box<dyn std::future::Future<Output = Result<crate::protocol::binary::BinaryProtocolClient>> + Send>>;
+
+/// Bytes per Wintun ring (4 MiB each way)
+#[cfg(target_os = "windows")]
+const WINTUN_RING_CAPACITY: u32 = 0x40_0000;
+
+/// Most packets the Wintun pump moves per burst
+#[cfg(target_os = "windows")]
+const WINTUN_BATCH_SIZE: usize = 64;
 
 /// TUN interface configuration
 #[derive(Debug, Clone)]
@@ -101,6 +126,30 @@ pub struct TunnelManager {
     packet_rx: Option<mpsc::UnboundedReceiver<Vec<u8>>>,
     // Packet framing for proper VPN encapsulation
     packet_framer: Option<packet_framing::SharedPacketFramer>,
+    // Data channels handed over by the client, consumed when the pump starts
+    #[cfg(any(unix, target_os = "windows"))]
+    data_channel: Option<(tokio::runtime::Handle, Vec<DataChannelConnect>)>,
+    // Number of TUN queues to open (Linux multi-queue when > 1)
+    tun_queues: usize,
+    // Open the TUN device with segmentation offload (Linux IFF_VNET_HDR)
+    tun_offload: bool,
+    // Clamp the MSS of forwarded TCP SYNs to the tunnel MTU
+    mss_clamp: bool,
+    // Resize the TUN MTU to the data channel's path MTU
+    adaptive_mtu: bool,
+    // Drive the packet pump's TUN I/O through io_uring
+    tun_io_uring: bool,
+    // Native TUN device, used instead of `tun_device` for multi-queue or offload
+    #[cfg(target_os = "linux")]
+    native_device: Option<linux_tun::LinuxTunInterface>,
+    // TUN <-> data channel forwarding
+    #[cfg(unix)]
+    packet_pump: Option<pump::PacketPump>,
+    // Use a Wintun adapter and its ring-buffer pump instead of TAP-Windows
+    #[cfg(target_os = "windows")]
+    wintun: bool,
+    #[cfg(target_os = "windows")]
+    wintun_pump: Option<wintun::WintunPump>,
 }
 
 impl TunnelManager {
@@ -124,6 +173,106 @@ impl TunnelManager {
                 session_id, 
                 config.remote_ip.into()
             )),
+            #[cfg(any(unix, target_os = "windows"))]
+            data_channel: None,
+            tun_queues: 1,
+            tun_offload: false,
+            mss_clamp: false,
+            adaptive_mtu: false,
+            tun_io_uring: false,
+            #[cfg(target_os = "linux")]
+            native_device: None,
+            #[cfg(unix)]
+            packet_pump: None,
+            #[cfg(target_os = "windows")]
+            wintun: false,
+            #[cfg(target_os = "windows")]
+            wintun_pump: None,
+        }
+    }
+
+    /// Hand over the data channel the packet routing loop forwards TUN traffic to
+    ///
+    /// `connect` resolves to an established binary protocol client and is
+    /// driven on `runtime` once the tunnel is up.
+    #[cfg(unix)]
+    pub fn attach_data_channel(&mut self, runtime: tokio::runtime::Handle, connect: pump::DataChannelConnect) {
+        self.data_channel = Some((runtime, vec![connect]));
+    }
+
+    /// Hand over one data channel per TUN queue worker
+    ///
+    /// Queue `q` sends through channel `q % connects.len()`; see
+    /// [`pump::PacketPump::start_multi_queue`].
+    /// On Windows only the first channel is used, by the Wintun pump.
+    #[cfg(any(unix, target_os = "windows"))]
+    pub fn attach_data_channels(&mut self, runtime: tokio::runtime::Handle, connects: Vec<DataChannelConnect>) {
+        self.data_channel = Some((runtime, connects));
+    }
+
+    /// Set how many TUN queues to open when the tunnel is established
+    ///
+    /// Values above 1 open a Linux multi-queue device and run one packet pump
+    /// worker per queue; other platforms always use a single queue.
+    pub fn set_tun_queues(&mut self, queues: usize) {
+        self.tun_queues = queues.max(1);
+    }
+
+    /// Enable TSO/USO segmentation offload on the TUN device
+    ///
+    /// Linux only; ignored elsewhere.
+    pub fn set_tun_offload(&mut self, enabled: bool) {
+        self.tun_offload = enabled;
+    }
+
+    /// Clamp the MSS option of TCP SYNs crossing the tunnel to fit its MTU
+    pub fn set_mss_clamp(&mut self, enabled: bool) {
+        self.mss_clamp = enabled;
+    }
+
+    /// Lower (and later restore) the TUN MTU as the data channel's path MTU changes
+    ///
+    /// Linux only; ignored elsewhere. The configured MTU stays the ceiling.
+    pub fn set_adaptive_mtu(&mut self, enabled: bool) {
+        self.adaptive_mtu = enabled;
+    }
+
+    /// Read and write the TUN device through io_uring instead of poll(2)
+    ///
+    /// Linux 5.6+ only; the pump falls back to poll elsewhere.
+    pub fn set_tun_io_uring(&mut self, enabled: bool) {
+        self.tun_io_uring = enabled;
+    }
+
+    /// Run the tunnel on a Wintun adapter with the ring-buffer packet pump
+    ///
+    /// Windows only; ignored elsewhere. Needs `wintun.dll` next to the
+    /// application or in System32.
+    pub fn set_wintun(&mut self, enabled: bool) {
+        #[cfg(target_os = "windows")]
+        {
+            self.wintun = enabled;
+        }
+        #[cfg(not(target_os = "windows"))]
+        let _ = enabled;
+    }
+
+    /// Packet pump counters, if the pump is running
+    #[cfg(unix)]
+    pub fn pump_stats(&self) -> Option<&pump::PumpStats> {
+        self.packet_pump.as_ref().filter(|pump| pump.is_running()).map(|pump| pump.stats())
+    }
+
+    /// Move a running tunnel onto new data channels
+    ///
+    /// The TUN device, routes and DNS stay as they are; see
+    /// [`pump::PacketPump::resume`]. Needs one channel per data channel
+    /// originally attached.
+    #[cfg(unix)]
+    pub fn resume_data_channels(&mut self, connects: Vec<pump::DataChannelConnect>) -> Result<()> {
+        match self.packet_pump.as_ref() {
+            Some(pump) => pump.resume(connects),
+            None => Err(VpnError::InvalidState("Tunnel has no running packet pump to resume".to_string())),
         }
     }
 
@@ -176,11 +325,24 @@ impl TunnelManager {
     fn configure_vpn_routing(&mut self) -> Result<()> {
         println!("🛣️  Configuring VPN routing...");
 
-        // Add route for VPN server to prevent routing loop
-        self.add_vpn_server_route()?;
+        #[cfg(target_os = "linux")]
+        let routed = match self.configure_vpn_routing_netlink() {
+            Ok(()) => true,
+            Err(e) => {
+                println!("   ℹ️  Netlink routing unavailable ({}), using ip commands", e);
+                false
+            }
+        };
+        #[cfg(not(target_os = "linux"))]
+        let routed = false;
+
+        if !routed {
+            // Add route for VPN server to prevent routing loop
+            self.add_vpn_server_route()?;
 
-        // Configure VPN tunnel as default gateway
-        self.set_vpn_default_gateway()?;
+            // Configure VPN tunnel as default gateway
+            self.set_vpn_default_gateway()?;
+        }
 
         // Configure DNS to use VPN DNS servers
         self.configure_vpn_dns()?;
@@ -189,6 +351,98 @@ impl TunnelManager {
         Ok(())
     }
 
+    /// Point the default route at the tunnel with one rtnetlink batch
+    ///
+    /// Same routes and kernel settings as [`Self::add_vpn_server_route`] and
+    /// [`Self::set_vpn_default_gateway`], without forking `ip` or `sysctl`.
+    #[cfg(target_os = "linux")]
+    fn configure_vpn_routing_netlink(&self) -> Result<()> {
+        use netlink::{Netlink, Route, RouteBatch};
+
+        let tun_index = Netlink::link_index(&self.interface_name)?;
+        let mut netlink = Netlink::open()?;
+        let (default_gateway, default_interface) = netlink.default_route()?.unwrap_or((None, None));
+        let original_gateway = self.original_route.as_deref()
+            .and_then(|gateway| gateway.parse::<Ipv4Addr>().ok())
+            .or(default_gateway);
+        let remote_ip = self.config.remote_ip;
+
+        let mut batch = RouteBatch::new();
+        if let Some(gateway) = original_gateway {
+            batch.add(Route::new(remote_ip, 32).via(gateway));
+            // Keep reaching the VPN server the way we did before
+            if let Some(server) = self.get_vpn_server_ip().and_then(|ip| ip.parse::<Ipv4Addr>().ok()) {
+                let mut server_route = Route::new(server, 32).via(gateway);
+                server_route.interface = default_interface;
+                batch.replace(server_route);
+            }
+        }
+        batch
+            .delete(Route::default_route())
+            .add(Route::default_route().via(remote_ip).dev(tun_index))
+            .add(Route::new(Ipv4Addr::new(0, 0, 0, 0), 1).via(remote_ip).dev(tun_index))
+            .add(Route::new(Ipv4Addr::new(128, 0, 0, 0), 1).via(remote_ip).dev(tun_index));
+
+        let failures = netlink.apply(&batch)?;
+        for failure in &failures {
+            println!("   ⚠️  Warning: {}", failure);
+        }
+        println!("   ✅ Applied {} route changes over netlink", batch.len() - failures.len());
+
+        // Reverse path filtering drops tunnel replies; forwarding carries them
+        for (key, value) in [
+            ("net.ipv4.conf.all.rp_filter".to_string(), "0"),
+            (format!("net.ipv4.conf.{}.rp_filter", self.interface_name), "0"),
+            ("net.ipv4.ip_forward".to_string(), "1"),
+        ] {
+            if let Err(e) = netlink::write_sysctl(&key, value) {
+                println!("   ⚠️  Warning: {}", e);
+            }
+        }
+
+        self.configure_vpn_firewall();
+        Ok(())
+    }
+
+    /// NAT and forwarding rules for traffic leaving through the tunnel
+    #[cfg(target_os = "linux")]
+    fn configure_vpn_firewall(&self) {
+        // IMPROVED: Flush existing NAT rules to avoid conflicts
+        let _flush_nat = Command::new("sudo")
+            .args([
+                "iptables", "-t", "nat", "-F"
+            ])
+            .output();
+        
+        // Add NAT rule to route traffic through VPN
+        let nat_result = Command::new("sudo")
+            .args([
+                "iptables", "-t", "nat", "-A", "POSTROUTING",
+                "-o", &self.interface_name, "-j", "MASQUERADE"
+            ])
+            .output();
+        
+        if let Ok(result) = nat_result {
+            if result.status.success() {
+                println!("   ✅ Added iptables NAT rule for VPN traffic");
+            }
+        }
+        
+        // Add rule to forward traffic to VPN interface
+        let forward_result = Command::new("sudo")
+            .args([
+                "iptables", "-A", "FORWARD",
+                "-i", &self.interface_name, "-j", "ACCEPT"
+            ])
+            .output();
+        
+        if let Ok(result) = forward_result {
+            if result.status.success() {
+                println!("   ✅ Added iptables forward rule for VPN traffic");
+            }
+        }
+    }
+
     /// Add specific route for VPN server through original gateway
     fn add_vpn_server_route(&self) -> Result<()> {
         if let Some(ref original_gateway) = self.original_route {
@@ -451,40 +705,7 @@ impl TunnelManager {
                 }
             }
             
-            // IMPROVED: Flush existing NAT rules to avoid conflicts
-            let _flush_nat = Command::new("sudo")
-                .args([
-                    "iptables", "-t", "nat", "-F"
-                ])
-                .output();
-            
-            // Add NAT rule to route traffic through VPN
-            let nat_result = Command::new("sudo")
-                .args([
-                    "iptables", "-t", "nat", "-A", "POSTROUTING",
-                    "-o", &self.interface_name, "-j", "MASQUERADE"
-                ])
-                .output();
-            
-            if let Ok(result) = nat_result {
-                if result.status.success() {
-                    println!("   ✅ Added iptables NAT rule for VPN traffic");
-                }
-            }
-            
-            // Add rule to forward traffic to VPN interface
-            let forward_result = Command::new("sudo")
-                .args([
-                    "iptables", "-A", "FORWARD",
-                    "-i", &self.interface_name, "-j", "ACCEPT"
-                ])
-                .output();
-            
-            if let Ok(result) = forward_result {
-                if result.status.success() {
-                    println!("   ✅ Added iptables forward rule for VPN traffic");
-                }
-            }
+            self.configure_vpn_firewall();
             
             // Verify the route was added
             let verify_output = Command::new("ip")
@@ -781,6 +1002,18 @@ impl TunnelManager {
         println!("🔄 Restoring original routing...");
 
         if let Some(ref original_gateway) = self.original_route {
+            #[cfg(target_os = "linux")]
+            match self.restore_original_routing_netlink(original_gateway) {
+                Ok(()) => {
+                    println!("   ✅ Original routing restored");
+                    let _restore_dns = Command::new("sudo")
+                        .args(["mv", "/etc/resolv.conf.vpn_backup", "/etc/resolv.conf"])
+                        .output();
+                    return Ok(());
+                }
+                Err(e) => println!("   ℹ️  Netlink routing unavailable ({}), using ip commands", e),
+            }
+
             #[cfg(target_os = "linux")]
             {
                 // Remove VPN default route
@@ -845,6 +1078,25 @@ impl TunnelManager {
         Ok(())
     }
 
+    /// Put the original default route back in one rtnetlink batch
+    #[cfg(target_os = "linux")]
+    fn restore_original_routing_netlink(&self, original_gateway: &str) -> Result<()> {
+        use netlink::{Netlink, Route, RouteBatch};
+
+        let gateway: Ipv4Addr = original_gateway.parse()
+            .map_err(|_| VpnError::Routing(format!("Invalid gateway '{}'", original_gateway)))?;
+        let mut batch = RouteBatch::new();
+        if let Ok(tun_index) = Netlink::link_index(&self.interface_name) {
+            batch.delete(Route::default_route().dev(tun_index));
+        }
+        batch.add(Route::default_route().via(gateway));
+
+        for failure in Netlink::open()?.apply(&batch)? {
+            println!("   ⚠️  Warning: {}", failure);
+        }
+        Ok(())
+    }
+
     /// Establish platform-specific tunnel (fallback method)
     fn establish_platform_tunnel(&mut self) -> Result<()> {
         #[cfg(target_os = "linux")]
@@ -862,6 +1114,11 @@ impl TunnelManager {
 
     /// Create TUN interface using the tun crate
     fn create_tun_interface(&mut self) -> Result<()> {
+        #[cfg(target_os = "linux")]
+        if self.tun_queues > 1 || self.tun_offload {
+            return self.create_native_tun_interface();
+        }
+
         println!("   🔧 Creating TUN interface with tun crate...");
 
         // Configure TUN device
@@ -885,7 +1142,11 @@ impl TunnelManager {
                 
                 // Additional Linux-specific configuration to ensure interface is fully operational
                 #[cfg(target_os = "linux")]
-                {
+                let brought_up = netlink::Netlink::link_index(&self.interface_name)
+                    .and_then(|index| netlink::Netlink::open()?.set_link_up(index, true))
+                    .is_ok();
+                #[cfg(target_os = "linux")]
+                if !brought_up {
                     // Ensure interface is up and configured properly
                     let _up_result = Command::new("sudo")
                         .args(["ip", "link", "set", "dev", &self.interface_name, "up"])
@@ -924,6 +1185,35 @@ impl TunnelManager {
         }
     }
 
+    /// Create a native TUN interface (multi-queue and/or offloaded), one fd per packet pump worker
+    #[cfg(target_os = "linux")]
+    fn create_native_tun_interface(&mut self) -> Result<()> {
+        println!(
+            "   🔧 Creating TUN interface ({} queues, offload {})...",
+            self.tun_queues,
+            if self.tun_offload { "on" } else { "off" }
+        );
+
+        let name = Some(self.interface_name.clone());
+        let mut device = if self.tun_offload {
+            linux_tun::LinuxTunInterface::new_offloaded(name, self.tun_queues)?
+        } else {
+            linux_tun::LinuxTunInterface::new_multi_queue(name, true, self.tun_queues)?
+        };
+        // On error the device is dropped, which closes every queue
+        device.configure(
+            &self.config.local_ip.to_string(),
+            &self.config.remote_ip.to_string(),
+            &self.config.netmask.to_string(),
+        )?;
+        device.set_mtu(u32::from(self.config.mtu))?;
+
+        self.interface_name = device.interface_name().to_string();
+        self.native_device = Some(device);
+        println!("   ✅ TUN interface '{}' created with {} queues", self.interface_name, self.tun_queues);
+        Ok(())
+    }
+
     /// Start the packet routing loop for VPN traffic
     fn start_packet_routing_loop(&mut self) -> Result<()> {
         println!("🔄 Starting VPN packet routing loop...");
@@ -931,15 +1221,19 @@ impl TunnelManager {
         // Enable IP forwarding on the system
         #[cfg(target_os = "linux")]
         {
-            let forward_output = Command::new("sudo")
-                .args(["sysctl", "-w", "net.ipv4.ip_forward=1"])
-                .output();
-            
-            if let Ok(result) = forward_output {
-                if result.status.success() {
-                    println!("   ✅ Enabled IP forwarding");
-                } else {
-                    println!("   ⚠️ Warning: Failed to enable IP forwarding");
+            if netlink::write_sysctl("net.ipv4.ip_forward", "1").is_ok() {
+                println!("   ✅ Enabled IP forwarding");
+            } else {
+                let forward_output = Command::new("sudo")
+                    .args(["sysctl", "-w", "net.ipv4.ip_forward=1"])
+                    .output();
+                
+                if let Ok(result) = forward_output {
+                    if result.status.success() {
+                        println!("   ✅ Enabled IP forwarding");
+                    } else {
+                        println!("   ⚠️ Warning: Failed to enable IP forwarding");
+                    }
                 }
             }
             
@@ -978,18 +1272,68 @@ impl TunnelManager {
             }
         }
 
-        // TODO: Start actual packet processing loop
-        // This should run in a background task to:
-        // 1. Read packets from TUN interface
-        // 2. Encrypt and send to VPN server via the client connection
-        // 3. Receive encrypted packets from VPN server
-        // 4. Decrypt and write to TUN interface
+        // Forward TUN traffic over the data channel, one pipelined task per direction
+        #[cfg(unix)]
+        {
+            use std::os::unix::io::AsRawFd;
+
+            let mut queue_fds: Vec<std::os::unix::io::RawFd> =
+                self.tun_device.iter().map(|device| device.as_raw_fd()).collect();
+            #[allow(unused_mut)]
+            let mut vnet_hdr = false;
+            #[cfg(target_os = "linux")]
+            if let Some(device) = self.native_device.as_ref() {
+                queue_fds = device.queue_fds();
+                vnet_hdr = device.vnet_hdr();
+            }
+
+            match (queue_fds.is_empty(), self.data_channel.take()) {
+                (false, Some((runtime, mut connects))) => {
+                    let config = pump::PumpConfig {
+                        mtu: self.config.mtu as usize,
+                        vnet_hdr,
+                        mss_clamp: self.mss_clamp,
+                        io_uring: self.tun_io_uring,
+                        mtu_hook: self.path_mtu_hook(),
+                        ..pump::PumpConfig::default()
+                    };
+                    // Surplus channels would never be used by any queue
+                    connects.truncate(queue_fds.len());
+                    let lanes = connects.len();
+                    self.packet_pump = Some(pump::PacketPump::start_multi_queue(&queue_fds, connects, &runtime, config)?);
+                    println!("   ✅ Packet pump started ({} queues, {} data channels)", queue_fds.len(), lanes);
+                    return Ok(());
+                }
+                (true, _) => println!("   ⚠️ No TUN device - packet forwarding disabled"),
+                (_, None) => println!("   📝 No data channel attached - packet forwarding is left to the application"),
+            }
+        }
 
         println!("   ✅ Packet routing loop prepared");
-        println!("   📝 Note: Full packet forwarding requires VPN client integration");
         Ok(())
     }
 
+    /// Hook the packet pump calls to resize the TUN device, if adaptive MTU is on
+    #[cfg(unix)]
+    fn path_mtu_hook(&self) -> Option<pump::MtuHook> {
+        if !self.adaptive_mtu {
+            return None;
+        }
+        #[cfg(target_os = "linux")]
+        {
+            let interface = self.interface_name.clone();
+            Some(pump::MtuHook::new(move |mtu| {
+                let index = netlink::Netlink::link_index(&interface)?;
+                netlink::Netlink::open()?.set_mtu(index, mtu)
+            }))
+        }
+        #[cfg(not(target_os = "linux"))]
+        {
+            println!("   ℹ️  Adaptive MTU is only supported on Linux");
+            None
+        }
+    }
+
     /// Send packet through VPN tunnel
     pub fn send_packet(&mut self, packet: Vec<u8>) -> Result<()> {
         if let Some(ref tx) = self.packet_tx {
@@ -1011,6 +1355,10 @@ impl TunnelManager {
 
     /// Write packet to TUN interface
     pub fn write_to_tun(&mut self, packet: &[u8]) -> Result<()> {
+        #[cfg(target_os = "linux")]
+        if let Some(ref mut device) = self.native_device {
+            return device.write_packet_blocking(packet);
+        }
         if let Some(ref mut device) = self.tun_device {
             device.write(packet)
                 .map_err(|e| VpnError::Connection(format!("Failed to write to TUN: {}", e)))?;
@@ -1022,8 +1370,12 @@ impl TunnelManager {
 
     /// Read packet from TUN interface  
     pub fn read_from_tun(&mut self) -> Result<Vec<u8>> {
+        #[cfg(target_os = "linux")]
+        if let Some(ref mut device) = self.native_device {
+            return device.read_packet_blocking().map(|packet| packet.to_vec());
+        }
         if let Some(ref mut device) = self.tun_device {
-            let mut buffer = vec![0u8; 1500]; // MTU size
+            let mut buffer = vec![0u8; usize::from(self.config.mtu)];
             let size = device.read(&mut buffer)
                 .map_err(|e| VpnError::Connection(format!("Failed to read from TUN: {}", e)))?;
             buffer.truncate(size);
@@ -1035,6 +1387,10 @@ impl TunnelManager {
 
     #[cfg(target_os = "windows")]
     fn establish_windows_tunnel(&mut self) -> Result<()> {
+        if self.wintun {
+            return self.establish_wintun_tunnel();
+        }
+
         // On Windows, we need to use TAP-Windows adapter
         println!("🪟 Setting up Windows TAP interface...");
         
@@ -1059,6 +1415,24 @@ impl TunnelManager {
         Ok(())
     }
 
+    /// Open the Wintun adapter and start forwarding between its rings and the data channel
+    #[cfg(target_os = "windows")]
+    fn establish_wintun_tunnel(&mut self) -> Result<()> {
+        println!("🪟 Setting up Wintun adapter {}...", self.interface_name);
+        let adapter = Arc::new(wintun::WintunAdapter::open_or_create(&self.interface_name, "rVPNSE")?);
+        let session = Arc::new(adapter.start_session(WINTUN_RING_CAPACITY)?);
+
+        match self.data_channel.take() {
+            Some((runtime, connects)) if !connects.is_empty() => {
+                let connect = connects.into_iter().next().expect("non-empty");
+                self.wintun_pump = Some(wintun::WintunPump::start(session, connect, &runtime, WINTUN_BATCH_SIZE)?);
+                println!("   ✅ Wintun packet pump started");
+            }
+            _ => println!("   📝 No data channel attached - packet forwarding is left to the application"),
+        }
+        Ok(())
+    }
+
     #[cfg(target_os = "macos")]
     fn establish_macos_tunnel(&mut self) -> Result<()> {
         // On macOS, we can use utun interfaces
@@ -1177,18 +1551,36 @@ impl TunnelManager {
             println!("   ⚠️  Warning: Failed to restore original routing: {}", e);
         }
         
+        // Stop forwarding before the device goes away
+        #[cfg(unix)]
+        if let Some(mut pump) = self.packet_pump.take() {
+            pump.stop();
+        }
+        #[cfg(target_os = "windows")]
+        if let Some(mut pump) = self.wintun_pump.take() {
+            pump.stop();
+        }
+
         // Close TUN device if it exists
         if let Some(device) = self.tun_device.take() {
             println!("   🔽 Closing TUN device: {}", self.interface_name);
             drop(device); // TUN device will be automatically closed
         }
+        #[cfg(target_os = "linux")]
+        if let Some(mut device) = self.native_device.take() {
+            println!("   🔽 Closing native TUN device: {}", self.interface_name);
+            let _ = device.cleanup();
+        }
         
         // Remove TUN interface if we created it
         #[cfg(target_os = "linux")]
-        {
-            let _remove_result = Command::new("sudo")
-                .args(["ip", "link", "del", &self.interface_name])
-                .output();
+        if let Ok(index) = netlink::Netlink::link_index(&self.interface_name) {
+            let deleted = netlink::Netlink::open().and_then(|mut netlink| netlink.delete_link(index));
+            if deleted.is_err() {
+                let _remove_result = Command::new("sudo")
+                    .args(["ip", "link", "del", &self.interface_name])
+                    .output();
+            }
         }
         
         // Close packet channels
@@ -1455,7 +1847,12 @@ impl TunnelManager {
         }
 
         #[cfg(target_os = "linux")]
-        {
+        if let Ok(Some((Some(gateway), _))) = netlink::Netlink::open().and_then(|mut netlink| netlink.default_route()) {
+            self.original_route = Some(gateway.to_string());
+        }
+
+        #[cfg(target_os = "linux")]
+        if self.original_route.is_none() {
             let output = Command::new("ip")
                 .args(["route", "show", "default"])
                 .output()
@@ -0,0 +1,223 @@
+//! Path MTU tracking and TCP MSS clamping
+//!
+//! The data channel is TCP, so the kernel already discovers the outer path
+//! MTU and keeps the socket's MSS in step with it. Subtracting the framing a
+//! packet picks up on the way (SoftEther header, TLS record) gives the
+//! largest TUN MTU whose packets each still fit in one outer segment.
+//!
+//! MSS clamping rewrites the MSS option of forwarded TCP SYNs so the hosts
+//! behind the tunnel never send segments larger than the tunnel MTU, which
+//! keeps PPPoE and LTE paths with small MTUs from fragmenting or
+//! blackholing.
+
+use crate::protocol::binary::protocol_constants::PACKET_HEADER_SIZE;
+use std::io;
+use std::os::unix::io::RawFd;
+
+/// TLS 1.2 AES-GCM record overhead: header, explicit nonce and tag
+pub const TLS_RECORD_OVERHEAD: u32 = 5 + 8 + 16;
+
+/// Bytes the data channel adds to every packet before it reaches TCP
+pub const DATA_CHANNEL_OVERHEAD: u32 = PACKET_HEADER_SIZE as u32 + TLS_RECORD_OVERHEAD;
+
+/// Smallest MTU ever set on the TUN device (the IPv6 minimum)
+pub const MIN_TUNNEL_MTU: u32 = 1280;
+
+const IPV4_HEADER_LEN: u16 = 20;
+const IPV6_HEADER_LEN: u16 = 40;
+const TCP_HEADER_LEN: u16 = 20;
+const IPPROTO_TCP: u8 = 6;
+const TCP_FLAG_SYN: u8 = 0x02;
+const TCP_OPT_END: u8 = 0;
+const TCP_OPT_NOP: u8 = 1;
+const TCP_OPT_MSS: u8 = 2;
+
+/// TUN MTU for a data channel whose socket MSS is `mss`, capped at `ceiling`
+pub fn tunnel_mtu_for_mss(mss: u32, ceiling: u32) -> u32 {
+    mss.saturating_sub(DATA_CHANNEL_OVERHEAD).clamp(MIN_TUNNEL_MTU, ceiling.max(MIN_TUNNEL_MTU))
+}
+
+/// Largest TCP MSS that fits an MTU of `mtu`
+pub fn mss_for_mtu(mtu: u32, ipv6: bool) -> u16 {
+    let headers = TCP_HEADER_LEN + if ipv6 { IPV6_HEADER_LEN } else { IPV4_HEADER_LEN };
+    (mtu.min(u32::from(u16::MAX)) as u16).saturating_sub(headers)
+}
+
+/// Current MSS of a connected TCP socket; tracks path MTU changes
+pub fn socket_mss(fd: RawFd) -> io::Result<u32> {
+    let mut mss: libc::c_int = 0;
+    let mut len = std::mem::size_of::<libc::c_int>() as libc::socklen_t;
+    let rc = unsafe {
+        libc::getsockopt(
+            fd,
+            libc::IPPROTO_TCP,
+            libc::TCP_MAXSEG,
+            &mut mss as *mut libc::c_int as *mut libc::c_void,
+            &mut len,
+        )
+    };
+    if rc < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    Ok(mss.max(0) as u32)
+}
+
+/// Offset of the TCP header if `packet` is the first fragment of an IPv4 or IPv6 TCP SYN
+pub fn tcp_syn_offset(packet: &[u8]) -> Option<usize> {
+    let l4_off = match packet.first()? >> 4 {
+        4 if packet.len() >= usize::from(IPV4_HEADER_LEN) => {
+            let fragment_offset = u16::from_be_bytes([packet[6], packet[7]]) & 0x1fff;
+            if packet[9] != IPPROTO_TCP || fragment_offset != 0 {
+                return None;
+            }
+            usize::from(packet[0] & 0x0f) * 4
+        }
+        6 if packet.len() >= usize::from(IPV6_HEADER_LEN) => {
+            if packet[6] != IPPROTO_TCP {
+                return None;
+            }
+            usize::from(IPV6_HEADER_LEN)
+        }
+        _ => return None,
+    };
+    let flags = *packet.get(l4_off + 13)?;
+    (flags & TCP_FLAG_SYN != 0).then_some(l4_off)
+}
+
+/// Lower the MSS option of a TCP SYN to at most `max_mss`
+///
+/// The TCP checksum is updated incrementally. Returns whether the packet
+/// changed; anything that is not a SYN with an MSS option is left alone.
+pub fn clamp_mss(packet: &mut [u8], max_mss: u16) -> bool {
+    let Some(l4_off) = tcp_syn_offset(packet) else {
+        return false;
+    };
+    let header_end = l4_off + usize::from(packet[l4_off + 12] >> 4) * 4;
+    if header_end > packet.len() {
+        return false;
+    }
+
+    let mut at = l4_off + usize::from(TCP_HEADER_LEN);
+    while at < header_end {
+        match packet[at] {
+            TCP_OPT_END => break,
+            TCP_OPT_NOP => at += 1,
+            kind => {
+                let Some(&len) = packet.get(at + 1) else { break };
+                let len = usize::from(len);
+                if len < 2 || at + len > header_end {
+                    break;
+                }
+                if kind == TCP_OPT_MSS && len == 4 {
+                    let value_at = at + 2;
+                    let old = u16::from_be_bytes([packet[value_at], packet[value_at + 1]]);
+                    if old <= max_mss {
+                        return false;
+                    }
+                    packet[value_at..value_at + 2].copy_from_slice(&max_mss.to_be_bytes());
+
+                    // A value at an odd offset straddles two checksum words
+                    let (old_word, new_word) = if (value_at - l4_off) % 2 == 0 {
+                        (old, max_mss)
+                    } else {
+                        (old.swap_bytes(), max_mss.swap_bytes())
+                    };
+                    let csum_at = l4_off + 16;
+                    let csum = u16::from_be_bytes([packet[csum_at], packet[csum_at + 1]]);
+                    let csum = update_checksum(csum, old_word, new_word);
+                    packet[csum_at..csum_at + 2].copy_from_slice(&csum.to_be_bytes());
+                    return true;
+                }
+                at += len;
+            }
+        }
+    }
+    false
+}
+
+/// Incremental one's-complement checksum update for one changed 16-bit word (RFC 1624)
+fn update_checksum(csum: u16, old: u16, new: u16) -> u16 {
+    let mut sum = u32::from(!csum) + u32::from(!old) + u32::from(new);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    !(sum as u16)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn ones_complement(data: &[u8], mut sum: u32) -> u16 {
+        for chunk in data.chunks(2) {
+            sum += u32::from(u16::from_be_bytes([chunk[0], *chunk.get(1).unwrap_or(&0)]));
+        }
+        while sum >> 16 != 0 {
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        !(sum as u16)
+    }
+
+    fn tcp_checksum(packet: &[u8]) -> u16 {
+        let l4 = &packet[20..];
+        let mut pseudo = packet[12..20].to_vec();
+        pseudo.extend_from_slice(&[0, IPPROTO_TCP]);
+        pseudo.extend_from_slice(&(l4.len() as u16).to_be_bytes());
+        let sum = u32::from(!ones_complement(&pseudo, 0));
+        ones_complement(l4, sum)
+    }
+
+    /// IPv4 SYN with `options`, checksummed
+    fn ipv4_syn(options: &[u8]) -> Vec<u8> {
+        let tcp_len = 20 + options.len();
+        let mut packet = vec![0u8; 20 + tcp_len];
+        packet[0] = 0x45;
+        packet[2..4].copy_from_slice(&((20 + tcp_len) as u16).to_be_bytes());
+        packet[9] = IPPROTO_TCP;
+        packet[12..16].copy_from_slice(&[10, 0, 0, 2]);
+        packet[16..20].copy_from_slice(&[93, 184, 216, 34]);
+        packet[20..22].copy_from_slice(&40000u16.to_be_bytes());
+        packet[22..24].copy_from_slice(&443u16.to_be_bytes());
+        packet[32] = ((tcp_len / 4) as u8) << 4;
+        packet[33] = TCP_FLAG_SYN;
+        packet[40..].copy_from_slice(options);
+        let csum = tcp_checksum(&packet);
+        packet[36..38].copy_from_slice(&csum.to_be_bytes());
+        packet
+    }
+
+    #[test]
+    fn test_clamp_lowers_mss_and_keeps_checksum_valid() {
+        // MSS first (even offset), then after a NOP (odd offset)
+        for options in [vec![2, 4, 0x05, 0xb4, 1, 1, 1, 0], vec![1, 2, 4, 0x05, 0xb4, 1, 1, 0]] {
+            let mut packet = ipv4_syn(&options);
+            assert!(clamp_mss(&mut packet, 1300));
+            let at = 40 + options.iter().position(|&b| b == 2).unwrap() + 2;
+            assert_eq!(u16::from_be_bytes([packet[at], packet[at + 1]]), 1300);
+            let stored = u16::from_be_bytes([packet[36], packet[37]]);
+            packet[36..38].copy_from_slice(&[0, 0]);
+            assert_eq!(stored, tcp_checksum(&packet));
+        }
+    }
+
+    #[test]
+    fn test_clamp_leaves_small_mss_and_non_syn_alone() {
+        let mut small = ipv4_syn(&[2, 4, 0x04, 0x00]);
+        let before = small.clone();
+        assert!(!clamp_mss(&mut small, 1300));
+        assert_eq!(small, before);
+
+        let mut ack = ipv4_syn(&[2, 4, 0x05, 0xb4]);
+        ack[33] = 0x10;
+        assert!(!clamp_mss(&mut ack, 1300));
+        assert!(tcp_syn_offset(&[0x45u8; 10]).is_none());
+    }
+
+    #[test]
+    fn test_tunnel_mtu_follows_mss_within_bounds() {
+        assert_eq!(tunnel_mtu_for_mss(1448, 1500), 1448 - DATA_CHANNEL_OVERHEAD);
+        assert_eq!(tunnel_mtu_for_mss(9000, 1500), 1500);
+        assert_eq!(tunnel_mtu_for_mss(500, 1500), MIN_TUNNEL_MTU);
+        assert_eq!(mss_for_mtu(1400, false), 1360);
+        assert_eq!(mss_for_mtu(1400, true), 1340);
+    }
+}
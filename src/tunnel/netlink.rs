@@ -0,0 +1,604 @@
+//! rtnetlink backend for link, address and route configuration
+//!
+//! Talks to the kernel over a `NETLINK_ROUTE` socket instead of spawning `ip`
+//! and `sysctl`. Requests are queued and sent together: a [`RouteBatch`] goes
+//! out in one `send` and its acknowledgements come back in one read loop, so
+//! switching the default route over to the tunnel costs a single round trip
+//! rather than one process per step.
+//!
+//! Netlink has no transactions; the kernel applies each request in order and
+//! acknowledges each one, and failures are reported per request.
+
+use crate::error::{Result, VpnError};
+use libc::{c_int, c_void};
+use std::io;
+use std::net::Ipv4Addr;
+use std::os::unix::io::RawFd;
+
+/// Netlink message header length
+const NLMSG_HDR_LEN: usize = 16;
+
+/// Receive buffer size; dumps arrive in several reads of at most this much
+const RECV_BUF_SIZE: usize = 32 * 1024;
+
+/// How long to wait for the kernel before giving up on a reply
+const RECV_TIMEOUT_SECS: libc::time_t = 2;
+
+const IFLA_IFNAME: u16 = 3;
+const IFA_ADDRESS: u16 = 1;
+const IFA_LOCAL: u16 = 2;
+const RTA_DST: u16 = 1;
+const RTA_OIF: u16 = 4;
+const RTA_GATEWAY: u16 = 5;
+const RTA_PRIORITY: u16 = 6;
+const RTA_TABLE: u16 = 15;
+
+/// Align a netlink length to 4 bytes
+fn align(len: usize) -> usize {
+    (len + 3) & !3
+}
+
+/// An IPv4 route
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Route {
+    pub destination: Ipv4Addr,
+    pub prefix_len: u8,
+    pub gateway: Option<Ipv4Addr>,
+    /// Output interface index
+    pub interface: Option<u32>,
+}
+
+impl Route {
+    /// Route to `destination/prefix_len`
+    pub fn new(destination: Ipv4Addr, prefix_len: u8) -> Self {
+        Self { destination, prefix_len, gateway: None, interface: None }
+    }
+
+    /// The default route
+    pub fn default_route() -> Self {
+        Self::new(Ipv4Addr::UNSPECIFIED, 0)
+    }
+
+    /// Send through `gateway`
+    pub fn via(mut self, gateway: Ipv4Addr) -> Self {
+        self.gateway = Some(gateway);
+        self
+    }
+
+    /// Send out of interface `index`
+    pub fn dev(mut self, index: u32) -> Self {
+        self.interface = Some(index);
+        self
+    }
+}
+
+impl std::fmt::Display for Route {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(f, "{}/{}", self.destination, self.prefix_len)?;
+        if let Some(gateway) = self.gateway {
+            write!(f, " via {}", gateway)?;
+        }
+        if let Some(index) = self.interface {
+            write!(f, " dev #{}", index)?;
+        }
+        Ok(())
+    }
+}
+
+/// One queued request
+#[derive(Debug, Clone)]
+struct Request {
+    kind: u16,
+    flags: u16,
+    body: Vec<u8>,
+    /// Error the request may fail with without it counting as a failure
+    tolerated: Option<c_int>,
+    what: String,
+}
+
+impl Request {
+    /// Append the framed message to `buf`
+    fn encode(&self, seq: u32, buf: &mut Vec<u8>) {
+        let len = NLMSG_HDR_LEN + self.body.len();
+        buf.extend_from_slice(&(len as u32).to_ne_bytes());
+        buf.extend_from_slice(&self.kind.to_ne_bytes());
+        buf.extend_from_slice(&(self.flags | (libc::NLM_F_REQUEST | libc::NLM_F_ACK) as u16).to_ne_bytes());
+        buf.extend_from_slice(&seq.to_ne_bytes());
+        buf.extend_from_slice(&0u32.to_ne_bytes());
+        buf.extend_from_slice(&self.body);
+        buf.resize(align(buf.len()), 0);
+    }
+}
+
+/// Append a route attribute
+fn put_attr(body: &mut Vec<u8>, kind: u16, data: &[u8]) {
+    body.extend_from_slice(&((4 + data.len()) as u16).to_ne_bytes());
+    body.extend_from_slice(&kind.to_ne_bytes());
+    body.extend_from_slice(data);
+    body.resize(align(body.len()), 0);
+}
+
+/// Iterate over `(kind, data)` attributes
+fn attrs(mut data: &[u8]) -> impl Iterator<Item = (u16, &[u8])> {
+    std::iter::from_fn(move || {
+        if data.len() < 4 {
+            return None;
+        }
+        let len = u16::from_ne_bytes([data[0], data[1]]) as usize;
+        let kind = u16::from_ne_bytes([data[2], data[3]]) & 0x3fff;
+        if len < 4 || len > data.len() {
+            return None;
+        }
+        let value = &data[4..len];
+        data = &data[align(len).min(data.len())..];
+        Some((kind, value))
+    })
+}
+
+fn attr_ipv4(value: &[u8]) -> Option<Ipv4Addr> {
+    <[u8; 4]>::try_from(value).ok().map(Ipv4Addr::from)
+}
+
+fn attr_u32(value: &[u8]) -> Option<u32> {
+    <[u8; 4]>::try_from(value).ok().map(u32::from_ne_bytes)
+}
+
+/// `rtmsg` followed by the route's attributes
+///
+/// `protocol`, `scope` and `kind` fill `rtm_protocol`, `rtm_scope` and
+/// `rtm_type`.
+fn route_body(route: &Route, protocol: u8, scope: u8, kind: u8) -> Vec<u8> {
+    let mut body = vec![
+        libc::AF_INET as u8,
+        route.prefix_len,
+        0,
+        0,
+        libc::RT_TABLE_MAIN,
+        protocol,
+        scope,
+        kind,
+    ];
+    body.extend_from_slice(&0u32.to_ne_bytes());
+    if route.prefix_len > 0 {
+        put_attr(&mut body, RTA_DST, &route.destination.octets());
+    }
+    if let Some(gateway) = route.gateway {
+        put_attr(&mut body, RTA_GATEWAY, &gateway.octets());
+    }
+    if let Some(index) = route.interface {
+        put_attr(&mut body, RTA_OIF, &index.to_ne_bytes());
+    }
+    body
+}
+
+/// `ifinfomsg` for link `index`, changing the IFF_UP bit when `up` is given
+fn link_body(index: u32, up: Option<bool>) -> Vec<u8> {
+    let mut body = vec![libc::AF_UNSPEC as u8, 0];
+    body.extend_from_slice(&0u16.to_ne_bytes());
+    body.extend_from_slice(&(index as i32).to_ne_bytes());
+    let (flags, change) = match up {
+        Some(true) => (libc::IFF_UP as u32, libc::IFF_UP as u32),
+        Some(false) => (0, libc::IFF_UP as u32),
+        None => (0, 0),
+    };
+    body.extend_from_slice(&flags.to_ne_bytes());
+    body.extend_from_slice(&change.to_ne_bytes());
+    body
+}
+
+/// Route changes sent to the kernel in one go
+#[derive(Debug, Clone, Default)]
+pub struct RouteBatch {
+    requests: Vec<Request>,
+}
+
+impl RouteBatch {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Add `route`; an identical existing route is left alone
+    pub fn add(&mut self, route: Route) -> &mut Self {
+        self.push_route(libc::RTM_NEWROUTE, libc::NLM_F_CREATE | libc::NLM_F_EXCL, route, Some(libc::EEXIST), "add")
+    }
+
+    /// Add `route`, replacing any route to the same destination
+    pub fn replace(&mut self, route: Route) -> &mut Self {
+        self.push_route(libc::RTM_NEWROUTE, libc::NLM_F_CREATE | libc::NLM_F_REPLACE, route, None, "replace")
+    }
+
+    /// Delete `route`; a route that is already gone is not an error
+    ///
+    /// Unset gateway and interface match any, as with `ip route del`.
+    pub fn delete(&mut self, route: Route) -> &mut Self {
+        self.push_route(libc::RTM_DELROUTE, 0, route, Some(libc::ESRCH), "delete")
+    }
+
+    /// Number of queued changes
+    pub fn len(&self) -> usize {
+        self.requests.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.requests.is_empty()
+    }
+
+    fn push_route(&mut self, kind: u16, flags: c_int, route: Route, tolerated: Option<c_int>, verb: &str) -> &mut Self {
+        // Deletes leave protocol, scope and type unset so they match routes
+        // whoever added them, as `ip route del` does; gateway-less routes out
+        // of an interface are added on-link
+        let body = if kind == libc::RTM_DELROUTE {
+            route_body(&route, libc::RTPROT_UNSPEC, libc::RT_SCOPE_NOWHERE, libc::RTN_UNSPEC)
+        } else if route.gateway.is_none() && route.interface.is_some() {
+            route_body(&route, libc::RTPROT_BOOT, libc::RT_SCOPE_LINK, libc::RTN_UNICAST)
+        } else {
+            route_body(&route, libc::RTPROT_BOOT, libc::RT_SCOPE_UNIVERSE, libc::RTN_UNICAST)
+        };
+        self.requests.push(Request {
+            kind,
+            flags: flags as u16,
+            body,
+            tolerated,
+            what: format!("{} route {}", verb, route),
+        });
+        self
+    }
+}
+
+/// `NETLINK_ROUTE` socket
+pub struct Netlink {
+    fd: RawFd,
+    seq: u32,
+}
+
+impl Netlink {
+    /// Open a route netlink socket
+    pub fn open() -> Result<Self> {
+        let fd = unsafe { libc::socket(libc::AF_NETLINK, libc::SOCK_RAW | libc::SOCK_CLOEXEC, libc::NETLINK_ROUTE) };
+        if fd < 0 {
+            return Err(VpnError::Routing(format!("Failed to open netlink socket: {}", io::Error::last_os_error())));
+        }
+        // Own the fd from here so every error path closes it
+        let netlink = Self { fd, seq: 0 };
+
+        let mut addr: libc::sockaddr_nl = unsafe { std::mem::zeroed() };
+        addr.nl_family = libc::AF_NETLINK as libc::sa_family_t;
+        let bound = unsafe {
+            libc::bind(
+                fd,
+                &addr as *const libc::sockaddr_nl as *const libc::sockaddr,
+                std::mem::size_of::<libc::sockaddr_nl>() as libc::socklen_t,
+            )
+        };
+        if bound < 0 {
+            return Err(VpnError::Routing(format!("Failed to bind netlink socket: {}", io::Error::last_os_error())));
+        }
+
+        let timeout = libc::timeval { tv_sec: RECV_TIMEOUT_SECS, tv_usec: 0 };
+        unsafe {
+            libc::setsockopt(
+                fd,
+                libc::SOL_SOCKET,
+                libc::SO_RCVTIMEO,
+                &timeout as *const libc::timeval as *const c_void,
+                std::mem::size_of::<libc::timeval>() as libc::socklen_t,
+            );
+        }
+        Ok(netlink)
+    }
+
+    /// Index of interface `name`
+    pub fn link_index(name: &str) -> Result<u32> {
+        let c_name = std::ffi::CString::new(name)
+            .map_err(|_| VpnError::Routing(format!("Invalid interface name '{}'", name)))?;
+        match unsafe { libc::if_nametoindex(c_name.as_ptr()) } {
+            0 => Err(VpnError::Routing(format!("No interface named '{}'", name))),
+            index => Ok(index),
+        }
+    }
+
+    /// Apply every change in `batch`, in order, with one send
+    ///
+    /// Returns a description of each change the kernel refused. Fails outright
+    /// only if netlink itself does, or if the kernel refused for lack of
+    /// privilege, in which case nothing in the batch took effect.
+    pub fn apply(&mut self, batch: &RouteBatch) -> Result<Vec<String>> {
+        self.execute(&batch.requests)
+    }
+
+    /// Set link `index` up or down
+    pub fn set_link_up(&mut self, index: u32, up: bool) -> Result<()> {
+        self.execute_one(Request {
+            kind: libc::RTM_NEWLINK,
+            flags: 0,
+            body: link_body(index, Some(up)),
+            tolerated: None,
+            what: format!("set link #{} {}", index, if up { "up" } else { "down" }),
+        })
+    }
+
+    /// Set the MTU of link `index`
+    pub fn set_mtu(&mut self, index: u32, mtu: u32) -> Result<()> {
+        let mut body = link_body(index, None);
+        put_attr(&mut body, libc::IFLA_MTU, &mtu.to_ne_bytes());
+        self.execute_one(Request {
+            kind: libc::RTM_NEWLINK,
+            flags: 0,
+            body,
+            tolerated: None,
+            what: format!("set link #{} mtu {}", index, mtu),
+        })
+    }
+
+    /// Delete link `index`
+    pub fn delete_link(&mut self, index: u32) -> Result<()> {
+        self.execute_one(Request {
+            kind: libc::RTM_DELLINK,
+            flags: 0,
+            body: link_body(index, None),
+            tolerated: Some(libc::ENODEV),
+            what: format!("delete link #{}", index),
+        })
+    }
+
+    /// Assign `local/prefix_len` to link `index`, point-to-point with `peer` when given
+    pub fn add_address(&mut self, index: u32, local: Ipv4Addr, prefix_len: u8, peer: Option<Ipv4Addr>) -> Result<()> {
+        let prefix_len = if peer.is_some() { 32 } else { prefix_len };
+        let mut body = vec![libc::AF_INET as u8, prefix_len, 0, libc::RT_SCOPE_UNIVERSE];
+        body.extend_from_slice(&index.to_ne_bytes());
+        put_attr(&mut body, IFA_LOCAL, &local.octets());
+        put_attr(&mut body, IFA_ADDRESS, &peer.unwrap_or(local).octets());
+        self.execute_one(Request {
+            kind: libc::RTM_NEWADDR,
+            flags: (libc::NLM_F_CREATE | libc::NLM_F_REPLACE) as u16,
+            body,
+            tolerated: None,
+            what: format!("add address {}/{} to link #{}", local, prefix_len, index),
+        })
+    }
+
+    /// Names of all interfaces
+    pub fn link_names(&mut self) -> Result<Vec<String>> {
+        let messages = self.dump(libc::RTM_GETLINK, link_body(0, None))?;
+        Ok(messages
+            .iter()
+            .filter(|(kind, _)| *kind == libc::RTM_NEWLINK)
+            .filter_map(|(_, payload)| {
+                let (_, name) = attrs(payload.get(16..)?).find(|(kind, _)| *kind == IFLA_IFNAME)?;
+                let name = name.split(|&b| b == 0).next()?;
+                Some(String::from_utf8_lossy(name).into_owned())
+            })
+            .collect())
+    }
+
+    /// IPv4 addresses assigned to link `index`
+    pub fn ipv4_addresses(&mut self, index: u32) -> Result<Vec<Ipv4Addr>> {
+        let mut request = vec![libc::AF_INET as u8, 0, 0, 0];
+        request.extend_from_slice(&0u32.to_ne_bytes());
+        let messages = self.dump(libc::RTM_GETADDR, request)?;
+        Ok(messages
+            .iter()
+            .filter(|(kind, payload)| *kind == libc::RTM_NEWADDR && payload.len() >= 8)
+            .filter(|(_, payload)| attr_u32(&payload[4..8]) == Some(index))
+            .filter_map(|(_, payload)| {
+                let mut address = None;
+                for (kind, value) in attrs(&payload[8..]) {
+                    match kind {
+                        IFA_LOCAL => return attr_ipv4(value),
+                        IFA_ADDRESS => address = attr_ipv4(value),
+                        _ => {}
+                    }
+                }
+                address
+            })
+            .collect())
+    }
+
+    /// Gateway and interface index of the main table's preferred IPv4 default route
+    pub fn default_route(&mut self) -> Result<Option<(Option<Ipv4Addr>, Option<u32>)>> {
+        let messages = self.dump(libc::RTM_GETROUTE, route_body(&Route::default_route(), libc::RTPROT_BOOT, libc::RT_SCOPE_UNIVERSE, libc::RTN_UNICAST))?;
+        let mut best: Option<(u32, Option<Ipv4Addr>, Option<u32>)> = None;
+        for (kind, payload) in &messages {
+            // rtm_dst_len, rtm_table and rtm_type
+            if *kind != libc::RTM_NEWROUTE || payload.len() < 12 || payload[1] != 0 || payload[7] != libc::RTN_UNICAST {
+                continue;
+            }
+            let (mut table, mut gateway, mut interface, mut metric) = (u32::from(payload[4]), None, None, 0);
+            for (kind, value) in attrs(&payload[12..]) {
+                match kind {
+                    RTA_TABLE => table = attr_u32(value).unwrap_or(table),
+                    RTA_GATEWAY => gateway = attr_ipv4(value),
+                    RTA_OIF => interface = attr_u32(value),
+                    RTA_PRIORITY => metric = attr_u32(value).unwrap_or(0),
+                    _ => {}
+                }
+            }
+            if table == u32::from(libc::RT_TABLE_MAIN) && best.map_or(true, |(lowest, _, _)| metric < lowest) {
+                best = Some((metric, gateway, interface));
+            }
+        }
+        Ok(best.map(|(_, gateway, interface)| (gateway, interface)))
+    }
+
+    fn execute_one(&mut self, request: Request) -> Result<()> {
+        match self.execute(std::slice::from_ref(&request))?.into_iter().next() {
+            Some(failure) => Err(VpnError::Routing(failure)),
+            None => Ok(()),
+        }
+    }
+
+    fn execute(&mut self, requests: &[Request]) -> Result<Vec<String>> {
+        if requests.is_empty() {
+            return Ok(Vec::new());
+        }
+        let first_seq = self.seq.wrapping_add(1);
+        let mut buf = Vec::with_capacity(requests.iter().map(|r| NLMSG_HDR_LEN + align(r.body.len())).sum());
+        for request in requests {
+            self.seq = self.seq.wrapping_add(1);
+            request.encode(self.seq, &mut buf);
+        }
+        self.send(&buf)?;
+
+        let mut pending = requests.len();
+        let mut failures = Vec::new();
+        let mut denied = false;
+        let mut recv_buf = vec![0u8; RECV_BUF_SIZE];
+        while pending > 0 {
+            let len = self.recv(&mut recv_buf)?;
+            for (kind, seq, payload) in messages(&recv_buf[..len]) {
+                if kind != libc::NLMSG_ERROR as u16 {
+                    continue;
+                }
+                let Some(request) = requests.get(seq.wrapping_sub(first_seq) as usize) else {
+                    continue;
+                };
+                pending -= 1;
+                let errno = payload.get(..4).and_then(attr_u32).map_or(0, |code| -(code as i32));
+                if errno == 0 || Some(errno) == request.tolerated {
+                    continue;
+                }
+                denied |= errno == libc::EPERM || errno == libc::EACCES;
+                failures.push(format!("{}: {}", request.what, io::Error::from_raw_os_error(errno)));
+            }
+        }
+
+        if denied && failures.len() == requests.len() {
+            return Err(VpnError::Permission(format!("Netlink configuration not permitted: {}", failures[0])));
+        }
+        Ok(failures)
+    }
+
+    /// Run a dump request and collect `(type, payload)` of every reply
+    fn dump(&mut self, kind: u16, body: Vec<u8>) -> Result<Vec<(u16, Vec<u8>)>> {
+        self.seq = self.seq.wrapping_add(1);
+        let seq = self.seq;
+        let mut buf = Vec::new();
+        let request = Request { kind, flags: libc::NLM_F_DUMP as u16, body, tolerated: None, what: String::new() };
+        request.encode(seq, &mut buf);
+        self.send(&buf)?;
+
+        let mut replies = Vec::new();
+        let mut recv_buf = vec![0u8; RECV_BUF_SIZE];
+        loop {
+            let len = self.recv(&mut recv_buf)?;
+            for (reply_kind, reply_seq, payload) in messages(&recv_buf[..len]) {
+                if reply_seq != seq {
+                    continue;
+                }
+                match reply_kind as c_int {
+                    libc::NLMSG_DONE => return Ok(replies),
+                    libc::NLMSG_ERROR => {
+                        let errno = payload.get(..4).and_then(attr_u32).map_or(0, |code| -(code as i32));
+                        if errno != 0 {
+                            return Err(VpnError::Routing(format!(
+                                "Netlink dump failed: {}", io::Error::from_raw_os_error(errno)
+                            )));
+                        }
+                    }
+                    _ => replies.push((reply_kind, payload.to_vec())),
+                }
+            }
+        }
+    }
+
+    fn send(&self, buf: &[u8]) -> Result<()> {
+        let sent = unsafe { libc::send(self.fd, buf.as_ptr() as *const c_void, buf.len(), 0) };
+        if sent < 0 || sent as usize != buf.len() {
+            return Err(VpnError::Routing(format!("Netlink send failed: {}", io::Error::last_os_error())));
+        }
+        Ok(())
+    }
+
+    fn recv(&self, buf: &mut [u8]) -> Result<usize> {
+        loop {
+            let received = unsafe { libc::recv(self.fd, buf.as_mut_ptr() as *mut c_void, buf.len(), 0) };
+            if received >= 0 {
+                return Ok(received as usize);
+            }
+            let err = io::Error::last_os_error();
+            if err.kind() != io::ErrorKind::Interrupted {
+                return Err(VpnError::Routing(format!("Netlink receive failed: {}", err)));
+            }
+        }
+    }
+}
+
+impl Drop for Netlink {
+    fn drop(&mut self) {
+        unsafe { libc::close(self.fd) };
+    }
+}
+
+/// Iterate over `(type, seq, payload)` of the messages in one read
+fn messages(mut data: &[u8]) -> impl Iterator<Item = (u16, u32, &[u8])> {
+    std::iter::from_fn(move || {
+        if data.len() < NLMSG_HDR_LEN {
+            return None;
+        }
+        let len = u32::from_ne_bytes([data[0], data[1], data[2], data[3]]) as usize;
+        if len < NLMSG_HDR_LEN || len > data.len() {
+            return None;
+        }
+        let kind = u16::from_ne_bytes([data[4], data[5]]);
+        let seq = u32::from_ne_bytes([data[8], data[9], data[10], data[11]]);
+        let payload = &data[NLMSG_HDR_LEN..len];
+        data = &data[align(len).min(data.len())..];
+        Some((kind, seq, payload))
+    })
+}
+
+/// Set a kernel parameter by writing under `/proc/sys`, as `sysctl -w` does
+///
+/// `key` uses sysctl's dotted form, e.g. `net.ipv4.ip_forward`.
+pub fn write_sysctl(key: &str, value: &str) -> Result<()> {
+    let path = format!("/proc/sys/{}", key.replace('.', "/"));
+    std::fs::write(&path, value).map_err(|e| VpnError::Permission(format!("Failed to set {}: {}", key, e)))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_route_batch_encodes_one_message_per_change() {
+        let mut batch = RouteBatch::new();
+        batch
+            .delete(Route::default_route())
+            .add(Route::new(Ipv4Addr::new(0, 0, 0, 0), 1).via(Ipv4Addr::new(10, 0, 0, 1)).dev(7))
+            .replace(Route::new(Ipv4Addr::new(203, 0, 113, 5), 32).via(Ipv4Addr::new(192, 168, 1, 1)));
+        assert_eq!(batch.len(), 3);
+
+        let mut buf = Vec::new();
+        for (seq, request) in batch.requests.iter().enumerate() {
+            request.encode(seq as u32 + 1, &mut buf);
+        }
+        let framed: Vec<(u16, u32, &[u8])> = messages(&buf).collect();
+        assert_eq!(framed.len(), 3);
+        assert_eq!(framed[0].0, libc::RTM_DELROUTE);
+        assert_eq!(framed[1].0, libc::RTM_NEWROUTE);
+        // rtm_protocol, rtm_scope and rtm_type: wildcards on delete
+        assert_eq!(framed[0].2[5..8], [libc::RTPROT_UNSPEC, libc::RT_SCOPE_NOWHERE, libc::RTN_UNSPEC]);
+        assert_eq!(framed[1].2[5..8], [libc::RTPROT_BOOT, libc::RT_SCOPE_UNIVERSE, libc::RTN_UNICAST]);
+        assert_eq!(framed.iter().map(|m| m.1).collect::<Vec<_>>(), vec![1, 2, 3]);
+
+        // Default route delete carries no destination; the /1 add carries all three
+        assert_eq!(attrs(&framed[0].2[12..]).count(), 0);
+        let added: Vec<(u16, &[u8])> = attrs(&framed[1].2[12..]).collect();
+        assert_eq!(framed[1].2[1], 1);
+        assert_eq!(added[0], (RTA_DST, &[0u8, 0, 0, 0][..]));
+        assert_eq!(added[1], (RTA_GATEWAY, &[10u8, 0, 0, 1][..]));
+        assert_eq!(attr_u32(added[2].1), Some(7));
+        assert_eq!(framed[2].2[1], 32);
+    }
+
+    #[test]
+    fn test_link_dump_lists_loopback() {
+        let Ok(mut netlink) = Netlink::open() else {
+            return; // No netlink in this sandbox
+        };
+        let names = netlink.link_names().unwrap();
+        assert!(names.iter().any(|name| name == "lo"));
+        let lo = Netlink::link_index("lo").unwrap();
+        assert!(netlink.ipv4_addresses(lo).unwrap().contains(&Ipv4Addr::LOCALHOST));
+    }
+}
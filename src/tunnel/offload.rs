@@ -0,0 +1,661 @@
+//! TUN segmentation offload (`IFF_VNET_HDR`)
+//!
+//! With `IFF_VNET_HDR` and `TUNSETOFFLOAD` the Linux kernel hands TUN
+//! readers TCP and UDP super-packets of up to 64 KB. Each one is prefixed by
+//! a `virtio_net_hdr` that says how to cut it into MTU-sized segments. The
+//! kernel also accepts super-packets in the same format on write.
+//!
+//! This module does the cutting on the read side ([`segment`]) and the gluing
+//! on the write side ([`GroCoalescer`]). The data channel therefore still
+//! carries ordinary IP packets, while the kernel crosses the TUN boundary
+//! once per super-packet instead of once per segment.
+
+use crate::error::{Result, VpnError};
+use bytes::{Bytes, BytesMut};
+use std::io::{self, IoSlice, Write};
+
+/// Size of the `virtio_net_hdr` in front of every frame
+pub const VIRTIO_NET_HDR_LEN: usize = 10;
+
+/// Largest super-packet the kernel passes through TUN
+pub const MAX_SUPER_PACKET: usize = 65535;
+
+/// `virtio_net_hdr.flags`: L4 checksum is partial and must be completed
+pub const VIRTIO_NET_HDR_F_NEEDS_CSUM: u8 = 1;
+
+/// `virtio_net_hdr.gso_type` values
+pub const VIRTIO_NET_HDR_GSO_NONE: u8 = 0;
+pub const VIRTIO_NET_HDR_GSO_TCPV4: u8 = 1;
+pub const VIRTIO_NET_HDR_GSO_TCPV6: u8 = 4;
+pub const VIRTIO_NET_HDR_GSO_UDP_L4: u8 = 5;
+pub const VIRTIO_NET_HDR_GSO_ECN: u8 = 0x80;
+
+/// Most segments glued into one write
+const MAX_GRO_SEGMENTS: usize = 64;
+
+const IPPROTO_TCP: u8 = 6;
+const IPPROTO_UDP: u8 = 17;
+
+const TCP_FLAG_FIN: u8 = 0x01;
+const TCP_FLAG_PSH: u8 = 0x08;
+const TCP_FLAG_ACK: u8 = 0x10;
+const TCP_FLAG_CWR: u8 = 0x80;
+
+/// Offsets of the L4 checksum field within TCP and UDP headers
+const TCP_CSUM_OFFSET: usize = 16;
+const UDP_CSUM_OFFSET: usize = 6;
+
+/// `struct virtio_net_hdr`, in host byte order as TUN uses it
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct VirtioNetHdr {
+    pub flags: u8,
+    pub gso_type: u8,
+    /// Length of the IP plus L4 headers
+    pub hdr_len: u16,
+    /// Payload bytes per segment
+    pub gso_size: u16,
+    /// Offset of the L4 header
+    pub csum_start: u16,
+    /// Offset of the checksum field from `csum_start`
+    pub csum_offset: u16,
+}
+
+impl VirtioNetHdr {
+    /// Parse the header at the start of `buf`
+    pub fn decode(buf: &[u8]) -> Option<Self> {
+        if buf.len() < VIRTIO_NET_HDR_LEN {
+            return None;
+        }
+        let u16_at = |at: usize| u16::from_ne_bytes([buf[at], buf[at + 1]]);
+        Some(Self {
+            flags: buf[0],
+            gso_type: buf[1],
+            hdr_len: u16_at(2),
+            gso_size: u16_at(4),
+            csum_start: u16_at(6),
+            csum_offset: u16_at(8),
+        })
+    }
+
+    /// Serialize for writing in front of a frame
+    pub fn encode(&self) -> [u8; VIRTIO_NET_HDR_LEN] {
+        let mut buf = [0u8; VIRTIO_NET_HDR_LEN];
+        buf[0] = self.flags;
+        buf[1] = self.gso_type;
+        buf[2..4].copy_from_slice(&self.hdr_len.to_ne_bytes());
+        buf[4..6].copy_from_slice(&self.gso_size.to_ne_bytes());
+        buf[6..8].copy_from_slice(&self.csum_start.to_ne_bytes());
+        buf[8..10].copy_from_slice(&self.csum_offset.to_ne_bytes());
+        buf
+    }
+}
+
+/// Cut a packet read from TUN into wire-ready IP packets
+///
+/// Segments are assembled in `buf` and pushed to `out` as frozen splits of
+/// it, so one allocation serves many segments. Plain packets are copied
+/// through, with a partial checksum completed if the header asks for it.
+pub fn segment(hdr: &VirtioNetHdr, packet: &[u8], buf: &mut BytesMut, out: &mut Vec<Bytes>) -> Result<()> {
+    let gso_type = hdr.gso_type & !VIRTIO_NET_HDR_GSO_ECN;
+    if gso_type == VIRTIO_NET_HDR_GSO_NONE {
+        buf.extend_from_slice(packet);
+        if hdr.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM != 0 {
+            if let Err(e) = complete_checksum(&mut buf[..], hdr) {
+                buf.clear();
+                return Err(e);
+            }
+        }
+        out.push(buf.split().freeze());
+        return Ok(());
+    }
+
+    let is_v4 = packet.first().map(|b| b >> 4) == Some(4);
+    let l4_off = usize::from(hdr.csum_start);
+    let min_l4_off = if is_v4 { 20 } else { 40 };
+    let (protocol, l4_hdr_len) = match gso_type {
+        VIRTIO_NET_HDR_GSO_TCPV4 | VIRTIO_NET_HDR_GSO_TCPV6 if packet.len() >= l4_off + 20 => {
+            (IPPROTO_TCP, usize::from(packet[l4_off + 12] >> 4) * 4)
+        }
+        VIRTIO_NET_HDR_GSO_UDP_L4 => (IPPROTO_UDP, 8),
+        _ => {
+            return Err(VpnError::TunTap(format!(
+                "Unsupported GSO type {} for {} byte packet",
+                hdr.gso_type,
+                packet.len()
+            )))
+        }
+    };
+    let header_len = l4_off + l4_hdr_len;
+    let gso_size = usize::from(hdr.gso_size);
+    if l4_off < min_l4_off || l4_hdr_len < 8 || packet.len() < header_len || gso_size == 0 {
+        return Err(VpnError::TunTap(format!(
+            "Malformed GSO packet: {} bytes, L4 at {}, segment size {}",
+            packet.len(),
+            l4_off,
+            gso_size
+        )));
+    }
+
+    let headers = &packet[..header_len];
+    let payload = &packet[header_len..];
+    let segments = payload.len().div_ceil(gso_size).max(1);
+    buf.reserve(segments * header_len + payload.len());
+
+    let ip_id = u16::from_be_bytes([packet[4], packet[5]]);
+    let tcp_seq = u32::from_be_bytes([packet[l4_off + 4], packet[l4_off + 5], packet[l4_off + 6], packet[l4_off + 7]]);
+
+    for (i, chunk) in payload.chunks(gso_size).enumerate() {
+        buf.extend_from_slice(headers);
+        buf.extend_from_slice(chunk);
+        let seg = &mut buf[..];
+        let total = seg.len();
+
+        if is_v4 {
+            put_u16(seg, 2, total as u16);
+            put_u16(seg, 4, ip_id.wrapping_add(i as u16));
+            fill_ipv4_checksum(seg);
+        } else {
+            put_u16(seg, 4, (total - 40) as u16);
+        }
+
+        if protocol == IPPROTO_TCP {
+            let seq = tcp_seq.wrapping_add((i * gso_size) as u32);
+            seg[l4_off + 4..l4_off + 8].copy_from_slice(&seq.to_be_bytes());
+            if i + 1 < segments {
+                seg[l4_off + 13] &= !(TCP_FLAG_FIN | TCP_FLAG_PSH);
+            }
+            if i > 0 {
+                seg[l4_off + 13] &= !TCP_FLAG_CWR;
+            }
+            fill_l4_checksum(seg, l4_off, IPPROTO_TCP);
+        } else {
+            put_u16(seg, l4_off + 4, (total - l4_off) as u16);
+            fill_l4_checksum(seg, l4_off, IPPROTO_UDP);
+        }
+
+        out.push(buf.split().freeze());
+    }
+    Ok(())
+}
+
+/// Frame ready to write to a `IFF_VNET_HDR` TUN device
+#[derive(Debug)]
+pub struct GroFrame {
+    vnet: [u8; VIRTIO_NET_HDR_LEN],
+    /// The whole packet, or the patched headers of a coalesced one
+    head: Bytes,
+    /// Payloads following `head` in a coalesced frame
+    tail: Vec<Bytes>,
+}
+
+impl GroFrame {
+    /// Number of original packets carried by this frame
+    pub fn segments(&self) -> usize {
+        if self.tail.is_empty() { 1 } else { self.tail.len() }
+    }
+
+    /// IP bytes in this frame, excluding the virtio header
+    pub fn len(&self) -> usize {
+        self.head.len() + self.tail.iter().map(|p| p.len()).sum::<usize>()
+    }
+
+    /// Whether the frame carries no IP bytes
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Write the frame with a single vectored write
+    pub fn write_to<W: Write>(&self, writer: &mut W) -> io::Result<usize> {
+        let mut slices = Vec::with_capacity(2 + self.tail.len());
+        slices.push(IoSlice::new(&self.vnet));
+        slices.push(IoSlice::new(&self.head));
+        slices.extend(self.tail.iter().map(|p| IoSlice::new(p)));
+        writer.write_vectored(&slices)
+    }
+}
+
+/// Coalesces consecutive in-order TCP segments into GSO super-packets
+///
+/// Packets are pushed in arrival order and drained as frames. Only a flow's
+/// most recent frame is ever extended, so the order within every flow is
+/// kept. Packets that cannot be coalesced become frames of their own.
+#[derive(Default)]
+pub struct GroCoalescer {
+    items: Vec<GroItem>,
+}
+
+struct GroItem {
+    /// Addresses and ports of a TCP packet, whether or not it can be merged
+    flow: Option<FlowKey>,
+    first: Bytes,
+    payloads: Vec<Bytes>,
+    tcp: Option<TcpSegment>,
+    next_seq: u32,
+    total_len: usize,
+    psh: bool,
+    closed: bool,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+struct FlowKey {
+    addrs_and_ports: [u8; 36],
+}
+
+#[derive(Debug, Clone, Copy)]
+struct TcpSegment {
+    is_v4: bool,
+    l4_off: usize,
+    header_len: usize,
+    seq: u32,
+    payload_len: usize,
+    psh: bool,
+}
+
+impl GroCoalescer {
+    /// Create an empty coalescer
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Add the next packet bound for TUN
+    pub fn push(&mut self, packet: Bytes) {
+        let flow = flow_key(&packet);
+        let tcp = flow.and_then(|_| tcp_segment(&packet));
+
+        // Only the flow's latest frame may grow, or segments would overtake
+        // whatever the flow sent in between
+        if let (Some(key), Some(tcp)) = (flow, tcp) {
+            if let Some(item) = self.items.iter_mut().rev().find(|item| item.flow == Some(key)) {
+                if item.same_headers(&packet) && item.try_append(&packet, &tcp) {
+                    return;
+                }
+            }
+        }
+        self.items.push(GroItem::single(packet, flow, tcp));
+    }
+
+    /// Number of frames pending
+    pub fn len(&self) -> usize {
+        self.items.len()
+    }
+
+    /// Whether nothing is pending
+    pub fn is_empty(&self) -> bool {
+        self.items.is_empty()
+    }
+
+    /// Take the pending frames in order
+    pub fn drain(&mut self) -> impl Iterator<Item = GroFrame> + '_ {
+        self.items.drain(..).map(GroItem::into_frame)
+    }
+}
+
+impl GroItem {
+    fn single(packet: Bytes, flow: Option<FlowKey>, tcp: Option<TcpSegment>) -> Self {
+        let (next_seq, psh) = tcp
+            .map(|t| (t.seq.wrapping_add(t.payload_len as u32), t.psh))
+            .unwrap_or((0, false));
+        Self {
+            flow,
+            total_len: packet.len(),
+            first: packet,
+            payloads: Vec::new(),
+            tcp,
+            next_seq,
+            psh,
+            closed: psh,
+        }
+    }
+
+    /// Whether `packet`, from the same flow, has headers that allow merging
+    fn same_headers(&self, packet: &[u8]) -> bool {
+        let Some(tcp) = self.tcp else {
+            return false;
+        };
+        let first = &self.first[..];
+        if packet.len() < tcp.header_len || first[0] != packet[0] {
+            return false;
+        }
+        let l4 = tcp.l4_off;
+        let same_ip = if tcp.is_v4 {
+            // TOS, TTL and protocol
+            first[1] == packet[1] && first[8..10] == packet[8..10]
+        } else {
+            // Traffic class, flow label, next header and hop limit
+            first[..4] == packet[..4] && first[6..8] == packet[6..8]
+        };
+        // ACK number, data offset and flags except PSH, then options
+        same_ip
+            && first[l4 + 8..l4 + 13] == packet[l4 + 8..l4 + 13]
+            && (first[l4 + 13] | TCP_FLAG_PSH) == (packet[l4 + 13] | TCP_FLAG_PSH)
+            && first[l4 + 20..tcp.header_len] == packet[l4 + 20..tcp.header_len]
+    }
+
+    fn try_append(&mut self, packet: &Bytes, tcp: &TcpSegment) -> bool {
+        let Some(head) = self.tcp else {
+            return false;
+        };
+        let gso_size = head.payload_len;
+        if self.closed
+            || tcp.seq != self.next_seq
+            || tcp.header_len != head.header_len
+            || tcp.payload_len > gso_size
+            || self.total_len + tcp.payload_len > MAX_SUPER_PACKET
+            || self.payloads.len() + 2 > MAX_GRO_SEGMENTS
+        {
+            return false;
+        }
+
+        self.payloads.push(packet.slice(tcp.header_len..));
+        self.total_len += tcp.payload_len;
+        self.next_seq = tcp.seq.wrapping_add(tcp.payload_len as u32);
+        self.psh |= tcp.psh;
+        // A short or pushed segment ends the run, as it would on the sender
+        self.closed = tcp.psh || tcp.payload_len < gso_size;
+        true
+    }
+
+    fn into_frame(self) -> GroFrame {
+        let tcp = match self.tcp {
+            Some(tcp) if !self.payloads.is_empty() => tcp,
+            _ => {
+                return GroFrame {
+                    vnet: VirtioNetHdr::default().encode(),
+                    head: self.first,
+                    tail: Vec::new(),
+                }
+            }
+        };
+
+        let mut head = BytesMut::from(&self.first[..tcp.header_len]);
+        let total = self.total_len;
+        let l4 = tcp.l4_off;
+        if tcp.is_v4 {
+            put_u16(&mut head, 2, total as u16);
+            fill_ipv4_checksum(&mut head);
+        } else {
+            put_u16(&mut head, 4, (total - 40) as u16);
+        }
+        if self.psh {
+            head[l4 + 13] |= TCP_FLAG_PSH;
+        }
+        // Partial checksum: folded pseudo-header sum, completed by the kernel
+        put_u16(&mut head, l4 + TCP_CSUM_OFFSET, 0);
+        let pseudo = fold(pseudo_header_sum(&head, IPPROTO_TCP, total - l4));
+        put_u16(&mut head, l4 + TCP_CSUM_OFFSET, pseudo);
+
+        let vnet = VirtioNetHdr {
+            flags: VIRTIO_NET_HDR_F_NEEDS_CSUM,
+            gso_type: if tcp.is_v4 { VIRTIO_NET_HDR_GSO_TCPV4 } else { VIRTIO_NET_HDR_GSO_TCPV6 },
+            hdr_len: tcp.header_len as u16,
+            gso_size: tcp.payload_len as u16,
+            csum_start: l4 as u16,
+            csum_offset: TCP_CSUM_OFFSET as u16,
+        };
+
+        let mut tail = Vec::with_capacity(1 + self.payloads.len());
+        tail.push(self.first.slice(tcp.header_len..));
+        tail.extend(self.payloads);
+        GroFrame { vnet: vnet.encode(), head: head.freeze(), tail }
+    }
+}
+
+/// Addresses and ports of a TCP packet
+fn flow_key(packet: &[u8]) -> Option<FlowKey> {
+    let (addrs, l4_off) = match packet.first().map(|b| b >> 4) {
+        Some(4) if packet.len() >= 20 && packet[9] == IPPROTO_TCP => {
+            (&packet[12..20], usize::from(packet[0] & 0x0f) * 4)
+        }
+        Some(6) if packet.len() >= 40 && packet[6] == IPPROTO_TCP => (&packet[8..40], 40),
+        _ => return None,
+    };
+    let ports = packet.get(l4_off..l4_off + 4)?;
+    let mut key = FlowKey { addrs_and_ports: [0u8; 36] };
+    key.addrs_and_ports[..addrs.len()].copy_from_slice(addrs);
+    key.addrs_and_ports[32..].copy_from_slice(ports);
+    Some(key)
+}
+
+/// Parse a plain data-carrying TCP segment that GRO may merge
+fn tcp_segment(packet: &[u8]) -> Option<TcpSegment> {
+    let (is_v4, l4_off) = match packet.first().map(|b| b >> 4) {
+        Some(4) if packet.len() >= 40 => {
+            let unfragmented = u16::from_be_bytes([packet[6], packet[7]]) & 0x3fff == 0;
+            let total_len = usize::from(u16::from_be_bytes([packet[2], packet[3]]));
+            // No IP options, no fragments, no trailing padding
+            if packet[0] & 0x0f != 5 || packet[9] != IPPROTO_TCP || !unfragmented || total_len != packet.len() {
+                return None;
+            }
+            (true, 20)
+        }
+        Some(6) if packet.len() >= 60 => {
+            let payload_len = usize::from(u16::from_be_bytes([packet[4], packet[5]]));
+            if packet[6] != IPPROTO_TCP || payload_len + 40 != packet.len() {
+                return None;
+            }
+            (false, 40)
+        }
+        _ => return None,
+    };
+
+    let header_len = l4_off + usize::from(packet[l4_off + 12] >> 4) * 4;
+    let flags = packet[l4_off + 13];
+    if header_len < l4_off + 20 || header_len >= packet.len() || flags & !TCP_FLAG_PSH != TCP_FLAG_ACK {
+        return None;
+    }
+    Some(TcpSegment {
+        is_v4,
+        l4_off,
+        header_len,
+        seq: u32::from_be_bytes([packet[l4_off + 4], packet[l4_off + 5], packet[l4_off + 6], packet[l4_off + 7]]),
+        payload_len: packet.len() - header_len,
+        psh: flags & TCP_FLAG_PSH != 0,
+    })
+}
+
+/// Finish a partial L4 checksum as described by `hdr`
+fn complete_checksum(packet: &mut [u8], hdr: &VirtioNetHdr) -> Result<()> {
+    let start = usize::from(hdr.csum_start);
+    let at = start + usize::from(hdr.csum_offset);
+    if at + 2 > packet.len() {
+        return Err(VpnError::TunTap(format!(
+            "Checksum offset {} beyond {} byte packet",
+            at,
+            packet.len()
+        )));
+    }
+    // The field already holds the pseudo-header sum
+    let mut csum = !fold(sum_be(&packet[start..], 0));
+    if csum == 0 && at == start + UDP_CSUM_OFFSET {
+        csum = 0xffff;
+    }
+    put_u16(packet, at, csum);
+    Ok(())
+}
+
+/// Compute and store the full TCP or UDP checksum of `packet`
+fn fill_l4_checksum(packet: &mut [u8], l4_off: usize, protocol: u8) {
+    let at = l4_off + if protocol == IPPROTO_TCP { TCP_CSUM_OFFSET } else { UDP_CSUM_OFFSET };
+    put_u16(packet, at, 0);
+    let sum = pseudo_header_sum(packet, protocol, packet.len() - l4_off);
+    let mut csum = !fold(sum_be(&packet[l4_off..], sum));
+    if csum == 0 && protocol == IPPROTO_UDP {
+        csum = 0xffff;
+    }
+    put_u16(packet, at, csum);
+}
+
+/// Compute and store the IPv4 header checksum
+fn fill_ipv4_checksum(packet: &mut [u8]) {
+    let ihl = usize::from(packet[0] & 0x0f) * 4;
+    put_u16(packet, 10, 0);
+    let csum = !fold(sum_be(&packet[..ihl], 0));
+    put_u16(packet, 10, csum);
+}
+
+/// One's-complement sum of the IPv4 or IPv6 pseudo-header
+fn pseudo_header_sum(packet: &[u8], protocol: u8, l4_len: usize) -> u64 {
+    let addrs = if packet[0] >> 4 == 4 { &packet[12..20] } else { &packet[8..40] };
+    sum_be(addrs, u64::from(protocol) + l4_len as u64)
+}
+
+/// Add `data` to a running one's-complement sum, 32 bits at a time
+fn sum_be(data: &[u8], initial: u64) -> u64 {
+    let mut sum = initial;
+    let mut words = data.chunks_exact(4);
+    for word in &mut words {
+        sum += u64::from(u32::from_be_bytes([word[0], word[1], word[2], word[3]]));
+    }
+    let rest = words.remainder();
+    if !rest.is_empty() {
+        let mut word = [0u8; 4];
+        word[..rest.len()].copy_from_slice(rest);
+        sum += u64::from(u32::from_be_bytes(word));
+    }
+    sum
+}
+
+fn fold(mut sum: u64) -> u16 {
+    while sum >> 16 != 0 {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    sum as u16
+}
+
+#[inline]
+fn put_u16(buf: &mut [u8], at: usize, value: u16) {
+    buf[at..at + 2].copy_from_slice(&value.to_be_bytes());
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// IPv4/TCP packet with `flags` and `payload` bytes
+    fn tcp_v4(seq: u32, flags: u8, payload: &[u8]) -> Vec<u8> {
+        let mut packet = vec![0u8; 40];
+        packet[0] = 0x45;
+        put_u16(&mut packet, 2, (40 + payload.len()) as u16);
+        put_u16(&mut packet, 4, 0x1000);
+        packet[8] = 64;
+        packet[9] = IPPROTO_TCP;
+        packet[12..16].copy_from_slice(&[10, 0, 0, 2]);
+        packet[16..20].copy_from_slice(&[10, 0, 0, 1]);
+        put_u16(&mut packet, 20, 40000);
+        put_u16(&mut packet, 22, 443);
+        packet[24..28].copy_from_slice(&seq.to_be_bytes());
+        packet[28..32].copy_from_slice(&7u32.to_be_bytes());
+        packet[32] = 5 << 4;
+        packet[33] = flags;
+        put_u16(&mut packet, 34, 0xffff);
+        packet.extend_from_slice(payload);
+        fill_ipv4_checksum(&mut packet);
+        fill_l4_checksum(&mut packet, 20, IPPROTO_TCP);
+        packet
+    }
+
+    fn checksums_valid(packet: &[u8]) -> bool {
+        let ip_ok = fold(sum_be(&packet[..20], 0)) == 0xffff;
+        let l4_sum = pseudo_header_sum(packet, IPPROTO_TCP, packet.len() - 20);
+        ip_ok && fold(sum_be(&packet[20..], l4_sum)) == 0xffff
+    }
+
+    fn tso_hdr(gso_size: u16) -> VirtioNetHdr {
+        VirtioNetHdr {
+            flags: VIRTIO_NET_HDR_F_NEEDS_CSUM,
+            gso_type: VIRTIO_NET_HDR_GSO_TCPV4,
+            hdr_len: 40,
+            gso_size,
+            csum_start: 20,
+            csum_offset: TCP_CSUM_OFFSET as u16,
+        }
+    }
+
+    #[test]
+    fn test_virtio_header_round_trip() {
+        let hdr = tso_hdr(1448);
+        assert_eq!(VirtioNetHdr::decode(&hdr.encode()), Some(hdr));
+        assert_eq!(VirtioNetHdr::decode(&[0u8; 4]), None);
+    }
+
+    #[test]
+    fn test_segment_tso_super_packet() {
+        let payload: Vec<u8> = (0..2500u32).map(|i| i as u8).collect();
+        let super_packet = tcp_v4(1000, TCP_FLAG_ACK | TCP_FLAG_PSH, &payload);
+
+        let mut buf = BytesMut::new();
+        let mut out = Vec::new();
+        segment(&tso_hdr(1000), &super_packet, &mut buf, &mut out).unwrap();
+
+        assert_eq!(out.len(), 3);
+        assert_eq!(out.iter().map(|s| s.len() - 40).collect::<Vec<_>>(), vec![1000, 1000, 500]);
+        for (i, seg) in out.iter().enumerate() {
+            assert!(checksums_valid(seg), "segment {} checksum", i);
+            let seq = u32::from_be_bytes([seg[24], seg[25], seg[26], seg[27]]);
+            assert_eq!(seq, 1000 + 1000 * i as u32);
+            assert_eq!(seg[33] & TCP_FLAG_PSH != 0, i == 2);
+        }
+        assert_eq!(&out[1][40..], &payload[1000..2000]);
+    }
+
+    #[test]
+    fn test_segment_completes_partial_checksum() {
+        let mut packet = tcp_v4(1, TCP_FLAG_ACK, b"hello");
+        let pseudo = fold(pseudo_header_sum(&packet, IPPROTO_TCP, packet.len() - 20));
+        put_u16(&mut packet, 36, pseudo);
+        let hdr = VirtioNetHdr { gso_type: VIRTIO_NET_HDR_GSO_NONE, ..tso_hdr(0) };
+
+        let mut buf = BytesMut::new();
+        let mut out = Vec::new();
+        segment(&hdr, &packet, &mut buf, &mut out).unwrap();
+        assert_eq!(out.len(), 1);
+        assert!(checksums_valid(&out[0]));
+    }
+
+    #[test]
+    fn test_gro_coalesces_in_order_segments_and_resegments_identically() {
+        let payload: Vec<u8> = (0..3000u32).map(|i| (i * 7) as u8).collect();
+        let mut buf = BytesMut::new();
+        let mut segments = Vec::new();
+        segment(&tso_hdr(1200), &tcp_v4(5000, TCP_FLAG_ACK | TCP_FLAG_PSH, &payload), &mut buf, &mut segments).unwrap();
+
+        let mut gro = GroCoalescer::new();
+        for seg in &segments {
+            gro.push(seg.clone());
+        }
+        let frames: Vec<GroFrame> = gro.drain().collect();
+        assert_eq!(frames.len(), 1);
+        assert_eq!(frames[0].segments(), 3);
+
+        let mut wire = Vec::new();
+        frames[0].write_to(&mut wire).unwrap();
+        let hdr = VirtioNetHdr::decode(&wire).unwrap();
+        assert_eq!(hdr.gso_type, VIRTIO_NET_HDR_GSO_TCPV4);
+        assert_eq!(hdr.gso_size, 1200);
+
+        let mut again = Vec::new();
+        segment(&hdr, &wire[VIRTIO_NET_HDR_LEN..], &mut buf, &mut again).unwrap();
+        assert_eq!(again, segments);
+    }
+
+    #[test]
+    fn test_gro_keeps_gaps_and_other_packets_separate() {
+        let mut gro = GroCoalescer::new();
+        gro.push(Bytes::from(tcp_v4(0, TCP_FLAG_ACK, &[1u8; 100])));
+        // Sequence gap: cannot extend the first frame
+        gro.push(Bytes::from(tcp_v4(200, TCP_FLAG_ACK, &[2u8; 100])));
+        // Not TCP
+        gro.push(Bytes::from_static(&[0x45, 0, 0, 20]));
+        // A FIN in between must not be overtaken by later data
+        gro.push(Bytes::from(tcp_v4(300, TCP_FLAG_ACK | TCP_FLAG_FIN, &[])));
+        gro.push(Bytes::from(tcp_v4(300, TCP_FLAG_ACK, &[3u8; 100])));
+        assert_eq!(gro.len(), 5);
+
+        let frames: Vec<GroFrame> = gro.drain().collect();
+        assert!(frames.iter().all(|f| f.segments() == 1));
+        let mut wire = Vec::new();
+        frames[0].write_to(&mut wire).unwrap();
+        assert_eq!(VirtioNetHdr::decode(&wire), Some(VirtioNetHdr::default()));
+        assert!(gro.is_empty());
+    }
+}
@@ -2,9 +2,10 @@
 // This module handles proper encapsulation and framing of packets for VPN tunnels
 
 use crate::error::{VpnError as Error, Result};
+use bytes::{BufMut, Bytes, BytesMut};
 use std::net::IpAddr;
+use std::sync::atomic::{AtomicU64, Ordering};
 use std::sync::Arc;
-use tokio::sync::Mutex;
 
 /// Packet header structure
 /// Based on SoftEther's implementation but simplified for our needs
@@ -36,14 +37,19 @@ impl PacketHeader {
     }
     
     pub fn to_bytes(&self) -> Vec<u8> {
-        let mut buffer = Vec::with_capacity(Self::SIZE);
-        buffer.push(self.version);
-        buffer.push(self.packet_type);
-        buffer.extend_from_slice(&self.session_id.to_be_bytes());
-        buffer.extend_from_slice(&self.payload_size.to_be_bytes());
+        let mut buffer = vec![0u8; Self::SIZE];
+        self.write_to(&mut buffer);
         buffer
     }
     
+    /// Write the header into the first `SIZE` bytes of `out`
+    pub fn write_to(&self, out: &mut [u8]) {
+        out[0] = self.version;
+        out[1] = self.packet_type;
+        out[2..6].copy_from_slice(&self.session_id.to_be_bytes());
+        out[6..10].copy_from_slice(&self.payload_size.to_be_bytes());
+    }
+    
     pub fn from_bytes(data: &[u8]) -> Result<Self> {
         if data.len() < Self::SIZE {
             return Err(Error::PacketError("Header data too small".into()));
@@ -70,13 +76,16 @@ impl PacketHeader {
 }
 
 /// PacketFramer - Handles packet framing for the VPN tunnel
+///
+/// All methods take `&self`: the counters are atomics, so one framer can
+/// serve the send and receive tasks at the same time without a lock.
 pub struct PacketFramer {
     session_id: u32,
     remote_ip: IpAddr,
     // Stats for debugging
-    sent_packets: u64,
-    received_packets: u64,
-    errors: u64,
+    sent_packets: AtomicU64,
+    received_packets: AtomicU64,
+    errors: AtomicU64,
 }
 
 impl PacketFramer {
@@ -84,31 +93,41 @@ impl PacketFramer {
         Self {
             session_id,
             remote_ip,
-            sent_packets: 0,
-            received_packets: 0,
-            errors: 0,
+            sent_packets: AtomicU64::new(0),
+            received_packets: AtomicU64::new(0),
+            errors: AtomicU64::new(0),
         }
     }
     
+    /// Remote tunnel endpoint this framer was created for
+    pub fn remote_ip(&self) -> IpAddr {
+        self.remote_ip
+    }
+    
     /// Frame a packet for sending through the tunnel
-    pub fn frame_packet(&mut self, data: &[u8]) -> Vec<u8> {
-        let header = PacketHeader::new(
-            PacketHeader::TYPE_DATA,
-            self.session_id,
-            data.len() as u32
-        );
-        
-        let mut framed_packet = header.to_bytes();
-        framed_packet.extend_from_slice(data);
-        
-        self.sent_packets += 1;
-        framed_packet
+    pub fn frame_packet(&self, data: &[u8]) -> Bytes {
+        let mut framed_packet = BytesMut::with_capacity(PacketHeader::SIZE + data.len());
+        framed_packet.put_bytes(0, PacketHeader::SIZE);
+        framed_packet.put_slice(data);
+        self.frame_in_place(&mut framed_packet);
+        framed_packet.freeze()
     }
     
-    /// Decode a received packet
-    pub fn decode_packet(&mut self, data: &[u8]) -> Result<(PacketHeader, Vec<u8>)> {
+    /// Frame a payload that already sits behind `PacketHeader::SIZE` bytes of headroom
+    ///
+    /// `buf` holds the reserved header space followed by the payload; the
+    /// header is written over the headroom, so the payload is never copied.
+    pub fn frame_in_place(&self, buf: &mut [u8]) {
+        let payload_size = buf.len().saturating_sub(PacketHeader::SIZE);
+        PacketHeader::new(PacketHeader::TYPE_DATA, self.session_id, payload_size as u32)
+            .write_to(buf);
+        self.sent_packets.fetch_add(1, Ordering::Relaxed);
+    }
+    
+    /// Decode a received packet; the payload is a view into `data`
+    pub fn decode_packet(&self, data: Bytes) -> Result<(PacketHeader, Bytes)> {
         if data.len() < PacketHeader::SIZE {
-            self.errors += 1;
+            self.errors.fetch_add(1, Ordering::Relaxed);
             return Err(Error::PacketError("Packet too small".into()));
         }
         
@@ -116,12 +135,12 @@ impl PacketFramer {
         
         // Validate header
         if header.version != PacketHeader::VERSION {
-            self.errors += 1;
+            self.errors.fetch_add(1, Ordering::Relaxed);
             return Err(Error::PacketError(format!("Invalid packet version: {}", header.version)));
         }
         
         if (header.payload_size as usize) != data.len() - PacketHeader::SIZE {
-            self.errors += 1;
+            self.errors.fetch_add(1, Ordering::Relaxed);
             return Err(Error::PacketError(format!(
                 "Payload size mismatch: expected {}, got {}",
                 header.payload_size,
@@ -129,79 +148,116 @@ impl PacketFramer {
             )));
         }
         
-        let payload = data[PacketHeader::SIZE..].to_vec();
-        self.received_packets += 1;
+        let payload = data.slice(PacketHeader::SIZE..);
+        self.received_packets.fetch_add(1, Ordering::Relaxed);
         
         Ok((header, payload))
     }
     
     /// Create a keepalive packet
-    pub fn create_keepalive(&self) -> Vec<u8> {
-        let header = PacketHeader::new(
-            PacketHeader::TYPE_KEEPALIVE,
-            self.session_id,
-            0
-        );
-        
-        header.to_bytes()
+    pub fn create_keepalive(&self) -> Bytes {
+        let mut packet = [0u8; PacketHeader::SIZE];
+        PacketHeader::new(PacketHeader::TYPE_KEEPALIVE, self.session_id, 0).write_to(&mut packet);
+        Bytes::copy_from_slice(&packet)
     }
     
     /// Check if packet is a keepalive packet
     pub fn is_keepalive(&self, data: &[u8]) -> bool {
-        if data.len() >= PacketHeader::SIZE {
-            if let Ok(header) = PacketHeader::from_bytes(&data[0..PacketHeader::SIZE]) {
-                return header.packet_type == PacketHeader::TYPE_KEEPALIVE;
-            }
-        }
-        false
+        data.len() >= PacketHeader::SIZE && data[1] == PacketHeader::TYPE_KEEPALIVE
     }
     
     /// Get current statistics
     pub fn get_stats(&self) -> (u64, u64, u64) {
-        (self.sent_packets, self.received_packets, self.errors)
+        (
+            self.sent_packets.load(Ordering::Relaxed),
+            self.received_packets.load(Ordering::Relaxed),
+            self.errors.load(Ordering::Relaxed),
+        )
     }
 }
 
-/// Thread-safe packet framer wrapper
+/// Thread-safe packet framer handle; clones share one framer and its counters
+#[derive(Clone)]
 pub struct SharedPacketFramer {
-    inner: Arc<Mutex<PacketFramer>>,
+    inner: Arc<PacketFramer>,
 }
 
 impl SharedPacketFramer {
     pub fn new(session_id: u32, remote_ip: IpAddr) -> Self {
         Self {
-            inner: Arc::new(Mutex::new(PacketFramer::new(session_id, remote_ip))),
+            inner: Arc::new(PacketFramer::new(session_id, remote_ip)),
         }
     }
     
-    pub fn clone(&self) -> Self {
-        Self {
-            inner: Arc::clone(&self.inner),
-        }
+    pub fn frame_packet(&self, data: &[u8]) -> Bytes {
+        self.inner.frame_packet(data)
     }
     
-    pub async fn frame_packet(&self, data: &[u8]) -> Vec<u8> {
-        let mut framer = self.inner.lock().await;
-        framer.frame_packet(data)
+    pub fn frame_in_place(&self, buf: &mut [u8]) {
+        self.inner.frame_in_place(buf)
     }
     
-    pub async fn decode_packet(&self, data: &[u8]) -> Result<(PacketHeader, Vec<u8>)> {
-        let mut framer = self.inner.lock().await;
-        framer.decode_packet(data)
+    pub fn decode_packet(&self, data: Bytes) -> Result<(PacketHeader, Bytes)> {
+        self.inner.decode_packet(data)
     }
     
-    pub async fn create_keepalive(&self) -> Vec<u8> {
-        let framer = self.inner.lock().await;
-        framer.create_keepalive()
+    pub fn create_keepalive(&self) -> Bytes {
+        self.inner.create_keepalive()
     }
     
-    pub async fn is_keepalive(&self, data: &[u8]) -> bool {
-        let framer = self.inner.lock().await;
-        framer.is_keepalive(data)
+    pub fn is_keepalive(&self, data: &[u8]) -> bool {
+        self.inner.is_keepalive(data)
     }
     
-    pub async fn get_stats(&self) -> (u64, u64, u64) {
-        let framer = self.inner.lock().await;
-        framer.get_stats()
+    pub fn get_stats(&self) -> (u64, u64, u64) {
+        self.inner.get_stats()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::net::Ipv4Addr;
+
+    #[test]
+    fn test_frame_and_decode_share_buffers() {
+        let framer = SharedPacketFramer::new(7, IpAddr::V4(Ipv4Addr::LOCALHOST));
+
+        // Header goes into reserved headroom in front of the payload
+        let mut buf = vec![0u8; PacketHeader::SIZE];
+        buf.extend_from_slice(b"payload");
+        framer.frame_in_place(&mut buf);
+        assert_eq!(&buf[..], &framer.frame_packet(b"payload")[..]);
+
+        let framed = Bytes::from(buf);
+        let (header, payload) = framer.decode_packet(framed.clone()).unwrap();
+        assert_eq!(header.session_id, 7);
+        assert_eq!(&payload[..], b"payload");
+        assert_eq!(payload.as_ptr(), framed[PacketHeader::SIZE..].as_ptr());
+
+        assert!(framer.is_keepalive(&framer.create_keepalive()));
+        assert!(!framer.is_keepalive(&framed));
+        assert!(framer.decode_packet(framed.slice(..12)).is_err());
+        assert_eq!(framer.get_stats(), (2, 1, 1));
+    }
+
+    #[test]
+    fn test_concurrent_framing_counts_every_packet() {
+        let framer = SharedPacketFramer::new(1, IpAddr::V4(Ipv4Addr::LOCALHOST));
+        let threads: Vec<_> = (0..4)
+            .map(|_| {
+                let framer = framer.clone();
+                std::thread::spawn(move || {
+                    for _ in 0..1000 {
+                        let framed = framer.frame_packet(b"x");
+                        framer.decode_packet(framed).unwrap();
+                    }
+                })
+            })
+            .collect();
+        for thread in threads {
+            thread.join().unwrap();
+        }
+        assert_eq!(framer.get_stats(), (4000, 4000, 0));
     }
 }
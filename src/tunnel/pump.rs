@@ -0,0 +1,1552 @@
+//! TUN <-> data channel packet pump
+//!
+//! Moves IP packets between the TUN device and the SoftEther binary data
+//! channel. The pump is a four-stage pipeline, one stage per direction and
+//! side, connected by bounded queues:
+//!
+//! ```text
+//! TUN read thread --[uplink queue]--> uplink task   --> data channel
+//! TUN write thread <-[downlink queue]-- downlink task <-- data channel
+//! ```
+//!
+//! TUN I/O runs on dedicated blocking threads; socket I/O runs as async
+//! tasks. A full queue stalls the stage feeding it, so a slow server slows
+//! TUN reads and a slow TUN slows socket reads (and with it TCP flow
+//! control) instead of growing memory.
+//!
+//! Transports can be swapped under a running pump ([`PacketPump::resume`]).
+//! When a data channel fails, its lane keeps the TUN side and its queues up
+//! for [`PumpConfig::resume_window`] and waits for a replacement. Packets
+//! read in the meantime wait in the bounded uplink queue, and the batch that
+//! was in flight is sent again on the new channel.
+//!
+//! Optionally each lane also watches its channel's TCP MSS and reports the
+//! tunnel MTU it allows ([`PumpConfig::mtu_hook`]), and TCP SYNs in both
+//! directions get their MSS clamped to that MTU ([`PumpConfig::mss_clamp`]).
+//!
+//! Packets carry the time they entered the pump through the queues, so
+//! [`PumpStats`] can histogram TUN read -> wire and wire -> TUN write
+//! latency, queueing included.
+//!
+//! On Linux the TUN threads can do their I/O through io_uring instead
+//! ([`PumpConfig::io_uring`]): the reader keeps a read in flight for every
+//! registered buffer, and the writer submits each batch of packets with one
+//! system call. Where io_uring is missing the poll-based threads are used.
+//! On macOS they move whole batches of utun frames per `recvmsg_x` and
+//! `sendmsg_x` call.
+
+use crate::error::{Result, VpnError};
+use crate::monitoring::{LatencyHistogram, LatencySummary, ShardedCounter};
+use super::mtu;
+use super::offload::{self, GroCoalescer, VirtioNetHdr, MAX_SUPER_PACKET, VIRTIO_NET_HDR_LEN};
+#[cfg(target_os = "linux")]
+use super::uring::{IoUring, Sqe, Timespec};
+#[cfg(target_os = "macos")]
+use super::macos_tun::UtunBatch;
+use crate::protocol::binary::{BinaryDataReader, BinaryDataWriter, BinaryProtocolClient};
+use bytes::{Bytes, BytesMut};
+use std::fs::File;
+use std::io::{Read, Write};
+use std::os::unix::io::{AsFd, AsRawFd, FromRawFd, OwnedFd, RawFd};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread;
+use std::time::{Duration, Instant};
+use tokio::io::{AsyncRead, AsyncWrite};
+use tokio::sync::{mpsc, watch};
+
+/// A queued packet and when it entered the pump
+type Stamped = (Instant, Bytes);
+
+pub use super::DataChannelConnect;
+
+/// Per-packet protocol information header the OS puts on raw TUN reads
+#[cfg(target_os = "macos")]
+const TUN_PI_LEN: usize = 4;
+#[cfg(not(target_os = "macos"))]
+const TUN_PI_LEN: usize = 0;
+
+/// How often the TUN read thread checks for shutdown while idle
+const TUN_POLL_TIMEOUT_MS: i32 = 100;
+
+/// Replacement data channels a lane can have queued
+const RESUME_QUEUE_DEPTH: usize = 4;
+
+/// How often a lane re-reads its data channel's MSS
+const PATH_MTU_PROBE_INTERVAL: Duration = Duration::from_secs(5);
+
+/// Most reads an io_uring TUN reader keeps in flight
+#[cfg(target_os = "linux")]
+const URING_READS_MAX: usize = 256;
+
+/// Completion tag of the io_uring reader's shutdown check timer
+#[cfg(target_os = "linux")]
+const URING_TICK: u64 = u64::MAX;
+
+/// Completion tag of the io_uring reader's readiness poll
+#[cfg(target_os = "linux")]
+const URING_READABLE: u64 = u64::MAX - 1;
+
+/// Applies a new TUN MTU, e.g. via `LinuxTunInterface::set_mtu`
+#[derive(Clone)]
+pub struct MtuHook(Arc<dyn Fn(u32) -> Result<()> + Send + Sync>);
+
+impl MtuHook {
+    pub fn new(apply: impl Fn(u32) -> Result<()> + Send + Sync + 'static) -> Self {
+        Self(Arc::new(apply))
+    }
+}
+
+impl std::fmt::Debug for MtuHook {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.write_str("MtuHook")
+    }
+}
+
+/// Packet pump tuning
+#[derive(Debug, Clone)]
+pub struct PumpConfig {
+    /// TUN MTU; sizes the read buffers
+    pub mtu: usize,
+    /// Capacity of each direction's queue, in packets
+    pub queue_depth: usize,
+    /// Most packets moved per data channel read or write
+    pub batch_size: usize,
+    /// TUN frames carry a virtio_net_hdr (Linux IFF_VNET_HDR offload):
+    /// super-packets are segmented on read and TCP segments coalesced on write
+    pub vnet_hdr: bool,
+    /// How long a lane whose data channel failed waits for a replacement
+    /// before the pump stops; zero stops it at once
+    pub resume_window: Duration,
+    /// Lower the MSS option of forwarded TCP SYNs to fit the tunnel MTU
+    pub mss_clamp: bool,
+    /// Follow the data channels' path MTU: called whenever the TUN MTU they
+    /// allow changes. Never raised above `mtu`, which sizes the read buffers.
+    pub mtu_hook: Option<MtuHook>,
+    /// Linux: batch TUN reads and writes through io_uring (5.6+), falling
+    /// back to the poll threads where it is unavailable. Not combined with
+    /// `vnet_hdr`.
+    pub io_uring: bool,
+}
+
+impl Default for PumpConfig {
+    fn default() -> Self {
+        Self {
+            mtu: 1500,
+            queue_depth: 1024,
+            batch_size: 64,
+            vnet_hdr: false,
+            resume_window: Duration::from_secs(30),
+            mss_clamp: false,
+            mtu_hook: None,
+            io_uring: false,
+        }
+    }
+}
+
+/// Packet pump counters
+#[derive(Debug, Default)]
+pub struct PumpStats {
+    /// Packets read from TUN and queued for the server
+    pub uplink_packets: ShardedCounter,
+    pub uplink_bytes: ShardedCounter,
+    /// Packets received from the server and written to TUN
+    pub downlink_packets: ShardedCounter,
+    pub downlink_bytes: ShardedCounter,
+    /// TUN read until the data channel write returned
+    pub uplink_latency: LatencyHistogram,
+    /// Data channel read until the TUN write returned
+    pub downlink_latency: LatencyHistogram,
+    /// Times a stage had to wait because the next queue was full
+    pub backpressure_events: AtomicU64,
+    /// Offloaded super-packets read from TUN and segmented
+    pub gso_packets: AtomicU64,
+    /// TUN writes that carried more than one coalesced packet
+    pub gro_frames: AtomicU64,
+    /// Data channels that failed under a running lane
+    pub transport_losses: AtomicU64,
+    /// Replacement data channels a lane switched to
+    pub resumes: AtomicU64,
+    /// MTU currently used for the tunnel (and MSS clamping)
+    pub tunnel_mtu: AtomicU64,
+    /// Times path MTU tracking changed the tunnel MTU
+    pub mtu_changes: AtomicU64,
+    /// TCP SYNs whose MSS option was lowered
+    pub mss_clamped: AtomicU64,
+}
+
+impl PumpStats {
+    /// Read every counter and histogram
+    pub fn snapshot(&self) -> PumpSnapshot {
+        PumpSnapshot {
+            uplink_packets: self.uplink_packets.get(),
+            uplink_bytes: self.uplink_bytes.get(),
+            downlink_packets: self.downlink_packets.get(),
+            downlink_bytes: self.downlink_bytes.get(),
+            uplink_latency: self.uplink_latency.summary(),
+            downlink_latency: self.downlink_latency.summary(),
+            backpressure_events: self.backpressure_events.load(Ordering::Relaxed),
+            gso_packets: self.gso_packets.load(Ordering::Relaxed),
+            gro_frames: self.gro_frames.load(Ordering::Relaxed),
+            transport_losses: self.transport_losses.load(Ordering::Relaxed),
+            resumes: self.resumes.load(Ordering::Relaxed),
+            tunnel_mtu: self.tunnel_mtu.load(Ordering::Relaxed),
+            mtu_changes: self.mtu_changes.load(Ordering::Relaxed),
+            mss_clamped: self.mss_clamped.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// Point-in-time copy of [`PumpStats`]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct PumpSnapshot {
+    pub uplink_packets: u64,
+    pub uplink_bytes: u64,
+    pub downlink_packets: u64,
+    pub downlink_bytes: u64,
+    pub uplink_latency: LatencySummary,
+    pub downlink_latency: LatencySummary,
+    pub backpressure_events: u64,
+    pub gso_packets: u64,
+    pub gro_frames: u64,
+    pub transport_losses: u64,
+    pub resumes: u64,
+    pub tunnel_mtu: u64,
+    pub mtu_changes: u64,
+    pub mss_clamped: u64,
+}
+
+/// Running packet pump; stops when dropped
+pub struct PacketPump {
+    shutdown: watch::Sender<bool>,
+    running: Arc<AtomicBool>,
+    stats: Arc<PumpStats>,
+    tun_readers: Vec<thread::JoinHandle<()>>,
+    /// Per lane: where replacement data channels go
+    resumes: Vec<mpsc::Sender<DataChannelConnect>>,
+    /// Whether the TUN threads do their I/O through io_uring
+    io_uring: bool,
+}
+
+impl PacketPump {
+    /// Start pumping between `tun_fd` and the data channel produced by `connect`
+    ///
+    /// `tun_fd` is duplicated, so the caller keeps ownership of its device.
+    /// Async stages are spawned on `runtime`.
+    pub fn start(
+        tun_fd: RawFd,
+        connect: DataChannelConnect,
+        runtime: &tokio::runtime::Handle,
+        config: PumpConfig,
+    ) -> Result<Self> {
+        Self::start_multi_queue(&[tun_fd], vec![connect], runtime, config)
+    }
+
+    /// Start pumping between the queues of a multi-queue TUN device and one or more data channels
+    ///
+    /// Every queue gets its own read and write thread. Queue `q` sends through
+    /// data channel `q % connects.len()`, so with one channel per queue each
+    /// lane is fully independent. Packets arriving from any channel are written
+    /// to the queue chosen by their flow hash, keeping each flow on one queue
+    /// and therefore in order.
+    pub fn start_multi_queue(
+        tun_fds: &[RawFd],
+        connects: Vec<DataChannelConnect>,
+        runtime: &tokio::runtime::Handle,
+        config: PumpConfig,
+    ) -> Result<Self> {
+        if tun_fds.is_empty() || connects.is_empty() || connects.len() > tun_fds.len() {
+            return Err(VpnError::TunTap(format!(
+                "Packet pump needs 1..={} data channels for {} TUN queues, got {}",
+                tun_fds.len(), tun_fds.len(), connects.len()
+            )));
+        }
+
+        let (shutdown, shutdown_rx) = watch::channel(false);
+        let mut pump = Self {
+            shutdown,
+            running: Arc::new(AtomicBool::new(true)),
+            stats: Arc::new(PumpStats::default()),
+            tun_readers: Vec::with_capacity(tun_fds.len()),
+            resumes: Vec::with_capacity(connects.len()),
+            io_uring: false,
+        };
+
+        pump.stats.tunnel_mtu.store(config.mtu as u64, Ordering::Relaxed);
+        let lanes = connects.len();
+        let path_mtu = config.mtu_hook.clone().map(|hook| Arc::new(PathMtu::new(lanes, config.mtu as u32, hook)));
+        let (uplink_txs, uplink_rxs): (Vec<_>, Vec<_>) =
+            (0..lanes).map(|_| mpsc::channel::<Stamped>(config.queue_depth)).unzip();
+        let mut downlink_txs = Vec::with_capacity(tun_fds.len());
+
+        // Dropping `pump` on error stops whatever was already started
+        for (queue, &tun_fd) in tun_fds.iter().enumerate() {
+            let tun_read = dup_fd(tun_fd)?;
+            let tun_write = dup_fd(tun_fd)?;
+            let (downlink_tx, downlink_rx) = mpsc::channel::<Stamped>(config.queue_depth);
+            downlink_txs.push(downlink_tx);
+
+            let (read_io, write_io) = TunIo::for_queue(&config);
+            #[cfg(target_os = "linux")]
+            {
+                pump.io_uring |= matches!(read_io, TunIo::Uring(_));
+            }
+
+            let uplink = uplink_txs[queue % lanes].clone();
+            let running = pump.running.clone();
+            let stats = pump.stats.clone();
+            let reader_config = config.clone();
+            let reader = thread::Builder::new()
+                .name(format!("rvpnse-tun-rx{}", queue))
+                .spawn(move || match read_io {
+                    TunIo::Poll => tun_read_loop(tun_read, uplink, &running, &stats, &reader_config),
+                    #[cfg(target_os = "linux")]
+                    TunIo::Uring(ring) => tun_read_loop_uring(tun_read, ring, uplink, &running, &stats, &reader_config),
+                    #[cfg(target_os = "macos")]
+                    TunIo::Batched(batch) => tun_read_loop_batched(tun_read, batch, uplink, &running, &stats, &reader_config),
+                })
+                .map_err(|e| VpnError::TunTap(format!("Failed to spawn TUN reader: {}", e)))?;
+            pump.tun_readers.push(reader);
+
+            let running = pump.running.clone();
+            let stats = pump.stats.clone();
+            let writer_config = config.clone();
+            thread::Builder::new()
+                .name(format!("rvpnse-tun-tx{}", queue))
+                .spawn(move || match write_io {
+                    TunIo::Poll => tun_write_loop(tun_write, downlink_rx, &running, &stats, &writer_config),
+                    #[cfg(target_os = "linux")]
+                    TunIo::Uring(ring) => tun_write_loop_uring(tun_write, ring, downlink_rx, &running, &stats, &writer_config),
+                    #[cfg(target_os = "macos")]
+                    TunIo::Batched(batch) => tun_write_loop_batched(tun_write, batch, downlink_rx, &running, &stats, &writer_config),
+                })
+                .map_err(|e| VpnError::TunTap(format!("Failed to spawn TUN writer: {}", e)))?;
+        }
+        // Only the reader threads hold uplink senders now
+        drop(uplink_txs);
+
+        for (lane, (connect, uplink_rx)) in connects.into_iter().zip(uplink_rxs).enumerate() {
+            let (resume_tx, resume_rx) = mpsc::channel(RESUME_QUEUE_DEPTH);
+            pump.resumes.push(resume_tx);
+            let lane = Lane {
+                index: lane,
+                resumes: resume_rx,
+                uplink: uplink_rx,
+                downlinks: downlink_txs.clone(),
+                shutdown: shutdown_rx.clone(),
+                stats: pump.stats.clone(),
+                batch_size: config.batch_size,
+                resume_window: config.resume_window,
+                mss_clamp: config.mss_clamp,
+                path_mtu: path_mtu.clone(),
+            };
+            let running = pump.running.clone();
+            runtime.spawn(async move {
+                lane.run(connect).await;
+                running.store(false, Ordering::Release);
+            });
+        }
+
+        Ok(pump)
+    }
+
+    /// Whether every stage is still running
+    pub fn is_running(&self) -> bool {
+        self.running.load(Ordering::Acquire)
+    }
+
+    /// Whether the TUN threads run on io_uring rather than the poll fallback
+    pub fn uses_io_uring(&self) -> bool {
+        self.io_uring
+    }
+
+    /// Pump counters
+    pub fn stats(&self) -> &PumpStats {
+        &self.stats
+    }
+
+    /// Move every lane onto a new data channel, keeping the TUN side as it is
+    ///
+    /// Takes one channel per lane, in lane order. A lane drops its current
+    /// channel (failed or not) as soon as the new one is open.
+    pub fn resume(&self, connects: Vec<DataChannelConnect>) -> Result<()> {
+        if connects.len() != self.resumes.len() {
+            return Err(VpnError::InvalidState(format!(
+                "Resume needs {} data channels, got {}", self.resumes.len(), connects.len()
+            )));
+        }
+        if !self.is_running() {
+            return Err(VpnError::InvalidState("Packet pump has stopped".to_string()));
+        }
+        for (resume, connect) in self.resumes.iter().zip(connects) {
+            resume.try_send(connect).map_err(|_| {
+                VpnError::InvalidState("Packet pump lane is not accepting a new data channel".to_string())
+            })?;
+        }
+        Ok(())
+    }
+
+    /// Stop all stages
+    ///
+    /// Waits for the TUN read threads, which notice within one poll interval;
+    /// the other stages wind down on their own once their queues close.
+    pub fn stop(&mut self) {
+        self.running.store(false, Ordering::Release);
+        let _ = self.shutdown.send(true);
+        for reader in self.tun_readers.drain(..) {
+            let _ = reader.join();
+        }
+    }
+}
+
+impl Drop for PacketPump {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+/// Duplicate a file descriptor into an owned `File`
+fn dup_fd(fd: RawFd) -> Result<File> {
+    let dup = unsafe { libc::dup(fd) };
+    if dup < 0 {
+        return Err(VpnError::TunTap(format!(
+            "Failed to duplicate TUN descriptor: {}",
+            std::io::Error::last_os_error()
+        )));
+    }
+    Ok(unsafe { File::from_raw_fd(dup) })
+}
+
+/// Wait until `fd` is readable or the poll interval expires
+fn wait_readable(fd: RawFd) -> std::io::Result<bool> {
+    let mut pollfd = libc::pollfd {
+        fd,
+        events: libc::POLLIN,
+        revents: 0,
+    };
+    let ready = unsafe { libc::poll(&mut pollfd, 1, TUN_POLL_TIMEOUT_MS) };
+    if ready < 0 {
+        let err = std::io::Error::last_os_error();
+        if err.kind() == std::io::ErrorKind::Interrupted {
+            return Ok(false);
+        }
+        return Err(err);
+    }
+    Ok(ready > 0)
+}
+
+/// How one TUN thread does its I/O
+enum TunIo {
+    /// Blocking reads and writes, with poll(2) for shutdown checks
+    Poll,
+    #[cfg(target_os = "linux")]
+    Uring(IoUring),
+    /// Many frames per recvmsg_x/sendmsg_x, with poll(2) for shutdown checks
+    #[cfg(target_os = "macos")]
+    Batched(UtunBatch),
+}
+
+impl TunIo {
+    /// Reader and writer I/O for one queue
+    fn for_queue(config: &PumpConfig) -> (Self, Self) {
+        #[cfg(target_os = "linux")]
+        if config.io_uring {
+            if config.vnet_hdr {
+                log::info!("io_uring TUN I/O does not handle offload frames; using poll threads");
+                return (TunIo::Poll, TunIo::Poll);
+            }
+            let reads = config.batch_size.clamp(1, URING_READS_MAX);
+            // Every read, the tick and the readiness poll can be in flight at once
+            let rings = IoUring::new(reads as u32 + 2).and_then(|mut reader| {
+                reader.register_buffers(reads, config.mtu + TUN_PI_LEN)?;
+                Ok((reader, IoUring::new(config.batch_size.max(1) as u32)?))
+            });
+            match rings {
+                Ok((reader, writer)) => return (TunIo::Uring(reader), TunIo::Uring(writer)),
+                Err(e) => log::warn!("io_uring unavailable ({}); using poll threads for TUN I/O", e),
+            }
+        }
+        #[cfg(target_os = "macos")]
+        if config.batch_size > 1 {
+            return (TunIo::Batched(UtunBatch::new(config.batch_size)), TunIo::Batched(UtunBatch::new(config.batch_size)));
+        }
+        #[cfg(not(any(target_os = "linux", target_os = "macos")))]
+        let _ = config;
+        (TunIo::Poll, TunIo::Poll)
+    }
+}
+
+/// Count, clamp and queue one packet read from TUN
+///
+/// Blocks while the uplink queue is full. Returns false once the queue has
+/// closed.
+fn enqueue_uplink(uplink: &mpsc::Sender<Stamped>, stats: &PumpStats, config: &PumpConfig, read_at: Instant, packet: Bytes) -> bool {
+    let packet = if config.mss_clamp { clamp_syn(packet, stats) } else { packet };
+    stats.uplink_packets.add(1);
+    stats.uplink_bytes.add(packet.len() as u64);
+
+    let packet = match uplink.try_send((read_at, packet)) {
+        Ok(()) => return true,
+        Err(mpsc::error::TrySendError::Full(packet)) => packet,
+        Err(mpsc::error::TrySendError::Closed(_)) => return false,
+    };
+    stats.backpressure_events.fetch_add(1, Ordering::Relaxed);
+    uplink.blocking_send(packet).is_ok()
+}
+
+/// TUN -> uplink queue
+fn tun_read_loop(
+    mut tun: File,
+    uplink: mpsc::Sender<Stamped>,
+    running: &AtomicBool,
+    stats: &PumpStats,
+    config: &PumpConfig,
+) {
+    let frame_size = config.mtu + TUN_PI_LEN;
+    // Packets are split off one large buffer, so allocation is amortised
+    // over many reads instead of paid per packet.
+    let chunk_size = frame_size * config.batch_size.max(1);
+    let mut buf = BytesMut::with_capacity(chunk_size);
+    // Offloaded reads land here first and are cut into `buf`
+    let mut super_buf = if config.vnet_hdr { vec![0u8; VIRTIO_NET_HDR_LEN + MAX_SUPER_PACKET] } else { Vec::new() };
+    let mut segments: Vec<Bytes> = Vec::new();
+
+    let enqueue = |read_at: Instant, packet: Bytes| enqueue_uplink(&uplink, stats, config, read_at, packet);
+
+    'read: while running.load(Ordering::Acquire) {
+        match wait_readable(tun.as_raw_fd()) {
+            Ok(true) => {}
+            Ok(false) => continue,
+            Err(e) => {
+                log::error!("TUN poll failed: {}", e);
+                break;
+            }
+        }
+
+        if config.vnet_hdr {
+            let n = match tun.read(&mut super_buf) {
+                Ok(0) => break,
+                Ok(n) => n,
+                Err(e) if e.kind() == std::io::ErrorKind::WouldBlock
+                    || e.kind() == std::io::ErrorKind::Interrupted => continue,
+                Err(e) => {
+                    log::error!("TUN read failed: {}", e);
+                    break;
+                }
+            };
+            let Some(hdr) = VirtioNetHdr::decode(&super_buf[..n]) else {
+                continue;
+            };
+            if buf.capacity() < n {
+                buf.reserve(chunk_size.max(n));
+            }
+            if let Err(e) = offload::segment(&hdr, &super_buf[VIRTIO_NET_HDR_LEN..n], &mut buf, &mut segments) {
+                log::debug!("Dropping TUN frame: {}", e);
+                continue;
+            }
+            if segments.len() > 1 {
+                stats.gso_packets.fetch_add(1, Ordering::Relaxed);
+            }
+            let read_at = Instant::now();
+            for packet in segments.drain(..) {
+                if !enqueue(read_at, packet) {
+                    break 'read;
+                }
+            }
+            continue;
+        }
+
+        if buf.capacity() < frame_size {
+            buf.reserve(chunk_size);
+        }
+        buf.resize(frame_size, 0);
+        let n = match tun.read(&mut buf[..]) {
+            Ok(0) => break,
+            Ok(n) => n,
+            Err(e) if e.kind() == std::io::ErrorKind::WouldBlock
+                || e.kind() == std::io::ErrorKind::Interrupted => continue,
+            Err(e) => {
+                log::error!("TUN read failed: {}", e);
+                break;
+            }
+        };
+        if n <= TUN_PI_LEN {
+            continue;
+        }
+        buf.truncate(n);
+        if !enqueue(Instant::now(), buf.split().freeze().slice(TUN_PI_LEN..)) {
+            break;
+        }
+    }
+
+    running.store(false, Ordering::Release);
+    log::debug!("TUN read thread stopped");
+}
+
+/// Downlink queue -> TUN
+fn tun_write_loop(
+    mut tun: File,
+    mut downlink: mpsc::Receiver<Stamped>,
+    running: &AtomicBool,
+    stats: &PumpStats,
+    config: &PumpConfig,
+) {
+    if config.vnet_hdr {
+        tun_write_coalesced(tun, downlink, stats, config.batch_size);
+        running.store(false, Ordering::Release);
+        log::debug!("TUN write thread stopped");
+        return;
+    }
+
+    while let Some((received_at, packet)) = downlink.blocking_recv() {
+        let written = if TUN_PI_LEN > 0 {
+            let header = tun_pi_header(&packet);
+            tun.write_vectored(&[std::io::IoSlice::new(&header), std::io::IoSlice::new(&packet)])
+        } else {
+            tun.write(&packet)
+        };
+        match written {
+            Ok(_) => {
+                stats.downlink_packets.add(1);
+                stats.downlink_bytes.add(packet.len() as u64);
+                stats.downlink_latency.record_since(received_at, Instant::now());
+            }
+            // Dropping a packet the kernel refuses is what a NIC would do
+            Err(e) if e.kind() == std::io::ErrorKind::InvalidInput => {
+                log::debug!("TUN rejected {} byte packet: {}", packet.len(), e);
+            }
+            Err(e) => {
+                log::error!("TUN write failed: {}", e);
+                break;
+            }
+        }
+    }
+
+    running.store(false, Ordering::Release);
+    log::debug!("TUN write thread stopped");
+}
+
+/// Downlink queue -> offloaded TUN, gluing queued TCP segments into super-packets
+fn tun_write_coalesced(mut tun: File, mut downlink: mpsc::Receiver<Stamped>, stats: &PumpStats, batch_size: usize) {
+    let mut gro = GroCoalescer::new();
+    // Arrival times of the packets in `gro`, recorded once their frames are written
+    let mut received: Vec<Instant> = Vec::with_capacity(batch_size);
+    while let Some((received_at, first)) = downlink.blocking_recv() {
+        gro.push(first);
+        received.push(received_at);
+        while gro.len() < batch_size {
+            match downlink.try_recv() {
+                Ok((received_at, packet)) => {
+                    gro.push(packet);
+                    received.push(received_at);
+                }
+                Err(_) => break,
+            }
+        }
+
+        for frame in gro.drain() {
+            match frame.write_to(&mut tun) {
+                Ok(_) => {
+                    if frame.segments() > 1 {
+                        stats.gro_frames.fetch_add(1, Ordering::Relaxed);
+                    }
+                    stats.downlink_packets.add(frame.segments() as u64);
+                    stats.downlink_bytes.add(frame.len() as u64);
+                }
+                Err(e) if e.kind() == std::io::ErrorKind::InvalidInput => {
+                    log::debug!("TUN rejected {} byte frame: {}", frame.len(), e);
+                }
+                Err(e) => {
+                    log::error!("TUN write failed: {}", e);
+                    return;
+                }
+            }
+        }
+        let written_at = Instant::now();
+        for received_at in received.drain(..) {
+            stats.downlink_latency.record_since(received_at, written_at);
+        }
+    }
+}
+
+/// utun -> uplink queue, a batch of frames per read
+///
+/// Packets are handed on as slices of the read buffer, behind their
+/// address family headers.
+#[cfg(target_os = "macos")]
+fn tun_read_loop_batched(
+    tun: File,
+    mut batch: UtunBatch,
+    uplink: mpsc::Sender<Stamped>,
+    running: &AtomicBool,
+    stats: &PumpStats,
+    config: &PumpConfig,
+) {
+    let frame_size = config.mtu + TUN_PI_LEN;
+    let mut buf = BytesMut::new();
+    let mut packets: Vec<Bytes> = Vec::with_capacity(config.batch_size);
+
+    'read: while running.load(Ordering::Acquire) {
+        match wait_readable(tun.as_raw_fd()) {
+            Ok(true) => {}
+            Ok(false) => continue,
+            Err(e) => {
+                log::error!("TUN poll failed: {}", e);
+                break;
+            }
+        }
+
+        match batch.recv(tun.as_raw_fd(), &mut buf, frame_size, &mut packets) {
+            Ok(_) => {}
+            Err(e) if e.kind() == std::io::ErrorKind::UnexpectedEof => break,
+            Err(e) if e.kind() == std::io::ErrorKind::WouldBlock
+                || e.kind() == std::io::ErrorKind::Interrupted => continue,
+            Err(e) => {
+                log::error!("TUN read failed: {}", e);
+                break;
+            }
+        }
+        let read_at = Instant::now();
+        for packet in packets.drain(..) {
+            if !enqueue_uplink(&uplink, stats, config, read_at, packet) {
+                break 'read;
+            }
+        }
+    }
+
+    running.store(false, Ordering::Release);
+    log::debug!("TUN read thread stopped");
+}
+
+/// Downlink queue -> utun, writing every queued packet with one call
+#[cfg(target_os = "macos")]
+fn tun_write_loop_batched(
+    tun: File,
+    mut batch: UtunBatch,
+    mut downlink: mpsc::Receiver<Stamped>,
+    running: &AtomicBool,
+    stats: &PumpStats,
+    config: &PumpConfig,
+) {
+    let mut packets: Vec<Bytes> = Vec::with_capacity(config.batch_size);
+    let mut received: Vec<Instant> = Vec::with_capacity(config.batch_size);
+    while let Some((received_at, first)) = downlink.blocking_recv() {
+        packets.push(first);
+        received.push(received_at);
+        while packets.len() < config.batch_size {
+            match downlink.try_recv() {
+                Ok((received_at, packet)) => {
+                    packets.push(packet);
+                    received.push(received_at);
+                }
+                Err(_) => break,
+            }
+        }
+
+        match batch.send(tun.as_raw_fd(), &packets) {
+            Ok((accepted, bytes)) => {
+                stats.downlink_packets.add(accepted as u64);
+                stats.downlink_bytes.add(bytes as u64);
+                let written_at = Instant::now();
+                for received_at in received.drain(..) {
+                    stats.downlink_latency.record_since(received_at, written_at);
+                }
+            }
+            Err(e) => {
+                log::error!("TUN write failed: {}", e);
+                break;
+            }
+        }
+        packets.clear();
+        received.clear();
+    }
+
+    running.store(false, Ordering::Release);
+    log::debug!("TUN write thread stopped");
+}
+
+/// TUN -> uplink queue, reading through io_uring
+///
+/// Every registered buffer has a read in flight. Each wakeup reaps all
+/// completed reads, copies the packets out (into one shared chunk, as the
+/// poll reader splits its reads) and resubmits the buffers with the next
+/// wait, so under load one system call covers many packets.
+#[cfg(target_os = "linux")]
+fn tun_read_loop_uring(
+    tun: File,
+    mut ring: IoUring,
+    uplink: mpsc::Sender<Stamped>,
+    running: &AtomicBool,
+    stats: &PumpStats,
+    config: &PumpConfig,
+) {
+    let fd = tun.as_raw_fd();
+    let slots = ring.buffers().slots();
+    let chunk_size = ring.buffers().slot_size() * slots;
+    let mut buf = BytesMut::with_capacity(chunk_size);
+    let tick = Timespec::from(Duration::from_millis(TUN_POLL_TIMEOUT_MS as u64));
+    // Buffers whose read found a non-blocking descriptor empty; resubmitted
+    // as soon as the one readiness poll they share completes
+    let mut parked: Vec<usize> = Vec::new();
+    let mut poll_armed = false;
+
+    // Safety (every push below): the buffers belong to the ring and outlive
+    // its reads, and the kernel copies the timeout when it is submitted
+    let armed = (0..slots).all(|slot| queued(unsafe { ring.push_or_submit(ring.read_fixed(fd, slot)) }))
+        && queued(unsafe { ring.push_or_submit(Sqe::timeout(&tick, URING_TICK)) });
+
+    'read: while armed && running.load(Ordering::Acquire) {
+        if let Err(e) = ring.submit_and_wait(1) {
+            log::error!("TUN io_uring wait failed: {}", e);
+            break;
+        }
+        while let Some(completion) = ring.completion() {
+            if completion.user_data == URING_TICK {
+                if !queued(unsafe { ring.push_or_submit(Sqe::timeout(&tick, URING_TICK)) }) {
+                    break 'read;
+                }
+                continue;
+            }
+            if completion.user_data == URING_READABLE {
+                poll_armed = false;
+                for slot in std::mem::take(&mut parked) {
+                    if !queued(unsafe { ring.push_or_submit(ring.read_fixed(fd, slot)) }) {
+                        break 'read;
+                    }
+                }
+                continue;
+            }
+            let slot = completion.user_data as usize;
+            match completion.result {
+                0 => break 'read,
+                n if n > TUN_PI_LEN as i32 => {
+                    let n = n as usize;
+                    if buf.capacity() < n {
+                        buf.reserve(chunk_size);
+                    }
+                    buf.extend_from_slice(&ring.buffers().filled(slot, n)[TUN_PI_LEN..]);
+                    if !enqueue_uplink(&uplink, stats, config, Instant::now(), buf.split().freeze()) {
+                        break 'read;
+                    }
+                }
+                n if n == -libc::EAGAIN => {
+                    parked.push(slot);
+                    if !poll_armed {
+                        if !queued(unsafe { ring.push_or_submit(Sqe::poll_readable(fd, URING_READABLE)) }) {
+                            break 'read;
+                        }
+                        poll_armed = true;
+                    }
+                    continue;
+                }
+                n if n < 0 && n != -libc::EINTR => {
+                    log::error!("TUN read failed: {}", std::io::Error::from_raw_os_error(-n));
+                    break 'read;
+                }
+                _ => {}
+            }
+            if !queued(unsafe { ring.push_or_submit(ring.read_fixed(fd, slot)) }) {
+                break 'read;
+            }
+        }
+    }
+
+    running.store(false, Ordering::Release);
+    log::debug!("TUN read thread stopped");
+}
+
+/// Whether an io_uring submission was queued, logging why not
+#[cfg(target_os = "linux")]
+fn queued(result: std::io::Result<()>) -> bool {
+    if let Err(e) = &result {
+        log::error!("TUN io_uring submit failed: {}", e);
+    }
+    result.is_ok()
+}
+
+/// Downlink queue -> TUN, writing through io_uring
+///
+/// Submits every queued packet (up to a batch) at once and waits for the
+/// whole batch before taking more.
+#[cfg(target_os = "linux")]
+fn tun_write_loop_uring(
+    tun: File,
+    ring: IoUring,
+    mut downlink: mpsc::Receiver<Stamped>,
+    running: &AtomicBool,
+    stats: &PumpStats,
+    config: &PumpConfig,
+) {
+    let fd = tun.as_raw_fd();
+    let max_batch = config.batch_size.clamp(1, ring.capacity() as usize);
+    let mut batch: Vec<Stamped> = Vec::with_capacity(max_batch);
+    // Declared after `batch` so it is dropped first: writes still in flight
+    // on an early exit never outlive the packets they read from
+    let mut ring = ring;
+
+    'write: while let Some(first) = downlink.blocking_recv() {
+        batch.push(first);
+        while batch.len() < max_batch {
+            match downlink.try_recv() {
+                Ok(packet) => batch.push(packet),
+                Err(_) => break,
+            }
+        }
+
+        let mut outstanding = 0;
+        for (i, (_, packet)) in batch.iter().enumerate() {
+            // Safety: `batch` holds every packet until all its writes complete
+            let sqe = Sqe::write(fd, packet.as_ptr(), packet.len() as u32, i as u64);
+            if !queued(unsafe { ring.push_or_submit(sqe) }) {
+                break 'write;
+            }
+            outstanding += 1;
+        }
+        let mut failed = None;
+        while outstanding > 0 {
+            if let Err(e) = ring.submit_and_wait(1) {
+                log::error!("TUN io_uring wait failed: {}", e);
+                break 'write;
+            }
+            let written_at = Instant::now();
+            while let Some(completion) = ring.completion() {
+                outstanding -= 1;
+                let (received_at, packet) = &batch[completion.user_data as usize];
+                match completion.result {
+                    n if n >= 0 => {
+                        stats.downlink_packets.add(1);
+                        stats.downlink_bytes.add(packet.len() as u64);
+                        stats.downlink_latency.record_since(*received_at, written_at);
+                    }
+                    // Dropping a packet the kernel refuses is what a NIC would do
+                    n if n == -libc::EINVAL || n == -libc::EAGAIN => {
+                        log::debug!("TUN rejected {} byte packet: {}", packet.len(), std::io::Error::from_raw_os_error(-n));
+                    }
+                    n => failed = Some(std::io::Error::from_raw_os_error(-n)),
+                }
+            }
+        }
+        batch.clear();
+        if let Some(e) = failed {
+            log::error!("TUN write failed: {}", e);
+            break;
+        }
+    }
+
+    running.store(false, Ordering::Release);
+    log::debug!("TUN write thread stopped");
+}
+
+/// Address family header for platforms whose TUN expects one
+fn tun_pi_header(packet: &[u8]) -> [u8; 4] {
+    let family = match packet.first().map(|b| b >> 4) {
+        Some(6) => libc::AF_INET6,
+        _ => libc::AF_INET,
+    };
+    (family as u32).to_be_bytes()
+}
+
+/// Why a lane stopped using its data channel
+enum LaneEnd {
+    /// The pump is shutting down or a TUN stage stopped
+    Stopped,
+    /// The data channel failed
+    TransportLost,
+    /// A replacement data channel was handed in
+    Replaced(DataChannelConnect),
+}
+
+/// One data channel's share of the pump, outliving the channels it runs on
+struct Lane {
+    index: usize,
+    resumes: mpsc::Receiver<DataChannelConnect>,
+    uplink: mpsc::Receiver<Stamped>,
+    downlinks: Vec<mpsc::Sender<Stamped>>,
+    shutdown: watch::Receiver<bool>,
+    stats: Arc<PumpStats>,
+    batch_size: usize,
+    resume_window: Duration,
+    mss_clamp: bool,
+    path_mtu: Option<Arc<PathMtu>>,
+}
+
+impl Lane {
+    /// Forward traffic over `connect`, then over each replacement, until stopped
+    async fn run(mut self, connect: DataChannelConnect) {
+        // Survives transports: a batch that failed to send goes out again
+        let mut batch: Vec<Stamped> = Vec::with_capacity(self.batch_size);
+        let mut next = Some(connect);
+        let mut established = false;
+
+        while let Some(connect) = next.take() {
+            let opened = tokio::select! {
+                channel = connect => channel.and_then(|channel| {
+                    let probe = self.start_path_mtu_probe(&channel);
+                    Ok((channel.into_split()?, probe))
+                }),
+                _ = self.shutdown.changed() => return,
+            };
+            let ((reader, mut writer), probe) = match opened {
+                Ok(opened) => opened,
+                Err(e) => {
+                    log::error!("Packet pump lane {} could not open data channel: {}", self.index, e);
+                    // A lane that never carried traffic has nothing to resume
+                    if established {
+                        next = self.wait_for_replacement().await;
+                    }
+                    continue;
+                }
+            };
+            if established {
+                self.stats.resumes.fetch_add(1, Ordering::Relaxed);
+                log::info!("Packet pump lane {} resumed with {} packets carried over", self.index, batch.len() + self.uplink.len());
+            } else {
+                log::info!("Packet pump lane {} forwarding traffic", self.index);
+            }
+            established = true;
+
+            let mut downlink = tokio::spawn(downlink_loop(
+                reader,
+                self.downlinks.clone(),
+                self.shutdown.clone(),
+                self.stats.clone(),
+                self.batch_size,
+                self.mss_clamp,
+            ));
+            let uplink = uplink_loop(
+                &mut writer,
+                &mut self.uplink,
+                &mut self.resumes,
+                &mut batch,
+                self.shutdown.clone(),
+                &self.stats,
+                self.batch_size,
+            );
+            let end = tokio::select! {
+                end = uplink => end,
+                end = &mut downlink => end.unwrap_or(LaneEnd::Stopped),
+            };
+            downlink.abort();
+            if let Some(probe) = probe {
+                probe.abort();
+            }
+
+            next = match end {
+                LaneEnd::Stopped => None,
+                LaneEnd::Replaced(replacement) => Some(self.newest(replacement)),
+                LaneEnd::TransportLost => {
+                    self.stats.transport_losses.fetch_add(1, Ordering::Relaxed);
+                    self.wait_for_replacement().await
+                }
+            };
+        }
+    }
+
+    /// Start reporting the path MTU `channel` allows, if the pump tracks it
+    fn start_path_mtu_probe(&self, channel: &BinaryProtocolClient) -> Option<tokio::task::JoinHandle<()>> {
+        let path_mtu = self.path_mtu.clone()?;
+        // A duplicate keeps the probe from touching a descriptor closed under it
+        let socket = match channel.tcp_stream()?.as_fd().try_clone_to_owned() {
+            Ok(socket) => socket,
+            Err(e) => {
+                log::debug!("Path MTU probe for lane {} unavailable: {}", self.index, e);
+                return None;
+            }
+        };
+        Some(tokio::spawn(probe_path_mtu(socket, self.index, path_mtu, self.stats.clone())))
+    }
+
+    /// Wait up to the resume window for a new data channel
+    async fn wait_for_replacement(&mut self) -> Option<DataChannelConnect> {
+        if self.resume_window.is_zero() {
+            return None;
+        }
+        log::warn!("Packet pump lane {} lost its data channel; waiting {:?} for a new one", self.index, self.resume_window);
+        tokio::select! {
+            Some(replacement) = self.resumes.recv() => Some(self.newest(replacement)),
+            _ = tokio::time::sleep(self.resume_window) => {
+                log::error!("Packet pump lane {} got no new data channel in time", self.index);
+                None
+            }
+            _ = self.shutdown.changed() => None,
+        }
+    }
+
+    /// The most recently queued replacement; older ones are stale
+    fn newest(&mut self, mut replacement: DataChannelConnect) -> DataChannelConnect {
+        while let Ok(newer) = self.resumes.try_recv() {
+            replacement = newer;
+        }
+        replacement
+    }
+}
+
+/// Uplink queue -> data channel
+///
+/// Packets leave `batch` only once written, so after a failure they are
+/// still there for the next channel. A replacement channel is taken only
+/// between writes, never while a batch is half on the old one.
+async fn uplink_loop<W: AsyncWrite + Unpin>(
+    writer: &mut BinaryDataWriter<W>,
+    uplink: &mut mpsc::Receiver<Stamped>,
+    resumes: &mut mpsc::Receiver<DataChannelConnect>,
+    batch: &mut Vec<Stamped>,
+    mut shutdown: watch::Receiver<bool>,
+    stats: &PumpStats,
+    batch_size: usize,
+) -> LaneEnd {
+    loop {
+        if *shutdown.borrow() {
+            return LaneEnd::Stopped;
+        }
+        if let Ok(replacement) = resumes.try_recv() {
+            return LaneEnd::Replaced(replacement);
+        }
+        if batch.is_empty() {
+            let first = tokio::select! {
+                packet = uplink.recv() => match packet {
+                    Some(packet) => packet,
+                    None => return LaneEnd::Stopped,
+                },
+                Some(replacement) = resumes.recv() => return LaneEnd::Replaced(replacement),
+                _ = shutdown.changed() => return LaneEnd::Stopped,
+            };
+            batch.push(first);
+        }
+
+        // Take whatever else is already queued so one write carries the batch
+        while batch.len() < batch_size {
+            match uplink.try_recv() {
+                Ok(packet) => batch.push(packet),
+                Err(_) => break,
+            }
+        }
+
+        if let Err(e) = writer.send_batch(batch.iter().map(|(_, p)| p.as_ref())).await {
+            log::error!("Uplink send failed: {}", e);
+            return LaneEnd::TransportLost;
+        }
+        let sent_at = Instant::now();
+        for (read_at, _) in batch.drain(..) {
+            stats.uplink_latency.record_since(read_at, sent_at);
+        }
+    }
+}
+
+/// Data channel -> per-queue downlink queues, chosen by flow hash
+async fn downlink_loop<R: AsyncRead + Unpin>(
+    mut reader: BinaryDataReader<R>,
+    downlinks: Vec<mpsc::Sender<Stamped>>,
+    mut shutdown: watch::Receiver<bool>,
+    stats: Arc<PumpStats>,
+    batch_size: usize,
+    mss_clamp: bool,
+) -> LaneEnd {
+    let mut batch: Vec<Bytes> = Vec::with_capacity(batch_size);
+    loop {
+        let received = tokio::select! {
+            received = reader.recv_batch(batch_size, &mut batch) => received,
+            _ = shutdown.changed() => return LaneEnd::Stopped,
+        };
+        if let Err(e) = received {
+            log::error!("Downlink receive failed: {}", e);
+            return LaneEnd::TransportLost;
+        }
+
+        let received_at = Instant::now();
+        for packet in batch.drain(..) {
+            let packet = if mss_clamp { clamp_syn(packet, &stats) } else { packet };
+            let downlink = if downlinks.len() == 1 {
+                &downlinks[0]
+            } else {
+                &downlinks[flow_hash(&packet) as usize % downlinks.len()]
+            };
+            let packet = match downlink.try_send((received_at, packet)) {
+                Ok(()) => continue,
+                Err(mpsc::error::TrySendError::Full(packet)) => packet,
+                Err(mpsc::error::TrySendError::Closed(_)) => return LaneEnd::Stopped,
+            };
+            stats.backpressure_events.fetch_add(1, Ordering::Relaxed);
+            if downlink.send(packet).await.is_err() {
+                return LaneEnd::Stopped;
+            }
+        }
+    }
+}
+
+/// Tunnel MTU allowed by every lane's data channel
+struct PathMtu {
+    /// Per lane: the MTU its channel allows, 0 until measured
+    lanes: Vec<AtomicU64>,
+    ceiling: u32,
+    hook: MtuHook,
+    /// Last MTU handed to the hook
+    applied: Mutex<u32>,
+}
+
+impl PathMtu {
+    fn new(lanes: usize, ceiling: u32, hook: MtuHook) -> Self {
+        Self {
+            lanes: (0..lanes).map(|_| AtomicU64::new(0)).collect(),
+            ceiling,
+            hook,
+            applied: Mutex::new(ceiling),
+        }
+    }
+
+    /// Record what `lane` allows and apply the smallest MTU any lane allows
+    fn report(&self, lane: usize, allowed: u32, stats: &PumpStats) {
+        self.lanes[lane].store(u64::from(allowed), Ordering::Relaxed);
+        let target = self.lanes.iter()
+            .map(|lane| lane.load(Ordering::Relaxed) as u32)
+            .filter(|&mtu| mtu > 0)
+            .min()
+            .unwrap_or(self.ceiling);
+
+        let mut applied = self.applied.lock().unwrap_or_else(|e| e.into_inner());
+        if *applied == target {
+            return;
+        }
+        match (self.hook.0)(target) {
+            Ok(()) => {
+                log::info!("Tunnel MTU {} -> {} to match the data channel path", *applied, target);
+                *applied = target;
+                stats.tunnel_mtu.store(u64::from(target), Ordering::Relaxed);
+                stats.mtu_changes.fetch_add(1, Ordering::Relaxed);
+            }
+            Err(e) => log::warn!("Failed to set tunnel MTU to {}: {}", target, e),
+        }
+    }
+}
+
+/// Re-read a data channel's MSS until the lane aborts the probe
+async fn probe_path_mtu(socket: OwnedFd, lane: usize, path_mtu: Arc<PathMtu>, stats: Arc<PumpStats>) {
+    let mut interval = tokio::time::interval(PATH_MTU_PROBE_INTERVAL);
+    loop {
+        interval.tick().await;
+        match mtu::socket_mss(socket.as_raw_fd()) {
+            Ok(0) => {}
+            Ok(mss) => path_mtu.report(lane, mtu::tunnel_mtu_for_mss(mss, path_mtu.ceiling), &stats),
+            Err(e) => {
+                log::debug!("Path MTU probe for lane {} stopped: {}", lane, e);
+                return;
+            }
+        }
+    }
+}
+
+/// Clamp a TCP SYN's MSS to the current tunnel MTU; only SYNs are copied
+fn clamp_syn(packet: Bytes, stats: &PumpStats) -> Bytes {
+    if mtu::tcp_syn_offset(&packet).is_none() {
+        return packet;
+    }
+    let tunnel_mtu = stats.tunnel_mtu.load(Ordering::Relaxed) as u32;
+    let max_mss = mtu::mss_for_mtu(tunnel_mtu, packet[0] >> 4 == 6);
+    let mut clamped = BytesMut::from(&packet[..]);
+    if !mtu::clamp_mss(&mut clamped, max_mss) {
+        return packet;
+    }
+    stats.mss_clamped.fetch_add(1, Ordering::Relaxed);
+    clamped.freeze()
+}
+
+/// Hash of an IP packet's flow (addresses, protocol and, when present, ports)
+///
+/// Symmetric in source and destination, so both directions of a connection
+/// map to the same queue. Non-IP or truncated packets hash to 0.
+pub fn flow_hash(packet: &[u8]) -> u32 {
+    let (addrs, protocol, l4) = match packet.first().map(|b| b >> 4) {
+        Some(4) if packet.len() >= 20 => {
+            let header_len = usize::from(packet[0] & 0x0f) * 4;
+            let fragment = u16::from_be_bytes([packet[6], packet[7]]) & 0x1fff;
+            // Only the first fragment carries ports; keep all fragments together
+            let l4 = if fragment == 0 { packet.get(header_len..) } else { None };
+            (&packet[12..20], packet[9], l4)
+        }
+        Some(6) if packet.len() >= 40 => (&packet[8..40], packet[6], packet.get(40..)),
+        _ => return 0,
+    };
+
+    let half = addrs.len() / 2;
+    let (a, b) = (fold_bytes(&addrs[..half]), fold_bytes(&addrs[half..]));
+    let mut hash = (a ^ b).wrapping_add(a.wrapping_mul(b) | 1) ^ u32::from(protocol);
+
+    if matches!(protocol, 6 | 17) {
+        if let Some(ports) = l4.filter(|l4| l4.len() >= 4) {
+            let src = u32::from(u16::from_be_bytes([ports[0], ports[1]]));
+            let dst = u32::from(u16::from_be_bytes([ports[2], ports[3]]));
+            hash ^= (src ^ dst) | ((src.max(dst)) << 16);
+        }
+    }
+
+    // Final avalanche (murmur3 fmix32)
+    hash ^= hash >> 16;
+    hash = hash.wrapping_mul(0x85eb_ca6b);
+    hash ^= hash >> 13;
+    hash = hash.wrapping_mul(0xc2b2_ae35);
+    hash ^ (hash >> 16)
+}
+
+#[inline]
+fn fold_bytes(bytes: &[u8]) -> u32 {
+    bytes.chunks(4).fold(0u32, |acc, chunk| {
+        let mut word = [0u8; 4];
+        word[..chunk.len()].copy_from_slice(chunk);
+        acc.rotate_left(5) ^ u32::from_be_bytes(word)
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_tun_pi_header_family() {
+        let v4 = [0x45u8, 0, 0, 20];
+        let v6 = [0x60u8, 0, 0, 0];
+        assert_eq!(tun_pi_header(&v4), (libc::AF_INET as u32).to_be_bytes());
+        assert_eq!(tun_pi_header(&v6), (libc::AF_INET6 as u32).to_be_bytes());
+    }
+
+    fn ipv4_udp(src: [u8; 4], dst: [u8; 4], sport: u16, dport: u16) -> Vec<u8> {
+        let mut packet = vec![0u8; 28];
+        packet[0] = 0x45;
+        packet[9] = 17;
+        packet[12..16].copy_from_slice(&src);
+        packet[16..20].copy_from_slice(&dst);
+        packet[20..22].copy_from_slice(&sport.to_be_bytes());
+        packet[22..24].copy_from_slice(&dport.to_be_bytes());
+        packet
+    }
+
+    #[test]
+    fn test_flow_hash_is_symmetric_and_distinguishes_flows() {
+        let forward = ipv4_udp([10, 0, 0, 2], [8, 8, 8, 8], 40000, 53);
+        let reverse = ipv4_udp([8, 8, 8, 8], [10, 0, 0, 2], 53, 40000);
+        let other = ipv4_udp([10, 0, 0, 2], [8, 8, 8, 8], 40001, 53);
+
+        assert_eq!(flow_hash(&forward), flow_hash(&reverse));
+        assert_ne!(flow_hash(&forward), flow_hash(&other));
+        assert_eq!(flow_hash(&[0u8; 3]), 0);
+    }
+
+    #[test]
+    fn test_path_mtu_applies_smallest_lane_mtu_once() {
+        let applied = Arc::new(Mutex::new(Vec::new()));
+        let hook = {
+            let applied = applied.clone();
+            MtuHook::new(move |mtu| {
+                applied.lock().unwrap().push(mtu);
+                Ok(())
+            })
+        };
+        let stats = PumpStats::default();
+        let path_mtu = PathMtu::new(2, 1500, hook);
+
+        path_mtu.report(0, 1500, &stats);
+        path_mtu.report(1, 1400, &stats);
+        path_mtu.report(1, 1400, &stats);
+        path_mtu.report(0, 1300, &stats);
+        assert_eq!(*applied.lock().unwrap(), vec![1400, 1300]);
+        assert_eq!(stats.tunnel_mtu.load(Ordering::Relaxed), 1300);
+        assert_eq!(stats.mtu_changes.load(Ordering::Relaxed), 2);
+    }
+
+    /// One packet each way through a pump running with `config`; returns the stopped pump
+    ///
+    /// With `nonblocking` the TUN stand-in is put in O_NONBLOCK mode, as real
+    /// TUN descriptors often are.
+    async fn round_trip(config: PumpConfig, nonblocking: bool) -> PacketPump {
+        let listener = tokio::net::TcpListener::bind("127.0.0.1:0").await.unwrap();
+        let addr = listener.local_addr().unwrap();
+
+        // Socketpair standing in for the TUN device
+        let mut fds = [0 as libc::c_int; 2];
+        assert_eq!(unsafe { libc::socketpair(libc::AF_UNIX, libc::SOCK_SEQPACKET, 0, fds.as_mut_ptr()) }, 0);
+        let mut host_side = unsafe { File::from_raw_fd(fds[1]) };
+        if nonblocking {
+            let flags = unsafe { libc::fcntl(fds[0], libc::F_GETFL) };
+            assert_eq!(unsafe { libc::fcntl(fds[0], libc::F_SETFL, flags | libc::O_NONBLOCK) }, 0);
+        }
+
+        let connect: DataChannelConnect = Box::pin(async move {
+            let stream = tokio::net::TcpStream::connect(addr).await?;
+            Ok(BinaryProtocolClient::from_stream(stream, 1))
+        });
+        let server = tokio::spawn(async move { listener.accept().await.unwrap().0 });
+
+        let mut pump = PacketPump::start(fds[0], connect, &tokio::runtime::Handle::current(), config).unwrap();
+        unsafe { libc::close(fds[0]) };
+        let server_stream = server.await.unwrap();
+        let (server_read, server_write) = server_stream.into_split();
+        let mut server_reader = BinaryDataReader::new(server_read);
+        let mut server_writer = BinaryDataWriter::new(server_write, 1);
+
+        // Uplink: TUN -> server
+        let mut outbound = vec![0x45u8; 60];
+        outbound[1] = 7;
+        host_side.write_all(&outbound).unwrap();
+        let mut received = Vec::new();
+        while received.is_empty() {
+            server_reader.recv_batch(8, &mut received).await.unwrap();
+        }
+        assert_eq!(&received[0][..], &outbound[TUN_PI_LEN..]);
+
+        // Downlink: server -> TUN
+        let inbound = vec![0x45u8; 80];
+        server_writer.send_batch([&inbound[..]]).await.unwrap();
+        let mut buf = vec![0u8; 2048];
+        let (_host_side, buf) = tokio::task::spawn_blocking(move || {
+            let n = host_side.read(&mut buf).unwrap();
+            buf.truncate(n);
+            (host_side, buf)
+        })
+        .await
+        .unwrap();
+        assert_eq!(&buf[TUN_PI_LEN..], &inbound[..]);
+
+        assert!(pump.is_running());
+        assert_eq!(pump.stats().uplink_packets.get(), 1);
+        for _ in 0..100 {
+            let stats = pump.stats().snapshot();
+            if stats.uplink_latency.count == 1 && stats.downlink_latency.count == 1 {
+                break;
+            }
+            tokio::time::sleep(std::time::Duration::from_millis(5)).await;
+        }
+        let stats = pump.stats().snapshot();
+        assert_eq!((stats.uplink_latency.count, stats.downlink_latency.count), (1, 1));
+        assert!(stats.uplink_latency.max >= stats.uplink_latency.p50);
+        pump.stop();
+        assert!(!pump.is_running());
+        pump
+    }
+
+    #[tokio::test(flavor = "multi_thread", worker_threads = 2)]
+    async fn test_pump_round_trip_over_pipe() {
+        assert!(!round_trip(PumpConfig::default(), false).await.uses_io_uring());
+    }
+
+    #[cfg(target_os = "linux")]
+    #[tokio::test(flavor = "multi_thread", worker_threads = 2)]
+    async fn test_pump_round_trip_over_io_uring() {
+        if IoUring::new(2).is_err() {
+            return; // No io_uring in this sandbox
+        }
+        for nonblocking in [false, true] {
+            let pump = round_trip(PumpConfig { io_uring: true, ..PumpConfig::default() }, nonblocking).await;
+            assert!(pump.uses_io_uring());
+        }
+    }
+
+    #[tokio::test(flavor = "multi_thread", worker_threads = 2)]
+    async fn test_lane_resumes_on_new_channel_and_keeps_gap_packets() {
+        let listener = Arc::new(tokio::net::TcpListener::bind("127.0.0.1:0").await.unwrap());
+        let addr = listener.local_addr().unwrap();
+        let connect_to = |addr| -> DataChannelConnect {
+            Box::pin(async move {
+                let stream = tokio::net::TcpStream::connect(addr).await?;
+                Ok(BinaryProtocolClient::from_stream(stream, 1))
+            })
+        };
+
+        let mut fds = [0 as libc::c_int; 2];
+        assert_eq!(unsafe { libc::socketpair(libc::AF_UNIX, libc::SOCK_SEQPACKET, 0, fds.as_mut_ptr()) }, 0);
+        let mut host_side = unsafe { File::from_raw_fd(fds[1]) };
+
+        let first = {
+            let listener = listener.clone();
+            tokio::spawn(async move { listener.accept().await.unwrap().0 })
+        };
+        let mut pump = PacketPump::start(fds[0], connect_to(addr), &tokio::runtime::Handle::current(), PumpConfig::default()).unwrap();
+        unsafe { libc::close(fds[0]) };
+
+        // The server side of the first channel goes away
+        drop(first.await.unwrap());
+        while pump.stats().transport_losses.load(Ordering::Relaxed) == 0 {
+            tokio::time::sleep(std::time::Duration::from_millis(5)).await;
+        }
+        assert!(pump.is_running());
+
+        // Read from the TUN while no channel is up
+        let mut outbound = vec![0x45u8; 60];
+        outbound[1] = 9;
+        host_side.write_all(&outbound).unwrap();
+
+        let second = {
+            let listener = listener.clone();
+            tokio::spawn(async move { listener.accept().await.unwrap().0 })
+        };
+        pump.resume(vec![connect_to(addr)]).unwrap();
+        assert!(pump.resume(Vec::new()).is_err());
+        let (server_read, _server_write) = second.await.unwrap().into_split();
+        let mut server_reader = BinaryDataReader::new(server_read);
+        let mut received = Vec::new();
+        while received.is_empty() {
+            server_reader.recv_batch(8, &mut received).await.unwrap();
+        }
+        assert_eq!(&received[0][..], &outbound[TUN_PI_LEN..]);
+        assert_eq!(pump.stats().resumes.load(Ordering::Relaxed), 1);
+
+        pump.stop();
+        assert!(!pump.is_running());
+    }
+
+    #[tokio::test(flavor = "multi_thread", worker_threads = 2)]
+    async fn test_lane_replaced_while_healthy_sends_each_packet_once() {
+        let listener = Arc::new(tokio::net::TcpListener::bind("127.0.0.1:0").await.unwrap());
+        let addr = listener.local_addr().unwrap();
+        let connect_to = |addr| -> DataChannelConnect {
+            Box::pin(async move {
+                let stream = tokio::net::TcpStream::connect(addr).await?;
+                Ok(BinaryProtocolClient::from_stream(stream, 1))
+            })
+        };
+        let accept = || {
+            let listener = listener.clone();
+            tokio::spawn(async move {
+                // Keep the write half: dropping it would end the lane's downlink
+                let (read, write) = listener.accept().await.unwrap().0.into_split();
+                (BinaryDataReader::new(read), write)
+            })
+        };
+
+        let mut fds = [0 as libc::c_int; 2];
+        assert_eq!(unsafe { libc::socketpair(libc::AF_UNIX, libc::SOCK_SEQPACKET, 0, fds.as_mut_ptr()) }, 0);
+        let mut host_side = unsafe { File::from_raw_fd(fds[1]) };
+        let first = accept();
+        let mut pump = PacketPump::start(fds[0], connect_to(addr), &tokio::runtime::Handle::current(), PumpConfig::default()).unwrap();
+        unsafe { libc::close(fds[0]) };
+        let (mut first, _first_write) = first.await.unwrap();
+
+        let packet = |marker: u8| {
+            let mut packet = vec![0x45u8; 60];
+            packet[1] = marker;
+            packet
+        };
+        let mut received = Vec::new();
+        host_side.write_all(&packet(1)).unwrap();
+        while received.is_empty() {
+            first.recv_batch(8, &mut received).await.unwrap();
+        }
+        assert_eq!(received.len(), 1);
+
+        let second = accept();
+        pump.resume(vec![connect_to(addr)]).unwrap();
+        let (mut second, _second_write) = second.await.unwrap();
+        while pump.stats().resumes.load(Ordering::Relaxed) == 0 {
+            tokio::time::sleep(std::time::Duration::from_millis(5)).await;
+        }
+
+        // Only packets read after the switch go out on the new channel
+        host_side.write_all(&packet(2)).unwrap();
+        received.clear();
+        while received.is_empty() {
+            second.recv_batch(8, &mut received).await.unwrap();
+        }
+        assert_eq!(received.len(), 1);
+        assert_eq!(received[0][1], 2);
+
+        pump.stop();
+    }
+}
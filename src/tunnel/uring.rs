@@ -0,0 +1,484 @@
+//! Minimal io_uring for batched TUN I/O
+//!
+//! Just enough of the io_uring ABI for the packet pump: fixed-buffer reads,
+//! plain writes, readiness polls and timeouts, submitted and reaped in batches so one
+//! `io_uring_enter` covers many packets. Rings are mapped by hand over
+//! `libc` the way [`super::netlink`] speaks rtnetlink, rather than pulling in
+//! a binding crate.
+//!
+//! Needs Linux 5.6 (`IORING_OP_WRITE` and opcode probing). [`IoUring::new`]
+//! fails on older kernels, or where io_uring is disabled, and callers fall
+//! back to their poll-based path.
+
+use std::io;
+use std::os::unix::io::{AsRawFd, FromRawFd, OwnedFd, RawFd};
+use std::ptr::NonNull;
+use std::sync::atomic::{AtomicU32, Ordering};
+
+const IORING_OFF_SQ_RING: libc::off_t = 0;
+const IORING_OFF_CQ_RING: libc::off_t = 0x800_0000;
+const IORING_OFF_SQES: libc::off_t = 0x1000_0000;
+
+const IORING_ENTER_GETEVENTS: u32 = 1;
+
+const IORING_REGISTER_BUFFERS: u32 = 0;
+const IORING_REGISTER_PROBE: u32 = 8;
+const IO_URING_OP_SUPPORTED: u16 = 1;
+
+const IORING_OP_READ_FIXED: u8 = 4;
+const IORING_OP_POLL_ADD: u8 = 6;
+const IORING_OP_TIMEOUT: u8 = 11;
+const IORING_OP_WRITE: u8 = 23;
+
+/// Opcodes the pump submits; the ring is refused unless all are supported
+const REQUIRED_OPS: [u8; 4] = [IORING_OP_READ_FIXED, IORING_OP_POLL_ADD, IORING_OP_TIMEOUT, IORING_OP_WRITE];
+
+#[repr(C)]
+#[derive(Default)]
+struct SqringOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    flags: u32,
+    dropped: u32,
+    array: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+#[repr(C)]
+#[derive(Default)]
+struct CqringOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    overflow: u32,
+    cqes: u32,
+    flags: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+#[repr(C)]
+#[derive(Default)]
+struct Params {
+    sq_entries: u32,
+    cq_entries: u32,
+    flags: u32,
+    sq_thread_cpu: u32,
+    sq_thread_idle: u32,
+    features: u32,
+    wq_fd: u32,
+    resv: [u32; 3],
+    sq_off: SqringOffsets,
+    cq_off: CqringOffsets,
+}
+
+/// Submission queue entry
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct Sqe {
+    opcode: u8,
+    flags: u8,
+    ioprio: u16,
+    fd: i32,
+    off: u64,
+    addr: u64,
+    len: u32,
+    op_flags: u32,
+    user_data: u64,
+    buf_index: u16,
+    personality: u16,
+    splice_fd_in: i32,
+    addr3: u64,
+    pad: u64,
+}
+
+impl Sqe {
+    /// Read up to `len` bytes into registered buffer `buf_index`, starting at `buf`
+    pub fn read_fixed(fd: RawFd, buf: *mut u8, len: u32, buf_index: u16, user_data: u64) -> Self {
+        // Offset 0: TUN devices and sockets ignore it
+        Self { opcode: IORING_OP_READ_FIXED, fd, addr: buf as u64, len, buf_index, user_data, ..Self::default() }
+    }
+
+    /// Write `len` bytes from `buf`
+    pub fn write(fd: RawFd, buf: *const u8, len: u32, user_data: u64) -> Self {
+        Self { opcode: IORING_OP_WRITE, fd, addr: buf as u64, len, user_data, ..Self::default() }
+    }
+
+    /// Complete once `fd` is readable (one-shot)
+    pub fn poll_readable(fd: RawFd, user_data: u64) -> Self {
+        // `poll32_events`, which the kernel reads halfword-swapped on big endian
+        let events = libc::POLLIN as u32;
+        #[cfg(target_endian = "big")]
+        let events = events.rotate_left(16);
+        Self { opcode: IORING_OP_POLL_ADD, fd, op_flags: events, user_data, ..Self::default() }
+    }
+
+    /// Complete with `-ETIME` after `timeout`
+    ///
+    /// The kernel copies `timeout` while the entry is submitted.
+    pub fn timeout(timeout: &Timespec, user_data: u64) -> Self {
+        Self { opcode: IORING_OP_TIMEOUT, addr: timeout as *const Timespec as u64, len: 1, user_data, ..Self::default() }
+    }
+}
+
+/// `__kernel_timespec`
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct Timespec {
+    pub tv_sec: i64,
+    pub tv_nsec: i64,
+}
+
+impl From<std::time::Duration> for Timespec {
+    fn from(duration: std::time::Duration) -> Self {
+        Self { tv_sec: duration.as_secs() as i64, tv_nsec: duration.subsec_nanos() as i64 }
+    }
+}
+
+#[repr(C)]
+struct Cqe {
+    user_data: u64,
+    res: i32,
+    flags: u32,
+}
+
+/// Result of one completed operation
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Completion {
+    pub user_data: u64,
+    /// Bytes transferred, or a negated errno
+    pub result: i32,
+}
+
+/// Shared memory mapping, unmapped on drop
+struct Mmap {
+    ptr: NonNull<u8>,
+    len: usize,
+}
+
+impl Mmap {
+    fn ring(fd: RawFd, len: usize, offset: libc::off_t) -> io::Result<Self> {
+        Self::map(len, libc::MAP_SHARED | libc::MAP_POPULATE, fd, offset)
+    }
+
+    /// Anonymous memory, for buffers a ring may write to after it is closed
+    fn anonymous(len: usize) -> io::Result<Self> {
+        Self::map(len, libc::MAP_PRIVATE | libc::MAP_ANONYMOUS, -1, 0)
+    }
+
+    fn map(len: usize, flags: libc::c_int, fd: RawFd, offset: libc::off_t) -> io::Result<Self> {
+        let ptr = unsafe { libc::mmap(std::ptr::null_mut(), len, libc::PROT_READ | libc::PROT_WRITE, flags, fd, offset) };
+        if ptr == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(Self { ptr: NonNull::new(ptr as *mut u8).unwrap(), len })
+    }
+
+    /// `T` at byte `offset`
+    fn at<T>(&self, offset: u32) -> *mut T {
+        debug_assert!(offset as usize + std::mem::size_of::<T>() <= self.len);
+        unsafe { self.ptr.as_ptr().add(offset as usize) as *mut T }
+    }
+}
+
+impl Drop for Mmap {
+    fn drop(&mut self) {
+        unsafe { libc::munmap(self.ptr.as_ptr() as *mut libc::c_void, self.len) };
+    }
+}
+
+/// One io_uring instance
+pub struct IoUring {
+    // Field order is drop order: the ring fd is closed, cancelling whatever
+    // is in flight, before any mapping goes away
+    fd: OwnedFd,
+    sq_ring: Mmap,
+    cq_ring: Mmap,
+    sqes: Mmap,
+    buffers: Option<FixedBuffers>,
+    sq_off: SqringOffsets,
+    cq_off: CqringOffsets,
+    sq_entries: u32,
+    /// Entries pushed but not yet submitted
+    pending: u32,
+}
+
+// The mappings belong to this ring alone, and the ring to whichever thread owns it
+unsafe impl Send for IoUring {}
+
+impl IoUring {
+    /// Set up a ring of at least `entries` submission slots
+    pub fn new(entries: u32) -> io::Result<Self> {
+        let mut params = Params::default();
+        let fd = unsafe { libc::syscall(libc::SYS_io_uring_setup, entries, &mut params as *mut Params) };
+        if fd < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        let fd = unsafe { OwnedFd::from_raw_fd(fd as RawFd) };
+
+        let sq_len = params.sq_off.array as usize + params.sq_entries as usize * std::mem::size_of::<u32>();
+        let cq_len = params.cq_off.cqes as usize + params.cq_entries as usize * std::mem::size_of::<Cqe>();
+        let sqes_len = params.sq_entries as usize * std::mem::size_of::<Sqe>();
+        let ring = Self {
+            sq_ring: Mmap::ring(fd.as_raw_fd(), sq_len, IORING_OFF_SQ_RING)?,
+            cq_ring: Mmap::ring(fd.as_raw_fd(), cq_len, IORING_OFF_CQ_RING)?,
+            sqes: Mmap::ring(fd.as_raw_fd(), sqes_len, IORING_OFF_SQES)?,
+            buffers: None,
+            fd,
+            sq_off: params.sq_off,
+            cq_off: params.cq_off,
+            sq_entries: params.sq_entries,
+            pending: 0,
+        };
+        ring.check_ops()?;
+        Ok(ring)
+    }
+
+    /// Fail unless the kernel knows every opcode in [`REQUIRED_OPS`]
+    fn check_ops(&self) -> io::Result<()> {
+        // struct io_uring_probe: a 16 byte header plus 8 bytes per opcode
+        const OPS: usize = 64;
+        let mut probe = [0u8; 16 + OPS * 8];
+        self.register(IORING_REGISTER_PROBE, probe.as_mut_ptr() as *const libc::c_void, OPS as u32)?;
+        let ops_len = probe[1] as usize;
+        for op in REQUIRED_OPS {
+            let entry = 16 + op as usize * 8;
+            let flags = u16::from_ne_bytes([probe[entry + 2], probe[entry + 3]]);
+            if op as usize >= ops_len || flags & IO_URING_OP_SUPPORTED == 0 {
+                return Err(io::Error::new(io::ErrorKind::Unsupported, format!("io_uring opcode {} unsupported", op)));
+            }
+        }
+        Ok(())
+    }
+
+    fn register(&self, opcode: u32, arg: *const libc::c_void, nr_args: u32) -> io::Result<()> {
+        let ret = unsafe { libc::syscall(libc::SYS_io_uring_register, self.fd.as_raw_fd(), opcode, arg, nr_args) };
+        if ret < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(())
+    }
+
+    /// Submission slots
+    pub fn capacity(&self) -> u32 {
+        self.sq_entries
+    }
+
+    /// Register `slots` buffers of `slot_size` bytes for [`read_fixed`](Self::read_fixed)
+    pub fn register_buffers(&mut self, slots: usize, slot_size: usize) -> io::Result<()> {
+        let memory = Mmap::anonymous(slots * slot_size)?;
+        // One registration covering every slot; reads name their slot by address
+        let iov = libc::iovec { iov_base: memory.ptr.as_ptr() as *mut libc::c_void, iov_len: memory.len };
+        self.register(IORING_REGISTER_BUFFERS, &iov as *const libc::iovec as *const libc::c_void, 1)?;
+        self.buffers = Some(FixedBuffers { memory, slot_size, slots });
+        Ok(())
+    }
+
+    /// The registered buffers
+    ///
+    /// # Panics
+    /// If [`register_buffers`](Self::register_buffers) has not been called.
+    pub fn buffers(&self) -> &FixedBuffers {
+        self.buffers.as_ref().expect("io_uring buffers not registered")
+    }
+
+    /// A fixed read filling registered `slot`, tagged with the slot number
+    pub fn read_fixed(&self, fd: RawFd, slot: usize) -> Sqe {
+        let buffers = self.buffers();
+        Sqe::read_fixed(fd, buffers.slot_ptr(slot), buffers.slot_size as u32, 0, slot as u64)
+    }
+
+    /// Queue `sqe` for the next [`submit_and_wait`](Self::submit_and_wait)
+    ///
+    /// Returns false if the submission queue is full.
+    ///
+    /// # Safety
+    /// Whatever `sqe` points to must stay valid until its completion is reaped
+    /// or the ring is dropped.
+    pub unsafe fn push(&mut self, sqe: Sqe) -> bool {
+        let head = (*self.sq_ring.at::<AtomicU32>(self.sq_off.head)).load(Ordering::Acquire);
+        let tail_ptr = self.sq_ring.at::<AtomicU32>(self.sq_off.tail);
+        let tail = (*tail_ptr).load(Ordering::Relaxed);
+        if tail.wrapping_sub(head) >= self.sq_entries {
+            return false;
+        }
+        let mask = *self.sq_ring.at::<u32>(self.sq_off.ring_mask);
+        let index = tail & mask;
+        self.sqes.at::<Sqe>(0).add(index as usize).write(sqe);
+        self.sq_ring.at::<u32>(self.sq_off.array).add(index as usize).write(index);
+        (*tail_ptr).store(tail.wrapping_add(1), Ordering::Release);
+        self.pending += 1;
+        true
+    }
+
+    /// Queue `sqe`, first submitting what is queued if the submission queue is full
+    ///
+    /// # Safety
+    /// As for [`push`](Self::push).
+    pub unsafe fn push_or_submit(&mut self, sqe: Sqe) -> io::Result<()> {
+        if self.push(sqe) {
+            return Ok(());
+        }
+        self.submit_and_wait(0)?;
+        if self.push(sqe) {
+            Ok(())
+        } else {
+            Err(io::Error::new(io::ErrorKind::WouldBlock, "io_uring submission queue is full"))
+        }
+    }
+
+    /// Submit everything pushed and wait for at least `want` completions
+    pub fn submit_and_wait(&mut self, want: u32) -> io::Result<()> {
+        let flags = if want > 0 { IORING_ENTER_GETEVENTS } else { 0 };
+        loop {
+            let ret = unsafe {
+                libc::syscall(
+                    libc::SYS_io_uring_enter,
+                    self.fd.as_raw_fd(),
+                    self.pending,
+                    want,
+                    flags,
+                    std::ptr::null::<libc::sigset_t>(),
+                    0usize,
+                )
+            };
+            if ret >= 0 {
+                self.pending -= (ret as u32).min(self.pending);
+                return Ok(());
+            }
+            let err = io::Error::last_os_error();
+            if err.kind() != io::ErrorKind::Interrupted {
+                return Err(err);
+            }
+        }
+    }
+
+    /// Next completion, if one is ready
+    pub fn completion(&mut self) -> Option<Completion> {
+        let head_ptr = self.cq_ring.at::<AtomicU32>(self.cq_off.head);
+        unsafe {
+            let head = (*head_ptr).load(Ordering::Relaxed);
+            let tail = (*self.cq_ring.at::<AtomicU32>(self.cq_off.tail)).load(Ordering::Acquire);
+            if head == tail {
+                return None;
+            }
+            let mask = *self.cq_ring.at::<u32>(self.cq_off.ring_mask);
+            let cqe = &*self.cq_ring.at::<Cqe>(self.cq_off.cqes).add((head & mask) as usize);
+            let completion = Completion { user_data: cqe.user_data, result: cqe.res };
+            (*head_ptr).store(head.wrapping_add(1), Ordering::Release);
+            Some(completion)
+        }
+    }
+}
+
+/// Equal-sized buffers registered with a ring for fixed-buffer reads
+///
+/// Backed by an anonymous mapping that lives as long as the ring, so memory
+/// the kernel may still write into is never handed out by the allocator.
+pub struct FixedBuffers {
+    memory: Mmap,
+    slot_size: usize,
+    slots: usize,
+}
+
+impl FixedBuffers {
+    pub fn slots(&self) -> usize {
+        self.slots
+    }
+
+    pub fn slot_size(&self) -> usize {
+        self.slot_size
+    }
+
+    /// First `len` bytes of `slot`
+    ///
+    /// Only meaningful once the read issued for it has completed.
+    pub fn filled(&self, slot: usize, len: usize) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.slot_ptr(slot), len.min(self.slot_size)) }
+    }
+
+    fn slot_ptr(&self, slot: usize) -> *mut u8 {
+        assert!(slot < self.slots);
+        unsafe { self.memory.ptr.as_ptr().add(slot * self.slot_size) }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_fixed_reads_and_writes_round_trip() {
+        let mut ring = match IoUring::new(8) {
+            Ok(ring) => ring,
+            Err(e) => {
+                eprintln!("io_uring unavailable, skipping: {}", e);
+                return;
+            }
+        };
+        ring.register_buffers(2, 64).unwrap();
+        let mut fds = [0 as libc::c_int; 2];
+        assert_eq!(unsafe { libc::socketpair(libc::AF_UNIX, libc::SOCK_SEQPACKET, 0, fds.as_mut_ptr()) }, 0);
+        let (a, b) = unsafe { (OwnedFd::from_raw_fd(fds[0]), OwnedFd::from_raw_fd(fds[1])) };
+
+        let messages: [&[u8]; 2] = [b"first", b"second packet"];
+        unsafe {
+            assert!(ring.push(ring.read_fixed(b.as_raw_fd(), 0)));
+            assert!(ring.push(ring.read_fixed(b.as_raw_fd(), 1)));
+            for (i, message) in messages.iter().enumerate() {
+                assert!(ring.push(Sqe::write(a.as_raw_fd(), message.as_ptr(), message.len() as u32, 10 + i as u64)));
+            }
+        }
+        let mut completions = Vec::new();
+        while completions.len() < 4 {
+            ring.submit_and_wait(1).unwrap();
+            completions.extend(std::iter::from_fn(|| ring.completion()));
+        }
+
+        let mut received: Vec<&[u8]> = completions
+            .iter()
+            .filter(|c| c.user_data < 2)
+            .map(|c| ring.buffers().filled(c.user_data as usize, c.result as usize))
+            .collect();
+        received.sort();
+        assert_eq!(received, messages);
+        assert!(completions.iter().filter(|c| c.user_data >= 10).all(|c| c.result > 0));
+
+        let timeout = Timespec::from(std::time::Duration::from_millis(1));
+        unsafe { assert!(ring.push(Sqe::timeout(&timeout, 99))) };
+        ring.submit_and_wait(1).unwrap();
+        assert_eq!(ring.completion(), Some(Completion { user_data: 99, result: -libc::ETIME }));
+    }
+
+    #[test]
+    fn test_push_or_submit_flushes_a_full_queue() {
+        let mut ring = match IoUring::new(2) {
+            Ok(ring) => ring,
+            Err(e) => {
+                eprintln!("io_uring unavailable, skipping: {}", e);
+                return;
+            }
+        };
+        let timeout = Timespec::from(std::time::Duration::from_millis(1));
+        let entries = ring.capacity() as u64;
+        unsafe {
+            for i in 0..entries {
+                assert!(ring.push(Sqe::timeout(&timeout, i)));
+            }
+            assert!(!ring.push(Sqe::timeout(&timeout, entries)));
+            ring.push_or_submit(Sqe::timeout(&timeout, entries)).unwrap();
+        }
+
+        let mut completed = Vec::new();
+        while completed.len() as u64 <= entries {
+            ring.submit_and_wait(1).unwrap();
+            completed.extend(std::iter::from_fn(|| ring.completion()).map(|c| c.user_data));
+        }
+        completed.sort();
+        assert_eq!(completed, (0..=entries).collect::<Vec<_>>());
+    }
+}
@@ -2,6 +2,9 @@
 //! 
 //! Provides Windows-specific TUN/TAP interface management using
 //! the OpenVPN TAP-Windows adapter
+//!
+//! This costs a ReadFile/WriteFile per packet; [`super::wintun`] moves
+//! packets through Wintun's shared-memory rings instead.
 
 use crate::error::{Result, VpnError};
 use std::ffi::OsString;
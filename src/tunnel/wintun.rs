@@ -0,0 +1,514 @@
+//! Wintun ring-buffer TUN backend for Windows
+//!
+//! Wintun exchanges packets with the driver through a pair of shared-memory
+//! rings instead of one ReadFile/WriteFile per packet. Received packets are
+//! read in place in the receive ring and released once the data channel has
+//! framed them; outgoing packets are written straight into space allocated
+//! in the send ring. The driver only needs a kernel transition when a ring
+//! goes from empty to non-empty, so a burst costs one event wait.
+//!
+//! `wintun.dll` is loaded at runtime from the application directory or
+//! System32, so the library still loads on machines without it.
+
+use crate::error::{Result, VpnError};
+use crate::protocol::binary::{BinaryDataReader, BinaryDataWriter, DataReadHalf, DataWriteHalf};
+use crate::tunnel::DataChannelConnect;
+use bytes::Bytes;
+use std::ffi::OsStr;
+use std::os::windows::ffi::OsStrExt;
+use std::ptr;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::Arc;
+use std::thread;
+use std::time::Duration;
+use winapi::shared::guiddef::GUID;
+use winapi::shared::minwindef::{BYTE, DWORD, FARPROC, HMODULE};
+use winapi::shared::winerror::{ERROR_BUFFER_OVERFLOW, ERROR_HANDLE_EOF, ERROR_NO_MORE_ITEMS, WAIT_TIMEOUT};
+use winapi::um::errhandlingapi::GetLastError;
+use winapi::um::libloaderapi::{
+    FreeLibrary, GetProcAddress, LoadLibraryExW, LOAD_LIBRARY_SEARCH_APPLICATION_DIR, LOAD_LIBRARY_SEARCH_SYSTEM32,
+};
+use winapi::um::synchapi::WaitForSingleObject;
+use winapi::um::winbase::{WAIT_FAILED, WAIT_OBJECT_0};
+use winapi::um::winnt::{HANDLE, LPCWSTR};
+
+/// Smallest ring capacity Wintun accepts (128 KiB)
+pub const MIN_RING_CAPACITY: u32 = 0x2_0000;
+
+/// Largest ring capacity Wintun accepts (64 MiB)
+pub const MAX_RING_CAPACITY: u32 = 0x400_0000;
+
+/// Largest packet the rings carry
+pub const MAX_IP_PACKET_SIZE: usize = 0xFFFF;
+
+/// How often the ring reader checks for shutdown while idle
+const READ_WAIT_TIMEOUT: Duration = Duration::from_millis(100);
+
+type AdapterHandle = *mut std::ffi::c_void;
+type SessionHandle = *mut std::ffi::c_void;
+
+/// Entry points of `wintun.dll`
+struct WintunApi {
+    module: HMODULE,
+    create_adapter: unsafe extern "system" fn(LPCWSTR, LPCWSTR, *const GUID) -> AdapterHandle,
+    open_adapter: unsafe extern "system" fn(LPCWSTR) -> AdapterHandle,
+    close_adapter: unsafe extern "system" fn(AdapterHandle),
+    get_running_driver_version: unsafe extern "system" fn() -> DWORD,
+    start_session: unsafe extern "system" fn(AdapterHandle, DWORD) -> SessionHandle,
+    end_session: unsafe extern "system" fn(SessionHandle),
+    get_read_wait_event: unsafe extern "system" fn(SessionHandle) -> HANDLE,
+    receive_packet: unsafe extern "system" fn(SessionHandle, *mut DWORD) -> *mut BYTE,
+    release_receive_packet: unsafe extern "system" fn(SessionHandle, *const BYTE),
+    allocate_send_packet: unsafe extern "system" fn(SessionHandle, DWORD) -> *mut BYTE,
+    send_packet: unsafe extern "system" fn(SessionHandle, *const BYTE),
+}
+
+// The module handle and function pointers are process-wide
+unsafe impl Send for WintunApi {}
+unsafe impl Sync for WintunApi {}
+
+impl WintunApi {
+    fn load() -> Result<Arc<Self>> {
+        let name = wide("wintun.dll");
+        let module = unsafe {
+            LoadLibraryExW(
+                name.as_ptr(),
+                ptr::null_mut(),
+                LOAD_LIBRARY_SEARCH_APPLICATION_DIR | LOAD_LIBRARY_SEARCH_SYSTEM32,
+            )
+        };
+        if module.is_null() {
+            return Err(VpnError::TunTap(format!(
+                "Failed to load wintun.dll: error code {}",
+                unsafe { GetLastError() }
+            )));
+        }
+
+        let symbol = |name: &[u8]| -> Result<FARPROC> {
+            let proc = unsafe { GetProcAddress(module, name.as_ptr() as *const i8) };
+            if proc.is_null() {
+                let name = String::from_utf8_lossy(&name[..name.len() - 1]).into_owned();
+                return Err(VpnError::TunTap(format!("wintun.dll has no {}", name)));
+            }
+            Ok(proc)
+        };
+        let resolve = || -> Result<Self> {
+            // SAFETY: each symbol is transmuted to its signature in wintun.h
+            unsafe {
+                Ok(Self {
+                    module,
+                    create_adapter: std::mem::transmute(symbol(b"WintunCreateAdapter\0")?),
+                    open_adapter: std::mem::transmute(symbol(b"WintunOpenAdapter\0")?),
+                    close_adapter: std::mem::transmute(symbol(b"WintunCloseAdapter\0")?),
+                    get_running_driver_version: std::mem::transmute(symbol(b"WintunGetRunningDriverVersion\0")?),
+                    start_session: std::mem::transmute(symbol(b"WintunStartSession\0")?),
+                    end_session: std::mem::transmute(symbol(b"WintunEndSession\0")?),
+                    get_read_wait_event: std::mem::transmute(symbol(b"WintunGetReadWaitEvent\0")?),
+                    receive_packet: std::mem::transmute(symbol(b"WintunReceivePacket\0")?),
+                    release_receive_packet: std::mem::transmute(symbol(b"WintunReleaseReceivePacket\0")?),
+                    allocate_send_packet: std::mem::transmute(symbol(b"WintunAllocateSendPacket\0")?),
+                    send_packet: std::mem::transmute(symbol(b"WintunSendPacket\0")?),
+                })
+            }
+        };
+        match resolve() {
+            Ok(api) => Ok(Arc::new(api)),
+            Err(e) => {
+                unsafe { FreeLibrary(module) };
+                Err(e)
+            }
+        }
+    }
+}
+
+impl Drop for WintunApi {
+    fn drop(&mut self) {
+        unsafe { FreeLibrary(self.module) };
+    }
+}
+
+/// A Wintun network adapter
+pub struct WintunAdapter {
+    api: Arc<WintunApi>,
+    handle: AdapterHandle,
+    name: String,
+}
+
+// Wintun adapter handles may be used from any thread
+unsafe impl Send for WintunAdapter {}
+unsafe impl Sync for WintunAdapter {}
+
+impl WintunAdapter {
+    /// Open the adapter called `name`, creating it if it does not exist
+    ///
+    /// Creating an adapter requires Administrator rights.
+    pub fn open_or_create(name: &str, tunnel_type: &str) -> Result<Self> {
+        let api = WintunApi::load()?;
+        let wide_name = wide(name);
+        let mut handle = unsafe { (api.open_adapter)(wide_name.as_ptr()) };
+        if handle.is_null() {
+            let wide_type = wide(tunnel_type);
+            handle = unsafe { (api.create_adapter)(wide_name.as_ptr(), wide_type.as_ptr(), ptr::null()) };
+        }
+        if handle.is_null() {
+            return Err(VpnError::TunTap(format!(
+                "Failed to open Wintun adapter {}: error code {}",
+                name,
+                unsafe { GetLastError() }
+            )));
+        }
+
+        let version = unsafe { (api.get_running_driver_version)() };
+        log::info!("Wintun adapter {} opened (driver {}.{})", name, version >> 16, version & 0xffff);
+        Ok(Self { api, handle, name: name.to_string() })
+    }
+
+    /// Adapter name
+    pub fn name(&self) -> &str {
+        &self.name
+    }
+
+    /// Start a session with rings of about `capacity` bytes each
+    ///
+    /// The capacity is rounded to the power of two Wintun requires.
+    pub fn start_session(self: &Arc<Self>, capacity: u32) -> Result<WintunSession> {
+        let capacity = ring_capacity(capacity);
+        let handle = unsafe { (self.api.start_session)(self.handle, capacity) };
+        if handle.is_null() {
+            return Err(VpnError::TunTap(format!(
+                "Failed to start Wintun session: error code {}",
+                unsafe { GetLastError() }
+            )));
+        }
+        let read_event = unsafe { (self.api.get_read_wait_event)(handle) };
+        log::debug!("Wintun session started on {} ({} KiB rings)", self.name, capacity / 1024);
+        Ok(WintunSession { adapter: self.clone(), handle, read_event })
+    }
+}
+
+impl Drop for WintunAdapter {
+    fn drop(&mut self) {
+        unsafe { (self.api.close_adapter)(self.handle) };
+        log::info!("Wintun adapter {} closed", self.name);
+    }
+}
+
+/// A pair of send/receive rings shared with the Wintun driver
+///
+/// Packets are received by one thread at a time through [`RecvBurst`];
+/// sending is safe from any thread, alongside the receiver.
+pub struct WintunSession {
+    adapter: Arc<WintunAdapter>,
+    handle: SessionHandle,
+    /// Signalled when the receive ring becomes non-empty; owned by the session
+    read_event: HANDLE,
+}
+
+// Wintun sessions are documented as safe for concurrent send and receive
+unsafe impl Send for WintunSession {}
+unsafe impl Sync for WintunSession {}
+
+impl WintunSession {
+    /// Reusable receive burst of up to `max_packets` packets
+    pub fn burst(&self, max_packets: usize) -> RecvBurst<'_> {
+        RecvBurst { session: self, packets: Vec::with_capacity(max_packets.max(1)) }
+    }
+
+    /// Copy `packet` into the send ring and hand it to the driver
+    ///
+    /// Returns `false` if the packet was dropped: the ring is full, or the
+    /// packet is larger than the rings carry.
+    pub fn send(&self, packet: &[u8]) -> Result<bool> {
+        let api = &self.adapter.api;
+        if packet.len() > MAX_IP_PACKET_SIZE {
+            log::debug!("Dropping {} byte packet, over the Wintun maximum", packet.len());
+            return Ok(false);
+        }
+        let slot = unsafe { (api.allocate_send_packet)(self.handle, packet.len() as DWORD) };
+        if slot.is_null() {
+            return match unsafe { GetLastError() } {
+                ERROR_BUFFER_OVERFLOW => Ok(false),
+                ERROR_HANDLE_EOF => Err(VpnError::TunTap("Wintun adapter is shutting down".to_string())),
+                code => Err(VpnError::TunTap(format!("Failed to allocate Wintun send packet: error code {}", code))),
+            };
+        }
+        // SAFETY: the driver allocated `packet.len()` bytes at `slot` for us
+        unsafe {
+            ptr::copy_nonoverlapping(packet.as_ptr(), slot, packet.len());
+            (api.send_packet)(self.handle, slot);
+        }
+        Ok(true)
+    }
+
+    /// Send every packet of a batch; returns how many were dropped
+    pub fn send_batch<'a, I>(&self, packets: I) -> Result<usize>
+    where
+        I: IntoIterator<Item = &'a [u8]>,
+    {
+        let mut dropped = 0;
+        for packet in packets {
+            if !self.send(packet)? {
+                dropped += 1;
+            }
+        }
+        Ok(dropped)
+    }
+
+    /// Wait until the receive ring may be non-empty; `false` on timeout
+    fn wait_readable(&self, timeout: Duration) -> Result<bool> {
+        match unsafe { WaitForSingleObject(self.read_event, timeout.as_millis() as DWORD) } {
+            WAIT_OBJECT_0 => Ok(true),
+            WAIT_TIMEOUT => Ok(false),
+            WAIT_FAILED => Err(VpnError::TunTap(format!(
+                "Failed to wait for Wintun packets: error code {}",
+                unsafe { GetLastError() }
+            ))),
+            other => Err(VpnError::TunTap(format!("Unexpected Wintun wait result {}", other))),
+        }
+    }
+}
+
+impl Drop for WintunSession {
+    fn drop(&mut self) {
+        unsafe { (self.adapter.api.end_session)(self.handle) };
+    }
+}
+
+/// Packets borrowed from the receive ring
+///
+/// The packets stay in the ring, readable through [`RecvBurst::iter`],
+/// until the burst is refilled, released or dropped.
+pub struct RecvBurst<'s> {
+    session: &'s WintunSession,
+    packets: Vec<(*const u8, usize)>,
+}
+
+impl RecvBurst<'_> {
+    /// Release the current packets and take up to the burst's capacity of
+    /// new ones, waiting at most `timeout` once if the ring is empty
+    ///
+    /// Returns the number of packets now held; zero after a timeout.
+    pub fn fill(&mut self, timeout: Duration) -> Result<usize> {
+        self.release();
+        if self.take_ready()? == 0 && self.session.wait_readable(timeout)? {
+            self.take_ready()?;
+        }
+        Ok(self.packets.len())
+    }
+
+    /// Move packets already in the ring into the burst, without waiting
+    fn take_ready(&mut self) -> Result<usize> {
+        let api = &self.session.adapter.api;
+        while self.packets.len() < self.packets.capacity() {
+            let mut size: DWORD = 0;
+            let packet = unsafe { (api.receive_packet)(self.session.handle, &mut size) };
+            if packet.is_null() {
+                return match unsafe { GetLastError() } {
+                    ERROR_NO_MORE_ITEMS => Ok(self.packets.len()),
+                    ERROR_HANDLE_EOF => Err(VpnError::TunTap("Wintun adapter is shutting down".to_string())),
+                    code => Err(VpnError::TunTap(format!("Failed to receive Wintun packet: error code {}", code))),
+                };
+            }
+            self.packets.push((packet as *const u8, size as usize));
+        }
+        Ok(self.packets.len())
+    }
+
+    /// Number of packets held
+    pub fn len(&self) -> usize {
+        self.packets.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.packets.is_empty()
+    }
+
+    /// The held packets, in ring order
+    pub fn iter(&self) -> impl Iterator<Item = &[u8]> + '_ {
+        // SAFETY: each packet stays valid in the ring until released
+        self.packets.iter().map(|&(packet, size)| unsafe { std::slice::from_raw_parts(packet, size) })
+    }
+
+    /// Hand the held packets' ring space back to the driver
+    pub fn release(&mut self) {
+        let api = &self.session.adapter.api;
+        for (packet, _) in self.packets.drain(..) {
+            unsafe { (api.release_receive_packet)(self.session.handle, packet) };
+        }
+    }
+}
+
+impl Drop for RecvBurst<'_> {
+    fn drop(&mut self) {
+        self.release();
+    }
+}
+
+/// Packet counters of a [`WintunPump`]
+#[derive(Debug, Default)]
+pub struct WintunPumpStats {
+    pub uplink_packets: AtomicU64,
+    pub uplink_bursts: AtomicU64,
+    pub downlink_packets: AtomicU64,
+    /// Downlink packets dropped because the send ring was full or they were oversized
+    pub downlink_dropped: AtomicU64,
+}
+
+/// Moves packets between a Wintun session and a data channel
+///
+/// Uplink runs on a dedicated thread: each burst is framed and sent
+/// directly from the receive ring, then released. Downlink runs as a task
+/// on the data channel's runtime and writes received batches into the send
+/// ring, which never blocks. The downlink task opens the data channel and
+/// hands the uplink thread its write half.
+pub struct WintunPump {
+    running: Arc<AtomicBool>,
+    stats: Arc<WintunPumpStats>,
+    uplink: Option<thread::JoinHandle<()>>,
+    downlink: tokio::task::JoinHandle<()>,
+}
+
+impl WintunPump {
+    /// Start pumping with bursts of up to `batch_size` packets once `connect` opens the data channel
+    pub fn start(
+        session: Arc<WintunSession>,
+        connect: DataChannelConnect,
+        runtime: &tokio::runtime::Handle,
+        batch_size: usize,
+    ) -> Result<Self> {
+        let running = Arc::new(AtomicBool::new(true));
+        let stats = Arc::new(WintunPumpStats::default());
+        let (writer_tx, writer_rx) = std::sync::mpsc::sync_channel::<BinaryDataWriter<DataWriteHalf>>(1);
+
+        let uplink = {
+            let session = session.clone();
+            let running = running.clone();
+            let stats = stats.clone();
+            let runtime = runtime.clone();
+            thread::Builder::new()
+                .name("wintun-uplink".to_string())
+                .spawn(move || {
+                    // Gone if the data channel failed to open or the pump stopped first
+                    let Ok(mut writer) = writer_rx.recv() else {
+                        running.store(false, Ordering::Relaxed);
+                        return;
+                    };
+                    let mut burst = session.burst(batch_size);
+                    while running.load(Ordering::Relaxed) {
+                        let packets = match burst.fill(READ_WAIT_TIMEOUT) {
+                            Ok(0) => continue,
+                            Ok(packets) => packets,
+                            Err(e) => {
+                                log::error!("Wintun uplink stopped: {}", e);
+                                break;
+                            }
+                        };
+                        if let Err(e) = runtime.block_on(writer.send_batch(burst.iter())) {
+                            log::error!("Wintun uplink stopped: {}", e);
+                            break;
+                        }
+                        stats.uplink_packets.fetch_add(packets as u64, Ordering::Relaxed);
+                        stats.uplink_bursts.fetch_add(1, Ordering::Relaxed);
+                    }
+                    running.store(false, Ordering::Relaxed);
+                })
+                .map_err(|e| VpnError::TunTap(format!("Failed to spawn Wintun uplink thread: {}", e)))?
+        };
+
+        let downlink = runtime.spawn(downlink_loop(session, connect, writer_tx, running.clone(), stats.clone(), batch_size));
+
+        Ok(Self { running, stats, uplink: Some(uplink), downlink })
+    }
+
+    /// Packet counters
+    pub fn stats(&self) -> Arc<WintunPumpStats> {
+        self.stats.clone()
+    }
+
+    /// Whether both directions are still running
+    pub fn is_running(&self) -> bool {
+        self.running.load(Ordering::Relaxed)
+    }
+
+    /// Stop both directions and wait for the uplink thread
+    pub fn stop(&mut self) {
+        self.running.store(false, Ordering::Relaxed);
+        self.downlink.abort();
+        if let Some(uplink) = self.uplink.take() {
+            let _ = uplink.join();
+        }
+    }
+}
+
+impl Drop for WintunPump {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+async fn downlink_loop(
+    session: Arc<WintunSession>,
+    connect: DataChannelConnect,
+    writer_tx: std::sync::mpsc::SyncSender<BinaryDataWriter<DataWriteHalf>>,
+    running: Arc<AtomicBool>,
+    stats: Arc<WintunPumpStats>,
+    batch_size: usize,
+) {
+    let mut reader: BinaryDataReader<DataReadHalf> = match connect.await.and_then(|client| client.into_split()) {
+        Ok((reader, writer)) => {
+            if writer_tx.send(writer).is_err() {
+                return; // The uplink thread has already stopped
+            }
+            reader
+        }
+        Err(e) => {
+            log::error!("Wintun data channel failed to open: {}", e);
+            running.store(false, Ordering::Relaxed);
+            return;
+        }
+    };
+    let mut packets: Vec<Bytes> = Vec::with_capacity(batch_size);
+    while running.load(Ordering::Relaxed) {
+        if let Err(e) = reader.recv_batch(batch_size, &mut packets).await {
+            log::error!("Wintun downlink stopped: {}", e);
+            break;
+        }
+        match session.send_batch(packets.iter().map(|packet| &packet[..])) {
+            Ok(dropped) => {
+                stats.downlink_packets.fetch_add((packets.len() - dropped) as u64, Ordering::Relaxed);
+                stats.downlink_dropped.fetch_add(dropped as u64, Ordering::Relaxed);
+            }
+            Err(e) => {
+                log::error!("Wintun downlink stopped: {}", e);
+                break;
+            }
+        }
+        packets.clear();
+    }
+    running.store(false, Ordering::Relaxed);
+}
+
+/// Nearest ring capacity Wintun accepts: a power of two within its limits
+fn ring_capacity(requested: u32) -> u32 {
+    requested
+        .clamp(MIN_RING_CAPACITY, MAX_RING_CAPACITY)
+        .checked_next_power_of_two()
+        .unwrap_or(MAX_RING_CAPACITY)
+}
+
+fn wide(s: &str) -> Vec<u16> {
+    OsStr::new(s).encode_wide().chain(std::iter::once(0)).collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_ring_capacity_is_a_power_of_two_within_limits() {
+        assert_eq!(ring_capacity(0), MIN_RING_CAPACITY);
+        assert_eq!(ring_capacity(MIN_RING_CAPACITY + 1), MIN_RING_CAPACITY * 2);
+        assert_eq!(ring_capacity(4 << 20), 4 << 20);
+        assert_eq!(ring_capacity(u32::MAX), MAX_RING_CAPACITY);
+    }
+}